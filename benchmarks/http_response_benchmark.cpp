@@ -0,0 +1,105 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/http_response.h"
+#include "microhttp/serialized_response.h"
+#include "microloop/buffer.h"
+#include "microloop/buffer_pool.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using microhttp::http::HttpResponse;
+
+static const std::vector<std::pair<std::string, std::string>> headers = {
+    {"Content-Type", "text/html; charset=utf-8"},
+    {"Server", "microhttp"},
+};
+
+/**
+ * The serializer responses were formatted with before: a string stream, the version rendered
+ * through another string stream, and a copy into the buffer through `c_str()`.
+ */
+static microloop::Buffer format_with_stream(const HttpResponse &response)
+{
+  std::ostringstream ss;
+  ss << static_cast<std::string>(response.http_version()) << " " << response.status_code() << " "
+     << response.reason_phrase() << "\r\n";
+
+  ss << "Content-Length: " << std::to_string(response.content().size()) << "\r\n";
+  for (const auto &[name, value] : headers)
+  {
+    ss << name << ": " << value << "\r\n";
+  }
+
+  ss << "\r\n" << response.content().str_view();
+
+  return microloop::Buffer{ss.str().c_str()};
+}
+
+/**
+ * Serialize the same response over and over, and return the number of responses per second.
+ */
+template <class Serialize>
+static double serialize_rate(std::uint64_t iterations, Serialize serialize)
+{
+  std::uint64_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::uint64_t i = 0; i != iterations; ++i)
+  {
+    bytes += serialize();
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  /*
+   * Keep the compiler from discarding the serialized responses.
+   */
+  asm volatile("" : : "r"(bytes));
+
+  return iterations / elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+  std::uint64_t iterations = argc > 1 ? std::stoull(argv[1]) : 1000000;
+
+  std::string body(4096, 'x');
+  HttpResponse response{microloop::Buffer{body.data(), body.size()}};
+  for (const auto &[name, value] : headers)
+  {
+    response.set_header(name, value);
+  }
+
+  microloop::BufferPool pool{1024};
+
+  std::vector<std::pair<const char *, double>> rates = {
+      {"ostringstream",
+          serialize_rate(iterations, [&] { return format_with_stream(response).size(); })},
+      {"format<Buffer>",
+          serialize_rate(
+              iterations, [&] { return response.format<microloop::Buffer>().size(); })},
+      {"pooled head",
+          serialize_rate(iterations,
+              [&] { return microhttp::http::SerializedResponse{response, pool}.size(); })},
+  };
+
+  std::cout << "iterations: " << iterations << ", body: " << body.size() << " bytes\n\n";
+  std::cout << std::left << std::setw(16) << "serializer" << std::right << std::setw(16)
+            << "responses/s" << std::setw(11) << "speedup\n";
+
+  for (const auto &[name, rate] : rates)
+  {
+    std::cout << std::left << std::setw(16) << name << std::right << std::fixed
+              << std::setprecision(0) << std::setw(16) << rate << std::setprecision(2)
+              << std::setw(10) << rate / rates.front().second << "x\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,194 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/router.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using microhttp::http::Method;
+using microhttp::http::Router;
+
+/// The number of allocations made so far, to check that matching does not allocate
+static std::uint64_t allocations = 0;
+
+void *operator new(std::size_t size)
+{
+  ++allocations;
+  if (auto ptr = std::malloc(size ? size : 1); ptr)
+  {
+    return ptr;
+  }
+
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+/**
+ * The routing every server had before the router: the patterns are tried one after the other,
+ * segment by segment.
+ */
+class LinearRouter
+{
+public:
+  void add(Method method, std::string pattern)
+  {
+    routes_.push_back({method, std::move(pattern)});
+  }
+
+  bool match(Method method, std::string_view path) const
+  {
+    for (const auto &route : routes_)
+    {
+      if (route.method == method && matches(route.pattern, path))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  struct Route
+  {
+    Method method;
+    std::string pattern;
+  };
+
+  static bool matches(std::string_view pattern, std::string_view path)
+  {
+    while (!pattern.empty() && !path.empty())
+    {
+      auto pattern_segment = pattern.substr(0, pattern.find('/', 1));
+      auto path_segment = path.substr(0, path.find('/', 1));
+
+      if (pattern_segment.substr(0, 2) == "/*")
+      {
+        return true;
+      }
+
+      if (pattern_segment.substr(0, 2) == "/:" ? path_segment.size() < 2
+                                                : pattern_segment != path_segment)
+      {
+        return false;
+      }
+
+      pattern.remove_prefix(pattern_segment.size());
+      path.remove_prefix(path_segment.size());
+    }
+
+    return pattern.empty() && path.empty();
+  }
+
+  std::vector<Route> routes_;
+};
+
+/**
+ * Match the paths over and over, and return the number of matches per second.
+ */
+template <class Match>
+static double match_rate(
+    std::uint64_t iterations, const std::vector<std::string> &paths, Match match)
+{
+  std::uint64_t found = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::uint64_t i = 0; i != iterations; ++i)
+  {
+    found += match(paths[i % paths.size()]);
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  /*
+   * Keep the compiler from discarding the matches.
+   */
+  asm volatile("" : : "r"(found));
+
+  return iterations / elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+  std::uint64_t iterations = argc > 1 ? std::stoull(argv[1]) : 100000;
+  std::size_t resources = argc > 2 ? std::stoull(argv[2]) : 500;
+
+  Router router;
+  LinearRouter linear;
+  auto handler = [](const auto &, auto &, const auto &) {};
+
+  /*
+   * A REST API: every resource has a collection, items, nested items and a few actions.
+   */
+  for (std::size_t idx = 0; idx != resources; ++idx)
+  {
+    auto resource = "/api/v1/resource" + std::to_string(idx);
+    for (auto [method, pattern] : std::vector<std::pair<Method, std::string>>{
+             {Method::GET, resource},
+             {Method::POST, resource},
+             {Method::GET, resource + "/:id"},
+             {Method::PUT, resource + "/:id"},
+             {Method::DELETE, resource + "/:id"},
+             {Method::GET, resource + "/:id/children/:child"},
+             {Method::POST, resource + "/:id/archive"},
+             {Method::GET, resource + "/:id/files/*path"},
+         })
+    {
+      router.add(method, pattern, handler);
+      linear.add(method, pattern);
+    }
+  }
+
+  std::vector<std::string> paths;
+  for (std::size_t idx = 0; idx < resources; idx += 7)
+  {
+    auto resource = "/api/v1/resource" + std::to_string(idx);
+    paths.push_back(resource);
+    paths.push_back(resource + "/42");
+    paths.push_back(resource + "/42/children/7");
+    paths.push_back(resource + "/42/files/docs/readme.md");
+    paths.push_back(resource + "/42/missing");
+  }
+
+  auto before = allocations;
+  auto router_rate = match_rate(iterations, paths,
+      [&](const auto &path) { return router.match(Method::GET, path).handler != nullptr; });
+  auto router_allocations = allocations - before;
+
+  auto linear_rate = match_rate(
+      iterations, paths, [&](const auto &path) { return linear.match(Method::GET, path); });
+
+  std::cout << "routes: " << router.size() << ", paths: " << paths.size()
+            << ", iterations: " << iterations << "\n\n";
+  std::cout << std::left << std::setw(16) << "router" << std::right << std::setw(16)
+            << "matches/s" << std::setw(11) << "speedup\n";
+
+  for (auto [name, rate] : {std::make_pair("linear scan", linear_rate),
+           std::make_pair("radix tree", router_rate)})
+  {
+    std::cout << std::left << std::setw(16) << name << std::right << std::fixed
+              << std::setprecision(0) << std::setw(16) << rate << std::setprecision(2)
+              << std::setw(10) << rate / linear_rate << "x\n";
+  }
+
+  std::cout << "\nallocations while matching with the radix tree: " << router_allocations << "\n";
+
+  return 0;
+}
@@ -0,0 +1,175 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/utils/thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * The thread pool as it was before the work-stealing scheduler: a single queue behind one mutex
+ * and one condition variable, with every job allocated separately. Kept here as the baseline.
+ */
+class MutexThreadPool
+{
+public:
+  explicit MutexThreadPool(std::uint32_t threads_count)
+  {
+    for (std::uint32_t i = 0; i != threads_count; ++i)
+    {
+      threads_.emplace_back(&MutexThreadPool::worker, this);
+    }
+  }
+
+  ~MutexThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      done_ = true;
+    }
+
+    condition_.notify_all();
+    for (auto &t : threads_)
+    {
+      t.join();
+    }
+  }
+
+  template <class Func>
+  void submit(Func &&fn)
+  {
+    auto job = std::make_unique<std::function<void()>>(std::bind(std::forward<Func>(fn)));
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    queue_.push(std::move(job));
+    condition_.notify_one();
+  }
+
+private:
+  void worker()
+  {
+    while (true)
+    {
+      std::unique_ptr<std::function<void()>> job;
+      {
+        std::unique_lock<std::mutex> lock{mutex_};
+        condition_.wait(lock, [&] { return !queue_.empty() || done_; });
+        if (done_)
+        {
+          return;
+        }
+
+        job = std::move(queue_.front());
+        queue_.pop();
+      }
+
+      (*job)();
+    }
+  }
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::queue<std::unique_ptr<std::function<void()>>> queue_;
+  bool done_ = false;
+};
+
+static void wait_for(const std::atomic<std::uint64_t> &counter, std::uint64_t expected)
+{
+  while (counter.load(std::memory_order_acquire) != expected)
+  {
+    std::this_thread::yield();
+  }
+}
+
+/**
+ * Submit many tiny jobs from the calling thread, which is how the event loop offloads work.
+ */
+template <class Pool>
+static double external_submissions(Pool &pool, std::uint64_t jobs)
+{
+  std::atomic<std::uint64_t> counter{0};
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::uint64_t i = 0; i != jobs; ++i)
+  {
+    pool.submit([&counter] { counter.fetch_add(1, std::memory_order_release); });
+  }
+
+  wait_for(counter, jobs);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  return jobs / elapsed.count();
+}
+
+/**
+ * Submit a few jobs which fan out into many tiny jobs from the workers themselves.
+ */
+template <class Pool>
+static double nested_submissions(Pool &pool, std::uint64_t jobs)
+{
+  static constexpr std::uint64_t fan_out = 1000;
+
+  std::atomic<std::uint64_t> counter{0};
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::uint64_t i = 0; i != jobs / fan_out; ++i)
+  {
+    pool.submit([&pool, &counter] {
+      for (std::uint64_t j = 0; j != fan_out; ++j)
+      {
+        pool.submit([&counter] { counter.fetch_add(1, std::memory_order_release); });
+      }
+    });
+  }
+
+  wait_for(counter, jobs / fan_out * fan_out);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  return jobs / elapsed.count();
+}
+
+static void report(const std::string &name, double mutex_rate, double stealing_rate)
+{
+  std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+            << std::setprecision(0) << std::setw(16) << mutex_rate << std::setw(16)
+            << stealing_rate << std::setprecision(2) << std::setw(10)
+            << stealing_rate / mutex_rate << "x\n";
+}
+
+int main(int argc, char **argv)
+{
+  std::uint32_t threads = argc > 1 ? std::stoul(argv[1]) : std::thread::hardware_concurrency();
+  std::uint64_t jobs = argc > 2 ? std::stoull(argv[2]) : 1000000;
+
+  /*
+   * The work-stealing pool caps its size to the available hardware threads, so the baseline gets
+   * the same number of workers to keep the comparison fair.
+   */
+  microloop::utils::ThreadPool stealing_pool{threads};
+  MutexThreadPool mutex_pool{static_cast<std::uint32_t>(stealing_pool.size())};
+
+  std::cout << "workers: " << stealing_pool.size() << ", jobs: " << jobs << "\n\n";
+  std::cout << std::left << std::setw(24) << "scenario" << std::right << std::setw(16)
+            << "mutex jobs/s" << std::setw(16) << "stealing jobs/s" << std::setw(11)
+            << "speedup\n";
+
+  report("external submissions", external_submissions(mutex_pool, jobs),
+      external_submissions(stealing_pool, jobs));
+  report("nested submissions", nested_submissions(mutex_pool, jobs),
+      nested_submissions(stealing_pool, jobs));
+
+  return 0;
+}
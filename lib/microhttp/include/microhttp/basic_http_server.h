@@ -4,31 +4,150 @@
 
 #pragma once
 
+#include "microhttp/http_request.h"
 #include "microhttp/http_response.h"
+#include "microhttp/pinned_headers.h"
+#include "microhttp/request_parser.h"
+#include "microhttp/router.h"
+#include "microhttp/static_files.h"
+#include "microloop/buffer_pool.h"
 #include "microloop/net/tcp_server.h"
 
 #include <cstdint>
-#include <function>
+#include <functional>
 #include <map>
-#include <tuple>
+#include <string_view>
 
 namespace microhttp
 {
 
+/**
+ * \brief An HTTP/1.1 server dispatching requests to the handlers of a router.
+ *
+ * Requests are parsed as they arrive, pipelined ones included, and each one is answered by the
+ * handler of the route matching its method and path. Requests without a route get a 404 response,
+ * or a 405 one with an Allow header if the path has routes for other methods. The responses to the
+ * requests received together are sent together.
+ */
 class BasicHttpServer : protected microloop::net::TcpServer
 {
-  using microhttp::http::HttpRequest;
-  using microhttp::http::HttpResponse;
-
 public:
-  using RequestHandler = std::function<void(const HttpRequest &, HttpResponse &)>;
+  using RequestHandler = http::Router::Handler;
+
+  static constexpr std::uint16_t DEFAULT_HTTP_PORT = 80;
+
+  explicit BasicHttpServer(std::uint16_t port = DEFAULT_HTTP_PORT);
+
+  /**
+   * \brief Answer the requests with the given method and a path matching the pattern with a
+   * handler. See \p http::Router for the syntax of the patterns.
+   * \throws std::invalid_argument if the route cannot be added.
+   */
+  void route(http::Method method, std::string_view pattern, RequestHandler handler)
+  {
+    router_.add(method, pattern, std::move(handler));
+  }
+
+  void get(std::string_view pattern, RequestHandler handler)
+  {
+    route(http::Method::GET, pattern, std::move(handler));
+  }
+
+  void post(std::string_view pattern, RequestHandler handler)
+  {
+    route(http::Method::POST, pattern, std::move(handler));
+  }
 
-  BasicHttpServer(std::uint16_t port = DEFAULT_HTTP_PORT);
+  void put(std::string_view pattern, RequestHandler handler)
+  {
+    route(http::Method::PUT, pattern, std::move(handler));
+  }
 
+  /**
+   * \brief Answer the GET and HEAD requests with a path matching the pattern with the files of a
+   * directory tree, found by the whole path of the request, e.g. a wildcard at the root to serve
+   * every path. The bodies are sent from the files with `sendfile`. The files must outlive the
+   * server.
+   * \throws std::invalid_argument if the route cannot be added.
+   */
+  void serve_files(std::string_view pattern, http::StaticFiles &files);
+
+  /**
+   * \brief Set the headers sent in every response. They must outlive the server.
+   */
+  void set_pinned_headers(const http::PinnedHeaders &headers) noexcept
+  {
+    pinned_headers_ = &headers;
+  }
+
+  /**
+   * \brief Answer a request as the server does, without a connection. The bodies of the files
+   * served by \p serve_files() are left out.
+   */
+  http::HttpResponse respond(const http::HttpRequest &request) const;
+
+  /**
+   * \brief Run the event loop until it has nothing left to do.
+   */
+  void run();
+
+  using TcpServer::admission_stats;
+  using TcpServer::connections_count;
+  using TcpServer::fd;
+  using TcpServer::set_admission_policy;
 
 private:
-  std::uint16_t port_;
-  std::map<std::string, std::tuple<std::string, RequestHandler>> mapping;
+  void on_conn(PeerConnection &conn);
+
+  void on_data(PeerConnection &conn, const microloop::Buffer &buf);
+
+  /**
+   * \brief Close a connection once its output queue is sent, or go on reading its requests.
+   */
+  void on_drain(PeerConnection &conn);
+
+  /**
+   * \brief Close a connection, or stop reading from it until its output queue is sent.
+   * \param close Whether the connection is to be closed.
+   */
+  void finish_output(PeerConnection &conn, bool close);
+
+  void close_client(PeerConnection &conn);
+
+  /**
+   * \brief Answer a request, with the file its body is sent from if it is served by
+   * \p serve_files().
+   */
+  http::StaticFiles::Reply reply(const http::HttpRequest &request) const;
+
+  http::HttpResponse respond(
+      const http::HttpRequest &request, const http::Router::Match &match) const;
+
+  http::Router router_;
+
+  /// The files answering the requests, by the handlers of their routes
+  std::map<const RequestHandler *, http::StaticFiles *> file_routes_;
+
+  /**
+   * \brief What the server keeps about a connection between reads.
+   */
+  struct Client
+  {
+    http::RequestParser parser;
+
+    /// Whether 100 Continue was sent for the request being received
+    bool continue_sent = false;
+
+    /// Whether the connection is closed once its output queue is sent
+    bool closing = false;
+  };
+
+  std::map<std::uint32_t, Client> clients_;
+
+  /// The blocks the response heads are written into
+  microloop::BufferPool heads_{1024};
+
+  const http::PinnedHeaders *pinned_headers_;
 };
 
 }  // namespace microhttp
@@ -0,0 +1,167 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/http_request.h"
+#include "microhttp/http_response.h"
+#include "microhttp/validators.h"
+#include "microloop/net/tcp_server.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <vector>
+
+namespace microhttp::http
+{
+
+/// The number of ranges above which the Range header of a request is ignored
+inline constexpr std::size_t MAX_RANGES = 16;
+
+/**
+ * \brief A range of bytes of a representation, with both ends included.
+ */
+struct ByteRange
+{
+  std::uint64_t first;
+  std::uint64_t last;
+
+  std::uint64_t size() const noexcept
+  {
+    return last - first + 1;
+  }
+};
+
+inline bool operator==(const ByteRange &lhs, const ByteRange &rhs) noexcept
+{
+  return lhs.first == rhs.first && lhs.last == rhs.last;
+}
+
+/**
+ * \brief The outcome of evaluating the Range header of a request against a representation.
+ */
+struct Ranges
+{
+  enum Status
+  {
+    /// The whole representation is sent, as if no Range header had been received
+    FULL,
+
+    /// Only the ranges are sent, in a 206 response
+    PARTIAL,
+
+    /// None of the ranges overlaps the representation, so a 416 response is sent
+    UNSATISFIABLE,
+  };
+
+  Status status = FULL;
+
+  /// The satisfiable ranges, clamped to the representation. They are in the order they were asked
+  /// for, unless some overlapped and were coalesced, which sorts them.
+  std::vector<ByteRange> ranges;
+};
+
+/**
+ * \brief Parse the value of a Range header (RFC 7233, Section 2.1) for a representation of the
+ * given size.
+ *
+ * Ranges past the end of the representation are left out, and the ones running over it are
+ * clamped. Overlapping ranges are coalesced, so that a client cannot make the server send the same
+ * bytes many times. A header with another unit than "bytes", with an invalid syntax or with more
+ * than \p max_ranges ranges is ignored, as the RFC allows.
+ */
+Ranges parse_ranges(
+    std::string_view range, std::uint64_t size, std::size_t max_ranges = MAX_RANGES);
+
+/**
+ * \brief Evaluate the Range and If-Range headers of a request for a representation.
+ * \param validators The validators of the representation, for If-Range.
+ * \returns `Ranges::FULL` if the request is not a GET, has no Range header or has an If-Range
+ * header which does not match.
+ */
+Ranges select_ranges(const HttpRequest &request, std::uint64_t size, const Validators &validators);
+
+/**
+ * \brief The body of a response to a range request: the whole representation, a single range, or
+ * several ones as a `multipart/byteranges` body (RFC 7233, Appendix A).
+ *
+ * The body never holds the bytes of the representation. The headers of the parts are rendered once,
+ * and the ranges are sent from wherever the representation is: gathered from memory with
+ * \p append_to(), or straight from a file with \p send().
+ */
+class RangedBody
+{
+public:
+  /**
+   * \param ranges The ranges selected for the request.
+   * \param size The size of the whole representation.
+   * \param content_type The type of the representation, written in the headers of the parts.
+   */
+  RangedBody(Ranges ranges, std::uint64_t size, std::string_view content_type = {});
+
+  /**
+   * \brief Set the status code and the Range related headers of the head of the response. The
+   * Content-Length is set explicitly, since the content of the head itself is not sent.
+   */
+  void apply(HttpResponse &head) const;
+
+  /**
+   * \brief Get the number of bytes of the body.
+   */
+  std::uint64_t content_length() const noexcept;
+
+  /**
+   * \brief Append the body to a scatter-gather list, pointing into the representation.
+   * \param representation The whole representation. It must outlive the list.
+   */
+  void append_to(std::vector<iovec> &iov, std::string_view representation) const;
+
+  /**
+   * \brief Queue a response whose body is read from a file on the output queue of a connection,
+   * without copying it through user space. The bytes of the file are sent as the peer reads them,
+   * without blocking.
+   * \param head The serialized head of the response, sent first.
+   * \param file Keeps the file open until the body is sent.
+   * \param file_fd The file holding the whole representation.
+   * \returns Whether the connection is still writable, see
+   * \p microloop::net::TcpServer::PeerConnection::write().
+   */
+  bool write(microloop::net::TcpServer::PeerConnection &conn, std::vector<iovec> head,
+      std::shared_ptr<const void> file, int file_fd) const;
+
+  const Ranges &ranges() const noexcept
+  {
+    return ranges_;
+  }
+
+private:
+  /**
+   * \brief Get the part of \p parts_ written before the range at the given index, or after the last
+   * range when the index equals the number of ranges.
+   */
+  std::string_view part_head(std::size_t idx) const noexcept
+  {
+    auto first = part_offsets_[idx], last = part_offsets_[idx + 1];
+    return std::string_view{parts_}.substr(first, last - first);
+  }
+
+  bool multipart() const noexcept
+  {
+    return ranges_.status == Ranges::PARTIAL && ranges_.ranges.size() > 1;
+  }
+
+  Ranges ranges_;
+  std::uint64_t size_;
+  std::string boundary_;
+
+  /// The headers of the parts and the closing delimiter, back to back, and where each one starts
+  std::string parts_;
+  std::vector<std::size_t> part_offsets_;
+};
+
+}  // namespace microhttp::http
@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/compression.h"
+#include "microloop/buffer.h"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief The compressed variants of contents that do not change between responses, kept so that
+ * each of them is compressed only once.
+ *
+ * The least recently used contents are dropped once the variants take more than the capacity. The
+ * cache is meant to be used from the event loop thread only.
+ */
+class CompressedVariants
+{
+public:
+  using Variant = std::shared_ptr<const microloop::Buffer>;
+
+  /**
+   * \param capacity How many bytes the variants may take, in total.
+   */
+  explicit CompressedVariants(std::size_t capacity) : capacity_{capacity}
+  {}
+
+  /**
+   * \brief Get a variant of a content.
+   * \returns Null if the variant is not cached.
+   */
+  Variant find(std::string_view key, ContentCoding coding);
+
+  /**
+   * \brief Cache a variant of a content.
+   * \returns The cached variant. It is returned even if it does not fit in the cache.
+   */
+  Variant insert(std::string_view key, ContentCoding coding, microloop::Buffer variant);
+
+  /**
+   * \brief Drop the variants of a content, e.g. once it changed.
+   */
+  void erase(std::string_view key);
+
+  /**
+   * \brief Get the number of bytes taken by the cached variants.
+   */
+  std::size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  std::size_t capacity() const noexcept
+  {
+    return capacity_;
+  }
+
+private:
+  struct Entry
+  {
+    std::array<Variant, CONTENT_CODINGS_COUNT> variants;
+    std::size_t size = 0;
+
+    /// The position of the content in the recency list
+    std::list<std::string_view>::iterator lru;
+  };
+
+  using Entries = std::map<std::string, Entry, std::less<>>;
+
+  void erase(Entries::iterator it);
+
+private:
+  std::size_t capacity_;
+  std::size_t size_ = 0;
+
+  Entries entries_;
+
+  /// The keys of the contents, most recently used first. They point into \p entries_.
+  std::list<std::string_view> lru_;
+};
+
+}  // namespace microhttp::http
@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/http_request.h"
+#include "microhttp/http_response.h"
+#include "microloop/buffer.h"
+#include "microloop/event_loop.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief The content codings responses can be sent with.
+ */
+enum class ContentCoding : std::uint8_t
+{
+  IDENTITY,
+  GZIP,
+  DEFLATE,
+};
+
+constexpr std::size_t CONTENT_CODINGS_COUNT = 3;
+
+/**
+ * \brief Get the name of a content coding, as sent in the Content-Encoding header.
+ */
+std::string_view coding_name(ContentCoding coding) noexcept;
+
+/**
+ * \brief Pick the coding a client prefers among gzip, deflate and identity (RFC 7231,
+ * Section 5.3.4). gzip wins over deflate when the client likes them equally.
+ * \param accept_encoding The value of the Accept-Encoding header.
+ */
+ContentCoding negotiate_coding(std::string_view accept_encoding) noexcept;
+
+/**
+ * \brief Whether a media type is worth compressing. Images, audio, video and archives are usually
+ * compressed already.
+ * \param content_type The value of the Content-Type header.
+ */
+bool is_compressible(std::string_view content_type) noexcept;
+
+/**
+ * \brief Encode bytes with a content coding.
+ * \param level The zlib compression level, from 1 (fastest) to 9 (smallest), or -1 for the zlib
+ * default.
+ * \throws std::invalid_argument If the coding is identity or the level is out of range.
+ */
+microloop::Buffer compress(std::string_view data, ContentCoding coding, int level);
+
+class CompressedVariants;
+
+/**
+ * \brief Compresses responses with the coding negotiated with each client.
+ */
+class Compressor
+{
+public:
+  struct Options
+  {
+    /// The zlib compression level, from 1 (fastest) to 9 (smallest)
+    int level = 6;
+
+    /// Smaller contents are sent as they are, since compressing them saves less than it costs
+    std::size_t min_size = 1024;
+
+    /// Contents at least this large are compressed on the thread pool by \p compress_async()
+    std::size_t offload_min_size = 64 * 1024;
+  };
+
+  Compressor() = default;
+
+  explicit Compressor(Options options) : options_{options}
+  {}
+
+  const Options &options() const noexcept
+  {
+    return options_;
+  }
+
+  /**
+   * \brief Pick the coding to send a response with. Responses that could be compressed get
+   * `Vary: Accept-Encoding`, whichever coding is picked for this client.
+   * \returns Identity if the response should be sent as it is.
+   */
+  ContentCoding negotiate(const HttpRequest &request, HttpResponse &response) const;
+
+  /**
+   * \brief Compress the content of a response, if the client accepts it and it is worth it.
+   */
+  void compress(const HttpRequest &request, HttpResponse &response) const;
+
+  /**
+   * \brief Like \p compress(request, response), for a content that does not change between
+   * responses, such as a static file. Each of its variants is compressed only once and kept in
+   * \p variants.
+   * \param key Identifies the content, e.g. a path and a modification time. Different contents must
+   * have different keys.
+   */
+  void compress(const HttpRequest &request, HttpResponse &response, CompressedVariants &variants,
+      std::string_view key) const;
+
+  /**
+   * \brief Like \p compress(request, response), without blocking the event loop on large contents:
+   * those are compressed on the thread pool of the loop.
+   * \param on_done Called on the event loop with the response, compressed or not. It is called
+   * right away if the response is not compressed on the thread pool.
+   */
+  template <class OnDone>
+  void compress_async(const HttpRequest &request, HttpResponse response, OnDone &&on_done) const
+  {
+    auto coding = negotiate(request, response);
+    if (coding == ContentCoding::IDENTITY || response.content().size() < options_.offload_min_size)
+    {
+      if (coding != ContentCoding::IDENTITY)
+      {
+        encode(response, coding, options_.level);
+      }
+
+      on_done(std::move(response));
+      return;
+    }
+
+    microloop::EventLoop::instance()
+        .offload(microloop::utils::ThreadPool::Priority::HIGH,
+            [response = std::move(response), coding, level = options_.level]() mutable {
+              encode(response, coding, level);
+              return std::move(response);
+            })
+        .then(std::forward<OnDone>(on_done));
+  }
+
+  /**
+   * \brief Replace the content of a response with its encoded form and set Content-Encoding.
+   */
+  static void encode(HttpResponse &response, ContentCoding coding, int level);
+
+private:
+  Options options_;
+};
+
+}  // namespace microhttp::http
@@ -2,6 +2,8 @@
 // Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
 //
 
+#pragma once
+
 #include <cstdint>
 #include <string_view>
 
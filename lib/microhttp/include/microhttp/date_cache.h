@@ -0,0 +1,81 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microloop/event_loop.h"
+#include "microloop/event_sources/timer.h"
+
+#include <array>
+#include <ctime>
+#include <optional>
+#include <string_view>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief The value of the Date header (RFC 7231, Section 7.1.1.2), which origin servers must send.
+ *
+ * The value only changes once per second, so it is rendered by a timer of the event loop instead
+ * of for every response. The cache is not thread-safe; it belongs to the thread running the loop.
+ */
+class DateCache
+{
+public:
+  /// The length of an IMF-fixdate, such as "Sun, 06 Nov 1994 08:49:37 GMT"
+  static constexpr std::size_t IMF_FIXDATE_LEN = 29;
+
+  /**
+   * \brief Get the cache of the event loop. Its timer is started on first use.
+   */
+  static DateCache &instance();
+
+  /**
+   * \brief Create a cache refreshed every second by a timer of the given event loop.
+   */
+  explicit DateCache(microloop::EventLoop *event_loop);
+
+  DateCache(const DateCache &) = delete;
+  DateCache &operator=(const DateCache &) = delete;
+
+  /**
+   * \brief Stop the timer refreshing this cache.
+   */
+  ~DateCache();
+
+  /**
+   * \brief Get the current date, as of the last refresh.
+   */
+  std::string_view value() const noexcept
+  {
+    return std::string_view{value_.data(), value_.size()};
+  }
+
+  /**
+   * \brief Render the current date, without waiting for the timer.
+   */
+  void refresh() noexcept;
+
+  /**
+   * \brief Render a time as an IMF-fixdate. Unlike `strftime()`, this does not depend on the
+   * locale.
+   * \param out Where to write the date. It must have room for \p IMF_FIXDATE_LEN bytes.
+   */
+  static void format(std::time_t time, char *out) noexcept;
+
+  /**
+   * \brief Parse an HTTP-date in any of the three formats recipients must accept (RFC 7231,
+   * Section 7.1.1.1): IMF-fixdate, RFC 850 and asctime.
+   * \returns An empty value if the date is not valid.
+   */
+  static std::optional<std::time_t> parse(std::string_view date) noexcept;
+
+private:
+  microloop::EventLoop *event_loop_;
+  microloop::event_sources::BaseTimer *timer_ = nullptr;
+  std::array<char, IMF_FIXDATE_LEN> value_{};
+};
+
+}  // namespace microhttp::http
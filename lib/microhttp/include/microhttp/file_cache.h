@@ -0,0 +1,171 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/validators.h"
+#include "microloop/event_loop.h"
+#include "microloop/event_sources/fs/file_watcher.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief A regular file opened for reading, with everything a response needs to know about it.
+ */
+struct CachedFile
+{
+  CachedFile(int fd, const struct stat &st, std::string_view mime_type) :
+      fd{fd}, st{st}, mime_type{mime_type}, validators{Validators::from_stat(st)}
+  {}
+
+  CachedFile(const CachedFile &) = delete;
+
+  ~CachedFile();
+
+  int fd;
+  struct stat st;
+
+  /// The media type of the file, with a charset for text types
+  std::string_view mime_type;
+
+  Validators validators;
+};
+
+/**
+ * \brief The files of a directory tree kept open, so that serving a file already seen takes no
+ * `open`, `fstat` nor `close` call.
+ *
+ * The least recently used files are closed once the cache holds more files or more bytes than
+ * allowed. Every cached file is watched with inotify, and dropped as soon as it is modified,
+ * replaced, moved or deleted, so the next request opens the new version. The cache is meant to be
+ * used from the event loop thread only.
+ */
+class FileCache
+{
+public:
+  using File = std::shared_ptr<const CachedFile>;
+
+  struct Options
+  {
+    /// How many files may be kept open
+    std::size_t max_files = 1024;
+
+    /// How many bytes the files kept open may hold, in total. Larger files are served, but not
+    /// kept open.
+    std::uint64_t max_bytes = 256 * 1024 * 1024;
+  };
+
+  /**
+   * \param root The directory the files are looked up in.
+   * \param loop The event loop the changes to the files are reported by.
+   * \throws std::filesystem::filesystem_error if the root does not exist.
+   */
+  FileCache(const std::filesystem::path &root, Options options,
+      microloop::EventLoop *loop = &microloop::EventLoop::instance());
+
+  FileCache(const FileCache &) = delete;
+
+  ~FileCache();
+
+  /**
+   * \brief Get a regular file.
+   * \param path The path of the file, relative to the root. It must not contain `..` segments,
+   * while symbolic links leading out of the root are detected and refused.
+   * \returns Null if there is no such regular file in the root.
+   */
+  File open(std::string_view path);
+
+  /**
+   * \brief Drop a file from the cache.
+   */
+  void erase(std::string_view path);
+
+  /**
+   * \brief Get the number of files kept open.
+   */
+  std::size_t size() const noexcept
+  {
+    return entries_.size();
+  }
+
+  /**
+   * \brief Get the number of bytes held by the files kept open.
+   */
+  std::uint64_t bytes() const noexcept
+  {
+    return bytes_;
+  }
+
+  std::uint64_t hits() const noexcept
+  {
+    return hits_;
+  }
+
+  std::uint64_t misses() const noexcept
+  {
+    return misses_;
+  }
+
+  const std::filesystem::path &root() const noexcept
+  {
+    return root_;
+  }
+
+private:
+  struct Entry
+  {
+    File file;
+    int wd;
+
+    /// The position of the file in the recency list
+    std::list<std::string_view>::iterator lru;
+  };
+
+  using Entries = std::map<std::string, Entry, std::less<>>;
+
+  /**
+   * \brief Open a file and check that it is a regular file inside the root.
+   */
+  File load(std::string_view path) const;
+
+  void erase(Entries::iterator it);
+
+  /**
+   * \brief Drop the files a change was reported for.
+   */
+  void on_change(const microloop::event_sources::fs::FileEvent &event);
+
+private:
+  std::filesystem::path root_;
+  Options options_;
+
+  microloop::EventLoop *loop_;
+  microloop::event_sources::fs::FileWatcher *watcher_;
+
+  Entries entries_;
+  std::uint64_t bytes_ = 0;
+
+  /// The paths of the files, most recently used first. They point into \p entries_.
+  std::list<std::string_view> lru_;
+
+  /// The paths watched by each watch descriptor. Hard links share one.
+  std::multimap<int, std::string_view> watches_;
+
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+};
+
+}  // namespace microhttp::http
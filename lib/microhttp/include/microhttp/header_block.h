@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/well_known.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief A header field of a request parsed in zero-copy mode. Both views point into the header
+ * block of the request.
+ */
+struct HeaderField
+{
+  /// The name of the field, as sent by the client
+  std::string_view name;
+
+  /// The value of the field, without the surrounding whitespace
+  std::string_view value;
+
+  /// The interned name, or `HeaderId::UNKNOWN` for uncommon names
+  HeaderId id = HeaderId::UNKNOWN;
+};
+
+/**
+ * \brief A read-only range over header fields.
+ */
+class HeaderFields
+{
+public:
+  HeaderFields(const HeaderField *first = nullptr, std::size_t count = 0) noexcept :
+      first_{first}, count_{count}
+  {}
+
+  const HeaderField *begin() const noexcept
+  {
+    return first_;
+  }
+
+  const HeaderField *end() const noexcept
+  {
+    return first_ + count_;
+  }
+
+  std::size_t size() const noexcept
+  {
+    return count_;
+  }
+
+  bool empty() const noexcept
+  {
+    return count_ == 0;
+  }
+
+  const HeaderField &operator[](std::size_t idx) const noexcept
+  {
+    return first_[idx];
+  }
+
+private:
+  const HeaderField *first_;
+  std::size_t count_;
+};
+
+/**
+ * \brief The raw header block of a request (the start line and the header lines, up to and
+ * including the empty line), together with the views of the request parts found in it.
+ *
+ * The raw bytes and the array of header fields share a single allocation, sized once the whole
+ * block has been received. Copying a block rebases the views onto the copy.
+ */
+class HeaderBlock
+{
+public:
+  HeaderBlock() noexcept = default;
+
+  /**
+   * \brief Copy the raw header block of a request.
+   * \param raw The header block.
+   * \param fields_capacity How many header fields will be added at most.
+   */
+  HeaderBlock(std::string_view raw, std::size_t fields_capacity);
+
+  HeaderBlock(const HeaderBlock &other);
+
+  HeaderBlock(HeaderBlock &&other) noexcept;
+
+  /**
+   * \brief Copy/move assignment operator. Implemented using the copy-and-swap idiom.
+   */
+  HeaderBlock &operator=(HeaderBlock other) noexcept;
+
+  friend void swap(HeaderBlock &a, HeaderBlock &b) noexcept;
+
+  /**
+   * \brief Get the raw header block. The views set on this block point into it.
+   */
+  std::string_view raw() const noexcept
+  {
+    return raw_;
+  }
+
+  bool empty() const noexcept
+  {
+    return raw_.empty();
+  }
+
+  /**
+   * \brief Set the views of the start line parts. Both must point into \p raw().
+   */
+  void set_start_line(std::string_view method, std::string_view request_target) noexcept
+  {
+    method_ = method;
+    request_target_ = request_target;
+  }
+
+  std::string_view method() const noexcept
+  {
+    return method_;
+  }
+
+  std::string_view request_target() const noexcept
+  {
+    return request_target_;
+  }
+
+  /**
+   * \brief Add a header field. Both views must point into \p raw().
+   * \returns `false` if the block has no room left for another field, `true` otherwise.
+   */
+  bool add_field(std::string_view name, std::string_view value) noexcept;
+
+  HeaderFields fields() const noexcept
+  {
+    return HeaderFields{fields_, fields_count_};
+  }
+
+  /**
+   * \brief Find the value of the first field with the given name, ignoring the case.
+   */
+  std::optional<std::string_view> find(std::string_view name) const noexcept;
+
+  /**
+   * \brief Find the value of the first field with a common name, without comparing any strings.
+   */
+  std::optional<std::string_view> find(HeaderId id) const noexcept
+  {
+    auto idx = id == HeaderId::UNKNOWN ? 0 : known_fields_[static_cast<std::size_t>(id)];
+    if (idx == 0)
+    {
+      return std::nullopt;
+    }
+
+    return fields_[idx - 1].value;
+  }
+
+private:
+  /**
+   * \brief Point a view of \p from into the same bytes of this block.
+   */
+  std::string_view rebase(std::string_view view, const HeaderBlock &from) const noexcept;
+
+  std::unique_ptr<char[]> storage_;
+  std::string_view raw_;
+  HeaderField *fields_ = nullptr;
+  std::size_t fields_count_ = 0;
+  std::size_t fields_capacity_ = 0;
+  std::string_view method_;
+  std::string_view request_target_;
+
+  /// The index of the first field with each common name, plus one; zero if there is no such field
+  std::array<std::uint16_t, HEADER_IDS_COUNT> known_fields_{};
+};
+
+}  // namespace microhttp::http
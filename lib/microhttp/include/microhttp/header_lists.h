@@ -0,0 +1,50 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <string_view>
+
+/**
+ * \brief Helpers for the header values made of comma-separated lists (RFC 7230, Section 7).
+ */
+namespace microhttp::http::header_lists
+{
+
+/**
+ * \brief Strip the optional whitespace around a value.
+ */
+inline std::string_view trim(std::string_view str) noexcept
+{
+  str.remove_prefix(std::min(str.find_first_not_of(" \t"), str.size()));
+  str.remove_suffix(str.size() - std::min(str.find_last_not_of(" \t") + 1, str.size()));
+
+  return str;
+}
+
+/**
+ * \brief Call \p fn with every non-empty element of a comma-separated list, until it returns
+ * `false`.
+ * \returns `false` if \p fn did, `true` otherwise.
+ */
+template <class Fn>
+bool for_each_element(std::string_view list, Fn fn)
+{
+  while (!list.empty())
+  {
+    auto comma_idx = std::min(list.find(','), list.size());
+    auto element = trim(list.substr(0, comma_idx));
+    list.remove_prefix(std::min(comma_idx + 1, list.size()));
+
+    if (!element.empty() && !fn(element))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace microhttp::http::header_lists
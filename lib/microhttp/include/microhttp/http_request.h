@@ -4,15 +4,22 @@
 
 #pragma once
 
+#include "microhttp/header_block.h"
+#include "microhttp/typed_headers.h"
 #include "microhttp/version.h"
+#include "microhttp/well_known.h"
 #include "microloop/buffer.h"
+#include "utils/string.h"
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <map>
 #include <optional>
 #include <string>
+#include <string_view>
 
 namespace microhttp::http
 {
@@ -20,9 +27,28 @@ namespace microhttp::http
 class HttpRequest
 {
 public:
+  using HeaderMap = std::map<std::string, std::string, std::less<>>;
+
   HttpRequest();
 
-  HttpRequest(std::string method, std::string uri);
+  HttpRequest(std::string_view method, std::string uri);
+
+  /**
+   * \brief Copy constructor. The index of the common headers is rebuilt for the copy.
+   */
+  HttpRequest(const HttpRequest &other);
+
+  /**
+   * \brief Move constructor. The values of the headers do not move, so their index stays valid.
+   */
+  HttpRequest(HttpRequest &&other) noexcept = default;
+
+  /**
+   * \brief Copy/move assignment operator. Implemented using the copy-and-swap idiom.
+   */
+  HttpRequest &operator=(HttpRequest other) noexcept;
+
+  friend void swap(HttpRequest &a, HttpRequest &b) noexcept;
 
   Version get_http_version() const
   {
@@ -46,22 +72,49 @@ public:
     return true;
   }
 
+  /**
+   * \brief Get the lowercase name of the method. This does not allocate for standard methods.
+   */
   std::string get_http_method() const
   {
-    return http_method;
+    return method == Method::UNKNOWN ? http_method : std::string{method_name(method)};
   }
 
-  void set_http_method(const std::string &method)
+  /**
+   * \brief Get the interned method, or `Method::UNKNOWN` for extension methods, whose name is only
+   * available through \p get_http_method().
+   */
+  Method get_method() const noexcept
   {
-    http_method = method;
+    return method;
+  }
 
+  void set_http_method(std::string_view name)
+  {
+    method = method_from_string(name);
+    if (method != Method::UNKNOWN)
+    {
+      http_method.clear();
+      return;
+    }
+
+    http_method.assign(name.begin(), name.end());
     std::transform(http_method.begin(), http_method.end(), http_method.begin(),
         [](auto c) { return std::tolower(c); });
   }
 
   std::string get_uri() const
   {
-    return uri;
+    return std::string{get_uri_view()};
+  }
+
+  /**
+   * \brief Get the request target without copying it. In zero-copy mode, the view points into the
+   * header block of the request.
+   */
+  std::string_view get_uri_view() const noexcept
+  {
+    return is_zero_copy() ? header_block.request_target() : std::string_view{uri};
   }
 
   void set_uri(const std::string &uri)
@@ -73,39 +126,165 @@ public:
     this->uri = uri;
   }
 
-  std::pair<std::string, bool> get_header(std::string header_name) const noexcept
+  std::pair<std::string, bool> get_header(std::string_view header_name) const noexcept
   {
-    std::transform(header_name.begin(), header_name.end(), header_name.begin(),
-        [](auto c) { return std::tolower(c); });
-
-    auto header = headers.find(header_name);
-    if (header == headers.cend())
+    auto value = find_header(header_name);
+    if (!value)
     {
       return std::make_pair("", false);
     }
 
-    return std::make_pair(header->second, true);
+    return std::make_pair(std::string{*value}, true);
   }
 
   void remove_header(const std::string &header_name) noexcept
   {
-    headers.erase(header_name);
+    auto header = headers.find(header_name);
+    if (header == headers.end())
+    {
+      return;
+    }
+
+    if (auto id = header_id(header->first); id != HeaderId::UNKNOWN)
+    {
+      known_headers[static_cast<std::size_t>(id)] = nullptr;
+      typed_headers.reset(id);
+    }
+
+    headers.erase(header);
   }
 
-  void set_header(const std::string &name, const std::string &value) noexcept
+  /**
+   * \brief Set a header, replacing any previous value. A malformed typed header is stored, but
+   * reads as absent through the typed accessors.
+   */
+  void set_header(std::string_view name, std::string value) noexcept
   {
-    std::string normalized_name = name;
-    std::transform(normalized_name.begin(), normalized_name.end(), normalized_name.begin(),
-        [](auto c) { return std::tolower(c); });
+    auto id = header_id(name);
+    const auto &header = store_header(id, name, std::move(value));
 
-    headers[normalized_name] = value;
+    typed_headers.reset(id);
+    typed_headers.add(id, header);
   }
 
-  const std::map<std::string, std::string> &get_headers() const
+  /**
+   * \brief Add a header received from the client. Unlike \p set_header(), the typed headers are
+   * validated, and repeated values are combined or rejected as described by \p TypedHeaders.
+   * \returns `false` if the header is malformed, in which case the request must be rejected.
+   */
+  bool add_header(std::string_view name, std::string value) noexcept
+  {
+    auto id = header_id(name);
+    if (!typed_headers.add(id, value))
+    {
+      return false;
+    }
+
+    store_header(id, name, std::move(value));
+    return true;
+  }
+
+  /**
+   * \brief Get the headers set by name. In zero-copy mode, the headers received from the client are
+   * not copied in here, see \p get_header_fields().
+   */
+  const HeaderMap &get_headers() const
   {
     return headers;
   }
 
+  /**
+   * \brief Find the value of a header, comparing the names case-insensitively. The fields of the
+   * header block are searched first, then the headers set by name.
+   */
+  std::optional<std::string_view> find_header(std::string_view name) const noexcept
+  {
+    auto id = header_id(name);
+    if (id != HeaderId::UNKNOWN)
+    {
+      return find_header(id);
+    }
+
+    if (auto value = header_block.find(name))
+    {
+      return value;
+    }
+
+    for (const auto &[header_name, value] : headers)
+    {
+      if (::utils::string::iequals(header_name, name))
+      {
+        return std::string_view{value};
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  /**
+   * \brief Find the value of a header with a common name. This is an array lookup, both in copy
+   * and in zero-copy mode.
+   */
+  std::optional<std::string_view> find_header(HeaderId id) const noexcept
+  {
+    if (auto value = header_block.find(id))
+    {
+      return value;
+    }
+
+    auto value = id == HeaderId::UNKNOWN ? nullptr : known_headers[static_cast<std::size_t>(id)];
+    if (!value)
+    {
+      return std::nullopt;
+    }
+
+    return std::string_view{*value};
+  }
+
+  /**
+   * \brief Whether the request was parsed in zero-copy mode, so that its start line and headers
+   * are views into its header block.
+   */
+  bool is_zero_copy() const noexcept
+  {
+    return !header_block.empty();
+  }
+
+  /**
+   * \brief Set the header block of a request parsed in zero-copy mode, and parse its typed
+   * headers the way \p add_header() does.
+   * \returns `false` if a typed header is malformed, in which case the request must be rejected.
+   */
+  bool set_header_block(HeaderBlock block) noexcept
+  {
+    header_block = std::move(block);
+    typed_headers = TypedHeaders{};
+
+    for (const auto &field : header_block.fields())
+    {
+      if (!typed_headers.add(field.id, field.value))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  const HeaderBlock &get_header_block() const noexcept
+  {
+    return header_block;
+  }
+
+  /**
+   * \brief Get the header fields in the order they were received, with the names in their original
+   * case. Empty unless the request was parsed in zero-copy mode.
+   */
+  HeaderFields get_header_fields() const noexcept
+  {
+    return header_block.fields();
+  }
+
   const microloop::Buffer &get_body() const noexcept
   {
     return body;
@@ -121,23 +300,88 @@ public:
     return body.str();
   }
 
+  /**
+   * \brief Get the headers parsed into typed values, which are read without any string work.
+   */
+  const TypedHeaders &get_typed_headers() const noexcept
+  {
+    return typed_headers;
+  }
+
   std::optional<std::size_t> get_content_length() const noexcept
   {
-    auto [content_length, found] = get_header("Content-Length");
+    return typed_headers.content_length;
+  }
+
+  std::optional<std::string_view> get_host() const noexcept
+  {
+    return find_header(HeaderId::HOST);
+  }
 
-    if (!found)
+  /**
+   * \brief Whether the connection can be reused after this request. HTTP/1.1 connections persist
+   * unless closed, and HTTP/1.0 ones only if asked to (RFC 7230, Section 6.3).
+   */
+  bool keep_alive() const noexcept
+  {
+    switch (typed_headers.connection)
     {
-      return std::nullopt;
+    case TypedHeaders::Connection::CLOSE:
+      return false;
+    case TypedHeaders::Connection::KEEP_ALIVE:
+      return true;
+    default:
+      return http_version.major > 1 || (http_version.major == 1 && http_version.minor >= 1);
+    }
+  }
+
+  bool expects_continue() const noexcept
+  {
+    return typed_headers.expectation == TypedHeaders::Expectation::CONTINUE;
+  }
+
+private:
+  /**
+   * \brief Store a header by its lowercase name, replacing any previous value.
+   */
+  const std::string &store_header(HeaderId id, std::string_view name, std::string value)
+  {
+    if (id != HeaderId::UNKNOWN)
+    {
+      /*
+       * The canonical name is already lowercase.
+       */
+      auto &header = headers[std::string{header_name(id)}];
+      header = std::move(value);
+      known_headers[static_cast<std::size_t>(id)] = &header;
+      return header;
     }
 
-    return std::atoll(content_length.c_str());
+    std::string normalized_name{name};
+    std::transform(normalized_name.begin(), normalized_name.end(), normalized_name.begin(),
+        [](auto c) { return std::tolower(c); });
+
+    auto &header = headers[normalized_name];
+    header = std::move(value);
+    return header;
   }
 
 private:
   Version http_version;
+  Method method = Method::UNKNOWN;
+
+  /// The name of an extension method; empty for the standard ones
   std::string http_method;
+
   std::string uri;
-  std::map<std::string, std::string> headers;
+  HeaderMap headers;
+
+  /// The values of the common headers in \p headers, indexed by their ID
+  std::array<const std::string *, HEADER_IDS_COUNT> known_headers{};
+
+  TypedHeaders typed_headers;
+
+  HeaderBlock header_block;
   microloop::Buffer body;
 };
 
@@ -5,14 +5,19 @@
 #pragma once
 
 #include "microhttp/constants.h"
+#include "microhttp/date_cache.h"
+#include "microhttp/pinned_headers.h"
 #include "microhttp/status_codes.h"
 #include "microhttp/version.h"
 #include "microloop/buffer.h"
+#include "utils/string.h"
 
+#include <algorithm>
 #include <map>
 #include <optional>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace microhttp::http
 {
@@ -20,12 +25,31 @@ namespace microhttp::http
 class HttpResponse
 {
 public:
+  /**
+   * \brief Orders the header names ignoring their case, so that each header is set only once.
+   */
+  struct HeaderNameLess
+  {
+    using is_transparent = void;
+
+    bool operator()(std::string_view a, std::string_view b) const noexcept
+    {
+      return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+          [](char x, char y) {
+            return ::utils::string::to_lower_ascii(x) < ::utils::string::to_lower_ascii(y);
+          });
+    }
+  };
+
+  /**
+   * \brief Create a response. Unless set explicitly, the Content-Length header is written from the
+   * size of the content when the response is serialized, except for the status codes of responses
+   * that have no body (1xx, 204 and 304).
+   */
   HttpResponse(const microloop::Buffer &content = microloop::Buffer{},
       microhttp::http::StatusCode status_code = StatusCode::OK) :
       status_code_{status_code}, content_{content}
-  {
-    set_header("Content-Length", content.size());
-  }
+  {}
 
   /**
    * \brief Set the HTTP version embedded within this response.
@@ -64,10 +88,9 @@ public:
   /**
    * \brief Get the HTTP reason phrase associated with the already set status code.
    */
-  auto reason_phrase() const
+  std::string_view reason_phrase() const
   {
-    auto entry = http_reason_phrases.find(status_code_);
-    return entry->second;
+    return get_reason_phrase(status_code_);
   }
 
   /**
@@ -97,14 +120,48 @@ public:
    * \param name The name of the header (case-insensitive).
    * \return Optional value of the header. nullopt if no such header is set on this response.
    */
-  std::optional<std::string> header(const std::string &name) const
+  std::optional<std::string> header(std::string_view name) const
   {
-    if (headers_.find(name) == headers_.end())
+    auto header = headers_.find(name);
+    if (header != headers_.end())
+    {
+      return header->second;
+    }
+
+    if (computes_content_length() && !HeaderNameLess{}(name, CONTENT_LENGTH)
+        && !HeaderNameLess{}(CONTENT_LENGTH, name))
     {
-      return std::nullopt;
+      return std::to_string(content_.size());
     }
 
-    return headers_.at(name);
+    return std::nullopt;
+  }
+
+  /**
+   * \brief Do not write the Content-Length header computed from the content, e.g. for a body
+   * streamed after the head. A Content-Length header set explicitly is still written.
+   */
+  void skip_content_length() noexcept
+  {
+    compute_content_length_ = false;
+  }
+
+  /**
+   * \brief Append headers rendered once, such as Server, to the head of this response.
+   * \param headers The headers to be pinned. They must outlive this response.
+   */
+  void pin_headers(const PinnedHeaders &headers) noexcept
+  {
+    pinned_headers_ = &headers;
+  }
+
+  /**
+   * \brief Send the Date header, as rendered by the given cache.
+   * \param date The cache of the current date. It must outlive this response.
+   */
+  void set_date(const DateCache &date) noexcept
+  {
+    date_ = &date;
   }
 
   /**
@@ -136,34 +193,48 @@ public:
   template <typename Format>
   Format format() const;
 
+  /**
+   * \brief Get the exact size of the serialized status line and headers, including the empty line
+   * ending them.
+   */
+  std::size_t head_size() const noexcept;
+
+  /**
+   * \brief Serialize the status line and the headers, without allocating.
+   * \param out Where to write them. It must have room for at least \p head_size() bytes.
+   * \returns The end of the bytes written.
+   */
+  char *write_head(char *out) const noexcept;
+
 private:
+  static constexpr std::string_view CONTENT_LENGTH = "Content-Length";
+
+  /**
+   * \brief Whether the Content-Length header is written from the size of the content, unless set
+   * explicitly.
+   */
+  bool computes_content_length() const noexcept
+  {
+    return compute_content_length_ && status_code_ / 100 != 1
+        && status_code_ != StatusCode::NO_CONTENT && status_code_ != StatusCode::NOT_MODIFIED;
+  }
+
   microhttp::http::Version http_version_{1, 1};
   microhttp::http::StatusCode status_code_;
-  std::map<std::string, std::string> headers_;
+  std::map<std::string, std::string, HeaderNameLess> headers_;
+  bool compute_content_length_ = true;
+  const PinnedHeaders *pinned_headers_ = nullptr;
+  const DateCache *date_ = nullptr;
   microloop::Buffer content_;
 };
 
 template <>
-std::string HttpResponse::format<>() const
-{
-  std::ostringstream ss;
-  ss << static_cast<std::string>(http_version()) << " " << status_code() << " " << reason_phrase()
-     << constants::crlf;
-
-  for (const auto &[name, value] : headers_)
-  {
-    ss << name << ": " << value << constants::crlf;
-  }
-
-  ss << constants::crlf << content().str_view();
-
-  return ss.str();
-}
+std::string HttpResponse::format<>() const;
 
+/**
+ * \brief The content is copied as it is, NUL bytes included.
+ */
 template <>
-microloop::Buffer HttpResponse::format<>() const
-{
-  return microloop::Buffer{format<std::string>().c_str()};
-}
+microloop::Buffer HttpResponse::format<>() const;
 
 }  // namespace microhttp::http
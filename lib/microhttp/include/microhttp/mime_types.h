@@ -0,0 +1,19 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <string_view>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief Guess the media type of a file from the extension of its name, ignoring its case. Text
+ * types are declared as UTF-8.
+ * \returns "application/octet-stream" for unknown extensions.
+ */
+std::string_view mime_type(std::string_view path) noexcept;
+
+}  // namespace microhttp::http
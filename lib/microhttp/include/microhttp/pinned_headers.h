@@ -0,0 +1,44 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/constants.h"
+
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief Headers sent with the same value in every response, such as Server, rendered once and
+ * appended verbatim to the heads of the responses they are pinned to.
+ */
+class PinnedHeaders
+{
+public:
+  PinnedHeaders(std::initializer_list<std::pair<std::string_view, std::string_view>> headers)
+  {
+    for (const auto &[name, value] : headers)
+    {
+      block_.append(name).append(": ").append(value).append(constants::crlf);
+    }
+  }
+
+  /**
+   * \brief Get the rendered header lines, each ending with CRLF.
+   */
+  std::string_view block() const noexcept
+  {
+    return block_;
+  }
+
+private:
+  std::string block_;
+};
+
+}  // namespace microhttp::http
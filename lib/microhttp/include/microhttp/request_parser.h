@@ -6,9 +6,13 @@
 
 #include "microhttp/http_request.h"
 #include "microhttp/rfc7230.h"
+#include "microhttp/status_codes.h"
 #include "microloop/buffer.h"
 
+#include <functional>
+#include <optional>
 #include <string>
+#include <string_view>
 
 namespace microhttp::http
 {
@@ -21,32 +25,171 @@ public:
     WAITING_START_LINE,
     WAITING_HEADER_LINE,
     WAITING_BODY,
+    WAITING_CHUNK_SIZE,
+    WAITING_CHUNK_DATA,
+    WAITING_CHUNK_DATA_END,
+    WAITING_TRAILER_LINE,
     BODY,
     DONE,
     ERROR,
   };
 
+  /**
+   * \brief How the parser stores the start line and the headers of a request.
+   */
+  enum class Mode
+  {
+    /// Copy the method, the request target and every header into strings
+    COPY,
+
+    /// Wait for the whole header block, copy it once, and expose its parts as views into it
+    ZERO_COPY,
+  };
+
+  /**
+   * \brief Why the parser entered the error state.
+   */
+  enum class Error
+  {
+    NONE,
+
+    /// The request is malformed
+    BAD_REQUEST,
+
+    /// The start line is longer than \p MAX_REQUEST_LINE_LEN (414 URI Too Long)
+    REQUEST_LINE_TOO_LONG,
+
+    /// The header block is larger than \p MAX_HEADER_BLOCK_SIZE (431 Request Header Fields Too
+    /// Large)
+    HEADER_BLOCK_TOO_LARGE,
+
+    /// The body is larger than the maximum body size (413 Payload Too Large)
+    BODY_TOO_LARGE,
+
+    /// The body uses a transfer coding other than chunked (501 Not Implemented)
+    UNSUPPORTED_TRANSFER_CODING,
+  };
+
+  /// The maximum length of the start line, including the CRLF
   static constexpr std::size_t MAX_REQUEST_LINE_LEN = 2048;
+
+  /// The maximum size of the start line and the header lines, including the final empty line
+  static constexpr std::size_t MAX_HEADER_BLOCK_SIZE = 16384;
+
+  /// The maximum length of a chunk-size line, including the chunk extensions and the CRLF
+  static constexpr std::size_t MAX_CHUNK_SIZE_LINE_LEN = 1024;
+
+  /// The default maximum size of a request body, whether it is chunked or not
+  static constexpr std::size_t DEFAULT_MAX_BODY_SIZE = 1024 * 1024;
+
+  /**
+   * \brief Get the status code of the response rejecting a request which failed with the given
+   * error.
+   */
+  static constexpr StatusCode get_error_status(Error error) noexcept
+  {
+    switch (error)
+    {
+    case Error::REQUEST_LINE_TOO_LONG:
+      return StatusCode::URI_TOO_LONG;
+    case Error::HEADER_BLOCK_TOO_LARGE:
+      return StatusCode::REQUEST_HEADER_FIELDS_TOO_LARGE;
+    case Error::BODY_TOO_LARGE:
+      return StatusCode::PAYLOAD_TOO_LARGE;
+    case Error::UNSUPPORTED_TRANSFER_CODING:
+      return StatusCode::NOT_IMPLEMENTED;
+    default:
+      return StatusCode::BAD_REQUEST;
+    }
+  }
 };
 
 class RequestParser : protected RFC7230, public BasicRequestParser
 {
 public:
-  RequestParser() : state{State::WAITING_START_LINE}
+  /**
+   * \brief Callbacks receiving the body of a request as it arrives, instead of buffering it in the
+   * request, so that a handler can stream an upload of any size in constant memory.
+   */
+  struct BodyHandler
+  {
+    /// Called once the headers of a request are parsed, before any byte of its body
+    std::function<void(HttpRequest &)> on_headers;
+
+    /// Called with every slice of the body, which is only valid during the call. Returning
+    /// `false` pauses the parser until \p resume() is called.
+    std::function<bool(std::string_view)> on_body_chunk;
+  };
+
+  explicit RequestParser(Mode mode = Mode::COPY) : mode{mode}, state{State::WAITING_START_LINE}
   {}
 
   /**
-   * Add a new chunk to be parsed by the parser.
+   * Add a new chunk to be parsed by the parser. The bytes received before are not scanned again,
+   * however the request was fragmented.
+   *
+   * Parsing stops once a request is complete, in the \p DONE state. The bytes after it, if any,
+   * belong to the next pipelined request and are kept until it is taken with \p next_request().
+   *
    * @param buf The buffer to append to the existing one.
    */
   void add_chunk(const microloop::Buffer &buf);
 
+  /**
+   * \brief Take the completed request, if any, and go on parsing the bytes received after it.
+   *
+   * Pipelined requests received in a single chunk are taken one after another by calling this
+   * until it returns an empty value.
+   */
+  std::optional<HttpRequest> next_request();
+
   /**
    * Retrieve the current state of the parser. If, at any interogation, this function returns
    * an error indicating state, then the caller should reject the request.
    */
   State get_state() const;
 
+  /**
+   * \brief Deliver the bodies of the requests to the given callbacks. The bodies of the requests
+   * returned by \p next_request() are then left empty.
+   */
+  void set_body_handler(BodyHandler handler)
+  {
+    body_handler = std::move(handler);
+  }
+
+  /**
+   * \brief Whether the body handler asked to stop receiving the body. Bytes added in the meantime
+   * are kept without being parsed, so the caller should stop reading from the connection.
+   */
+  bool is_paused() const noexcept
+  {
+    return paused;
+  }
+
+  /**
+   * \brief Go on parsing after the body handler paused the parser, starting with the bytes kept
+   * in the meantime.
+   */
+  void resume();
+
+  /**
+   * \brief Set the maximum size of a request body. Larger bodies put the parser in the error
+   * state with \p Error::BODY_TOO_LARGE, as soon as their size is known.
+   */
+  void set_max_body_size(std::size_t size) noexcept
+  {
+    max_body_size = size;
+  }
+
+  /**
+   * \brief Retrieve the reason of the error state, or \p Error::NONE if there was no error.
+   */
+  Error get_error() const noexcept
+  {
+    return error;
+  }
+
   /**
    * Retrieve the HTTP request as parsed so far.
    */
@@ -58,11 +201,97 @@ public:
   const HttpRequest &get_parsed_request() const;
 
   /**
-   * \brief Reset the parser.
+   * \brief Reset the parser, dropping any bytes received and not parsed yet.
    */
   void reset();
 
 private:
+  /**
+   * \brief Parse the bytes received so far, until they run out or a request is complete.
+   */
+  void parse();
+
+  /**
+   * \brief Forget the request parsed so far, keeping the bytes received after it.
+   */
+  void start_request();
+
+  /**
+   * \brief Find the next complete line, resuming the scan where the previous call stopped. The size
+   * limit is enforced as the bytes are scanned.
+   * \param max_size The maximum size of the line, including the CRLF.
+   * \param too_long The error to fail with if the line is longer.
+   * \returns The line, including the CRLF, or an empty value if the line is incomplete or too long.
+   */
+  std::optional<std::string_view> next_line(
+      std::string_view unit, std::size_t max_size, Error too_long) noexcept;
+
+  /**
+   * \brief Find the next complete line of the header block or of the trailer section, enforcing
+   * the limits of the header block.
+   */
+  std::optional<std::string_view> next_header_line(std::string_view unit) noexcept;
+
+  /**
+   * \brief Consume a line of the header block.
+   * \returns Whether parsing can go on.
+   */
+  bool consume_header_line(std::string_view unit);
+
+  /**
+   * \brief Decide how the body is delimited, once the headers are parsed.
+   */
+  void start_body();
+
+  /**
+   * \brief Consume the bytes of a body delimited by Content-Length.
+   * \returns Whether parsing can go on.
+   */
+  bool consume_body(std::string_view unit);
+
+  /**
+   * \brief Hand a slice of the body to the body handler, or append it to the request.
+   */
+  void deliver_body(std::string_view slice);
+
+  /**
+   * \brief Let the body handler know that the headers of the request are parsed.
+   */
+  void notify_headers();
+
+  /**
+   * \brief Consume the line with the size of a chunk.
+   * \returns Whether parsing can go on.
+   */
+  bool consume_chunk_size(std::string_view unit);
+
+  /**
+   * \brief Consume the bytes of a chunk, and the CRLF after them.
+   * \returns Whether parsing can go on.
+   */
+  bool consume_chunk_data(std::string_view unit);
+
+  /**
+   * \brief Consume a line of the trailer section, after the last chunk.
+   * \returns Whether parsing can go on.
+   */
+  bool consume_trailer_line(std::string_view unit);
+
+  /**
+   * \brief Parse the complete header block at the front of \p next_unit in zero-copy mode.
+   */
+  void parse_header_block(std::string_view raw);
+
+  /**
+   * \brief Enter the error state.
+   */
+  void fail(Error reason) noexcept;
+
+  /**
+   * The way the start line and the headers are stored.
+   */
+  Mode mode;
+
   /**
    * The request as parsed so far by the parser.
    */
@@ -77,6 +306,61 @@ private:
    * The current state of the parser. If an error-indicating stastus is set, parsing should stop.
    */
   State state;
+
+  /**
+   * The reason of the error state.
+   */
+  Error error = Error::NONE;
+
+  /**
+   * The offset into \p next_unit of the request being received.
+   */
+  std::size_t request_start = 0;
+
+  /**
+   * The offset into \p next_unit of the line being received.
+   */
+  std::size_t line_start = 0;
+
+  /**
+   * The offset into \p next_unit where the search for the end of the line resumes.
+   */
+  std::size_t scan_offset = 0;
+
+  /**
+   * The size of the complete lines of the header block received so far.
+   */
+  std::size_t header_block_size = 0;
+
+  /**
+   * The number of complete lines of the header block received so far.
+   */
+  std::size_t lines_count = 0;
+
+  /**
+   * The number of bytes of the current chunk not received yet.
+   */
+  std::size_t chunk_remaining = 0;
+
+  /**
+   * The number of bytes of the body received so far.
+   */
+  std::size_t body_received = 0;
+
+  /**
+   * The maximum size of a request body.
+   */
+  std::size_t max_body_size = DEFAULT_MAX_BODY_SIZE;
+
+  /**
+   * The callbacks receiving the bodies, if they are not buffered.
+   */
+  BodyHandler body_handler;
+
+  /**
+   * Whether the body handler paused the parser.
+   */
+  bool paused = false;
 };
 
 }  // namespace microhttp::http
@@ -4,22 +4,124 @@
 
 #pragma once
 
-#include "microhttp/status_codes.h"
-#include "microloop/buffer.h"
+#include "microhttp/http_response.h"
+#include "microhttp/version.h"
+#include "microloop/net/tcp_server.h"
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
 
 namespace microhttp::http
 {
 
+/**
+ * \brief Streams a response to a connection: the head first, then the body in as many pieces as it
+ * is produced, without ever holding all of it.
+ *
+ * Everything is queued on the non-blocking output of the connection and sent as soon as the socket
+ * takes it, so the client gets the head before the body is ready. When the queue fills up, the
+ * writer stops being writable and the producer should wait for the writable handler before going
+ * on, which bounds the memory used by a response of any size.
+ *
+ * The body is framed according to the head:
+ *  - responses that cannot have a body (1xx, 204 and 304) get none;
+ *  - with the Content-Length set on the head, exactly that many bytes must be written;
+ *  - otherwise, HTTP/1.1 clients get the chunked coding;
+ *  - older clients get a body delimited by closing the connection, see \p keep_alive().
+ */
 class ResponseWriter
 {
 public:
-  ResponseWriter();
+  using WritableHandler = std::function<void()>;
+
+  /**
+   * \param conn The connection the response is sent on. It must outlive the writer.
+   * \param request_version The version of the request being answered.
+   */
+  explicit ResponseWriter(
+      microloop::net::TcpServer::PeerConnection &conn, Version request_version = Version{1, 1});
+
+  /**
+   * \brief Send the status line and the headers of the response. The content of \p head, if any,
+   * is sent as the first part of the body.
+   * \returns Whether the connection is still writable.
+   * \throws std::logic_error If the head was already written.
+   * \throws std::invalid_argument If the Content-Length set on the head is not a number.
+   */
+  bool write_head(HttpResponse head);
+
+  /**
+   * \brief Send the next part of the body. Empty parts are ignored, since an empty chunk would end
+   * a chunked body.
+   * \returns Whether the connection is still writable.
+   * \throws std::logic_error If the head was not written yet, the response is finished, cannot have
+   * a body, or the body would exceed its Content-Length.
+   */
+  bool write(std::string_view data);
+
+  /**
+   * \brief End the response.
+   * \returns Whether the connection is still writable.
+   * \throws std::logic_error If the head was not written yet, or the body is shorter than its
+   * Content-Length.
+   */
+  bool finish();
 
-private:
   /**
-   * The HTTP status code associated with the response.
+   * \brief Whether more of the response can be written without growing the output queue past its
+   * high-water mark.
    */
-  StatusCode status_code;
+  bool writable() const noexcept
+  {
+    return conn_.writable();
+  }
+
+  /**
+   * \brief Set the function called once the output queue was sent after the writer stopped being
+   * writable. It replaces the drain handler of the connection.
+   */
+  void set_writable_handler(WritableHandler on_writable);
+
+  /**
+   * \brief Whether the connection can carry another response once this one is sent. It cannot if
+   * the end of the body is marked by closing the connection.
+   */
+  bool keep_alive() const noexcept
+  {
+    return framing_ != Framing::CLOSE_DELIMITED;
+  }
+
+  bool finished() const noexcept
+  {
+    return state_ == State::FINISHED;
+  }
+
+private:
+  enum class State
+  {
+    HEAD,
+    BODY,
+    FINISHED,
+  };
+
+  enum class Framing
+  {
+    NO_BODY,
+    CONTENT_LENGTH,
+    CHUNKED,
+    CLOSE_DELIMITED,
+  };
+
+private:
+  microloop::net::TcpServer::PeerConnection &conn_;
+  Version request_version_;
+
+  State state_ = State::HEAD;
+  Framing framing_ = Framing::CHUNKED;
+
+  /// The bytes of the body still to be written, when its length is known
+  std::uint64_t remaining_ = 0;
 };
 
 }  // namespace microhttp::http
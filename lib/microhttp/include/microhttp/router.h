@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/http_request.h"
+#include "microhttp/http_response.h"
+#include "microhttp/well_known.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief The parameters captured from a request path by a route, as views into the path.
+ *
+ * The storage is fixed, so that matching a route never allocates. The values are not
+ * percent-decoded, and are only valid as long as the path they were captured from.
+ */
+class RouteParams
+{
+public:
+  /// The maximum number of parameters, the wildcard included, a route can have
+  static constexpr std::size_t MAX_PARAMS = 8;
+
+  using Param = std::pair<std::string_view, std::string_view>;
+
+  /**
+   * \brief Get the value of the parameter or wildcard with the given name.
+   */
+  std::optional<std::string_view> get(std::string_view name) const noexcept
+  {
+    for (std::size_t idx = 0; idx != size_; ++idx)
+    {
+      if (params_[idx].first == name)
+      {
+        return params_[idx].second;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  std::size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  const Param &operator[](std::size_t idx) const noexcept
+  {
+    return params_[idx];
+  }
+
+  const Param *begin() const noexcept
+  {
+    return params_.data();
+  }
+
+  const Param *end() const noexcept
+  {
+    return params_.data() + size_;
+  }
+
+private:
+  friend class Router;
+
+  void push(std::string_view name, std::string_view value) noexcept
+  {
+    params_[size_++] = {name, value};
+  }
+
+  void pop() noexcept
+  {
+    --size_;
+  }
+
+  std::array<Param, MAX_PARAMS> params_{};
+  std::size_t size_ = 0;
+};
+
+/**
+ * \brief Maps request paths and methods to handlers, with a compressed radix tree.
+ *
+ * Routes are patterns made of segments separated by slashes:
+ *  - static segments, such as `/users`, match themselves;
+ *  - parameters, such as `/:id`, match a whole non-empty segment;
+ *  - a wildcard, such as `*path`, matches the rest of the path, slashes included. It can only be
+ *    the last segment of a pattern.
+ *
+ * The routes sharing a prefix share the nodes of the tree, so matching a path takes time
+ * proportional to its length, whatever the number of routes, and never allocates. When static and
+ * parameter segments overlap, e.g. `/users/new` and `/users/:id`, the static one has priority, and
+ * the parameter is only tried, going over that part of the path again, if the rest of the path does
+ * not match after it.
+ */
+class Router
+{
+public:
+  using Handler = std::function<void(const HttpRequest &, HttpResponse &, const RouteParams &)>;
+
+  /**
+   * \brief The outcome of matching a request against the routes.
+   */
+  struct Match
+  {
+    /// The handler for the method and path, or null if there is none
+    const Handler *handler = nullptr;
+
+    /// The methods the path has handlers for, one bit per `Method`. If the handler is null while
+    /// this is not zero, the method is not allowed for the path (405).
+    std::uint16_t allowed_methods = 0;
+
+    RouteParams params;
+  };
+
+  Router();
+
+  Router(Router &&) noexcept;
+
+  Router &operator=(Router &&) noexcept;
+
+  ~Router();
+
+  /**
+   * \brief Add a route.
+   * \throws std::invalid_argument if the pattern is not valid, has more than
+   * `RouteParams::MAX_PARAMS` parameters, already has a handler for the method, or names a
+   * parameter differently from another route at the same position.
+   * \returns The handler of the route, as \p match() returns it.
+   */
+  const Handler &add(Method method, std::string_view pattern, Handler handler);
+
+  /**
+   * \brief Match a request path, without its query, against the routes. HEAD requests are handled
+   * by the GET handler of the path if there is no HEAD one.
+   */
+  Match match(Method method, std::string_view path) const noexcept;
+
+  /**
+   * \brief Get the number of routes, one per pattern and method.
+   */
+  std::size_t size() const noexcept
+  {
+    return handlers_.size();
+  }
+
+private:
+  struct Node;
+
+  /**
+   * \brief Find the node matching the rest of a path, starting from a node whose prefix has
+   * already been matched.
+   */
+  static const Node *match_children(
+      const Node *node, std::string_view path, RouteParams &params) noexcept;
+
+  /**
+   * \brief Find or add the static node matching the given text, starting from a node whose prefix
+   * has already been matched.
+   */
+  static Node *insert_static(Node *node, std::string_view text);
+
+  std::unique_ptr<Node> root_;
+
+  /// The handlers, indexed by the nodes. A deque keeps them in place as routes are added.
+  std::deque<Handler> handlers_;
+};
+
+}  // namespace microhttp::http
@@ -0,0 +1,85 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/http_response.h"
+#include "microloop/buffer_pool.h"
+
+#include <memory>
+#include <string_view>
+#include <sys/uio.h>
+#include <vector>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief A response ready to be sent: the status line and the headers are written into a block
+ * of a buffer pool, and the content is referenced where it is, without being copied.
+ *
+ * The response must outlive its serialized form, and its content must not change in between.
+ */
+class SerializedResponse
+{
+public:
+  /**
+   * \brief Serialize the head of a response.
+   * \param response The response to be serialized.
+   * \param pool The pool the head is written into. A head larger than the blocks of the pool is
+   * written into a buffer of its own instead.
+   */
+  SerializedResponse(const HttpResponse &response, microloop::BufferPool &pool);
+
+  SerializedResponse(const SerializedResponse &) = delete;
+
+  SerializedResponse(SerializedResponse &&other) noexcept;
+
+  /**
+   * \brief Move assignment operator. Implemented using the move-and-swap idiom.
+   */
+  SerializedResponse &operator=(SerializedResponse other) noexcept;
+
+  ~SerializedResponse();
+
+  friend void swap(SerializedResponse &a, SerializedResponse &b) noexcept;
+
+  /**
+   * \brief Get the serialized status line and headers.
+   */
+  std::string_view head() const noexcept
+  {
+    return head_;
+  }
+
+  /**
+   * \brief Get the content of the response.
+   */
+  std::string_view body() const noexcept
+  {
+    return body_;
+  }
+
+  std::size_t size() const noexcept
+  {
+    return head_.size() + body_.size();
+  }
+
+  /**
+   * \brief Append the head and the body, if not empty, to a list of buffers to be sent with a
+   * single gathering write.
+   */
+  void append_to(std::vector<iovec> &iov) const;
+
+private:
+  /// The pool the head block was acquired from; null if the head has a buffer of its own
+  microloop::BufferPool *pool_ = nullptr;
+  char *block_ = nullptr;
+  std::unique_ptr<char[]> oversized_;
+
+  std::string_view head_;
+  std::string_view body_;
+};
+
+}  // namespace microhttp::http
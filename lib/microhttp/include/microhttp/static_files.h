@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/byte_ranges.h"
+#include "microhttp/file_cache.h"
+#include "microhttp/http_request.h"
+#include "microhttp/http_response.h"
+#include "microloop/net/tcp_server.h"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <vector>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief Map the path of a request target to a path relative to a document root.
+ *
+ * The path is percent-decoded and normalized: empty and `.` segments are dropped, and `..` segments
+ * remove the previous one. A trailing slash is kept, so that directories can be told apart.
+ *
+ * \returns An empty value if the path is not valid, would lead out of the root, or names a hidden
+ * file, i.e. has a segment starting with a dot.
+ */
+std::optional<std::string> map_to_root(std::string_view target);
+
+/**
+ * \brief Serves the files of a directory tree, answering GET and HEAD requests.
+ *
+ * The files are kept open by a \p FileCache, and their bodies are sent with `sendfile`, so a file
+ * already seen is sent without opening it, looking at its metadata or copying it through user
+ * space. Conditional requests are answered with the validators computed when the file was opened,
+ * and range requests with the ranges of the file.
+ */
+class StaticFiles
+{
+public:
+  struct Options
+  {
+    FileCache::Options cache;
+
+    /// The file served for a directory
+    std::string index = "index.html";
+  };
+
+  /**
+   * \brief A response to a request for a file: the head, and the file the body is sent from.
+   */
+  struct Reply
+  {
+    HttpResponse head;
+
+    /// The file the body is read from, kept open until it is sent. Null if the whole response
+    /// is the head.
+    FileCache::File file;
+
+    std::optional<RangedBody> body;
+
+    /**
+     * \brief Queue the body of the response on the output queue of a connection, after what is
+     * pending. The file is kept open until its bytes are sent, as the peer reads them.
+     * \param pending The responses to send before the body, e.g. to pipelined requests, followed
+     * by the serialized head of this one. They go out in the same segments as the body.
+     * \returns Whether the connection is still writable.
+     */
+    bool write(microloop::net::TcpServer::PeerConnection &conn, std::vector<iovec> pending) const;
+  };
+
+  /**
+   * \param root The document root.
+   * \param loop The event loop the changes to the files are reported by.
+   */
+  StaticFiles(const std::filesystem::path &root, Options options,
+      microloop::EventLoop *loop = &microloop::EventLoop::instance());
+
+  explicit StaticFiles(const std::filesystem::path &root) : StaticFiles{root, Options{}}
+  {}
+
+  /**
+   * \brief Answer a request for a file. The head is complete, except for the headers added to
+   * every response, such as Date.
+   */
+  Reply respond(const HttpRequest &request);
+
+  const FileCache &cache() const noexcept
+  {
+    return cache_;
+  }
+
+private:
+  Options options_;
+  FileCache cache_;
+};
+
+}  // namespace microhttp::http
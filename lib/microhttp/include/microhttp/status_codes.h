@@ -4,8 +4,9 @@
 
 #pragma once
 
+#include "microhttp/version.h"
+
 #include <cstdint>
-#include <map>
 #include <string_view>
 
 namespace microhttp::http
@@ -51,6 +52,7 @@ enum StatusCode : std::uint16_t
   RANGE_NOT_SATISFIABBLE = 416,
   EXPECTATION_FAILED = 417,
   UPGRADE_REQUIRED = 426,
+  REQUEST_HEADER_FIELDS_TOO_LARGE = 431,
   INTERNAL_SERVER_ERROR = 500,
   NOT_IMPLEMENTED = 501,
   BAD_GATEWAY = 502,
@@ -60,49 +62,107 @@ enum StatusCode : std::uint16_t
 };
 
 /**
- * \brief The mapping between HTTP status codes and reason phrases.
+ * \brief Get the reason phrase of a status code.
+ * \returns An empty string if the status code is not one of \p StatusCode.
  */
-static const std::map<std::uint16_t, std::string_view> http_reason_phrases{
-    std::make_pair(StatusCode::CONTINUE, "Continue"),
-    std::make_pair(StatusCode::SWITCHING_PROTOCOLS, "Switching Protocols"),
-    std::make_pair(StatusCode::OK, "OK"),
-    std::make_pair(StatusCode::CREATED, "Created"),
-    std::make_pair(StatusCode::ACCEPTED, "Accepted"),
-    std::make_pair(StatusCode::NON_AUTHORITATIVE_INFO, "Non-Authoritative Information"),
-    std::make_pair(StatusCode::NO_CONTENT, "No Content"),
-    std::make_pair(StatusCode::RESET_CONTENT, "Reset Content"),
-    std::make_pair(StatusCode::PARTIAL_CONTENT, "Partial Content"),
-    std::make_pair(StatusCode::MULTIPLE_CHOICES, "Multiple Choices"),
-    std::make_pair(StatusCode::MOVED_PERMANENTLY, "Moved Permanently"),
-    std::make_pair(StatusCode::FOUND, "Found"),
-    std::make_pair(StatusCode::SEE_OTHER, "See Other"),
-    std::make_pair(StatusCode::NOT_MODIFIED, "Not Modified"),
-    std::make_pair(StatusCode::USE_PROXY, "Use Proxy"),
-    std::make_pair(StatusCode::TEMPORARY_REDIRECT, "Temporary Redirect"),
-    std::make_pair(StatusCode::BAD_REQUEST, "Bad Request"),
-    std::make_pair(StatusCode::UNAUTHORIZED, "Unauthorized"),
-    std::make_pair(StatusCode::PAYMENT_REQUIRED, "Payment Required"),
-    std::make_pair(StatusCode::FORBIDDEN, "Forbidden"),
-    std::make_pair(StatusCode::NOT_FOUND, "Not Found"),
-    std::make_pair(StatusCode::METHOD_NOT_ALLOWED, "Method Not Allowed"),
-    std::make_pair(StatusCode::NOT_ACCEPTABLE, "Not Acceptable"),
-    std::make_pair(StatusCode::PROXY_AUTHENTICATION, "Proxy Authentication Required"),
-    std::make_pair(StatusCode::REQUEST_TIMEOUT, "Request Time-out"),
-    std::make_pair(StatusCode::CONFLICT, "Conflict"),
-    std::make_pair(StatusCode::GONE, "Gone"),
-    std::make_pair(StatusCode::LENGTH_REQUIRED, "Length Required"),
-    std::make_pair(StatusCode::PRECONDITION_FAILED, "Precondition Failed"),
-    std::make_pair(StatusCode::PAYLOAD_TOO_LARGE, "Request Entity Too Large"),
-    std::make_pair(StatusCode::URI_TOO_LONG, "Request-URI Too Large"),
-    std::make_pair(StatusCode::UNSUPPORTED_MEDIA_TYPE, "Unsupported Media Type"),
-    std::make_pair(StatusCode::RANGE_NOT_SATISFIABBLE, "Requested range not satisfiable"),
-    std::make_pair(StatusCode::EXPECTATION_FAILED, "Expectation Failed"),
-    std::make_pair(StatusCode::INTERNAL_SERVER_ERROR, "Internal Server Error"),
-    std::make_pair(StatusCode::NOT_IMPLEMENTED, "Not Implemented"),
-    std::make_pair(StatusCode::BAD_GATEWAY, "Bad Gateway"),
-    std::make_pair(StatusCode::SERVICE_UNAVAILABLE, "Service Unavailable"),
-    std::make_pair(StatusCode::GATEWAY_TIMEOUT, "Gateway Time-out"),
-    std::make_pair(StatusCode::HTTP_VERSION_NOT_SUPPORTED, "HTTP Version not supported"),
-};
+constexpr std::string_view get_reason_phrase(std::uint16_t code) noexcept
+{
+  switch (code)
+  {
+  case StatusCode::CONTINUE:
+    return "Continue";
+  case StatusCode::SWITCHING_PROTOCOLS:
+    return "Switching Protocols";
+  case StatusCode::OK:
+    return "OK";
+  case StatusCode::CREATED:
+    return "Created";
+  case StatusCode::ACCEPTED:
+    return "Accepted";
+  case StatusCode::NON_AUTHORITATIVE_INFO:
+    return "Non-Authoritative Information";
+  case StatusCode::NO_CONTENT:
+    return "No Content";
+  case StatusCode::RESET_CONTENT:
+    return "Reset Content";
+  case StatusCode::PARTIAL_CONTENT:
+    return "Partial Content";
+  case StatusCode::MULTIPLE_CHOICES:
+    return "Multiple Choices";
+  case StatusCode::MOVED_PERMANENTLY:
+    return "Moved Permanently";
+  case StatusCode::FOUND:
+    return "Found";
+  case StatusCode::SEE_OTHER:
+    return "See Other";
+  case StatusCode::NOT_MODIFIED:
+    return "Not Modified";
+  case StatusCode::USE_PROXY:
+    return "Use Proxy";
+  case StatusCode::TEMPORARY_REDIRECT:
+    return "Temporary Redirect";
+  case StatusCode::BAD_REQUEST:
+    return "Bad Request";
+  case StatusCode::UNAUTHORIZED:
+    return "Unauthorized";
+  case StatusCode::PAYMENT_REQUIRED:
+    return "Payment Required";
+  case StatusCode::FORBIDDEN:
+    return "Forbidden";
+  case StatusCode::NOT_FOUND:
+    return "Not Found";
+  case StatusCode::METHOD_NOT_ALLOWED:
+    return "Method Not Allowed";
+  case StatusCode::NOT_ACCEPTABLE:
+    return "Not Acceptable";
+  case StatusCode::PROXY_AUTHENTICATION:
+    return "Proxy Authentication Required";
+  case StatusCode::REQUEST_TIMEOUT:
+    return "Request Time-out";
+  case StatusCode::CONFLICT:
+    return "Conflict";
+  case StatusCode::GONE:
+    return "Gone";
+  case StatusCode::LENGTH_REQUIRED:
+    return "Length Required";
+  case StatusCode::PRECONDITION_FAILED:
+    return "Precondition Failed";
+  case StatusCode::PAYLOAD_TOO_LARGE:
+    return "Request Entity Too Large";
+  case StatusCode::URI_TOO_LONG:
+    return "Request-URI Too Large";
+  case StatusCode::UNSUPPORTED_MEDIA_TYPE:
+    return "Unsupported Media Type";
+  case StatusCode::RANGE_NOT_SATISFIABBLE:
+    return "Requested range not satisfiable";
+  case StatusCode::EXPECTATION_FAILED:
+    return "Expectation Failed";
+  case StatusCode::UPGRADE_REQUIRED:
+    return "Upgrade Required";
+  case StatusCode::REQUEST_HEADER_FIELDS_TOO_LARGE:
+    return "Request Header Fields Too Large";
+  case StatusCode::INTERNAL_SERVER_ERROR:
+    return "Internal Server Error";
+  case StatusCode::NOT_IMPLEMENTED:
+    return "Not Implemented";
+  case StatusCode::BAD_GATEWAY:
+    return "Bad Gateway";
+  case StatusCode::SERVICE_UNAVAILABLE:
+    return "Service Unavailable";
+  case StatusCode::GATEWAY_TIMEOUT:
+    return "Gateway Time-out";
+  case StatusCode::HTTP_VERSION_NOT_SUPPORTED:
+    return "HTTP Version not supported";
+  default:
+    return {};
+  }
+}
+
+/**
+ * \brief Get the status line of a response, CRLF included, such as "HTTP/1.1 200 OK\r\n". The
+ * status lines of HTTP/1.0 and HTTP/1.1 are rendered at compile time.
+ * \returns An empty string for any other version, or for a code which is not one of \p StatusCode.
+ */
+std::string_view get_status_line(Version version, std::uint16_t code) noexcept;
 
 }  // namespace microhttp::http
@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * \brief Vectorized scanning of HTTP messages.
+ *
+ * Every scan looks for the first byte in or out of a character class, 16 or 32 bytes at a time
+ * when the CPU supports SSE4.2 or AVX2, respectively. The widest kernel supported by the CPU is
+ * selected at runtime, and the scalar kernel is used on any other CPU.
+ */
+namespace microhttp::http::tokenizer
+{
+
+enum class Kernel
+{
+  SCALAR,
+  SSE42,
+  AVX2,
+};
+
+/**
+ * \brief A set of ASCII characters, stored as two nibble-indexed lookup tables.
+ *
+ * A byte `b` is in the class if `lo[b & 0xf] & hi[b >> 4]` is not zero. Each bit of `lo[l]` tells
+ * if the character with the low nibble `l` and a given high nibble is in the class, and `hi[h]`
+ * selects the bit of the high nibble `h`. Bytes above 0x7f are never in a class.
+ */
+struct CharClass
+{
+  template <class Predicate>
+  static constexpr CharClass from(Predicate predicate) noexcept
+  {
+    CharClass cls{};
+    for (std::uint32_t h = 0; h != 8; ++h)
+    {
+      cls.hi[h] = static_cast<std::uint8_t>(1u << h);
+      for (std::uint32_t l = 0; l != 16; ++l)
+      {
+        if (predicate(static_cast<char>(h << 4 | l)))
+        {
+          cls.lo[l] |= cls.hi[h];
+        }
+      }
+    }
+
+    return cls;
+  }
+
+  constexpr bool contains(char c) const noexcept
+  {
+    auto b = static_cast<std::uint8_t>(c);
+    return lo[b & 0xf] & hi[b >> 4];
+  }
+
+  alignas(16) std::array<std::uint8_t, 16> lo{};
+  alignas(16) std::array<std::uint8_t, 16> hi{};
+};
+
+/**
+ * \brief The characters allowed in a token (RFC 7230, Section 3.2.6), such as the method or the
+ * name of a header field.
+ */
+inline constexpr CharClass TOKEN = CharClass::from([](char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+      || std::string_view{"!#$%&'*+-.^_`|~"}.find(c) != std::string_view::npos;
+});
+
+/**
+ * \brief The characters not allowed in a field value: control characters other than HTAB.
+ */
+inline constexpr CharClass FIELD_VALUE_DELIMITERS
+    = CharClass::from([](char c) { return (c >= 0 && c < ' ' && c != '\t') || c == 0x7f; });
+
+/**
+ * \brief The characters not allowed in a request target: control characters and SP.
+ */
+inline constexpr CharClass REQUEST_TARGET_DELIMITERS
+    = CharClass::from([](char c) { return (c >= 0 && c <= ' ') || c == 0x7f; });
+
+/**
+ * \brief The kernel used by the scans.
+ */
+Kernel get_kernel() noexcept;
+
+/**
+ * \brief Select the kernel used by the scans, e.g. to compare them.
+ * \returns `false` if the CPU does not support the given kernel, `true` otherwise.
+ */
+bool set_kernel(Kernel kernel) noexcept;
+
+/**
+ * \brief Whether the CPU supports the given kernel.
+ */
+bool is_supported(Kernel kernel) noexcept;
+
+const char *kernel_name(Kernel kernel) noexcept;
+
+/**
+ * \brief Find the first byte of \p str in \p cls, if \p in_class is set, or out of it otherwise.
+ * \returns The index of the byte, or the size of \p str if there is no such byte.
+ */
+std::size_t scan(std::string_view str, const CharClass &cls, bool in_class) noexcept;
+
+/**
+ * \brief Get the length of the token at the start of \p str.
+ */
+inline std::size_t token_length(std::string_view str) noexcept
+{
+  return scan(str, TOKEN, false);
+}
+
+/**
+ * \brief Get the length of the field value at the start of \p str, including any trailing
+ * whitespace. A well-formed field value is followed by CRLF.
+ */
+inline std::size_t field_value_length(std::string_view str) noexcept
+{
+  return scan(str, FIELD_VALUE_DELIMITERS, true);
+}
+
+/**
+ * \brief Get the length of the request target at the start of \p str.
+ */
+inline std::size_t request_target_length(std::string_view str) noexcept
+{
+  return scan(str, REQUEST_TARGET_DELIMITERS, true);
+}
+
+/**
+ * \brief Find the first CRLF in \p str, starting at \p from.
+ * \returns The index of the CR, or `std::string_view::npos` if there is no CRLF.
+ */
+std::size_t find_crlf(std::string_view str, std::size_t from = 0) noexcept;
+
+}  // namespace microhttp::http::tokenizer
@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/well_known.h"
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief The headers which control how a request is received and answered, parsed once as they
+ * are added to the request, so that the parser and the handlers read plain fields.
+ */
+struct TypedHeaders
+{
+  enum class Connection : std::uint8_t
+  {
+    /// No connection option was sent, so the version of the request decides
+    DEFAULT,
+    KEEP_ALIVE,
+    CLOSE,
+  };
+
+  /**
+   * \brief The final transfer coding of the body.
+   */
+  enum class TransferCoding : std::uint8_t
+  {
+    NONE,
+    CHUNKED,
+
+    /// Any coding other than chunked, which cannot be decoded by the parser
+    UNSUPPORTED,
+  };
+
+  enum class Expectation : std::uint8_t
+  {
+    NONE,
+    CONTINUE,
+
+    /// Any expectation other than 100-continue (417 Expectation Failed)
+    UNSUPPORTED,
+  };
+
+  /**
+   * \brief Whether the header with the given ID is parsed into one of the fields.
+   */
+  static bool is_typed(HeaderId id) noexcept;
+
+  /**
+   * \brief Parse a header received from the client. Repeated list headers (Connection,
+   * Transfer-Encoding and Expect) are combined, as if their values were joined by commas.
+   * \returns `false` if the value is malformed, or if it is a repeated Content-Length or Host,
+   * `true` otherwise. Headers which are not typed are ignored.
+   */
+  bool add(HeaderId id, std::string_view value) noexcept;
+
+  /**
+   * \brief Forget the value of a header, as if it was never added.
+   */
+  void reset(HeaderId id) noexcept;
+
+  /// The length of the body, which fits in 64 bits
+  std::optional<std::uint64_t> content_length;
+
+  Connection connection = Connection::DEFAULT;
+  TransferCoding transfer_coding = TransferCoding::NONE;
+  Expectation expectation = Expectation::NONE;
+
+  /// Whether a Host header was received. Its value is found with `HeaderId::HOST`.
+  bool has_host = false;
+};
+
+}  // namespace microhttp::http
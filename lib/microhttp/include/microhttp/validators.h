@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microhttp/date_cache.h"
+#include "microhttp/http_request.h"
+#include "microhttp/http_response.h"
+
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <optional>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief The validators of a representation (RFC 7232): an entity tag and, if known, the date of
+ * the last modification.
+ *
+ * They are rendered once, when the representation is first seen, and kept next to it. Conditional
+ * requests are then answered without looking at the file or the content again.
+ */
+class Validators
+{
+public:
+  /**
+   * \brief Derive the validators of a file from its metadata. The entity tag is made of the inode,
+   * the modification time and the size, so it changes whenever the file is replaced or modified.
+   */
+  static Validators from_stat(const struct stat &st) noexcept;
+
+  /**
+   * \brief Derive the validators of a content from a hash of its bytes.
+   * \param last_modified When the content last changed, if known.
+   */
+  static Validators from_content(
+      std::string_view content, std::optional<std::time_t> last_modified = std::nullopt) noexcept;
+
+  /**
+   * \brief Get the strong entity tag, quotes included.
+   */
+  std::string_view etag() const noexcept
+  {
+    return std::string_view{etag_.data(), etag_size_};
+  }
+
+  std::optional<std::time_t> last_modified() const noexcept
+  {
+    return last_modified_;
+  }
+
+  /**
+   * \brief Set the ETag and Last-Modified headers of a response.
+   */
+  void apply(HttpResponse &response) const;
+
+  /**
+   * \brief Evaluate the If-None-Match and If-Modified-Since headers of a GET or HEAD request (RFC
+   * 7232, Section 6). If-Modified-Since is only looked at without If-None-Match.
+   * \returns Whether the copy of the client is current, so that it should be sent a 304 response.
+   */
+  bool not_modified(const HttpRequest &request) const noexcept;
+
+  /**
+   * \brief Evaluate the If-Range header of a request (RFC 7233, Section 3.2).
+   * \returns Whether the Range header of the request can be honored.
+   */
+  bool range_applies(const HttpRequest &request) const noexcept;
+
+  /**
+   * \brief Create the 304 response telling a client its copy is current. It carries the entity tag
+   * and no body.
+   */
+  HttpResponse not_modified_response() const;
+
+private:
+  /// Three 64-bit hexadecimal numbers, two dashes and two quotes
+  static constexpr std::size_t MAX_ETAG_SIZE = 3 * 16 + 2 + 2;
+
+  std::array<char, MAX_ETAG_SIZE> etag_{};
+  std::uint8_t etag_size_ = 0;
+
+  std::optional<std::time_t> last_modified_;
+  std::array<char, DateCache::IMF_FIXDATE_LEN> last_modified_date_{};
+};
+
+}  // namespace microhttp::http
@@ -0,0 +1,140 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * \brief The standard request methods and the common header field names, interned so that they
+ * can be compared and used as array indexes instead of strings.
+ *
+ * Names are looked up in perfect hash tables built at compile time, so a lookup hashes the name
+ * once and compares it with a single candidate. Like everywhere else in this library, the lookups
+ * ignore the case of the names.
+ */
+namespace microhttp::http
+{
+
+enum class Method : std::uint8_t
+{
+  GET,
+  HEAD,
+  POST,
+  PUT,
+  DELETE,
+  CONNECT,
+  OPTIONS,
+  TRACE,
+  PATCH,
+
+  /// Any other method, which is only available as a string
+  UNKNOWN,
+};
+
+inline constexpr std::size_t METHODS_COUNT = static_cast<std::size_t>(Method::UNKNOWN);
+
+enum class HeaderId : std::uint8_t
+{
+  ACCEPT,
+  ACCEPT_CHARSET,
+  ACCEPT_ENCODING,
+  ACCEPT_LANGUAGE,
+  ACCEPT_RANGES,
+  ACCESS_CONTROL_ALLOW_CREDENTIALS,
+  ACCESS_CONTROL_ALLOW_HEADERS,
+  ACCESS_CONTROL_ALLOW_METHODS,
+  ACCESS_CONTROL_ALLOW_ORIGIN,
+  ACCESS_CONTROL_EXPOSE_HEADERS,
+  ACCESS_CONTROL_MAX_AGE,
+  ACCESS_CONTROL_REQUEST_HEADERS,
+  ACCESS_CONTROL_REQUEST_METHOD,
+  AGE,
+  ALLOW,
+  AUTHORIZATION,
+  CACHE_CONTROL,
+  CONNECTION,
+  CONTENT_DISPOSITION,
+  CONTENT_ENCODING,
+  CONTENT_LANGUAGE,
+  CONTENT_LENGTH,
+  CONTENT_LOCATION,
+  CONTENT_RANGE,
+  CONTENT_SECURITY_POLICY,
+  CONTENT_TYPE,
+  COOKIE,
+  DATE,
+  DNT,
+  ETAG,
+  EXPECT,
+  EXPIRES,
+  FORWARDED,
+  FROM,
+  HOST,
+  IF_MATCH,
+  IF_MODIFIED_SINCE,
+  IF_NONE_MATCH,
+  IF_RANGE,
+  IF_UNMODIFIED_SINCE,
+  KEEP_ALIVE,
+  LAST_MODIFIED,
+  LINK,
+  LOCATION,
+  MAX_FORWARDS,
+  ORIGIN,
+  PRAGMA,
+  PROXY_AUTHENTICATE,
+  PROXY_AUTHORIZATION,
+  RANGE,
+  REFERER,
+  RETRY_AFTER,
+  SERVER,
+  SET_COOKIE,
+  STRICT_TRANSPORT_SECURITY,
+  TE,
+  TRAILER,
+  TRANSFER_ENCODING,
+  UPGRADE,
+  UPGRADE_INSECURE_REQUESTS,
+  USER_AGENT,
+  VARY,
+  VIA,
+  WWW_AUTHENTICATE,
+  X_FORWARDED_FOR,
+  X_FORWARDED_HOST,
+  X_FORWARDED_PROTO,
+  X_REQUEST_ID,
+  X_REQUESTED_WITH,
+
+  /// Any other field name, which is only available as a string
+  UNKNOWN,
+};
+
+inline constexpr std::size_t HEADER_IDS_COUNT = static_cast<std::size_t>(HeaderId::UNKNOWN);
+
+/**
+ * \brief Intern a method name, ignoring its case.
+ * \returns `Method::UNKNOWN` if this is not a standard method.
+ */
+Method method_from_string(std::string_view name) noexcept;
+
+/**
+ * \brief Get the lowercase name of a method, or an empty string for `Method::UNKNOWN`.
+ */
+std::string_view method_name(Method method) noexcept;
+
+/**
+ * \brief Intern a header field name, ignoring its case.
+ * \returns `HeaderId::UNKNOWN` if this is not a common field name.
+ */
+HeaderId header_id(std::string_view name) noexcept;
+
+/**
+ * \brief Get the lowercase name of a header field, or an empty string for `HeaderId::UNKNOWN`.
+ */
+std::string_view header_name(HeaderId id) noexcept;
+
+}  // namespace microhttp::http
@@ -0,0 +1,374 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/basic_http_server.h"
+
+#include "microhttp/date_cache.h"
+#include "microhttp/serialized_response.h"
+#include "microloop/event_loop.h"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <vector>
+
+namespace microhttp
+{
+
+namespace
+{
+
+const http::PinnedHeaders default_pinned_headers{{"Server", "microhttp"}};
+
+/**
+ * \brief Get the path of a request target, without the query, for the origin and absolute forms
+ * (RFC 7230, Section 5.3).
+ */
+std::string_view target_path(std::string_view target) noexcept
+{
+  if (!target.empty() && target[0] != '/')
+  {
+    auto authority_idx = target.find("://");
+    if (authority_idx == std::string_view::npos)
+    {
+      return {};
+    }
+
+    target.remove_prefix(authority_idx + 3);
+    auto path_idx = target.find_first_of("/?");
+    target.remove_prefix(std::min(path_idx, target.size()));
+    if (target.empty() || target[0] == '?')
+    {
+      return "/";
+    }
+  }
+
+  return target.substr(0, target.find('?'));
+}
+
+std::string allow_header(std::uint16_t allowed_methods)
+{
+  std::string allow;
+  for (std::size_t method = 0; method != http::METHODS_COUNT; ++method)
+  {
+    if (!(allowed_methods & (1u << method)))
+    {
+      continue;
+    }
+
+    if (!allow.empty())
+    {
+      allow += ", ";
+    }
+
+    for (auto c : http::method_name(static_cast<http::Method>(method)))
+    {
+      allow += static_cast<char>(std::toupper(c));
+    }
+  }
+
+  return allow;
+}
+
+/**
+ * \brief Whether the requirements of HTTP/1.1 apply to a request.
+ */
+bool is_http11(const http::HttpRequest &request) noexcept
+{
+  auto version = request.get_http_version();
+  return version.major > 1 || (version.major == 1 && version.minor >= 1);
+}
+
+/**
+ * \brief Get the status of the response rejecting a request before it is dispatched, if any.
+ * HTTP/1.1 requests must have a Host header (RFC 7230, Section 5.4), and 100-continue is the only
+ * expectation the server meets (RFC 7231, Section 5.1.1). Expectations are ignored in HTTP/1.0
+ * requests.
+ */
+std::optional<http::StatusCode> rejection_status(const http::HttpRequest &request) noexcept
+{
+  if (!is_http11(request))
+  {
+    return std::nullopt;
+  }
+
+  const auto &headers = request.get_typed_headers();
+  if (!headers.has_host)
+  {
+    return http::StatusCode::BAD_REQUEST;
+  }
+
+  if (headers.expectation == http::TypedHeaders::Expectation::UNSUPPORTED)
+  {
+    return http::StatusCode::EXPECTATION_FAILED;
+  }
+
+  return std::nullopt;
+}
+
+/**
+ * \brief Whether the parser has the headers of a request, and waits for its body.
+ */
+bool receives_body(http::RequestParser::State state) noexcept
+{
+  switch (state)
+  {
+  case http::RequestParser::WAITING_BODY:
+  case http::RequestParser::WAITING_CHUNK_SIZE:
+  case http::RequestParser::WAITING_CHUNK_DATA:
+  case http::RequestParser::WAITING_CHUNK_DATA_END:
+    return true;
+  default:
+    return false;
+  }
+}
+
+constexpr std::string_view continue_response = "HTTP/1.1 100 Continue\r\n\r\n";
+
+}  // namespace
+
+BasicHttpServer::BasicHttpServer(std::uint16_t port) :
+    TcpServer{port}, pinned_headers_{&default_pinned_headers}
+{
+  set_connection_callback(&BasicHttpServer::on_conn, this);
+  set_data_callback(&BasicHttpServer::on_data, this);
+}
+
+void BasicHttpServer::serve_files(std::string_view pattern, http::StaticFiles &files)
+{
+  /*
+   * The server sends the bodies itself, recognizing the handler. The handler only answers with the
+   * head when there is no connection to send the body on.
+   */
+  const auto &handler = router_.add(http::Method::GET, pattern,
+      [&files](const http::HttpRequest &request, http::HttpResponse &response, const auto &) {
+        response = files.respond(request).head;
+      });
+  file_routes_.emplace(&handler, &files);
+}
+
+http::HttpResponse BasicHttpServer::respond(const http::HttpRequest &request) const
+{
+  return respond(request, router_.match(request.get_method(), target_path(request.get_uri_view())));
+}
+
+http::StaticFiles::Reply BasicHttpServer::reply(const http::HttpRequest &request) const
+{
+  auto match = router_.match(request.get_method(), target_path(request.get_uri_view()));
+  if (auto it = file_routes_.find(match.handler); it != file_routes_.end())
+  {
+    return it->second->respond(request);
+  }
+
+  http::StaticFiles::Reply reply;
+  reply.head = respond(request, match);
+
+  return reply;
+}
+
+http::HttpResponse BasicHttpServer::respond(
+    const http::HttpRequest &request, const http::Router::Match &match) const
+{
+  http::HttpResponse response;
+  if (match.handler)
+  {
+    try
+    {
+      (*match.handler)(request, response, match.params);
+    }
+    catch (const std::exception &)
+    {
+      response = http::HttpResponse{{}, http::StatusCode::INTERNAL_SERVER_ERROR};
+    }
+  }
+  else if (match.allowed_methods)
+  {
+    response.set_status_code(http::StatusCode::METHOD_NOT_ALLOWED);
+    response.set_header("Allow", allow_header(match.allowed_methods));
+  }
+  else
+  {
+    response.set_status_code(http::StatusCode::NOT_FOUND);
+  }
+
+  return response;
+}
+
+void BasicHttpServer::run()
+{
+  while (MICROLOOP_TICK())
+    ;
+}
+
+void BasicHttpServer::on_conn(PeerConnection &conn)
+{
+  clients_.try_emplace(conn.fd());
+  conn.set_drain_handler([this](auto &conn) { on_drain(conn); });
+}
+
+void BasicHttpServer::on_data(PeerConnection &conn, const microloop::Buffer &buf)
+{
+  if (buf.empty())
+  {
+    /*
+     * A client may stop sending once it sent its requests, and still read the responses.
+     */
+    finish_output(conn, true);
+    return;
+  }
+
+  auto &client = clients_[conn.fd()];
+  auto &parser = client.parser;
+  parser.add_chunk(buf);
+
+  /*
+   * A single read may carry several pipelined requests. They are answered in order, and the
+   * responses are sent in one batch. The requests pipelined after one asking to close the
+   * connection are not answered.
+   */
+  std::vector<http::StaticFiles::Reply> replies;
+  std::vector<bool> with_body;
+  auto keep_alive = true;
+  while (keep_alive)
+  {
+    auto request = parser.next_request();
+    if (!request)
+    {
+      break;
+    }
+
+    keep_alive = request->keep_alive();
+    client.continue_sent = false;
+
+    auto status = rejection_status(*request);
+    auto &response =
+        status ? replies.emplace_back().head : replies.emplace_back(reply(*request)).head;
+    if (status)
+    {
+      response.set_status_code(*status);
+      keep_alive = keep_alive && *status != http::StatusCode::BAD_REQUEST;
+    }
+
+    with_body.push_back(request->get_method() != http::Method::HEAD);
+    if (!keep_alive)
+    {
+      response.set_header("Connection", "close");
+    }
+  }
+
+  auto failed = parser.get_state() == http::RequestParser::ERROR;
+  if (keep_alive && failed)
+  {
+    auto &response = replies.emplace_back().head;
+    response.set_status_code(http::RequestParser::get_error_status(parser.get_error()));
+    response.set_header("Connection", "close");
+    with_body.push_back(true);
+  }
+
+  /*
+   * The bodies of the files are sent from the files, with everything gathered before them going
+   * out in the same segments.
+   */
+  std::vector<http::SerializedResponse> serialized;
+  std::vector<iovec> iov;
+  serialized.reserve(replies.size());
+  for (std::size_t idx = 0; idx != replies.size(); ++idx)
+  {
+    auto &reply = replies[idx];
+    reply.head.pin_headers(*pinned_headers_);
+    reply.head.set_date(http::DateCache::instance());
+
+    /*
+     * HEAD responses carry the headers of the GET ones, Content-Length included, without the body.
+     */
+    auto &entry = serialized.emplace_back(reply.head, heads_);
+    if (!with_body[idx])
+    {
+      iov.push_back({const_cast<char *>(entry.head().data()), entry.head().size()});
+      continue;
+    }
+
+    entry.append_to(iov);
+    if (reply.file)
+    {
+      reply.write(conn, std::move(iov));
+      iov.clear();
+    }
+  }
+
+  /*
+   * A client expecting 100-continue waits for it before sending the body of its request, once the
+   * responses to the requests before it are sent (RFC 7231, Section 5.1.1).
+   */
+  const auto &pending = parser.get_parsed_request();
+  if (keep_alive && !failed && !client.continue_sent && receives_body(parser.get_state()) &&
+      pending.expects_continue() && is_http11(pending) && !rejection_status(pending))
+  {
+    iov.push_back({const_cast<char *>(continue_response.data()), continue_response.size()});
+    client.continue_sent = true;
+  }
+
+  if (!iov.empty())
+  {
+    conn.write(std::move(iov));
+  }
+
+  finish_output(conn, !keep_alive || failed);
+}
+
+void BasicHttpServer::on_drain(PeerConnection &conn)
+{
+  auto client = clients_.find(conn.fd());
+  if (client == clients_.end())
+  {
+    return;
+  }
+
+  if (client->second.closing || !conn.writable())
+  {
+    close_client(conn);
+    return;
+  }
+
+  conn.resume_reading();
+}
+
+void BasicHttpServer::finish_output(PeerConnection &conn, bool close)
+{
+  /*
+   * Nothing left in the output queue of a connection that is not writable means a send failed.
+   */
+  if (!conn.queued_bytes())
+  {
+    if (close || !conn.writable())
+    {
+      close_client(conn);
+    }
+
+    return;
+  }
+
+  /*
+   * The responses wait in the output queue until the peer reads them. The requests are not read in
+   * the meantime, so that a client pipelining requests without reading the responses cannot make
+   * the queue grow without bound. A connection to be closed is closed once its queue is sent.
+   */
+  if (close || !conn.writable())
+  {
+    clients_[conn.fd()].closing = close;
+    conn.pause_reading();
+  }
+}
+
+void BasicHttpServer::close_client(PeerConnection &conn)
+{
+  clients_.erase(conn.fd());
+  close_conn(conn);
+}
+
+}  // namespace microhttp
@@ -0,0 +1,370 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/byte_ranges.h"
+
+#include "microhttp/header_lists.h"
+#include "utils/string.h"
+
+#include <algorithm>
+#include <charconv>
+#include <memory>
+#include <optional>
+#include <random>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+constexpr std::string_view bytes_unit = "bytes=";
+
+/**
+ * \brief Parse a non-empty sequence of digits, the whole string.
+ */
+std::optional<std::uint64_t> parse_position(std::string_view str) noexcept
+{
+  std::uint64_t value = 0;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (str.empty() || ec != std::errc{} || ptr != str.data() + str.size())
+  {
+    return std::nullopt;
+  }
+
+  return value;
+}
+
+/**
+ * \brief Sort the ranges and merge the ones that overlap, if any do.
+ */
+void coalesce(std::vector<ByteRange> &ranges)
+{
+  auto sorted = ranges;
+  std::sort(sorted.begin(), sorted.end(),
+      [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+
+  auto overlap = std::adjacent_find(sorted.begin(), sorted.end(),
+      [](const auto &lhs, const auto &rhs) { return rhs.first <= lhs.last; });
+  if (overlap == sorted.end())
+  {
+    return;
+  }
+
+  ranges.clear();
+  for (const auto &range : sorted)
+  {
+    if (!ranges.empty() && range.first <= ranges.back().last)
+    {
+      ranges.back().last = std::max(ranges.back().last, range.last);
+    }
+    else
+    {
+      ranges.push_back(range);
+    }
+  }
+}
+
+/**
+ * \brief Render a random multipart boundary, so that it cannot be guessed and put in a
+ * representation to break its parts apart.
+ */
+std::string make_boundary()
+{
+  thread_local std::mt19937_64 generator{std::random_device{}()};
+
+  char boundary[16];
+  auto value = generator();
+  for (auto &c : boundary)
+  {
+    c = "0123456789abcdef"[value & 0xf];
+    value >>= 4;
+  }
+
+  return std::string{boundary, sizeof(boundary)};
+}
+
+void append_range(std::string &out, std::uint64_t first, std::uint64_t last, std::uint64_t size)
+{
+  out += "bytes ";
+  out += std::to_string(first);
+  out += '-';
+  out += std::to_string(last);
+  out += '/';
+  out += std::to_string(size);
+}
+
+}  // namespace
+
+Ranges parse_ranges(std::string_view range, std::uint64_t size, std::size_t max_ranges)
+{
+  range = header_lists::trim(range);
+  if (range.size() < bytes_unit.size()
+      || !::utils::string::iequals(range.substr(0, bytes_unit.size()), bytes_unit))
+  {
+    return {};
+  }
+
+  range.remove_prefix(bytes_unit.size());
+
+  Ranges result{Ranges::UNSATISFIABLE, {}};
+  std::size_t count = 0;
+  auto valid = header_lists::for_each_element(range, [&](auto spec) {
+    auto dash_idx = spec.find('-');
+    if (dash_idx == std::string_view::npos || ++count > max_ranges)
+    {
+      return false;
+    }
+
+    auto first_str = header_lists::trim(spec.substr(0, dash_idx));
+    auto last_str = header_lists::trim(spec.substr(dash_idx + 1));
+
+    if (first_str.empty())
+    {
+      /*
+       * A suffix range: the last bytes of the representation.
+       */
+      auto suffix = parse_position(last_str);
+      if (!suffix)
+      {
+        return false;
+      }
+
+      if (*suffix && size)
+      {
+        result.ranges.push_back({size - std::min(*suffix, size), size - 1});
+      }
+
+      return true;
+    }
+
+    auto first = parse_position(first_str);
+    auto last =
+        last_str.empty() ? std::optional<std::uint64_t>{size - 1} : parse_position(last_str);
+    if (!first || !last || (!last_str.empty() && *last < *first))
+    {
+      return false;
+    }
+
+    if (*first < size)
+    {
+      result.ranges.push_back({*first, std::min(*last, size - 1)});
+    }
+
+    return true;
+  });
+
+  if (!valid || !count)
+  {
+    return {};
+  }
+
+  if (!result.ranges.empty())
+  {
+    result.status = Ranges::PARTIAL;
+    coalesce(result.ranges);
+  }
+
+  return result;
+}
+
+Ranges select_ranges(const HttpRequest &request, std::uint64_t size, const Validators &validators)
+{
+  if (request.get_method() != Method::GET)
+  {
+    return {};
+  }
+
+  auto range = request.find_header(HeaderId::RANGE);
+  if (!range || !validators.range_applies(request))
+  {
+    return {};
+  }
+
+  return parse_ranges(*range, size);
+}
+
+RangedBody::RangedBody(Ranges ranges, std::uint64_t size, std::string_view content_type) :
+    ranges_{std::move(ranges)}, size_{size}
+{
+  if (!multipart())
+  {
+    return;
+  }
+
+  boundary_ = make_boundary();
+
+  /*
+   * The headers of the parts are rendered back to back and referred to by offsets, so that they
+   * stay valid when the body is moved.
+   */
+  for (std::size_t idx = 0; idx != ranges_.ranges.size(); ++idx)
+  {
+    const auto &range = ranges_.ranges[idx];
+
+    part_offsets_.push_back(parts_.size());
+    parts_ += idx ? "\r\n--" : "--";
+    parts_ += boundary_;
+    if (!content_type.empty())
+    {
+      parts_ += "\r\nContent-Type: ";
+      parts_ += content_type;
+    }
+
+    parts_ += "\r\nContent-Range: ";
+    append_range(parts_, range.first, range.last, size_);
+    parts_ += "\r\n\r\n";
+  }
+
+  part_offsets_.push_back(parts_.size());
+  parts_ += "\r\n--";
+  parts_ += boundary_;
+  parts_ += "--\r\n";
+  part_offsets_.push_back(parts_.size());
+}
+
+void RangedBody::apply(HttpResponse &head) const
+{
+  head.set_header("Accept-Ranges", "bytes");
+  head.skip_content_length();
+
+  switch (ranges_.status)
+  {
+  case Ranges::FULL:
+    break;
+
+  case Ranges::PARTIAL:
+    head.set_status_code(StatusCode::PARTIAL_CONTENT);
+    if (multipart())
+    {
+      head.set_header("Content-Type", "multipart/byteranges; boundary=" + boundary_);
+    }
+    else
+    {
+      std::string content_range;
+      append_range(content_range, ranges_.ranges[0].first, ranges_.ranges[0].last, size_);
+      head.set_header("Content-Range", std::move(content_range));
+    }
+    break;
+
+  case Ranges::UNSATISFIABLE:
+    head.set_status_code(StatusCode::RANGE_NOT_SATISFIABBLE);
+    head.set_header("Content-Range", "bytes */" + std::to_string(size_));
+    break;
+  }
+
+  head.set_header("Content-Length", content_length());
+}
+
+std::uint64_t RangedBody::content_length() const noexcept
+{
+  switch (ranges_.status)
+  {
+  case Ranges::FULL:
+    return size_;
+
+  case Ranges::UNSATISFIABLE:
+    return 0;
+
+  default:
+    break;
+  }
+
+  std::uint64_t length = parts_.size();
+  for (const auto &range : ranges_.ranges)
+  {
+    length += range.size();
+  }
+
+  return length;
+}
+
+void RangedBody::append_to(std::vector<iovec> &iov, std::string_view representation) const
+{
+  auto append = [&iov](std::string_view bytes) {
+    if (!bytes.empty())
+    {
+      iov.push_back({const_cast<char *>(bytes.data()), bytes.size()});
+    }
+  };
+
+  switch (ranges_.status)
+  {
+  case Ranges::FULL:
+    append(representation);
+    return;
+
+  case Ranges::UNSATISFIABLE:
+    return;
+
+  default:
+    break;
+  }
+
+  for (std::size_t idx = 0; idx != ranges_.ranges.size(); ++idx)
+  {
+    const auto &range = ranges_.ranges[idx];
+
+    if (multipart())
+    {
+      append(part_head(idx));
+    }
+
+    append(representation.substr(range.first, range.size()));
+  }
+
+  if (multipart())
+  {
+    append(part_head(ranges_.ranges.size()));
+  }
+}
+
+bool RangedBody::write(microloop::net::TcpServer::PeerConnection &conn, std::vector<iovec> head,
+    std::shared_ptr<const void> file, int file_fd) const
+{
+  switch (ranges_.status)
+  {
+  case Ranges::FULL:
+    conn.write(std::move(head), size_ != 0);
+    return conn.write_file(std::move(file), file_fd, 0, size_);
+
+  case Ranges::UNSATISFIABLE:
+    return conn.write(std::move(head));
+
+  default:
+    break;
+  }
+
+  /*
+   * The head and the headers of the parts are sent with MSG_MORE, so that they go out in the same
+   * segments as the bytes of the file following them. Everything is queued even once the
+   * connection stops being writable, since the response cannot be left half-way.
+   */
+  for (std::size_t idx = 0; idx != ranges_.ranges.size(); ++idx)
+  {
+    const auto &range = ranges_.ranges[idx];
+
+    if (multipart())
+    {
+      auto part = part_head(idx);
+      head.push_back({const_cast<char *>(part.data()), part.size()});
+    }
+
+    conn.write(std::move(head), true);
+    conn.write_file(file, file_fd, range.first, range.size());
+
+    head.clear();
+  }
+
+  if (multipart())
+  {
+    auto close_delimiter = part_head(ranges_.ranges.size());
+    conn.write(
+        std::vector<iovec>{{const_cast<char *>(close_delimiter.data()), close_delimiter.size()}});
+  }
+
+  return conn.writable();
+}
+
+}  // namespace microhttp::http
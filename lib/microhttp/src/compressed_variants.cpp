@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/compressed_variants.h"
+
+#include <utility>
+
+namespace microhttp::http
+{
+
+CompressedVariants::Variant CompressedVariants::find(std::string_view key, ContentCoding coding)
+{
+  auto it = entries_.find(key);
+  if (it == entries_.end())
+  {
+    return nullptr;
+  }
+
+  auto &entry = it->second;
+  auto &variant = entry.variants[static_cast<std::size_t>(coding)];
+  if (variant)
+  {
+    lru_.splice(lru_.begin(), lru_, entry.lru);
+  }
+
+  return variant;
+}
+
+CompressedVariants::Variant CompressedVariants::insert(
+    std::string_view key, ContentCoding coding, microloop::Buffer variant)
+{
+  auto cached = std::make_shared<const microloop::Buffer>(std::move(variant));
+  if (cached->size() > capacity_)
+  {
+    return cached;
+  }
+
+  auto it = entries_.find(key);
+  if (it == entries_.end())
+  {
+    it = entries_.emplace(std::string{key}, Entry{}).first;
+    lru_.push_front(it->first);
+    it->second.lru = lru_.begin();
+  }
+  else
+  {
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+  }
+
+  auto &entry = it->second;
+  auto &slot = entry.variants[static_cast<std::size_t>(coding)];
+  if (slot)
+  {
+    entry.size -= slot->size();
+    size_ -= slot->size();
+  }
+
+  slot = cached;
+  entry.size += cached->size();
+  size_ += cached->size();
+
+  while (size_ > capacity_)
+  {
+    erase(entries_.find(lru_.back()));
+  }
+
+  return cached;
+}
+
+void CompressedVariants::erase(std::string_view key)
+{
+  if (auto it = entries_.find(key); it != entries_.end())
+  {
+    erase(it);
+  }
+}
+
+void CompressedVariants::erase(Entries::iterator it)
+{
+  size_ -= it->second.size;
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+}  // namespace microhttp::http
@@ -0,0 +1,365 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/compression.h"
+
+#include "microhttp/compressed_variants.h"
+#include "microhttp/header_lists.h"
+#include "utils/string.h"
+
+#include <array>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+using header_lists::for_each_element;
+using header_lists::trim;
+
+constexpr std::string_view content_encoding_name = "Content-Encoding";
+constexpr std::string_view accept_encoding_name = "Accept-Encoding";
+constexpr std::string_view vary_name = "Vary";
+
+/**
+ * \brief A zlib stream kept by each thread for each coding, and reset between contents instead of
+ * allocating its state (a few hundred kilobytes) every time.
+ */
+class Deflater
+{
+public:
+  Deflater(ContentCoding coding, int level) : level_{level}
+  {
+    /*
+     * The "deflate" coding is the zlib format, not a raw deflate stream (RFC 7230, Section 4.2.2).
+     */
+    auto window_bits = coding == ContentCoding::GZIP ? MAX_WBITS + 16 : MAX_WBITS;
+    if (deflateInit2(&stream_, level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      throw std::runtime_error("cannot initialize the zlib stream");
+    }
+  }
+
+  Deflater(const Deflater &) = delete;
+
+  ~Deflater()
+  {
+    deflateEnd(&stream_);
+  }
+
+  z_stream &reset(int level)
+  {
+    deflateReset(&stream_);
+    if (level != level_ && deflateParams(&stream_, level, Z_DEFAULT_STRATEGY) == Z_OK)
+    {
+      level_ = level;
+    }
+
+    return stream_;
+  }
+
+private:
+  z_stream stream_{};
+  int level_;
+};
+
+z_stream &deflater(ContentCoding coding, int level)
+{
+  thread_local std::array<std::unique_ptr<Deflater>, CONTENT_CODINGS_COUNT> deflaters;
+
+  auto &deflater = deflaters[static_cast<std::size_t>(coding)];
+  if (!deflater)
+  {
+    deflater = std::make_unique<Deflater>(coding, level);
+  }
+
+  return deflater->reset(level);
+}
+
+/**
+ * \brief Parse a weight (RFC 7231, Section 5.3.1).
+ * \returns The weight in thousandths, or an empty value if it is not valid.
+ */
+std::optional<int> parse_qvalue(std::string_view str) noexcept
+{
+  if (str.empty() || (str[0] != '0' && str[0] != '1'))
+  {
+    return std::nullopt;
+  }
+
+  int value = (str[0] - '0') * 1000;
+  if (str.size() == 1)
+  {
+    return value;
+  }
+
+  if (str[1] != '.' || str.size() > 5)
+  {
+    return std::nullopt;
+  }
+
+  int scale = 100;
+  for (auto c : str.substr(2))
+  {
+    if (c < '0' || c > '9')
+    {
+      return std::nullopt;
+    }
+
+    value += (c - '0') * scale;
+    scale /= 10;
+  }
+
+  return value <= 1000 ? std::optional<int>{value} : std::nullopt;
+}
+
+bool list_contains(std::string_view list, std::string_view value) noexcept
+{
+  return !for_each_element(
+      list, [value](auto element) { return !::utils::string::iequals(element, value); });
+}
+
+/**
+ * \brief Let caches know that the response depends on the Accept-Encoding header of the request.
+ */
+void add_vary(HttpResponse &response)
+{
+  auto vary = response.header(vary_name);
+  if (!vary)
+  {
+    response.set_header(std::string{vary_name}, accept_encoding_name);
+  }
+  else if (!list_contains(*vary, "*") && !list_contains(*vary, accept_encoding_name))
+  {
+    response.set_header(std::string{vary_name}, *vary + ", " + std::string{accept_encoding_name});
+  }
+}
+
+/**
+ * \brief Mark a response as encoded. A strong entity tag becomes weak, since the encoded bytes
+ * differ from the ones it was computed for, while the representation stays equivalent.
+ */
+void set_encoding(HttpResponse &response, ContentCoding coding)
+{
+  response.set_header(std::string{content_encoding_name}, coding_name(coding));
+
+  if (auto etag = response.header("ETag"); etag && !etag->empty() && etag->front() == '"')
+  {
+    response.set_header("ETag", "W/" + *etag);
+  }
+}
+
+}  // namespace
+
+std::string_view coding_name(ContentCoding coding) noexcept
+{
+  switch (coding)
+  {
+  case ContentCoding::GZIP:
+    return "gzip";
+  case ContentCoding::DEFLATE:
+    return "deflate";
+  default:
+    return "identity";
+  }
+}
+
+ContentCoding negotiate_coding(std::string_view accept_encoding) noexcept
+{
+  /*
+   * The weights are in thousandths, and negative for the codings not listed.
+   */
+  int gzip = -1, deflate = -1, any = -1;
+
+  for_each_element(accept_encoding, [&](auto element) {
+    auto params_idx = std::min(element.find(';'), element.size());
+    auto coding = trim(element.substr(0, params_idx));
+
+    std::optional<int> weight = 1000;
+    for (auto params = element.substr(params_idx); !params.empty();)
+    {
+      params.remove_prefix(1);
+
+      auto param_end = std::min(params.find(';'), params.size());
+      auto param = trim(params.substr(0, param_end));
+      params.remove_prefix(param_end);
+
+      if (param.size() >= 2 && ::utils::string::iequals(param.substr(0, 2), "q="))
+      {
+        weight = parse_qvalue(trim(param.substr(2)));
+      }
+    }
+
+    if (!weight)
+    {
+      return true;
+    }
+
+    if (::utils::string::iequals(coding, "gzip") || ::utils::string::iequals(coding, "x-gzip"))
+    {
+      gzip = *weight;
+    }
+    else if (::utils::string::iequals(coding, "deflate"))
+    {
+      deflate = *weight;
+    }
+    else if (coding == "*")
+    {
+      any = *weight;
+    }
+
+    return true;
+  });
+
+  gzip = gzip < 0 ? any : gzip;
+  deflate = deflate < 0 ? any : deflate;
+
+  if (std::max(gzip, deflate) <= 0)
+  {
+    return ContentCoding::IDENTITY;
+  }
+
+  return gzip >= deflate ? ContentCoding::GZIP : ContentCoding::DEFLATE;
+}
+
+bool is_compressible(std::string_view content_type) noexcept
+{
+  using ::utils::string::iequals;
+
+  auto type = trim(content_type.substr(0, content_type.find(';')));
+  auto slash_idx = type.find('/');
+  if (slash_idx == std::string_view::npos)
+  {
+    return false;
+  }
+
+  auto top_level = type.substr(0, slash_idx);
+  auto subtype = type.substr(slash_idx + 1);
+
+  if (iequals(top_level, "text"))
+  {
+    return true;
+  }
+
+  auto suffix_idx = subtype.rfind('+');
+  if (suffix_idx != std::string_view::npos)
+  {
+    auto suffix = subtype.substr(suffix_idx + 1);
+    return iequals(suffix, "json") || iequals(suffix, "xml");
+  }
+
+  if (iequals(top_level, "application"))
+  {
+    for (auto compressible : {"json", "javascript", "x-javascript", "ecmascript", "xml", "wasm"})
+    {
+      if (iequals(subtype, compressible))
+      {
+        return true;
+      }
+    }
+  }
+
+  return iequals(top_level, "font") && (iequals(subtype, "ttf") || iequals(subtype, "otf"));
+}
+
+microloop::Buffer compress(std::string_view data, ContentCoding coding, int level)
+{
+  if (coding == ContentCoding::IDENTITY)
+  {
+    throw std::invalid_argument("identity is not a compression coding");
+  }
+
+  if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION)
+  {
+    throw std::invalid_argument("invalid compression level: " + std::to_string(level));
+  }
+
+  if (data.size() > std::numeric_limits<uInt>::max())
+  {
+    throw std::length_error("the content is too large to be compressed at once");
+  }
+
+  auto &stream = deflater(coding, level);
+
+  /*
+   * The output is sized for the worst case, so the whole content is compressed with one call.
+   */
+  microloop::Buffer compressed{deflateBound(&stream, data.size())};
+
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = static_cast<Bytef *>(compressed.data());
+  stream.avail_out = static_cast<uInt>(compressed.size());
+
+  if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+  {
+    throw std::runtime_error("cannot compress the content");
+  }
+
+  compressed.resize(stream.total_out);
+  return compressed;
+}
+
+ContentCoding Compressor::negotiate(const HttpRequest &request, HttpResponse &response) const
+{
+  if (response.content().size() < options_.min_size
+      || response.status_code() == StatusCode::PARTIAL_CONTENT
+      || response.header(content_encoding_name))
+  {
+    return ContentCoding::IDENTITY;
+  }
+
+  auto content_type = response.header("Content-Type");
+  if (!content_type || !is_compressible(*content_type))
+  {
+    return ContentCoding::IDENTITY;
+  }
+
+  add_vary(response);
+
+  auto accept_encoding = request.find_header(HeaderId::ACCEPT_ENCODING);
+  return accept_encoding ? negotiate_coding(*accept_encoding) : ContentCoding::IDENTITY;
+}
+
+void Compressor::compress(const HttpRequest &request, HttpResponse &response) const
+{
+  if (auto coding = negotiate(request, response); coding != ContentCoding::IDENTITY)
+  {
+    encode(response, coding, options_.level);
+  }
+}
+
+void Compressor::compress(const HttpRequest &request, HttpResponse &response,
+    CompressedVariants &variants, std::string_view key) const
+{
+  auto coding = negotiate(request, response);
+  if (coding == ContentCoding::IDENTITY)
+  {
+    return;
+  }
+
+  auto variant = variants.find(key, coding);
+  if (!variant)
+  {
+    variant = variants.insert(
+        key, coding, http::compress(response.content().str_view(), coding, options_.level));
+  }
+
+  response.content() = *variant;
+  set_encoding(response, coding);
+}
+
+void Compressor::encode(HttpResponse &response, ContentCoding coding, int level)
+{
+  response.content() = http::compress(response.content().str_view(), coding, level);
+  set_encoding(response, coding);
+}
+
+}  // namespace microhttp::http
@@ -0,0 +1,197 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/date_cache.h"
+
+#include "microloop/kernel_exception.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+constexpr std::string_view days = "SunMonTueWedThuFriSat";
+constexpr std::string_view months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+char *write_two_digits(char *out, int value) noexcept
+{
+  *out++ = static_cast<char>('0' + value / 10 % 10);
+  *out++ = static_cast<char>('0' + value % 10);
+
+  return out;
+}
+
+/**
+ * \brief Parse a number written with exactly \p str.size() digits; the first ones may be spaces.
+ */
+bool parse_digits(std::string_view str, int &value) noexcept
+{
+  str.remove_prefix(std::min(str.find_first_not_of(' '), str.size()));
+  if (str.empty())
+  {
+    return false;
+  }
+
+  value = 0;
+  for (auto c : str)
+  {
+    if (c < '0' || c > '9')
+    {
+      return false;
+    }
+
+    value = value * 10 + (c - '0');
+  }
+
+  return true;
+}
+
+bool parse_month(std::string_view str, int &month) noexcept
+{
+  for (month = 0; month != 12; ++month)
+  {
+    if (months.substr(month * 3, 3) == str)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * \brief Parse a time of day, such as "08:49:37".
+ */
+bool parse_time_of_day(std::string_view str, std::tm &tm) noexcept
+{
+  return str.size() == 8 && str[2] == ':' && str[5] == ':'
+      && parse_digits(str.substr(0, 2), tm.tm_hour) && parse_digits(str.substr(3, 2), tm.tm_min)
+      && parse_digits(str.substr(6, 2), tm.tm_sec);
+}
+
+}  // namespace
+
+DateCache &DateCache::instance()
+{
+  static DateCache instance_{&microloop::EventLoop::instance()};
+  return instance_;
+}
+
+DateCache::DateCache(microloop::EventLoop *event_loop) : event_loop_{event_loop}
+{
+  using microloop::event_sources::Timer;
+  using microloop::event_sources::TimerType;
+
+  refresh();
+
+  auto on_tick = [this](auto &) { refresh(); };
+  auto timer = std::make_unique<Timer<decltype(on_tick)>>(
+      std::chrono::seconds{1}, TimerType::INTERVAL, event_loop_, on_tick);
+
+  event_loop_->add_event_source(timer.get());
+  timer_ = timer.release();
+}
+
+DateCache::~DateCache()
+{
+  /*
+   * The event loop owns the timer, and destroys it once removed. A failure to remove it cannot be
+   * handled here, and must not escape the destructor.
+   */
+  try
+  {
+    event_loop_->remove_event_source(timer_);
+  }
+  catch (const microloop::KernelException &e)
+  {
+    std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] " << e.what() << "\n";
+  }
+}
+
+void DateCache::refresh() noexcept
+{
+  format(std::time(nullptr), value_.data());
+}
+
+void DateCache::format(std::time_t time, char *out) noexcept
+{
+  std::tm tm{};
+  gmtime_r(&time, &tm);
+
+  out = std::copy_n(days.data() + tm.tm_wday * 3, 3, out);
+  *out++ = ',';
+  *out++ = ' ';
+  out = write_two_digits(out, tm.tm_mday);
+  *out++ = ' ';
+  out = std::copy_n(months.data() + tm.tm_mon * 3, 3, out);
+  *out++ = ' ';
+  out = write_two_digits(out, (1900 + tm.tm_year) / 100);
+  out = write_two_digits(out, tm.tm_year % 100);
+  *out++ = ' ';
+  out = write_two_digits(out, tm.tm_hour);
+  *out++ = ':';
+  out = write_two_digits(out, tm.tm_min);
+  *out++ = ':';
+  out = write_two_digits(out, tm.tm_sec);
+  std::copy_n(" GMT", 4, out);
+}
+
+std::optional<std::time_t> DateCache::parse(std::string_view date) noexcept
+{
+  std::tm tm{};
+  bool valid = false;
+
+  auto comma_idx = date.find(',');
+  if (comma_idx == 3 && date.size() == IMF_FIXDATE_LEN)
+  {
+    /*
+     * IMF-fixdate: "Sun, 06 Nov 1994 08:49:37 GMT"
+     */
+    auto rest = date.substr(5);
+    valid = rest[2] == ' ' && rest[6] == ' ' && rest[11] == ' ' && rest.substr(20) == " GMT"
+        && parse_digits(rest.substr(0, 2), tm.tm_mday) && parse_month(rest.substr(3, 3), tm.tm_mon)
+        && parse_digits(rest.substr(7, 4), tm.tm_year) && parse_time_of_day(rest.substr(12, 8), tm);
+    tm.tm_year -= 1900;
+  }
+  else if (comma_idx != std::string_view::npos)
+  {
+    /*
+     * RFC 850: "Sunday, 06-Nov-94 08:49:37 GMT". Two-digit years are taken to be in the last
+     * century from 70 on, which is what the dates sent by old servers mean.
+     */
+    auto rest = date.substr(comma_idx + 1);
+    valid = rest.size() == 23 && rest[0] == ' ' && rest[3] == '-' && rest[7] == '-'
+        && rest[10] == ' ' && rest.substr(19) == " GMT"
+        && parse_digits(rest.substr(1, 2), tm.tm_mday) && parse_month(rest.substr(4, 3), tm.tm_mon)
+        && parse_digits(rest.substr(8, 2), tm.tm_year) && parse_time_of_day(rest.substr(11, 8), tm);
+    tm.tm_year += tm.tm_year < 70 ? 100 : 0;
+  }
+  else
+  {
+    /*
+     * asctime: "Sun Nov  6 08:49:37 1994"
+     */
+    valid = date.size() == 24 && date[3] == ' ' && date[7] == ' ' && date[10] == ' '
+        && date[19] == ' ' && parse_month(date.substr(4, 3), tm.tm_mon)
+        && parse_digits(date.substr(8, 2), tm.tm_mday) && parse_time_of_day(date.substr(11, 8), tm)
+        && parse_digits(date.substr(20, 4), tm.tm_year);
+    tm.tm_year -= 1900;
+  }
+
+  if (!valid || tm.tm_mday < 1 || tm.tm_mday > 31 || tm.tm_hour > 23 || tm.tm_min > 59
+      || tm.tm_sec > 60)
+  {
+    return std::nullopt;
+  }
+
+  return timegm(&tm);
+}
+
+}  // namespace microhttp::http
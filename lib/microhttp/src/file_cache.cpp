@@ -0,0 +1,207 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/file_cache.h"
+
+#include "microhttp/mime_types.h"
+#include "microloop/kernel_exception.h"
+
+#include <fcntl.h>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utility>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+/**
+ * \brief The changes after which a cached file is stale: its content or metadata changed, or it was
+ * replaced, which unlinks it, moved or deleted.
+ */
+constexpr std::uint32_t stale_events =
+    IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED;
+
+}  // namespace
+
+CachedFile::~CachedFile()
+{
+  ::close(fd);
+}
+
+FileCache::FileCache(
+    const std::filesystem::path &root, Options options, microloop::EventLoop *loop) :
+    root_{std::filesystem::canonical(root)}, options_{options}, loop_{loop}
+{
+  watcher_ = new microloop::event_sources::fs::FileWatcher{};
+  watcher_->set_on_event([this](const auto &event) { on_change(event); });
+  loop_->add_event_source(watcher_);
+}
+
+FileCache::~FileCache()
+{
+  /*
+   * The event loop owns the watcher, and closes its inotify instance when removing it. A failure to
+   * remove it cannot be handled here, and must not escape the destructor.
+   */
+  try
+  {
+    loop_->remove_event_source(watcher_);
+  }
+  catch (const microloop::KernelException &e)
+  {
+    std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] " << e.what() << "\n";
+  }
+}
+
+FileCache::File FileCache::open(std::string_view path)
+{
+  if (auto it = entries_.find(path); it != entries_.end())
+  {
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+
+    return it->second.file;
+  }
+
+  ++misses_;
+
+  auto file = load(path);
+  if (!file || static_cast<std::uint64_t>(file->st.st_size) > options_.max_bytes
+      || !options_.max_files)
+  {
+    return file;
+  }
+
+  auto full_path = root_ / path;
+  auto wd = watcher_->watch(full_path.c_str(), stale_events & ~IN_IGNORED);
+  if (wd == -1)
+  {
+    return file;
+  }
+
+  /*
+   * The file could have changed between opening it and watching it, in which case it is served
+   * this time, but not cached.
+   */
+  struct stat st
+  {};
+  if (::stat(full_path.c_str(), &st) != 0 || st.st_ino != file->st.st_ino
+      || st.st_mtim.tv_sec != file->st.st_mtim.tv_sec
+      || st.st_mtim.tv_nsec != file->st.st_mtim.tv_nsec || st.st_size != file->st.st_size)
+  {
+    if (watches_.find(wd) == watches_.end())
+    {
+      watcher_->unwatch(wd);
+    }
+
+    return file;
+  }
+
+  auto it = entries_.emplace(std::string{path}, Entry{file, wd, {}}).first;
+  lru_.push_front(it->first);
+  it->second.lru = lru_.begin();
+  watches_.emplace(wd, it->first);
+  bytes_ += file->st.st_size;
+
+  while (entries_.size() > options_.max_files || bytes_ > options_.max_bytes)
+  {
+    erase(entries_.find(lru_.back()));
+  }
+
+  return file;
+}
+
+void FileCache::erase(std::string_view path)
+{
+  if (auto it = entries_.find(path); it != entries_.end())
+  {
+    erase(it);
+  }
+}
+
+FileCache::File FileCache::load(std::string_view path) const
+{
+  auto full_path = root_ / path;
+
+  /*
+   * Opening a FIFO or a device may block until another process opens its other end, so the file is
+   * opened without blocking, and rejected below unless it is a regular file. The flag has no
+   * effect on the reads of a regular file.
+   */
+  auto fd = ::open(full_path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if (fd == -1)
+  {
+    return nullptr;
+  }
+
+  struct stat st
+  {};
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+  {
+    ::close(fd);
+    return nullptr;
+  }
+
+  /*
+   * Symbolic links may lead anywhere, so the real path of the file must still be in the root.
+   */
+  auto real_path = ::realpath(full_path.c_str(), nullptr);
+  auto inside = real_path
+      && std::string_view{real_path}.substr(0, root_.native().size()) == root_.native()
+      && (root_.native() == "/" || real_path[root_.native().size()] == '/');
+  ::free(real_path);
+
+  if (!inside)
+  {
+    ::close(fd);
+    return nullptr;
+  }
+
+  return std::make_shared<const CachedFile>(fd, st, mime_type(path));
+}
+
+void FileCache::erase(Entries::iterator it)
+{
+  auto wd = it->second.wd;
+  for (auto [first, last] = watches_.equal_range(wd); first != last; ++first)
+  {
+    if (first->second.data() == it->first.data())
+    {
+      watches_.erase(first);
+      break;
+    }
+  }
+
+  if (watches_.find(wd) == watches_.end())
+  {
+    watcher_->unwatch(wd);
+  }
+
+  bytes_ -= it->second.file->st.st_size;
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+void FileCache::on_change(const microloop::event_sources::fs::FileEvent &event)
+{
+  if (!(event.mask & stale_events))
+  {
+    return;
+  }
+
+  /*
+   * Erasing the last path of a watch descriptor removes the watch, so the paths are erased one by
+   * one, looking the descriptor up again every time.
+   */
+  for (auto it = watches_.find(event.wd); it != watches_.end(); it = watches_.find(event.wd))
+  {
+    erase(entries_.find(it->second));
+  }
+}
+
+}  // namespace microhttp::http
@@ -0,0 +1,130 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/header_block.h"
+
+#include "utils/string.h"
+
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <utility>
+
+namespace microhttp::http
+{
+
+HeaderBlock::HeaderBlock(std::string_view raw, std::size_t fields_capacity) :
+    fields_capacity_{fields_capacity}
+{
+  if (raw.empty() && !fields_capacity)
+  {
+    return;
+  }
+
+  /*
+   * The fields go first, since `new char[]` returns memory suitably aligned for them.
+   */
+  auto fields_size = fields_capacity * sizeof(HeaderField);
+  storage_ = std::make_unique<char[]>(fields_size + raw.size());
+
+  fields_ = new (storage_.get()) HeaderField[fields_capacity];
+  auto raw_copy = storage_.get() + fields_size;
+  std::copy_n(raw.data(), raw.size(), raw_copy);
+  raw_ = std::string_view{raw_copy, raw.size()};
+}
+
+HeaderBlock::HeaderBlock(const HeaderBlock &other) :
+    HeaderBlock{other.raw_, other.fields_capacity_}
+{
+  for (const auto &field : other.fields())
+  {
+    add_field(rebase(field.name, other), rebase(field.value, other));
+  }
+
+  set_start_line(rebase(other.method_, other), rebase(other.request_target_, other));
+}
+
+HeaderBlock::HeaderBlock(HeaderBlock &&other) noexcept
+{
+  swap(*this, other);
+}
+
+HeaderBlock &HeaderBlock::operator=(HeaderBlock other) noexcept
+{
+  swap(*this, other);
+  return *this;
+}
+
+void swap(HeaderBlock &a, HeaderBlock &b) noexcept
+{
+  using std::swap;
+
+  swap(a.storage_, b.storage_);
+  swap(a.raw_, b.raw_);
+  swap(a.fields_, b.fields_);
+  swap(a.fields_count_, b.fields_count_);
+  swap(a.fields_capacity_, b.fields_capacity_);
+  swap(a.method_, b.method_);
+  swap(a.request_target_, b.request_target_);
+  swap(a.known_fields_, b.known_fields_);
+}
+
+bool HeaderBlock::add_field(std::string_view name, std::string_view value) noexcept
+{
+  if (fields_count_ == fields_capacity_)
+  {
+    return false;
+  }
+
+  auto id = header_id(name);
+  fields_[fields_count_++] = HeaderField{name, value, id};
+
+  /*
+   * Only the first field with a name is indexed, as `find()` returns the first match.
+   */
+  if (id != HeaderId::UNKNOWN && fields_count_ <= std::numeric_limits<std::uint16_t>::max())
+  {
+    auto &known_field = known_fields_[static_cast<std::size_t>(id)];
+    if (!known_field)
+    {
+      known_field = static_cast<std::uint16_t>(fields_count_);
+    }
+  }
+
+  return true;
+}
+
+std::optional<std::string_view> HeaderBlock::find(std::string_view name) const noexcept
+{
+  auto id = header_id(name);
+  if (id != HeaderId::UNKNOWN)
+  {
+    return find(id);
+  }
+
+  /*
+   * An uncommon name can only match the fields which were not interned.
+   */
+  for (const auto &field : fields())
+  {
+    if (field.id == HeaderId::UNKNOWN && ::utils::string::iequals(field.name, name))
+    {
+      return field.value;
+    }
+  }
+
+  return std::nullopt;
+}
+
+std::string_view HeaderBlock::rebase(std::string_view view, const HeaderBlock &from) const noexcept
+{
+  if (view.data() == nullptr)
+  {
+    return view;
+  }
+
+  return std::string_view{raw_.data() + (view.data() - from.raw_.data()), view.size()};
+}
+
+}  // namespace microhttp::http
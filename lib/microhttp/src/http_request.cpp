@@ -4,14 +4,58 @@
 
 #include "microhttp/http_request.h"
 
+#include <utility>
+
 namespace microhttp::http
 {
 
 HttpRequest::HttpRequest() : http_version{1, 1}
 {}
 
-HttpRequest::HttpRequest(std::string http_method, std::string uri) :
-    http_version{1, 1}, http_method{http_method}, uri{uri}
-{}
+HttpRequest::HttpRequest(std::string_view http_method, std::string uri) :
+    http_version{1, 1}, uri{std::move(uri)}
+{
+  set_http_method(http_method);
+}
+
+HttpRequest::HttpRequest(const HttpRequest &other) :
+    http_version{other.http_version},
+    method{other.method},
+    http_method{other.http_method},
+    uri{other.uri},
+    headers{other.headers},
+    typed_headers{other.typed_headers},
+    header_block{other.header_block},
+    body{other.body}
+{
+  for (const auto &[name, value] : headers)
+  {
+    if (auto id = header_id(name); id != HeaderId::UNKNOWN)
+    {
+      known_headers[static_cast<std::size_t>(id)] = &value;
+    }
+  }
+}
+
+HttpRequest &HttpRequest::operator=(HttpRequest other) noexcept
+{
+  swap(*this, other);
+  return *this;
+}
+
+void swap(HttpRequest &a, HttpRequest &b) noexcept
+{
+  using std::swap;
+
+  swap(a.http_version, b.http_version);
+  swap(a.method, b.method);
+  swap(a.http_method, b.http_method);
+  swap(a.uri, b.uri);
+  swap(a.headers, b.headers);
+  swap(a.known_headers, b.known_headers);
+  swap(a.typed_headers, b.typed_headers);
+  swap(a.header_block, b.header_block);
+  swap(a.body, b.body);
+}
 
 }  // namespace microhttp::http
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/http_response.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+constexpr std::string_view header_separator = ": ";
+constexpr std::string_view date_name = "Date";
+
+std::size_t count_digits(std::uint64_t value) noexcept
+{
+  std::size_t count = 1;
+  for (; value >= 10; value /= 10)
+  {
+    ++count;
+  }
+
+  return count;
+}
+
+char *write(char *out, std::string_view str) noexcept
+{
+  return std::copy(str.begin(), str.end(), out);
+}
+
+char *write(char *out, std::uint64_t value) noexcept
+{
+  return std::to_chars(out, out + count_digits(value), value).ptr;
+}
+
+}  // namespace
+
+std::size_t HttpResponse::head_size() const noexcept
+{
+  auto size = get_status_line(http_version_, status_code_).size();
+  if (!size)
+  {
+    size = Version::HEADER.size() + count_digits(http_version_.major) + 1
+        + count_digits(http_version_.minor) + 1 + count_digits(status_code_) + 1
+        + reason_phrase().size() + constants::crlf_size;
+  }
+
+  if (date_)
+  {
+    size += date_name.size() + header_separator.size() + date_->value().size()
+        + constants::crlf_size;
+  }
+
+  if (pinned_headers_)
+  {
+    size += pinned_headers_->block().size();
+  }
+
+  for (const auto &[name, value] : headers_)
+  {
+    size += name.size() + header_separator.size() + value.size() + constants::crlf_size;
+  }
+
+  if (computes_content_length() && !headers_.count(CONTENT_LENGTH))
+  {
+    size += CONTENT_LENGTH.size() + header_separator.size() + count_digits(content_.size())
+        + constants::crlf_size;
+  }
+
+  return size + constants::crlf_size;
+}
+
+char *HttpResponse::write_head(char *out) const noexcept
+{
+  if (auto status_line = get_status_line(http_version_, status_code_); !status_line.empty())
+  {
+    out = write(out, status_line);
+  }
+  else
+  {
+    out = write(out, Version::HEADER);
+    out = write(out, http_version_.major);
+    *out++ = '.';
+    out = write(out, http_version_.minor);
+    *out++ = ' ';
+    out = write(out, status_code_);
+    *out++ = ' ';
+    out = write(out, reason_phrase());
+    out = write(out, constants::crlf);
+  }
+
+  if (date_)
+  {
+    out = write(out, date_name);
+    out = write(out, header_separator);
+    out = write(out, date_->value());
+    out = write(out, constants::crlf);
+  }
+
+  if (pinned_headers_)
+  {
+    out = write(out, pinned_headers_->block());
+  }
+
+  for (const auto &[name, value] : headers_)
+  {
+    out = write(out, name);
+    out = write(out, header_separator);
+    out = write(out, value);
+    out = write(out, constants::crlf);
+  }
+
+  if (computes_content_length() && !headers_.count(CONTENT_LENGTH))
+  {
+    out = write(out, CONTENT_LENGTH);
+    out = write(out, header_separator);
+    out = write(out, content_.size());
+    out = write(out, constants::crlf);
+  }
+
+  return write(out, constants::crlf);
+}
+
+template <>
+std::string HttpResponse::format<>() const
+{
+  std::string response(head_size() + content_.size(), '\0');
+
+  auto body = write_head(response.data());
+  write(body, content_.str_view());
+
+  return response;
+}
+
+template <>
+microloop::Buffer HttpResponse::format<>() const
+{
+  microloop::Buffer response{head_size() + content_.size()};
+
+  auto body = write_head(static_cast<char *>(response.data()));
+  write(body, content_.str_view());
+
+  return response;
+}
+
+}  // namespace microhttp::http
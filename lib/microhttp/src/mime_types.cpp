@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/mime_types.h"
+
+#include "utils/string.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+/**
+ * \brief The media types of the common extensions of the web, sorted by extension.
+ */
+constexpr std::array<std::pair<std::string_view, std::string_view>, 38> mime_types{{
+    {"avif", "image/avif"},
+    {"bmp", "image/bmp"},
+    {"css", "text/css; charset=utf-8"},
+    {"csv", "text/csv; charset=utf-8"},
+    {"gif", "image/gif"},
+    {"gz", "application/gzip"},
+    {"htm", "text/html; charset=utf-8"},
+    {"html", "text/html; charset=utf-8"},
+    {"ico", "image/x-icon"},
+    {"jpeg", "image/jpeg"},
+    {"jpg", "image/jpeg"},
+    {"js", "text/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"md", "text/markdown; charset=utf-8"},
+    {"mjs", "text/javascript; charset=utf-8"},
+    {"mp3", "audio/mpeg"},
+    {"mp4", "video/mp4"},
+    {"oga", "audio/ogg"},
+    {"ogg", "audio/ogg"},
+    {"ogv", "video/ogg"},
+    {"otf", "font/otf"},
+    {"pdf", "application/pdf"},
+    {"png", "image/png"},
+    {"svg", "image/svg+xml"},
+    {"tar", "application/x-tar"},
+    {"ttf", "font/ttf"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"wasm", "application/wasm"},
+    {"wav", "audio/wav"},
+    {"webm", "video/webm"},
+    {"webmanifest", "application/manifest+json"},
+    {"webp", "image/webp"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"xml", "application/xml"},
+    {"yaml", "application/yaml"},
+    {"zip", "application/zip"},
+}};
+
+constexpr std::string_view default_mime_type = "application/octet-stream";
+
+/// The longest extension of the table
+constexpr std::size_t max_extension_size = 16;
+
+}  // namespace
+
+std::string_view mime_type(std::string_view path) noexcept
+{
+  auto name = path.substr(std::min(path.rfind('/') + 1, path.size()));
+  auto dot_idx = name.rfind('.');
+  if (dot_idx == std::string_view::npos || dot_idx == 0)
+  {
+    return default_mime_type;
+  }
+
+  auto extension = name.substr(dot_idx + 1);
+  if (extension.empty() || extension.size() > max_extension_size)
+  {
+    return default_mime_type;
+  }
+
+  /*
+   * The extension is lowered into a small buffer, so that the table is searched with a binary
+   * search instead of comparing every extension ignoring case.
+   */
+  char lowered[max_extension_size];
+  std::transform(extension.begin(), extension.end(), lowered, ::utils::string::to_lower_ascii);
+  extension = std::string_view{lowered, extension.size()};
+
+  auto it = std::lower_bound(mime_types.begin(), mime_types.end(), extension,
+      [](const auto &entry, auto extension) { return entry.first < extension; });
+
+  return it != mime_types.end() && it->first == extension ? it->second : default_mime_type;
+}
+
+}  // namespace microhttp::http
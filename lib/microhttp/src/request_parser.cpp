@@ -5,98 +5,486 @@
 #include "microhttp/request_parser.h"
 
 #include "microhttp/constants.h"
+#include "microhttp/tokenizer.h"
+#include "microhttp/typed_headers.h"
 #include "microhttp/version.h"
+#include "microhttp/well_known.h"
 
 #include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <string_view>
+#include <utility>
 
 namespace microhttp::http
 {
 
 void RequestParser::add_chunk(const microloop::Buffer &buf)
 {
+  if (state == ERROR)
+  {
+    /*
+     * This request cannot be salvaged from the error state.
+     */
+
+    return;
+  }
+
+  /*
+   * The parsed bytes are dropped all at once, before appending the new ones. In zero-copy mode,
+   * the header block being received stays in place until it is complete.
+   */
+  auto parsed = mode == Mode::ZERO_COPY && state == WAITING_START_LINE ? request_start : line_start;
+  if (parsed)
+  {
+    next_unit.remove_prefix(parsed);
+    request_start -= std::min(request_start, parsed);
+    line_start -= parsed;
+    scan_offset -= parsed;
+  }
+
   next_unit.concat(buf);
+  parse();
+}
+
+std::optional<HttpRequest> RequestParser::next_request()
+{
+  if (state != DONE)
+  {
+    return std::nullopt;
+  }
+
+  std::optional<HttpRequest> completed{std::move(request)};
+
+  start_request();
+  parse();
+
+  return completed;
+}
+
+void RequestParser::resume()
+{
+  if (!paused)
+  {
+    return;
+  }
+
+  paused = false;
+  parse();
+}
+
+void RequestParser::parse()
+{
+  auto unit = next_unit.str_view();
 
-  while (!next_unit.empty())
+  for (auto progress = !paused; progress;)
   {
-    if (state == ERROR)
+    switch (state)
     {
-      /*
-       * This request cannot be salvaged from the error state.
-       */
+    case WAITING_START_LINE:
+    case WAITING_HEADER_LINE:
+      progress = consume_header_line(unit);
+      break;
+    case WAITING_BODY:
+      progress = consume_body(unit);
+      break;
+    case WAITING_CHUNK_SIZE:
+      progress = consume_chunk_size(unit);
+      break;
+    case WAITING_CHUNK_DATA:
+    case WAITING_CHUNK_DATA_END:
+      progress = consume_chunk_data(unit);
+      break;
+    case WAITING_TRAILER_LINE:
+      progress = consume_trailer_line(unit);
+      break;
+    default:
+      progress = false;
+      break;
+    }
+  }
+}
 
-      return;
+bool RequestParser::consume_header_line(std::string_view unit)
+{
+  auto line = next_header_line(unit);
+  if (!line)
+  {
+    return false;
+  }
+
+  if (state == WAITING_START_LINE && *line == constants::crlf && lines_count == 1)
+  {
+    /*
+     * Some clients send an extra CRLF after the body of a request, so empty lines before the
+     * start line are ignored, as recommended by RFC 7230, Section 3.5.
+     */
+    start_request();
+    return true;
+  }
+
+  if (mode == Mode::ZERO_COPY)
+  {
+    /*
+     * The lines are only counted until the whole block is received.
+     */
+    if (*line == constants::crlf)
+    {
+      parse_header_block(unit.substr(request_start, line_start - request_start));
     }
 
-    if (state == WAITING_BODY)
+    return true;
+  }
+
+  switch (state)
+  {
+  case WAITING_START_LINE: {
+    auto start_line = parse_start_line(*line);
+    if (!start_line)
+    {
+      fail(Error::BAD_REQUEST);
+      break;
+    }
+
+    request.set_http_method(start_line->method);
+    request.set_uri(std::string{start_line->request_target});
+    request.set_http_version(start_line->version);
+
+    state = WAITING_HEADER_LINE;
+    break;
+  }
+  case WAITING_HEADER_LINE: {
+    if (*line == constants::crlf)
     {
-      if (!request.get_content_length())
-      {
-        return;
-      }
+      start_body();
+      break;
+    }
 
-      auto remaining_body_size = *request.get_content_length() - request.get_body().size();
+    auto header_line = parse_header_line(*line);
+    if (!header_line || !request.add_header(header_line->name, std::string{header_line->value}))
+    {
+      fail(Error::BAD_REQUEST);
+      break;
+    }
 
-      request.get_body().concat(next_unit, remaining_body_size);
-      next_unit.clear();
+    // The state is not changed intentionally.
+
+    break;
+  }
+  default:
+    __builtin_unreachable();
+  }
+
+  return true;
+}
+
+void RequestParser::start_body()
+{
+  const auto &headers = request.get_typed_headers();
+
+  switch (headers.transfer_coding)
+  {
+  case TypedHeaders::TransferCoding::NONE:
+    /*
+     * A request with neither Transfer-Encoding nor Content-Length has no body (RFC 7230,
+     * Section 3.3.3).
+     */
+    if (headers.content_length.value_or(0) > max_body_size)
+    {
+      fail(Error::BODY_TOO_LARGE);
       return;
     }
 
-    auto crlf_idx = next_unit.str_view().find(constants::crlf);
-    if (crlf_idx == std::string_view::npos)
+    state = WAITING_BODY;
+    break;
+  case TypedHeaders::TransferCoding::CHUNKED:
+    /*
+     * A request with both could be read differently by an intermediary, so it is rejected rather
+     * than letting Transfer-Encoding win.
+     */
+    if (headers.content_length)
     {
-      /*
-       * We received a request fragment that we cannot parse in any way. Return and wait for
-       * another.
-       */
+      fail(Error::BAD_REQUEST);
       return;
     }
 
-    auto line = next_unit.str_view(0, crlf_idx + constants::crlf_size);
+    state = WAITING_CHUNK_SIZE;
+    break;
+  case TypedHeaders::TransferCoding::UNSUPPORTED:
+    /*
+     * Chunked must be the final coding. Any other coding is applied on top of it, and left for the
+     * handler to decode.
+     */
+    fail(headers.content_length ? Error::BAD_REQUEST : Error::UNSUPPORTED_TRANSFER_CODING);
+    return;
+  }
+
+  notify_headers();
+}
 
-    switch (state)
+void RequestParser::notify_headers()
+{
+  if (body_handler.on_headers)
+  {
+    body_handler.on_headers(request);
+  }
+}
+
+bool RequestParser::consume_body(std::string_view unit)
+{
+  auto body_size = request.get_typed_headers().content_length.value_or(0);
+
+  /*
+   * The bytes after the body belong to the next request.
+   */
+  auto count = std::min(body_size - body_received, unit.size() - line_start);
+  if (count)
+  {
+    deliver_body(unit.substr(line_start, count));
+  }
+
+  if (body_received != body_size || paused)
+  {
+    return false;
+  }
+
+  state = DONE;
+  return true;
+}
+
+void RequestParser::deliver_body(std::string_view slice)
+{
+  line_start += slice.size();
+  scan_offset = line_start;
+  body_received += slice.size();
+
+  if (!body_handler.on_body_chunk)
+  {
+    request.get_body().append(slice);
+    return;
+  }
+
+  if (!body_handler.on_body_chunk(slice))
+  {
+    paused = true;
+  }
+}
+
+bool RequestParser::consume_chunk_size(std::string_view unit)
+{
+  auto line = next_line(unit, MAX_CHUNK_SIZE_LINE_LEN, Error::BAD_REQUEST);
+  if (!line)
+  {
+    return false;
+  }
+
+  line->remove_suffix(constants::crlf_size);
+
+  std::uint64_t size = 0;
+  auto [end, ec] = std::from_chars(line->data(), line->data() + line->size(), size, 16);
+  if (ec != std::errc{} || end == line->data())
+  {
+    fail(ec == std::errc::result_out_of_range ? Error::BODY_TOO_LARGE : Error::BAD_REQUEST);
+    return false;
+  }
+
+  /*
+   * The chunk extensions are ignored, but they must at least be introduced properly.
+   */
+  auto extensions = line->substr(end - line->data());
+  extensions.remove_prefix(std::min(extensions.find_first_not_of(" \t"), extensions.size()));
+  if (!extensions.empty() && extensions.front() != ';')
+  {
+    fail(Error::BAD_REQUEST);
+    return false;
+  }
+
+  if (size > max_body_size - body_received)
+  {
+    fail(Error::BODY_TOO_LARGE);
+    return false;
+  }
+
+  chunk_remaining = size;
+  state = size ? WAITING_CHUNK_DATA : WAITING_TRAILER_LINE;
+  return true;
+}
+
+bool RequestParser::consume_chunk_data(std::string_view unit)
+{
+  if (state == WAITING_CHUNK_DATA)
+  {
+    auto count = std::min(chunk_remaining, unit.size() - line_start);
+    if (count)
     {
-    case WAITING_START_LINE: {
-      auto start_line = parse_start_line(line);
-      if (!start_line)
-      {
-        state = ERROR;
-        break;
-      }
-
-      request.set_http_method(std::string{start_line->method});
-      request.set_uri(std::string{start_line->request_target});
-      request.set_http_version(start_line->version);
-
-      state = WAITING_HEADER_LINE;
-      break;
+      deliver_body(unit.substr(line_start, count));
+      chunk_remaining -= count;
     }
-    case WAITING_HEADER_LINE: {
-      if (crlf_idx == 0)
-      {
-        state = WAITING_BODY;
-        break;
-      }
 
-      auto header_line = parse_header_line(line);
-      if (!header_line)
-      {
-        state = ERROR;
-        break;
-      }
+    if (chunk_remaining || paused)
+    {
+      return false;
+    }
 
-      request.set_header(std::string{header_line->name}, std::string{header_line->value});
+    state = WAITING_CHUNK_DATA_END;
+  }
 
-      // The state is not changed intentionally.
+  if (unit.size() - line_start < constants::crlf_size)
+  {
+    return false;
+  }
 
-      break;
-    }
-    default:
-      __builtin_unreachable();
+  if (unit.substr(line_start, constants::crlf_size) != constants::crlf)
+  {
+    fail(Error::BAD_REQUEST);
+    return false;
+  }
+
+  line_start += constants::crlf_size;
+  scan_offset = line_start;
+  state = WAITING_CHUNK_SIZE;
+  return true;
+}
+
+bool RequestParser::consume_trailer_line(std::string_view unit)
+{
+  auto line = next_header_line(unit);
+  if (!line)
+  {
+    return false;
+  }
+
+  if (*line == constants::crlf)
+  {
+    state = DONE;
+    return true;
+  }
+
+  /*
+   * The trailer fields are merged with the headers. In zero-copy mode, they are copied, since
+   * they are not part of the header block.
+   */
+  auto trailer_line = parse_header_line(*line);
+  if (!trailer_line)
+  {
+    fail(Error::BAD_REQUEST);
+    return false;
+  }
+
+  /*
+   * The fields controlling the framing or the routing of a message are not allowed in a trailer
+   * (RFC 7230, Section 4.1.2), and are dropped rather than changing a parsed request.
+   */
+  if (TypedHeaders::is_typed(header_id(trailer_line->name)))
+  {
+    return true;
+  }
+
+  request.set_header(trailer_line->name, std::string{trailer_line->value});
+  return true;
+}
+
+std::optional<std::string_view> RequestParser::next_line(
+    std::string_view unit, std::size_t max_size, Error too_long) noexcept
+{
+  auto crlf_idx = tokenizer::find_crlf(unit, scan_offset);
+  auto complete = crlf_idx != std::string_view::npos;
+  auto line_end = complete ? crlf_idx + constants::crlf_size : unit.size();
+  auto line_size = line_end - line_start;
+
+  if (line_size > max_size)
+  {
+    fail(too_long);
+    return std::nullopt;
+  }
+
+  if (!complete)
+  {
+    /*
+     * A trailing CR may be the first half of a CRLF split between chunks, so only that byte is
+     * scanned again.
+     */
+    scan_offset = unit.size() - (!unit.empty() && unit.back() == '\r');
+    return std::nullopt;
+  }
+
+  auto line = unit.substr(line_start, line_size);
+
+  line_start = line_end;
+  scan_offset = line_end;
+
+  return line;
+}
+
+std::optional<std::string_view> RequestParser::next_header_line(std::string_view unit) noexcept
+{
+  auto line = header_block_size
+      ? next_line(unit, MAX_HEADER_BLOCK_SIZE - header_block_size, Error::HEADER_BLOCK_TOO_LARGE)
+      : next_line(unit, MAX_REQUEST_LINE_LEN, Error::REQUEST_LINE_TOO_LONG);
+
+  if (line)
+  {
+    header_block_size += line->size();
+    ++lines_count;
+  }
+
+  return line;
+}
+
+void RequestParser::parse_header_block(std::string_view raw)
+{
+  /*
+   * Every line but the start line and the empty line is a header line, so the fields can be
+   * allocated together with the copy of the block.
+   */
+  HeaderBlock block{raw, lines_count - 2};
+  auto rest = block.raw();
+
+  auto line = rest.substr(0, tokenizer::find_crlf(rest) + constants::crlf_size);
+  auto start_line = parse_start_line(line);
+  if (!start_line)
+  {
+    fail(Error::BAD_REQUEST);
+    return;
+  }
+
+  rest.remove_prefix(line.size());
+
+  for (auto crlf_idx = tokenizer::find_crlf(rest); crlf_idx != 0;
+       crlf_idx = tokenizer::find_crlf(rest))
+  {
+    line = rest.substr(0, crlf_idx + constants::crlf_size);
+
+    auto header_line = parse_header_line(line);
+    if (!header_line)
+    {
+      fail(Error::BAD_REQUEST);
+      return;
     }
 
-    next_unit.remove_prefix(crlf_idx + constants::crlf_size);
+    block.add_field(header_line->name, header_line->value);
+    rest.remove_prefix(line.size());
   }
+
+  /*
+   * Standard methods are interned, so only extension methods are copied.
+   */
+  request.set_http_method(start_line->method);
+  request.set_http_version(start_line->version);
+  block.set_start_line(start_line->method, start_line->request_target);
+  if (!request.set_header_block(std::move(block)))
+  {
+    fail(Error::BAD_REQUEST);
+    return;
+  }
+
+  start_body();
+}
+
+void RequestParser::fail(Error reason) noexcept
+{
+  state = ERROR;
+  error = reason;
 }
 
 RequestParser::State RequestParser::get_state() const
@@ -115,10 +503,25 @@ HttpRequest &RequestParser::get_parsed_request()
 }
 
 void RequestParser::reset()
+{
+  next_unit.clear();
+  line_start = 0;
+  scan_offset = 0;
+
+  start_request();
+}
+
+void RequestParser::start_request()
 {
   state = WAITING_START_LINE;
+  error = Error::NONE;
   request = HttpRequest{};
-  next_unit.clear();
+  request_start = line_start;
+  header_block_size = 0;
+  lines_count = 0;
+  chunk_remaining = 0;
+  body_received = 0;
+  paused = false;
 }
 
 }  // namespace microhttp::http
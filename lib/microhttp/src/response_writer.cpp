@@ -0,0 +1,176 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/response_writer.h"
+
+#include "microhttp/constants.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <utility>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+constexpr std::string_view content_length_name = "Content-Length";
+constexpr std::string_view last_chunk = "0\r\n\r\n";
+
+/**
+ * \brief Whether a response with the given status code cannot have a body (RFC 7230, Section 3.3).
+ */
+bool is_bodiless(std::uint16_t code) noexcept
+{
+  return code / 100 == 1 || code == StatusCode::NO_CONTENT || code == StatusCode::NOT_MODIFIED;
+}
+
+}  // namespace
+
+ResponseWriter::ResponseWriter(
+    microloop::net::TcpServer::PeerConnection &conn, Version request_version) :
+    conn_{conn}, request_version_{request_version}
+{}
+
+bool ResponseWriter::write_head(HttpResponse head)
+{
+  if (state_ != State::HEAD)
+  {
+    throw std::logic_error("the head of the response was already written");
+  }
+
+  head.skip_content_length();
+
+  if (is_bodiless(head.status_code()))
+  {
+    framing_ = Framing::NO_BODY;
+  }
+  else if (auto length = head.header(content_length_name); length)
+  {
+    auto first = length->data(), last = length->data() + length->size();
+    auto [end, ec] = std::from_chars(first, last, remaining_);
+    if (ec != std::errc{} || end != last || first == last)
+    {
+      throw std::invalid_argument("invalid Content-Length: " + *length);
+    }
+
+    framing_ = Framing::CONTENT_LENGTH;
+  }
+  else if (request_version_.major > 1 || (request_version_.major == 1 && request_version_.minor))
+  {
+    framing_ = Framing::CHUNKED;
+    head.set_header("Transfer-Encoding", "chunked");
+  }
+  else
+  {
+    framing_ = Framing::CLOSE_DELIMITED;
+    head.set_header("Connection", "close");
+  }
+
+  microloop::Buffer serialized{head.head_size()};
+  head.write_head(static_cast<char *>(serialized.data()));
+
+  state_ = State::BODY;
+  conn_.write(std::move(serialized));
+
+  return write(head.content().str_view());
+}
+
+bool ResponseWriter::write(std::string_view data)
+{
+  if (state_ != State::BODY)
+  {
+    throw std::logic_error(state_ == State::HEAD ? "the head of the response was not written"
+                                                 : "the response is finished");
+  }
+
+  if (data.empty())
+  {
+    return conn_.writable();
+  }
+
+  switch (framing_)
+  {
+  case Framing::NO_BODY:
+    throw std::logic_error("the response cannot have a body");
+  case Framing::CONTENT_LENGTH:
+    if (data.size() > remaining_)
+    {
+      throw std::logic_error("the body exceeds its Content-Length");
+    }
+
+    remaining_ -= data.size();
+    break;
+  case Framing::CHUNKED: {
+    /*
+     * The chunk is framed in the same buffer it is copied into, so it takes a single allocation.
+     */
+    char size_line[sizeof(std::size_t) * 2 + constants::crlf_size];
+    auto size_end = std::to_chars(size_line, size_line + sizeof(size_line), data.size(), 16).ptr;
+    size_end = std::copy_n(constants::crlf, constants::crlf_size, size_end);
+
+    std::size_t size_line_len = size_end - size_line;
+    microloop::Buffer chunk{size_line_len + data.size() + constants::crlf_size};
+
+    auto out = static_cast<char *>(chunk.data());
+    out = std::copy(size_line, size_end, out);
+    out = std::copy(data.begin(), data.end(), out);
+    std::copy_n(constants::crlf, constants::crlf_size, out);
+
+    return conn_.write(std::move(chunk));
+  }
+  case Framing::CLOSE_DELIMITED:
+    break;
+  }
+
+  microloop::Buffer part{data.size()};
+  std::copy(data.begin(), data.end(), static_cast<char *>(part.data()));
+
+  return conn_.write(std::move(part));
+}
+
+bool ResponseWriter::finish()
+{
+  if (state_ == State::HEAD)
+  {
+    throw std::logic_error("the head of the response was not written");
+  }
+
+  if (state_ == State::FINISHED)
+  {
+    return conn_.writable();
+  }
+
+  if (framing_ == Framing::CONTENT_LENGTH && remaining_)
+  {
+    throw std::logic_error("the body is shorter than its Content-Length");
+  }
+
+  state_ = State::FINISHED;
+
+  if (framing_ == Framing::CHUNKED)
+  {
+    return conn_.write(microloop::Buffer{last_chunk.data(), last_chunk.size()});
+  }
+
+  return conn_.writable();
+}
+
+void ResponseWriter::set_writable_handler(WritableHandler on_writable)
+{
+  if (!on_writable)
+  {
+    conn_.set_drain_handler(nullptr);
+    return;
+  }
+
+  conn_.set_drain_handler(
+      [on_writable = std::move(on_writable)](microloop::net::TcpServer::PeerConnection &) {
+        on_writable();
+      });
+}
+
+}  // namespace microhttp::http
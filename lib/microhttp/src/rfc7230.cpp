@@ -4,22 +4,14 @@
 
 #include "microhttp/rfc7230.h"
 
-#include "absl/strings/str_split.h"
+#include "microhttp/tokenizer.h"
 #include "utils/string.h"
 
-#include <vector>
-
 namespace microhttp::http
 {
 
 std::optional<StartLineData> RFC7230::parse_start_line(std::string_view str) noexcept
 {
-  auto l = str.size();
-  if (l <= 2)
-  {
-    return std::nullopt;
-  }
-
   if (!utils::string::ends_with(str, "\r\n"))
   {
     return std::nullopt;
@@ -27,62 +19,67 @@ std::optional<StartLineData> RFC7230::parse_start_line(std::string_view str) noe
 
   str.remove_suffix(2);
 
-  std::vector<std::string_view> parts = absl::StrSplit(str, ' ');
-
   /*
-   * The start line is made of exactly THREE parts, per the standard: the HTTP method, the request
-   * target, and the HTTP version.
+   * The start line is made of exactly THREE parts, per the standard, separated by single spaces:
+   * the HTTP method, which is a token, the request target, and the HTTP version.
    */
-  if (parts.size() != 3)
+  auto method = str.substr(0, tokenizer::token_length(str));
+  if (method.empty() || method.size() == str.size() || str[method.size()] != ' ')
+  {
+    return std::nullopt;
+  }
+
+  str.remove_prefix(method.size() + 1);
+
+  auto request_target = str.substr(0, tokenizer::request_target_length(str));
+  if (request_target.empty() || request_target.size() == str.size()
+      || str[request_target.size()] != ' ')
   {
     return std::nullopt;
   }
 
-  for (const auto part : parts)
+  str.remove_prefix(request_target.size() + 1);
+
+  static constexpr std::size_t version_size = sizeof("HTTP/x.y") - 1;
+  if (str.size() != version_size)
   {
-    if (part.empty())
-    {
-      return std::nullopt;
-    }
+    return std::nullopt;
   }
 
-  auto [version, valid_version] = Version::from_string(parts[2]);
+  auto [version, valid_version] = Version::from_string(str);
   if (!valid_version)
   {
     return std::nullopt;
   }
 
-  return StartLineData{parts[0], parts[1], version};
+  return StartLineData{method, request_target, version};
 }
 
 std::optional<HeaderLineData> RFC7230::parse_header_line(std::string_view sv) noexcept
 {
-  auto l = sv.size();
-
-  if (l <= 2 || !utils::string::ends_with(sv, "\r\n"))
+  if (!utils::string::ends_with(sv, "\r\n"))
   {
     return std::nullopt;
   }
 
-  sv.remove_suffix(2);  // remove the CRLF token
-
-  std::vector<std::string_view> parts = absl::StrSplit(sv, absl::MaxSplits(':', 1));
-  if (parts.size() != 2)
+  /*
+   * The name is a token, so it can contain neither whitespace nor the colon.
+   */
+  auto name = sv.substr(0, tokenizer::token_length(sv));
+  if (name.empty() || sv[name.size()] != ':')
   {
-    return std::nullopt;  // does not respect the "Name: Value" format
+    return std::nullopt;  // no "Name:" prefix, or the name contains invalid characters
   }
 
-  if (parts.front().empty())
-  {
-    return std::nullopt;  // cannot allow name to be empty
-  }
+  sv.remove_prefix(name.size() + 1);
 
-  if (utils::string::starts_with(parts[0], " ") || utils::string::ends_with(parts[0], " "))
+  auto value_size = tokenizer::field_value_length(sv);
+  if (value_size != sv.size() - 2)
   {
-    return std::nullopt;
+    return std::nullopt;  // a control character, or a CR not part of the final CRLF
   }
 
-  auto &value = parts[1];
+  auto value = sv.substr(0, value_size);
 
   if (auto first_nonws_idx = value.find_first_not_of(" \t"); first_nonws_idx == 0)
   {
@@ -98,7 +95,7 @@ std::optional<HeaderLineData> RFC7230::parse_header_line(std::string_view sv) no
     value.remove_suffix(value.size() - last_nonws_idx - 1);
   }
 
-  return HeaderLineData{parts[0], value};
+  return HeaderLineData{name, value};
 }
 
 }  // namespace microhttp::http
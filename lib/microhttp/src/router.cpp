@@ -0,0 +1,276 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/router.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+constexpr std::uint32_t NO_HANDLER = std::numeric_limits<std::uint32_t>::max();
+
+std::uint16_t method_bit(Method method) noexcept
+{
+  return static_cast<std::uint16_t>(1u << static_cast<unsigned>(method));
+}
+
+std::invalid_argument invalid_pattern(std::string_view pattern, const char *reason)
+{
+  return std::invalid_argument{"invalid route \"" + std::string{pattern} + "\": " + reason};
+}
+
+}  // namespace
+
+struct Router::Node
+{
+  /// The static text matched by this node. Empty for the root and for parameter and wildcard nodes.
+  std::string prefix;
+
+  /// The first bytes of the prefixes of the static children, in the same order, scanned to pick the
+  /// child to descend into
+  std::string indices;
+  std::vector<std::unique_ptr<Node>> children;
+
+  /// The child matching a parameter segment, and the child matching the rest of the path
+  std::unique_ptr<Node> param;
+  std::unique_ptr<Node> wildcard;
+
+  /// The name of the parameter or wildcard matched by this node
+  std::string name;
+
+  /// The index of the handler of each method in `handlers_`
+  std::array<std::uint32_t, METHODS_COUNT> handlers;
+  std::uint16_t allowed_methods = 0;
+
+  Node()
+  {
+    handlers.fill(NO_HANDLER);
+  }
+};
+
+Router::Router() : root_{std::make_unique<Node>()}
+{}
+
+Router::Router(Router &&) noexcept = default;
+
+Router &Router::operator=(Router &&) noexcept = default;
+
+Router::~Router() = default;
+
+const Router::Handler &Router::add(Method method, std::string_view pattern, Handler handler)
+{
+  if (method == Method::UNKNOWN)
+  {
+    throw std::invalid_argument("routes can only be added for standard methods");
+  }
+
+  if (pattern.empty() || pattern[0] != '/')
+  {
+    throw invalid_pattern(pattern, "it must start with a slash");
+  }
+
+  auto node = root_.get();
+  std::size_t params_count = 0;
+
+  for (auto rest = pattern; !rest.empty();)
+  {
+    /*
+     * Parameters and wildcards start right after a slash.
+     */
+    auto special_idx = std::min(rest.find("/:"), rest.find("/*"));
+    if (special_idx == std::string_view::npos)
+    {
+      node = insert_static(node, rest);
+      break;
+    }
+
+    node = insert_static(node, rest.substr(0, special_idx + 1));
+    rest.remove_prefix(special_idx + 1);
+
+    auto kind = rest[0];
+    auto name_end = std::min(rest.find('/'), rest.size());
+    auto name = rest.substr(1, name_end - 1);
+    rest.remove_prefix(name_end);
+
+    if (name.empty() || name.find_first_of(":*") != std::string_view::npos)
+    {
+      throw invalid_pattern(pattern, "parameters and wildcards must be named");
+    }
+
+    if (++params_count > RouteParams::MAX_PARAMS)
+    {
+      throw invalid_pattern(pattern, "too many parameters");
+    }
+
+    if (kind == '*' && !rest.empty())
+    {
+      throw invalid_pattern(pattern, "a wildcard can only end a route");
+    }
+
+    auto &child = kind == ':' ? node->param : node->wildcard;
+    if (!child)
+    {
+      child = std::make_unique<Node>();
+      child->name = name;
+    }
+    else if (child->name != name)
+    {
+      throw invalid_pattern(pattern, "a parameter is named differently by another route");
+    }
+
+    node = child.get();
+  }
+
+  auto &handler_idx = node->handlers[static_cast<std::size_t>(method)];
+  if (handler_idx != NO_HANDLER)
+  {
+    throw invalid_pattern(pattern, "the method already has a handler");
+  }
+
+  handler_idx = static_cast<std::uint32_t>(handlers_.size());
+  node->allowed_methods |= method_bit(method);
+  return handlers_.emplace_back(std::move(handler));
+}
+
+Router::Match Router::match(Method method, std::string_view path) const noexcept
+{
+  Match match;
+
+  auto node = match_children(root_.get(), path, match.params);
+  if (!node)
+  {
+    return match;
+  }
+
+  match.allowed_methods = node->allowed_methods;
+  if (match.allowed_methods & method_bit(Method::GET))
+  {
+    match.allowed_methods |= method_bit(Method::HEAD);
+  }
+
+  if (method == Method::UNKNOWN)
+  {
+    return match;
+  }
+
+  auto handler_idx = node->handlers[static_cast<std::size_t>(method)];
+  if (handler_idx == NO_HANDLER && method == Method::HEAD)
+  {
+    handler_idx = node->handlers[static_cast<std::size_t>(Method::GET)];
+  }
+
+  if (handler_idx != NO_HANDLER)
+  {
+    match.handler = &handlers_[handler_idx];
+  }
+
+  return match;
+}
+
+const Router::Node *Router::match_children(
+    const Node *node, std::string_view path, RouteParams &params) noexcept
+{
+  if (path.empty() && node->allowed_methods)
+  {
+    return node;
+  }
+
+  if (!path.empty())
+  {
+    auto child_idx = node->indices.find(path[0]);
+    if (child_idx != std::string::npos)
+    {
+      const auto &child = *node->children[child_idx];
+      if (path.size() >= child.prefix.size()
+          && std::memcmp(path.data(), child.prefix.data(), child.prefix.size()) == 0)
+      {
+        if (auto found = match_children(&child, path.substr(child.prefix.size()), params); found)
+        {
+          return found;
+        }
+      }
+    }
+
+    if (node->param)
+    {
+      auto value = path.substr(0, path.find('/'));
+      if (!value.empty())
+      {
+        params.push(node->param->name, value);
+        if (auto found = match_children(node->param.get(), path.substr(value.size()), params);
+            found)
+        {
+          return found;
+        }
+
+        params.pop();
+      }
+    }
+  }
+
+  if (node->wildcard)
+  {
+    params.push(node->wildcard->name, path);
+    return node->wildcard.get();
+  }
+
+  return nullptr;
+}
+
+Router::Node *Router::insert_static(Node *node, std::string_view text)
+{
+  while (!text.empty())
+  {
+    auto child_idx = node->indices.find(text[0]);
+    if (child_idx == std::string::npos)
+    {
+      auto &child = node->children.emplace_back(std::make_unique<Node>());
+      child->prefix = text;
+      node->indices.push_back(text[0]);
+
+      return child.get();
+    }
+
+    auto child = node->children[child_idx].get();
+    auto mismatch =
+        std::mismatch(child->prefix.begin(), child->prefix.end(), text.begin(), text.end());
+    auto common = static_cast<std::size_t>(mismatch.first - child->prefix.begin());
+
+    if (common < child->prefix.size())
+    {
+      /*
+       * Split the child at the end of the common prefix, the rest of it becoming its only child.
+       */
+      auto split = std::make_unique<Node>();
+      split->prefix = child->prefix.substr(common);
+      split->indices = std::move(child->indices);
+      split->children = std::move(child->children);
+      split->param = std::move(child->param);
+      split->wildcard = std::move(child->wildcard);
+      split->handlers = child->handlers;
+      split->allowed_methods = child->allowed_methods;
+
+      child->prefix.resize(common);
+      child->indices.assign(1, split->prefix[0]);
+      child->children.clear();
+      child->children.push_back(std::move(split));
+      child->handlers.fill(NO_HANDLER);
+      child->allowed_methods = 0;
+    }
+
+    node = child;
+    text.remove_prefix(common);
+  }
+
+  return node;
+}
+
+}  // namespace microhttp::http
@@ -0,0 +1,74 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/serialized_response.h"
+
+#include <utility>
+
+namespace microhttp::http
+{
+
+SerializedResponse::SerializedResponse(const HttpResponse &response, microloop::BufferPool &pool) :
+    body_{response.content().str_view()}
+{
+  auto size = response.head_size();
+
+  char *head = nullptr;
+  if (size <= pool.block_size())
+  {
+    pool_ = &pool;
+    block_ = pool.acquire();
+    head = block_;
+  }
+  else
+  {
+    oversized_ = std::make_unique<char[]>(size);
+    head = oversized_.get();
+  }
+
+  response.write_head(head);
+  head_ = std::string_view{head, size};
+}
+
+SerializedResponse::SerializedResponse(SerializedResponse &&other) noexcept
+{
+  swap(*this, other);
+}
+
+SerializedResponse &SerializedResponse::operator=(SerializedResponse other) noexcept
+{
+  swap(*this, other);
+  return *this;
+}
+
+SerializedResponse::~SerializedResponse()
+{
+  if (pool_)
+  {
+    pool_->release(block_);
+  }
+}
+
+void swap(SerializedResponse &a, SerializedResponse &b) noexcept
+{
+  using std::swap;
+
+  swap(a.pool_, b.pool_);
+  swap(a.block_, b.block_);
+  swap(a.oversized_, b.oversized_);
+  swap(a.head_, b.head_);
+  swap(a.body_, b.body_);
+}
+
+void SerializedResponse::append_to(std::vector<iovec> &iov) const
+{
+  iov.push_back(iovec{const_cast<char *>(head_.data()), head_.size()});
+
+  if (!body_.empty())
+  {
+    iov.push_back(iovec{const_cast<char *>(body_.data()), body_.size()});
+  }
+}
+
+}  // namespace microhttp::http
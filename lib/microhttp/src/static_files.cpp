@@ -0,0 +1,236 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/static_files.h"
+
+#include <utility>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+int hex_value(char c) noexcept
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+
+  c = static_cast<char>(c | 0x20);
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/**
+ * \brief Percent-decode a path segment (RFC 3986, Section 2.1).
+ * \returns Whether the segment is valid. Encoded slashes and NUL bytes are not.
+ */
+bool decode_segment(std::string_view segment, std::string &out)
+{
+  for (std::size_t idx = 0; idx != segment.size(); ++idx)
+  {
+    auto c = segment[idx];
+    if (c == '%')
+    {
+      if (segment.size() - idx < 3)
+      {
+        return false;
+      }
+
+      auto high = hex_value(segment[idx + 1]), low = hex_value(segment[idx + 2]);
+      if (high == -1 || low == -1)
+      {
+        return false;
+      }
+
+      c = static_cast<char>(high << 4 | low);
+      idx += 2;
+
+      if (c == '/' || c == '\0')
+      {
+        return false;
+      }
+    }
+
+    out += c;
+  }
+
+  return true;
+}
+
+/**
+ * \brief Percent-encode a path for a Location header, leaving the slashes and the unreserved
+ * characters as they are.
+ */
+std::string encode_path(std::string_view path)
+{
+  std::string encoded;
+  for (auto c : path)
+  {
+    auto byte = static_cast<unsigned char>(c);
+    auto alnum = (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z')
+        || (byte >= '0' && byte <= '9');
+    if (alnum || c == '/' || c == '-' || c == '.' || c == '_' || c == '~')
+    {
+      encoded += c;
+    }
+    else
+    {
+      encoded += '%';
+      encoded += "0123456789ABCDEF"[byte >> 4];
+      encoded += "0123456789ABCDEF"[byte & 0xf];
+    }
+  }
+
+  return encoded;
+}
+
+HttpResponse error_response(StatusCode status_code)
+{
+  return HttpResponse{microloop::Buffer{}, status_code};
+}
+
+}  // namespace
+
+std::optional<std::string> map_to_root(std::string_view target)
+{
+  auto path = target.substr(0, target.find_first_of("?#"));
+  if (path.empty() || path[0] != '/')
+  {
+    return std::nullopt;
+  }
+
+  std::string mapped;
+  auto directory = true;
+  while (!path.empty())
+  {
+    path.remove_prefix(1);
+    auto segment = path.substr(0, path.find('/'));
+    path.remove_prefix(segment.size());
+
+    auto segment_start = mapped.size();
+    if (!decode_segment(segment, mapped))
+    {
+      return std::nullopt;
+    }
+
+    auto decoded = std::string_view{mapped}.substr(segment_start);
+    directory = decoded.empty() || decoded == "." || decoded == "..";
+
+    if (decoded == "..")
+    {
+      /*
+       * Drop the segment and its slash, then the previous segment, which must exist.
+       */
+      mapped.resize(segment_start);
+      if (mapped.empty())
+      {
+        return std::nullopt;
+      }
+
+      mapped.pop_back();
+      auto slash_idx = mapped.rfind('/');
+      mapped.resize(slash_idx == std::string::npos ? 0 : slash_idx + 1);
+    }
+    else if (directory)
+    {
+      mapped.resize(segment_start);
+    }
+    else if (decoded[0] == '.')
+    {
+      return std::nullopt;
+    }
+    else
+    {
+      mapped += '/';
+    }
+  }
+
+  /*
+   * Every segment kept is followed by a slash, which is only kept for a directory.
+   */
+  if (!directory && !mapped.empty())
+  {
+    mapped.pop_back();
+  }
+
+  return mapped;
+}
+
+bool StaticFiles::Reply::write(
+    microloop::net::TcpServer::PeerConnection &conn, std::vector<iovec> pending) const
+{
+  if (!file || !body)
+  {
+    return conn.write(std::move(pending));
+  }
+
+  return body->write(conn, std::move(pending), file, file->fd);
+}
+
+StaticFiles::StaticFiles(
+    const std::filesystem::path &root, Options options, microloop::EventLoop *loop) :
+    options_{std::move(options)}, cache_{root, options_.cache, loop}
+{}
+
+StaticFiles::Reply StaticFiles::respond(const HttpRequest &request)
+{
+  Reply reply;
+
+  auto method = request.get_method();
+  if (method != Method::GET && method != Method::HEAD)
+  {
+    reply.head = error_response(StatusCode::METHOD_NOT_ALLOWED);
+    reply.head.set_header("Allow", "GET, HEAD");
+
+    return reply;
+  }
+
+  auto path = map_to_root(request.get_uri_view());
+  if (!path)
+  {
+    reply.head = error_response(StatusCode::NOT_FOUND);
+    return reply;
+  }
+
+  auto directory = path->empty() || path->back() == '/';
+  auto file = cache_.open(directory ? *path + options_.index : *path);
+  if (!file)
+  {
+    /*
+     * A directory asked for without the trailing slash is redirected, so that the relative links
+     * of its index lead inside it.
+     */
+    if (!directory && cache_.open(*path + "/" + options_.index))
+    {
+      reply.head = error_response(StatusCode::MOVED_PERMANENTLY);
+      reply.head.set_header("Location", encode_path("/" + *path + "/"));
+    }
+    else
+    {
+      reply.head = error_response(StatusCode::NOT_FOUND);
+    }
+
+    return reply;
+  }
+
+  const auto &validators = file->validators;
+  if (validators.not_modified(request))
+  {
+    reply.head = validators.not_modified_response();
+    return reply;
+  }
+
+  auto size = static_cast<std::uint64_t>(file->st.st_size);
+  reply.head.set_header("Content-Type", file->mime_type);
+  reply.body.emplace(select_ranges(request, size, validators), size, file->mime_type);
+  reply.body->apply(reply.head);
+  validators.apply(reply.head);
+  reply.file = std::move(file);
+
+  return reply;
+}
+
+}  // namespace microhttp::http
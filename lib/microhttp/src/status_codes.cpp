@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/status_codes.h"
+
+#include <array>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+/// Every status code has three digits
+constexpr std::uint16_t MAX_CODE = 600;
+
+/**
+ * \brief A status line rendered at compile time.
+ */
+struct RenderedStatusLine
+{
+  std::array<char, 48> data{};
+  std::size_t size = 0;
+
+  constexpr void append(std::string_view str) noexcept
+  {
+    for (auto c : str)
+    {
+      data[size++] = c;
+    }
+  }
+};
+
+constexpr std::size_t count_codes() noexcept
+{
+  std::size_t count = 0;
+  for (std::uint16_t code = 0; code != MAX_CODE; ++code)
+  {
+    count += !get_reason_phrase(code).empty();
+  }
+
+  return count;
+}
+
+constexpr std::size_t CODES_COUNT = count_codes();
+static_assert(CODES_COUNT < 256);
+
+/**
+ * \brief The status lines of every known code, for HTTP/1.0 and HTTP/1.1, together with the index
+ * of the line of each code.
+ */
+struct StatusLines
+{
+  constexpr StatusLines() noexcept
+  {
+    std::size_t idx = 0;
+    for (std::uint16_t code = 0; code != MAX_CODE; ++code)
+    {
+      auto reason = get_reason_phrase(code);
+      if (reason.empty())
+      {
+        continue;
+      }
+
+      for (char minor : {'0', '1'})
+      {
+        auto &line = lines[minor - '0'][idx];
+        const char digits[] = {
+            static_cast<char>('0' + code / 100),
+            static_cast<char>('0' + code / 10 % 10),
+            static_cast<char>('0' + code % 10),
+        };
+
+        line.append("HTTP/1.");
+        line.append(std::string_view{&minor, 1});
+        line.append(" ");
+        line.append(std::string_view{digits, sizeof(digits)});
+        line.append(" ");
+        line.append(reason);
+        line.append("\r\n");
+      }
+
+      index[code] = static_cast<std::uint8_t>(++idx);
+    }
+  }
+
+  std::array<std::array<RenderedStatusLine, CODES_COUNT>, 2> lines{};
+
+  /// The index of the line of each code, plus one; zero for the unknown codes
+  std::array<std::uint8_t, MAX_CODE> index{};
+};
+
+constexpr StatusLines status_lines;
+
+}  // namespace
+
+std::string_view get_status_line(Version version, std::uint16_t code) noexcept
+{
+  if (version.major != 1 || version.minor > 1 || code >= MAX_CODE || !status_lines.index[code])
+  {
+    return {};
+  }
+
+  const auto &line = status_lines.lines[version.minor][status_lines.index[code] - 1];
+  return std::string_view{line.data.data(), line.size};
+}
+
+}  // namespace microhttp::http
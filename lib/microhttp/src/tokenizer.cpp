@@ -0,0 +1,229 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/tokenizer.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MICROHTTP_X86 1
+#endif
+
+namespace microhttp::http::tokenizer
+{
+
+namespace
+{
+
+using ScanFn = const char *(*)(const char *, const char *, const CharClass &, bool) noexcept;
+
+constexpr CharClass CR = CharClass::from([](char c) { return c == '\r'; });
+
+const char *scan_scalar(
+    const char *first, const char *last, const CharClass &cls, bool in_class) noexcept
+{
+  while (first != last && cls.contains(*first) != in_class)
+  {
+    ++first;
+  }
+
+  return first;
+}
+
+#ifdef MICROHTTP_X86
+
+/*
+ * Both kernels classify every byte of a block with two table lookups (PSHUFB), one by the low
+ * nibble and one by the high nibble, and stop at the first byte whose classification matches.
+ */
+
+__attribute__((target("sse4.2"))) const char *scan_sse42(
+    const char *first, const char *last, const CharClass &cls, bool in_class) noexcept
+{
+  const auto lo = _mm_load_si128(reinterpret_cast<const __m128i *>(cls.lo.data()));
+  const auto hi = _mm_load_si128(reinterpret_cast<const __m128i *>(cls.hi.data()));
+  const auto nibble = _mm_set1_epi8(0x0f);
+  const std::uint32_t flip = in_class ? 0xffff : 0;
+
+  for (; last - first >= 16; first += 16)
+  {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    auto lo_bits = _mm_shuffle_epi8(lo, _mm_and_si128(block, nibble));
+    auto hi_bits = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(block, 4), nibble));
+    auto outside = _mm_cmpeq_epi8(_mm_and_si128(lo_bits, hi_bits), _mm_setzero_si128());
+
+    auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(outside)) ^ flip;
+    if (mask)
+    {
+      return first + __builtin_ctz(mask);
+    }
+  }
+
+  return scan_scalar(first, last, cls, in_class);
+}
+
+__attribute__((target("avx2"))) const char *scan_avx2(
+    const char *first, const char *last, const CharClass &cls, bool in_class) noexcept
+{
+  if (last - first < 32)
+  {
+    return scan_sse42(first, last, cls, in_class);
+  }
+
+  const auto lo = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(cls.lo.data())));
+  const auto hi = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(cls.hi.data())));
+  const auto nibble = _mm256_set1_epi8(0x0f);
+  const std::uint32_t flip = in_class ? 0xffffffff : 0;
+
+  const char *found = nullptr;
+  for (; last - first >= 32 && !found; first += 32)
+  {
+    auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    auto lo_bits = _mm256_shuffle_epi8(lo, _mm256_and_si256(block, nibble));
+    auto hi_bits = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble));
+    auto outside = _mm256_cmpeq_epi8(_mm256_and_si256(lo_bits, hi_bits), _mm256_setzero_si256());
+
+    auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(outside)) ^ flip;
+    if (mask)
+    {
+      found = first + __builtin_ctz(mask);
+    }
+  }
+
+  /*
+   * The callers and the SSE kernel are not VEX-encoded, so the upper halves of the registers must
+   * be cleared on every way out, which the compiler does not guarantee on its own.
+   */
+  _mm256_zeroupper();
+  return found ? found : scan_sse42(first, last, cls, in_class);
+}
+
+#endif
+
+ScanFn kernel_scan(Kernel kernel) noexcept
+{
+  switch (kernel)
+  {
+#ifdef MICROHTTP_X86
+  case Kernel::AVX2:
+    return scan_avx2;
+  case Kernel::SSE42:
+    return scan_sse42;
+#endif
+  default:
+    return scan_scalar;
+  }
+}
+
+Kernel best_kernel() noexcept
+{
+  if (is_supported(Kernel::AVX2))
+  {
+    return Kernel::AVX2;
+  }
+
+  if (is_supported(Kernel::SSE42))
+  {
+    return Kernel::SSE42;
+  }
+
+  return Kernel::SCALAR;
+}
+
+struct Dispatch
+{
+  std::atomic<Kernel> kernel{best_kernel()};
+  std::atomic<ScanFn> scan{kernel_scan(kernel)};
+};
+
+Dispatch &dispatch() noexcept
+{
+  static Dispatch instance;
+  return instance;
+}
+
+}  // namespace
+
+bool is_supported(Kernel kernel) noexcept
+{
+  switch (kernel)
+  {
+  case Kernel::SCALAR:
+    return true;
+#ifdef MICROHTTP_X86
+  case Kernel::SSE42:
+    return __builtin_cpu_supports("sse4.2");
+  case Kernel::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+Kernel get_kernel() noexcept
+{
+  return dispatch().kernel.load(std::memory_order_relaxed);
+}
+
+bool set_kernel(Kernel kernel) noexcept
+{
+  if (!is_supported(kernel))
+  {
+    return false;
+  }
+
+  dispatch().kernel.store(kernel, std::memory_order_relaxed);
+  dispatch().scan.store(kernel_scan(kernel), std::memory_order_relaxed);
+  return true;
+}
+
+const char *kernel_name(Kernel kernel) noexcept
+{
+  switch (kernel)
+  {
+  case Kernel::SCALAR:
+    return "scalar";
+  case Kernel::SSE42:
+    return "sse4.2";
+  case Kernel::AVX2:
+    return "avx2";
+  }
+
+  return "unknown";
+}
+
+std::size_t scan(std::string_view str, const CharClass &cls, bool in_class) noexcept
+{
+  auto scan_fn = dispatch().scan.load(std::memory_order_relaxed);
+  return scan_fn(str.data(), str.data() + str.size(), cls, in_class) - str.data();
+}
+
+std::size_t find_crlf(std::string_view str, std::size_t from) noexcept
+{
+  auto scan_fn = dispatch().scan.load(std::memory_order_relaxed);
+  auto last = str.data() + str.size();
+
+  for (auto first = str.data() + std::min(from, str.size()); first != last; ++first)
+  {
+    first = scan_fn(first, last, CR, true);
+    if (last - first >= 2 && first[1] == '\n')
+    {
+      return first - str.data();
+    }
+
+    if (first == last)
+    {
+      break;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+}  // namespace microhttp::http::tokenizer
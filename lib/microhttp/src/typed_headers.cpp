@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/typed_headers.h"
+
+#include "microhttp/header_lists.h"
+#include "microhttp/tokenizer.h"
+#include "utils/string.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+using header_lists::for_each_element;
+using header_lists::trim;
+
+bool is_token(std::string_view str) noexcept
+{
+  return !str.empty() && tokenizer::token_length(str) == str.size();
+}
+
+}  // namespace
+
+bool TypedHeaders::is_typed(HeaderId id) noexcept
+{
+  switch (id)
+  {
+  case HeaderId::CONTENT_LENGTH:
+  case HeaderId::CONNECTION:
+  case HeaderId::TRANSFER_ENCODING:
+  case HeaderId::EXPECT:
+  case HeaderId::HOST:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool TypedHeaders::add(HeaderId id, std::string_view value) noexcept
+{
+  switch (id)
+  {
+  case HeaderId::CONTENT_LENGTH: {
+    /*
+     * Repeated or list values are rejected even when they agree, since intermediaries may read
+     * them differently (RFC 7230, Section 3.3.2).
+     */
+    if (content_length || value.empty())
+    {
+      return false;
+    }
+
+    std::uint64_t length = 0;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+    if (ec != std::errc{} || end != value.data() + value.size())
+    {
+      return false;
+    }
+
+    content_length = length;
+    return true;
+  }
+  case HeaderId::CONNECTION:
+    return for_each_element(value, [this](auto option) {
+      if (::utils::string::iequals(option, "close"))
+      {
+        connection = Connection::CLOSE;
+      }
+      else if (::utils::string::iequals(option, "keep-alive") && connection != Connection::CLOSE)
+      {
+        connection = Connection::KEEP_ALIVE;
+      }
+
+      return is_token(option);
+    });
+  case HeaderId::TRANSFER_ENCODING: {
+    auto valid = for_each_element(value, [this](auto element) {
+      auto coding = trim(element.substr(0, element.find(';')));
+      if (!is_token(coding))
+      {
+        return false;
+      }
+
+      /*
+       * Only the final coding matters, and chunked must not be applied twice.
+       */
+      auto chunked = ::utils::string::iequals(coding, "chunked");
+      if (chunked && transfer_coding == TransferCoding::CHUNKED)
+      {
+        return false;
+      }
+
+      transfer_coding = chunked ? TransferCoding::CHUNKED : TransferCoding::UNSUPPORTED;
+      return true;
+    });
+
+    return valid && transfer_coding != TransferCoding::NONE;
+  }
+  case HeaderId::EXPECT:
+    return for_each_element(value, [this](auto expectation) {
+      auto supported = ::utils::string::iequals(expectation, "100-continue");
+      if (!supported || this->expectation == Expectation::NONE)
+      {
+        this->expectation = supported ? Expectation::CONTINUE : Expectation::UNSUPPORTED;
+      }
+
+      return true;
+    });
+  case HeaderId::HOST:
+    if (has_host)
+    {
+      return false;
+    }
+
+    has_host = true;
+    return true;
+  default:
+    return true;
+  }
+}
+
+void TypedHeaders::reset(HeaderId id) noexcept
+{
+  switch (id)
+  {
+  case HeaderId::CONTENT_LENGTH:
+    content_length.reset();
+    break;
+  case HeaderId::CONNECTION:
+    connection = Connection::DEFAULT;
+    break;
+  case HeaderId::TRANSFER_ENCODING:
+    transfer_coding = TransferCoding::NONE;
+    break;
+  case HeaderId::EXPECT:
+    expectation = Expectation::NONE;
+    break;
+  case HeaderId::HOST:
+    has_host = false;
+    break;
+  default:
+    break;
+  }
+}
+
+}  // namespace microhttp::http
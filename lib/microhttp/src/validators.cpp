@@ -0,0 +1,157 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/validators.h"
+
+#include "microhttp/header_lists.h"
+
+#include <charconv>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+constexpr std::string_view weak_prefix = "W/";
+
+/**
+ * \brief Get the opaque part of an entity tag, for the weak comparison (RFC 7232, Section 2.3.2).
+ */
+std::string_view opaque_tag(std::string_view tag) noexcept
+{
+  if (tag.substr(0, weak_prefix.size()) == weak_prefix)
+  {
+    tag.remove_prefix(weak_prefix.size());
+  }
+
+  return tag;
+}
+
+std::uint64_t fnv1a(std::string_view bytes) noexcept
+{
+  std::uint64_t hash = 0xcbf29ce484222325;
+  for (auto c : bytes)
+  {
+    hash = (hash ^ static_cast<std::uint8_t>(c)) * 0x100000001b3;
+  }
+
+  return hash;
+}
+
+}  // namespace
+
+Validators Validators::from_stat(const struct stat &st) noexcept
+{
+  Validators validators;
+
+  auto mtime = static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+  auto first = validators.etag_.data(), last = first + validators.etag_.size();
+  auto out = first;
+  *out++ = '"';
+  out = std::to_chars(out, last, static_cast<std::uint64_t>(st.st_ino), 16).ptr;
+  *out++ = '-';
+  out = std::to_chars(out, last, mtime, 16).ptr;
+  *out++ = '-';
+  out = std::to_chars(out, last, static_cast<std::uint64_t>(st.st_size), 16).ptr;
+  *out++ = '"';
+
+  validators.etag_size_ = static_cast<std::uint8_t>(out - first);
+
+  validators.last_modified_ = st.st_mtim.tv_sec;
+  DateCache::format(st.st_mtim.tv_sec, validators.last_modified_date_.data());
+
+  return validators;
+}
+
+Validators Validators::from_content(
+    std::string_view content, std::optional<std::time_t> last_modified) noexcept
+{
+  Validators validators;
+
+  auto first = validators.etag_.data(), last = first + validators.etag_.size();
+  auto out = first;
+  *out++ = '"';
+  out = std::to_chars(out, last, fnv1a(content), 16).ptr;
+  *out++ = '"';
+
+  validators.etag_size_ = static_cast<std::uint8_t>(out - first);
+
+  if (last_modified)
+  {
+    validators.last_modified_ = last_modified;
+    DateCache::format(*last_modified, validators.last_modified_date_.data());
+  }
+
+  return validators;
+}
+
+void Validators::apply(HttpResponse &response) const
+{
+  response.set_header("ETag", etag());
+
+  if (last_modified_)
+  {
+    response.set_header("Last-Modified",
+        std::string_view{last_modified_date_.data(), last_modified_date_.size()});
+  }
+}
+
+bool Validators::not_modified(const HttpRequest &request) const noexcept
+{
+  auto method = request.get_method();
+  if (method != Method::GET && method != Method::HEAD)
+  {
+    return false;
+  }
+
+  if (auto if_none_match = request.find_header(HeaderId::IF_NONE_MATCH); if_none_match)
+  {
+    auto etag = opaque_tag(this->etag());
+
+    return !header_lists::for_each_element(*if_none_match,
+        [etag](auto tag) { return tag != "*" && opaque_tag(tag) != etag; });
+  }
+
+  if (auto if_modified_since = request.find_header(HeaderId::IF_MODIFIED_SINCE);
+      if_modified_since && last_modified_)
+  {
+    auto since = DateCache::parse(*if_modified_since);
+    return since && *last_modified_ <= *since;
+  }
+
+  return false;
+}
+
+bool Validators::range_applies(const HttpRequest &request) const noexcept
+{
+  auto if_range = request.find_header(HeaderId::IF_RANGE);
+  if (!if_range)
+  {
+    return true;
+  }
+
+  auto validator = header_lists::trim(*if_range);
+  if (validator.substr(0, weak_prefix.size()) == weak_prefix || validator.substr(0, 1) == "\"")
+  {
+    /*
+     * Entity tags are compared strongly, so a weak one never matches.
+     */
+    return validator == etag();
+  }
+
+  auto date = DateCache::parse(validator);
+  return date && last_modified_ && *date == *last_modified_;
+}
+
+HttpResponse Validators::not_modified_response() const
+{
+  HttpResponse response{microloop::Buffer{}, StatusCode::NOT_MODIFIED};
+  response.set_header("ETag", etag());
+
+  return response;
+}
+
+}  // namespace microhttp::http
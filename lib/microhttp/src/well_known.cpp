@@ -0,0 +1,203 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/well_known.h"
+
+#include "utils/string.h"
+
+#include <array>
+
+namespace microhttp::http
+{
+
+namespace
+{
+
+/**
+ * \brief A perfect hash table over a fixed set of names: every name hashes to its own slot.
+ */
+template <std::size_t N, std::size_t Slots>
+struct PerfectHashTable
+{
+  static_assert(N < 256 && (Slots & (Slots - 1)) == 0);
+
+  /**
+   * \brief FNV-1a, seeded, over the lowercased bytes of the name. Non-letters may collide when
+   * lowercased this way, which is fine since the name in the slot is compared afterwards.
+   */
+  static constexpr std::size_t slot(std::string_view name, std::uint32_t seed) noexcept
+  {
+    std::uint32_t hash = 2166136261u ^ seed;
+    for (auto c : name)
+    {
+      hash = (hash ^ static_cast<std::uint8_t>(c | 0x20)) * 16777619u;
+    }
+
+    return (hash ^ hash >> 16) & (Slots - 1);
+  }
+
+  /**
+   * \brief Try seeds until one maps every name to a different slot.
+   */
+  static constexpr PerfectHashTable build(const std::array<std::string_view, N> &names) noexcept
+  {
+    for (std::uint32_t seed = 0;; ++seed)
+    {
+      PerfectHashTable table{names, seed};
+
+      bool perfect = true;
+      for (std::size_t i = 0; i != N && perfect; ++i)
+      {
+        auto &entry = table.slots[slot(names[i], seed)];
+        perfect = entry == 0;
+        entry = static_cast<std::uint8_t>(i + 1);
+        table.max_size = names[i].size() > table.max_size ? names[i].size() : table.max_size;
+      }
+
+      if (perfect)
+      {
+        return table;
+      }
+    }
+  }
+
+  /**
+   * \returns The index of the name, or `N` if the name is not in the table.
+   */
+  constexpr std::size_t find(std::string_view name) const noexcept
+  {
+    if (name.size() > max_size)
+    {
+      return N;
+    }
+
+    auto entry = slots[slot(name, seed)];
+    if (entry == 0 || !::utils::string::iequals(names[entry - 1], name))
+    {
+      return N;
+    }
+
+    return entry - 1;
+  }
+
+  std::array<std::string_view, N> names;
+  std::uint32_t seed;
+
+  /// The index of the name in each slot, plus one; zero for the empty slots
+  std::array<std::uint8_t, Slots> slots{};
+
+  std::size_t max_size = 0;
+};
+
+constexpr std::array<std::string_view, METHODS_COUNT> method_names = {
+    "get",
+    "head",
+    "post",
+    "put",
+    "delete",
+    "connect",
+    "options",
+    "trace",
+    "patch",
+};
+
+constexpr std::array<std::string_view, HEADER_IDS_COUNT> header_names = {
+    "accept",
+    "accept-charset",
+    "accept-encoding",
+    "accept-language",
+    "accept-ranges",
+    "access-control-allow-credentials",
+    "access-control-allow-headers",
+    "access-control-allow-methods",
+    "access-control-allow-origin",
+    "access-control-expose-headers",
+    "access-control-max-age",
+    "access-control-request-headers",
+    "access-control-request-method",
+    "age",
+    "allow",
+    "authorization",
+    "cache-control",
+    "connection",
+    "content-disposition",
+    "content-encoding",
+    "content-language",
+    "content-length",
+    "content-location",
+    "content-range",
+    "content-security-policy",
+    "content-type",
+    "cookie",
+    "date",
+    "dnt",
+    "etag",
+    "expect",
+    "expires",
+    "forwarded",
+    "from",
+    "host",
+    "if-match",
+    "if-modified-since",
+    "if-none-match",
+    "if-range",
+    "if-unmodified-since",
+    "keep-alive",
+    "last-modified",
+    "link",
+    "location",
+    "max-forwards",
+    "origin",
+    "pragma",
+    "proxy-authenticate",
+    "proxy-authorization",
+    "range",
+    "referer",
+    "retry-after",
+    "server",
+    "set-cookie",
+    "strict-transport-security",
+    "te",
+    "trailer",
+    "transfer-encoding",
+    "upgrade",
+    "upgrade-insecure-requests",
+    "user-agent",
+    "vary",
+    "via",
+    "www-authenticate",
+    "x-forwarded-for",
+    "x-forwarded-host",
+    "x-forwarded-proto",
+    "x-request-id",
+    "x-requested-with",
+};
+
+constexpr auto methods = PerfectHashTable<METHODS_COUNT, 32>::build(method_names);
+constexpr auto headers = PerfectHashTable<HEADER_IDS_COUNT, 512>::build(header_names);
+
+}  // namespace
+
+Method method_from_string(std::string_view name) noexcept
+{
+  return static_cast<Method>(methods.find(name));
+}
+
+std::string_view method_name(Method method) noexcept
+{
+  return method == Method::UNKNOWN ? std::string_view{}
+                                   : method_names[static_cast<std::size_t>(method)];
+}
+
+HeaderId header_id(std::string_view name) noexcept
+{
+  return static_cast<HeaderId>(headers.find(name));
+}
+
+std::string_view header_name(HeaderId id) noexcept
+{
+  return id == HeaderId::UNKNOWN ? std::string_view{} : header_names[static_cast<std::size_t>(id)];
+}
+
+}  // namespace microhttp::http
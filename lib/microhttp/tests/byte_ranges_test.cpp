@@ -0,0 +1,318 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/byte_ranges.h"
+
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace microhttp::http
+{
+
+static const std::string representation = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static Ranges partial(std::vector<ByteRange> ranges)
+{
+  return Ranges{Ranges::PARTIAL, std::move(ranges)};
+}
+
+static std::string gather(const std::vector<iovec> &iov)
+{
+  std::string data;
+  for (const auto &vec : iov)
+  {
+    data.append(static_cast<const char *>(vec.iov_base), vec.iov_len);
+  }
+
+  return data;
+}
+
+static std::string boundary_of(const HttpResponse &head)
+{
+  auto content_type = head.header("Content-Type").value_or("");
+  return content_type.substr(content_type.find("boundary=") + 9);
+}
+
+static void expect_ranges(const Ranges &ranges, Ranges::Status status,
+    std::vector<ByteRange> expected = {})
+{
+  EXPECT_EQ(ranges.status, status);
+  EXPECT_EQ(ranges.ranges, expected);
+}
+
+TEST(ByteRanges, ParseSingleRange)
+{
+  expect_ranges(parse_ranges("bytes=0-9", 36), Ranges::PARTIAL, {{0, 9}});
+  expect_ranges(parse_ranges("Bytes = 5-", 36), Ranges::FULL);
+  expect_ranges(parse_ranges("BYTES=5-", 36), Ranges::PARTIAL, {{5, 35}});
+  expect_ranges(parse_ranges("bytes=-6", 36), Ranges::PARTIAL, {{30, 35}});
+  expect_ranges(parse_ranges("bytes=-100", 36), Ranges::PARTIAL, {{0, 35}});
+  expect_ranges(parse_ranges("bytes=30-100", 36), Ranges::PARTIAL, {{30, 35}});
+  expect_ranges(parse_ranges("bytes=35-35", 36), Ranges::PARTIAL, {{35, 35}});
+}
+
+TEST(ByteRanges, ParseMultipleRanges)
+{
+  expect_ranges(parse_ranges("bytes=0-1, 10-11,-2", 36), Ranges::PARTIAL,
+      {{0, 1}, {10, 11}, {34, 35}});
+
+  /*
+   * Ranges out of the representation are left out, and overlapping ones are coalesced.
+   */
+  expect_ranges(parse_ranges("bytes=40-50, 20-21", 36), Ranges::PARTIAL, {{20, 21}});
+  expect_ranges(parse_ranges("bytes=10-20, 0-1, 15-25, 26-27", 36), Ranges::PARTIAL,
+      {{0, 1}, {10, 25}, {26, 27}});
+  expect_ranges(parse_ranges("bytes=0-,0-,0-", 36), Ranges::PARTIAL, {{0, 35}});
+}
+
+TEST(ByteRanges, ParseUnsatisfiable)
+{
+  expect_ranges(parse_ranges("bytes=36-", 36), Ranges::UNSATISFIABLE);
+  expect_ranges(parse_ranges("bytes=40-50, 60-", 36), Ranges::UNSATISFIABLE);
+  expect_ranges(parse_ranges("bytes=-0", 36), Ranges::UNSATISFIABLE);
+  expect_ranges(parse_ranges("bytes=0-", 0), Ranges::UNSATISFIABLE);
+}
+
+TEST(ByteRanges, IgnoreInvalid)
+{
+  for (auto range : {"", "bytes=", "bytes=,", "items=0-1", "bytes 0-1", "bytes=1", "bytes=5-1",
+           "bytes=a-b", "bytes=-", "bytes=--1", "bytes=+1-2", "bytes=0-1;x",
+           "bytes=0-99999999999999999999", "bytes=0-1,foo"})
+  {
+    SCOPED_TRACE(range);
+    expect_ranges(parse_ranges(range, 36), Ranges::FULL);
+  }
+
+  expect_ranges(parse_ranges("bytes=0-0,2-2,4-4", 36, 2), Ranges::FULL);
+  expect_ranges(parse_ranges("bytes=0-0,2-2", 36, 2), Ranges::PARTIAL, {{0, 0}, {2, 2}});
+}
+
+TEST(ByteRanges, SelectRanges)
+{
+  auto validators = Validators::from_content(representation);
+
+  HttpRequest request{"GET", "/"};
+  expect_ranges(select_ranges(request, 36, validators), Ranges::FULL);
+
+  request.set_header("Range", "bytes=0-1");
+  expect_ranges(select_ranges(request, 36, validators), Ranges::PARTIAL, {{0, 1}});
+
+  request.set_header("If-Range", std::string{validators.etag()});
+  expect_ranges(select_ranges(request, 36, validators), Ranges::PARTIAL, {{0, 1}});
+
+  request.set_header("If-Range", "\"stale\"");
+  expect_ranges(select_ranges(request, 36, validators), Ranges::FULL);
+
+  HttpRequest head{"HEAD", "/"};
+  head.set_header("Range", "bytes=0-1");
+  expect_ranges(select_ranges(head, 36, validators), Ranges::FULL);
+}
+
+TEST(RangedBody, Full)
+{
+  RangedBody body{Ranges{}, representation.size()};
+
+  HttpResponse head;
+  body.apply(head);
+
+  EXPECT_EQ(head.status_code(), StatusCode::OK);
+  EXPECT_EQ(head.header("Accept-Ranges"), "bytes");
+  EXPECT_EQ(head.header("Content-Length"), "36");
+
+  std::vector<iovec> iov;
+  body.append_to(iov, representation);
+  ASSERT_EQ(iov.size(), 1u);
+  EXPECT_EQ(iov[0].iov_base, representation.data());
+}
+
+TEST(RangedBody, SingleRange)
+{
+  RangedBody body{partial({{10, 15}}), representation.size(), "text/plain"};
+
+  HttpResponse head{"ignored"};
+  body.apply(head);
+
+  EXPECT_EQ(head.status_code(), StatusCode::PARTIAL_CONTENT);
+  EXPECT_EQ(head.header("Content-Range"), "bytes 10-15/36");
+  EXPECT_EQ(head.format<std::string>(),
+      "HTTP/1.1 206 Partial Content\r\nAccept-Ranges: bytes\r\nContent-Length: 6\r\n"
+      "Content-Range: bytes 10-15/36\r\n\r\nignored");
+
+  std::vector<iovec> iov;
+  body.append_to(iov, representation);
+  ASSERT_EQ(iov.size(), 1u);
+  EXPECT_EQ(iov[0].iov_base, representation.data() + 10);
+  EXPECT_EQ(gather(iov), "abcdef");
+}
+
+TEST(RangedBody, MultipleRanges)
+{
+  RangedBody body{partial({{0, 2}, {34, 35}}), representation.size(), "text/plain"};
+
+  HttpResponse head;
+  body.apply(head);
+
+  auto boundary = boundary_of(head);
+  EXPECT_EQ(boundary.size(), 16u);
+  EXPECT_EQ(head.status_code(), StatusCode::PARTIAL_CONTENT);
+  EXPECT_EQ(head.header("Content-Range"), std::nullopt);
+
+  std::vector<iovec> iov;
+  body.append_to(iov, representation);
+
+  auto expected = "--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-2/36"
+      "\r\n\r\n012\r\n--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes "
+      "34-35/36\r\n\r\nyz\r\n--" + boundary + "--\r\n";
+  EXPECT_EQ(gather(iov), expected);
+  EXPECT_EQ(head.header("Content-Length"), std::to_string(expected.size()));
+  EXPECT_EQ(body.content_length(), expected.size());
+
+  /*
+   * The body can be moved while its parts are referred to by offsets.
+   */
+  auto moved = std::move(body);
+  iov.clear();
+  moved.append_to(iov, representation);
+  EXPECT_EQ(gather(iov), expected);
+}
+
+TEST(RangedBody, Unsatisfiable)
+{
+  RangedBody body{parse_ranges("bytes=50-", 36), representation.size()};
+
+  HttpResponse head;
+  body.apply(head);
+
+  EXPECT_EQ(head.status_code(), StatusCode::RANGE_NOT_SATISFIABBLE);
+  EXPECT_EQ(head.header("Content-Range"), "bytes */36");
+  EXPECT_EQ(head.header("Content-Length"), "0");
+
+  std::vector<iovec> iov;
+  body.append_to(iov, representation);
+  EXPECT_TRUE(iov.empty());
+}
+
+/**
+ * \brief A connection whose peer is the other end of a socket pair, and a file holding the
+ * representation.
+ */
+class RangedBodyWriteTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    conn.emplace(nullptr, sockaddr_storage{}, 0, fds[0]);
+    peer = fds[1];
+
+    file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(std::fwrite(representation.data(), 1, representation.size(), file),
+        representation.size());
+    std::fflush(file);
+  }
+
+  void TearDown() override
+  {
+    conn.reset();
+    close(peer);
+    std::fclose(file);
+  }
+
+  std::string received()
+  {
+    std::string data;
+    char buf[4096];
+
+    ssize_t nrecv;
+    while ((nrecv = recv(peer, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+      data.append(buf, nrecv);
+    }
+
+    return data;
+  }
+
+  std::optional<microloop::net::TcpServer::PeerConnection> conn;
+  int peer = -1;
+  std::FILE *file = nullptr;
+};
+
+TEST_F(RangedBodyWriteTest, SendsRangesFromFile)
+{
+  std::string head = "HEAD\r\n";
+
+  RangedBody single{partial({{1, 3}}), representation.size()};
+  EXPECT_TRUE(single.write(*conn, {{head.data(), head.size()}}, nullptr, fileno(file)));
+  EXPECT_EQ(received(), "HEAD\r\n123");
+
+  RangedBody full{Ranges{}, representation.size()};
+  EXPECT_TRUE(full.write(*conn, {{head.data(), head.size()}}, nullptr, fileno(file)));
+  EXPECT_EQ(received(), head + representation);
+
+  RangedBody multiple{partial({{0, 0}, {35, 35}}), representation.size()};
+  HttpResponse response;
+  multiple.apply(response);
+  auto boundary = boundary_of(response);
+
+  EXPECT_TRUE(multiple.write(*conn, {{head.data(), head.size()}}, nullptr, fileno(file)));
+  EXPECT_EQ(received(), head + "--" + boundary + "\r\nContent-Range: bytes 0-0/36\r\n\r\n0\r\n--"
+          + boundary + "\r\nContent-Range: bytes 35-35/36\r\n\r\nz\r\n--" + boundary + "--\r\n");
+
+  /*
+   * The file offset is left alone.
+   */
+  EXPECT_EQ(std::ftell(file), static_cast<long>(representation.size()));
+}
+
+TEST_F(RangedBodyWriteTest, FailsPastEndOfFile)
+{
+  RangedBody body{partial({{30, 40}}), 41};
+  EXPECT_FALSE(body.write(*conn, {}, nullptr, fileno(file)));
+  EXPECT_EQ(received(), "uvwxyz");
+}
+
+
+TEST_F(RangedBodyWriteTest, QueuesTheFileUntilThePeerReadsIt)
+{
+  std::string large(8 * 1024 * 1024, 'x');
+  auto large_file = std::tmpfile();
+  ASSERT_NE(large_file, nullptr);
+  ASSERT_EQ(std::fwrite(large.data(), 1, large.size(), large_file), large.size());
+  std::fflush(large_file);
+
+  /*
+   * The file does not fit in the socket buffers, so the rest of it waits for the peer, without
+   * blocking the caller.
+   */
+  RangedBody body{Ranges{}, large.size()};
+  EXPECT_FALSE(body.write(*conn, {}, nullptr, fileno(large_file)));
+  EXPECT_GT(conn->queued_bytes(), 0u);
+
+  auto drained = false;
+  conn->set_drain_handler([&drained](auto &) { drained = true; });
+
+  std::string data;
+  for (int tick = 0; tick != 100000 && !drained; ++tick)
+  {
+    data += received();
+    microloop::EventLoop::instance().next_tick();
+  }
+
+  data += received();
+  EXPECT_TRUE(drained);
+  EXPECT_TRUE(conn->writable());
+  EXPECT_EQ(conn->queued_bytes(), 0u);
+  EXPECT_EQ(data, large);
+
+  std::fclose(large_file);
+}
+
+}  // namespace microhttp::http
@@ -0,0 +1,226 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/compressed_variants.h"
+#include "microhttp/compression.h"
+
+#include "gtest/gtest.h"
+#include <optional>
+#include <string>
+#include <zlib.h>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief Decode a gzip or zlib stream.
+ */
+static std::string decompress(const microloop::Buffer &compressed, ContentCoding coding)
+{
+  z_stream stream{};
+  inflateInit2(&stream, coding == ContentCoding::GZIP ? MAX_WBITS + 16 : MAX_WBITS);
+
+  std::string data(1 << 20, '\0');
+  stream.next_in = static_cast<Bytef *>(const_cast<void *>(compressed.data()));
+  stream.avail_in = compressed.size();
+  stream.next_out = reinterpret_cast<Bytef *>(data.data());
+  stream.avail_out = data.size();
+
+  auto status = inflate(&stream, Z_FINISH);
+  data.resize(stream.total_out);
+  inflateEnd(&stream);
+
+  return status == Z_STREAM_END ? data : "<invalid stream>";
+}
+
+static HttpRequest accepting(std::string accept_encoding)
+{
+  HttpRequest request{"GET", "/"};
+  request.set_header("Accept-Encoding", std::move(accept_encoding));
+
+  return request;
+}
+
+static HttpResponse html(std::size_t size)
+{
+  HttpResponse response{microloop::Buffer{std::string(size, 'a').c_str()}};
+  response.set_header("Content-Type", "text/html; charset=utf-8");
+
+  return response;
+}
+
+TEST(Compression, NegotiateCoding)
+{
+  EXPECT_EQ(negotiate_coding(""), ContentCoding::IDENTITY);
+  EXPECT_EQ(negotiate_coding("gzip"), ContentCoding::GZIP);
+  EXPECT_EQ(negotiate_coding("deflate, gzip"), ContentCoding::GZIP);
+  EXPECT_EQ(negotiate_coding("x-gzip"), ContentCoding::GZIP);
+  EXPECT_EQ(negotiate_coding("gzip;q=0.5, deflate"), ContentCoding::DEFLATE);
+  EXPECT_EQ(negotiate_coding("gzip; q=0, deflate;q=0.001"), ContentCoding::DEFLATE);
+  EXPECT_EQ(negotiate_coding("gzip;q=0, deflate;q=0"), ContentCoding::IDENTITY);
+  EXPECT_EQ(negotiate_coding("*"), ContentCoding::GZIP);
+  EXPECT_EQ(negotiate_coding("*;q=0.1, gzip;q=0"), ContentCoding::DEFLATE);
+  EXPECT_EQ(negotiate_coding("br, identity"), ContentCoding::IDENTITY);
+
+  /*
+   * Elements with an invalid weight are ignored.
+   */
+  EXPECT_EQ(negotiate_coding("gzip;q=2, deflate"), ContentCoding::DEFLATE);
+  EXPECT_EQ(negotiate_coding("gzip;q=0.0001"), ContentCoding::IDENTITY);
+}
+
+TEST(Compression, IsCompressible)
+{
+  EXPECT_TRUE(is_compressible("text/html; charset=utf-8"));
+  EXPECT_TRUE(is_compressible("application/json"));
+  EXPECT_TRUE(is_compressible("application/problem+json"));
+  EXPECT_TRUE(is_compressible("image/svg+xml"));
+  EXPECT_TRUE(is_compressible("Application/JavaScript"));
+
+  EXPECT_FALSE(is_compressible("image/png"));
+  EXPECT_FALSE(is_compressible("application/zip"));
+  EXPECT_FALSE(is_compressible("video/mp4"));
+  EXPECT_FALSE(is_compressible("nonsense"));
+}
+
+TEST(Compression, RoundTrip)
+{
+  std::string data;
+  for (int i = 0; i != 1000; ++i)
+  {
+    data += "{\"id\": " + std::to_string(i) + ", \"name\": \"microhttp\"},";
+  }
+
+  for (auto coding : {ContentCoding::GZIP, ContentCoding::DEFLATE})
+  {
+    for (int level : {1, 6, 9, -1})
+    {
+      auto compressed = compress(data, coding, level);
+
+      EXPECT_LT(compressed.size(), data.size() / 5);
+      EXPECT_EQ(decompress(compressed, coding), data);
+    }
+  }
+
+  EXPECT_THROW(compress(data, ContentCoding::IDENTITY, 6), std::invalid_argument);
+  EXPECT_THROW(compress(data, ContentCoding::GZIP, 10), std::invalid_argument);
+}
+
+TEST(Compressor, CompressesEligibleResponses)
+{
+  Compressor compressor{Compressor::Options{6, 100}};
+
+  auto response = html(1000);
+  response.set_header("ETag", "\"abc\"");
+  compressor.compress(accepting("gzip, deflate"), response);
+
+  EXPECT_EQ(response.header("Content-Encoding"), "gzip");
+  EXPECT_EQ(response.header("Vary"), "Accept-Encoding");
+  EXPECT_EQ(response.header("ETag"), "W/\"abc\"");
+  EXPECT_EQ(response.header("Content-Length"), std::to_string(response.content().size()));
+  EXPECT_EQ(decompress(response.content(), ContentCoding::GZIP), std::string(1000, 'a'));
+}
+
+TEST(Compressor, SkipsIneligibleResponses)
+{
+  Compressor compressor{Compressor::Options{6, 100}};
+
+  auto small = html(99);
+  compressor.compress(accepting("gzip"), small);
+  EXPECT_EQ(small.header("Content-Encoding"), std::nullopt);
+  EXPECT_EQ(small.header("Vary"), std::nullopt);
+
+  auto image = html(1000);
+  image.set_header("Content-Type", "image/png");
+  compressor.compress(accepting("gzip"), image);
+  EXPECT_EQ(image.header("Content-Encoding"), std::nullopt);
+
+  auto encoded = html(1000);
+  encoded.set_header("Content-Encoding", "br");
+  compressor.compress(accepting("gzip"), encoded);
+  EXPECT_EQ(encoded.header("Content-Encoding"), "br");
+  EXPECT_EQ(encoded.content().size(), 1000u);
+
+  /*
+   * The response depends on Accept-Encoding even when it is sent as it is.
+   */
+  auto identity = html(1000);
+  identity.set_header("Vary", "Origin");
+  compressor.compress(HttpRequest{"GET", "/"}, identity);
+  EXPECT_EQ(identity.header("Content-Encoding"), std::nullopt);
+  EXPECT_EQ(identity.header("Vary"), "Origin, Accept-Encoding");
+}
+
+TEST(Compressor, CompressesAsync)
+{
+  Compressor compressor{Compressor::Options{6, 100, 1000}};
+
+  std::optional<HttpResponse> small;
+  compressor.compress_async(
+      accepting("deflate"), html(500), [&](HttpResponse response) { small = std::move(response); });
+
+  ASSERT_TRUE(small);
+  EXPECT_EQ(small->header("Content-Encoding"), "deflate");
+
+  std::optional<HttpResponse> large;
+  compressor.compress_async(
+      accepting("gzip"), html(5000), [&](HttpResponse response) { large = std::move(response); });
+
+  while (!large)
+  {
+    microloop::EventLoop::instance().next_tick();
+  }
+
+  EXPECT_EQ(large->header("Content-Encoding"), "gzip");
+  EXPECT_EQ(decompress(large->content(), ContentCoding::GZIP), std::string(5000, 'a'));
+}
+
+TEST(CompressedVariants, CompressesOnce)
+{
+  Compressor compressor{Compressor::Options{6, 100}};
+  CompressedVariants variants{1 << 20};
+
+  auto first = html(1000);
+  compressor.compress(accepting("gzip"), first, variants, "/index.html");
+  auto cached = variants.find("/index.html", ContentCoding::GZIP);
+  ASSERT_TRUE(cached);
+  EXPECT_EQ(variants.size(), cached->size());
+
+  auto second = html(1000);
+  compressor.compress(accepting("gzip"), second, variants, "/index.html");
+  EXPECT_EQ(variants.find("/index.html", ContentCoding::GZIP), cached);
+  EXPECT_EQ(second.content(), *cached);
+  EXPECT_EQ(second.header("Content-Encoding"), "gzip");
+
+  EXPECT_EQ(variants.find("/index.html", ContentCoding::DEFLATE), nullptr);
+  auto third = html(1000);
+  compressor.compress(accepting("deflate"), third, variants, "/index.html");
+  EXPECT_TRUE(variants.find("/index.html", ContentCoding::DEFLATE));
+
+  variants.erase("/index.html");
+  EXPECT_EQ(variants.find("/index.html", ContentCoding::GZIP), nullptr);
+  EXPECT_EQ(variants.size(), 0u);
+}
+
+TEST(CompressedVariants, EvictsLeastRecentlyUsed)
+{
+  CompressedVariants variants{10};
+
+  variants.insert("a", ContentCoding::GZIP, microloop::Buffer{"aaaa"});
+  variants.insert("b", ContentCoding::GZIP, microloop::Buffer{"bbbb"});
+  EXPECT_TRUE(variants.find("a", ContentCoding::GZIP));
+
+  variants.insert("c", ContentCoding::GZIP, microloop::Buffer{"cccc"});
+  EXPECT_TRUE(variants.find("a", ContentCoding::GZIP));
+  EXPECT_EQ(variants.find("b", ContentCoding::GZIP), nullptr);
+  EXPECT_TRUE(variants.find("c", ContentCoding::GZIP));
+  EXPECT_EQ(variants.size(), 8u);
+
+  auto oversized = variants.insert("d", ContentCoding::GZIP, microloop::Buffer{"ddddddddddd"});
+  EXPECT_EQ(oversized->size(), 11u);
+  EXPECT_EQ(variants.find("d", ContentCoding::GZIP), nullptr);
+  EXPECT_EQ(variants.size(), 8u);
+}
+
+}  // namespace microhttp::http
@@ -6,6 +6,7 @@
 #include "microhttp/version.h"
 
 #include "gtest/gtest.h"
+#include <utility>
 
 namespace microhttp::http
 {
@@ -26,6 +27,22 @@ TEST(HttpRequest, SetHttpMethod)
   req.set_http_method("GET");
 
   EXPECT_EQ(req.get_http_method(), "get");
+  EXPECT_EQ(req.get_method(), Method::GET);
+}
+
+TEST(HttpRequest, SetExtensionMethod)
+{
+  HttpRequest req;
+
+  req.set_http_method("PROPFIND");
+
+  EXPECT_EQ(req.get_http_method(), "propfind");
+  EXPECT_EQ(req.get_method(), Method::UNKNOWN);
+
+  req.set_http_method("Delete");
+
+  EXPECT_EQ(req.get_http_method(), "delete");
+  EXPECT_EQ(req.get_method(), Method::DELETE);
 }
 
 TEST(HttpRequest, SetHeader)
@@ -52,4 +69,77 @@ TEST(HttpRequest, GetContentLength)
   EXPECT_EQ(128, *content_length);
 }
 
+TEST(HttpRequest, FindHeaderIgnoresCase)
+{
+  HttpRequest req;
+
+  req.set_header("Content-Type", "text/plain");
+
+  EXPECT_EQ(req.find_header("CONTENT-TYPE"), "text/plain");
+  EXPECT_FALSE(req.find_header("content-length"));
+}
+
+TEST(HttpRequest, FindHeaderById)
+{
+  HttpRequest req;
+
+  req.set_header("Host", "example.com");
+  req.set_header("X-Custom", "1");
+
+  EXPECT_EQ(req.find_header(HeaderId::HOST), "example.com");
+  EXPECT_FALSE(req.find_header(HeaderId::CONNECTION));
+  EXPECT_FALSE(req.find_header(HeaderId::UNKNOWN));
+  EXPECT_EQ(req.find_header("x-custom"), "1");
+
+  req.set_header("HOST", "example.org");
+  EXPECT_EQ(req.find_header(HeaderId::HOST), "example.org");
+  EXPECT_EQ(req.get_headers().size(), 2u);
+
+  req.remove_header("host");
+  EXPECT_FALSE(req.find_header(HeaderId::HOST));
+}
+
+TEST(HttpRequest, CopyRebuildsHeaderIndex)
+{
+  HttpRequest copy;
+
+  {
+    HttpRequest req{"GET", "/"};
+    req.set_header("Connection", "close");
+
+    copy = req;
+    req.set_header("Connection", "keep-alive");
+  }
+
+  EXPECT_EQ(copy.find_header(HeaderId::CONNECTION), "close");
+
+  auto moved = std::move(copy);
+  EXPECT_EQ(moved.find_header(HeaderId::CONNECTION), "close");
+}
+
+TEST(HttpRequest, HeaderBlockCopyRebasesViews)
+{
+  std::string_view raw = "GET /a HTTP/1.1\r\nHost: x\r\n\r\n";
+
+  HeaderBlock block{raw, 1};
+  auto data = block.raw();
+  block.set_start_line(data.substr(0, 3), data.substr(4, 2));
+  block.add_field(data.substr(17, 4), data.substr(23, 1));
+  EXPECT_FALSE(block.add_field(data.substr(17, 4), data.substr(23, 1)));
+
+  HttpRequest req;
+  req.set_header_block(block);
+
+  auto copy = req.get_header_block();
+  EXPECT_NE(copy.raw().data(), block.raw().data());
+  EXPECT_EQ(copy.raw(), raw);
+  EXPECT_EQ(copy.method(), "GET");
+  EXPECT_EQ(copy.request_target(), "/a");
+  EXPECT_EQ(copy.find("host"), "x");
+  EXPECT_EQ(copy.find(HeaderId::HOST), "x");
+  EXPECT_EQ(copy.fields()[0].id, HeaderId::HOST);
+  EXPECT_EQ(copy.fields()[0].name.data(), copy.raw().data() + 17);
+  EXPECT_EQ(req.get_uri(), "/a");
+}
+
 }  // namespace microhttp::http
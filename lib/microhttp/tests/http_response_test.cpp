@@ -0,0 +1,194 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/http_response.h"
+#include "microhttp/serialized_response.h"
+#include "microloop/buffer_pool.h"
+
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+namespace microhttp::http
+{
+
+TEST(HttpResponse, FormatString)
+{
+  HttpResponse response{"hello", StatusCode::NOT_FOUND};
+  response.set_header("Server", "microhttp");
+  response.set_header("Age", 12);
+
+  EXPECT_EQ(response.format<std::string>(),
+      "HTTP/1.1 404 Not Found\r\n"
+      "Age: 12\r\n"
+      "Server: microhttp\r\n"
+      "Content-Length: 5\r\n"
+      "\r\n"
+      "hello");
+}
+
+TEST(HttpResponse, FormatBufferKeepsNulBytes)
+{
+  HttpResponse response;
+  response.content().append(std::string_view{"a\0b", 3});
+
+  auto formatted = response.format<microloop::Buffer>();
+
+  EXPECT_EQ(formatted.size(), response.head_size() + 3);
+  EXPECT_EQ(formatted.str_view(response.head_size()), std::string_view("a\0b", 3));
+}
+
+TEST(HttpResponse, HeadSizeIsExact)
+{
+  HttpResponse response{{}, StatusCode::UPGRADE_REQUIRED};
+  response.set_http_version(Version{2, 0});
+  response.set_header("Upgrade", "h2c");
+
+  std::string head(response.head_size() + 1, '#');
+  auto end = response.write_head(head.data());
+
+  EXPECT_EQ(end, head.data() + response.head_size());
+  EXPECT_EQ(head, "HTTP/2.0 426 Upgrade Required\r\nUpgrade: h2c\r\nContent-Length: 0\r\n\r\n#");
+
+  response.set_http_version(Version{1, 1});
+  response.set_status_code(static_cast<StatusCode>(299));
+  EXPECT_EQ(response.format<std::string>(),
+      "HTTP/1.1 299 \r\nUpgrade: h2c\r\nContent-Length: 0\r\n\r\n");
+}
+
+TEST(HttpResponse, SkipContentLength)
+{
+  HttpResponse response{"hello"};
+  response.skip_content_length();
+
+  EXPECT_EQ(response.header("Content-Length"), std::nullopt);
+  EXPECT_EQ(response.format<std::string>(), "HTTP/1.1 200 OK\r\n\r\nhello");
+
+  response.set_header("Content-Length", 5);
+  EXPECT_EQ(response.format<std::string>(), "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello");
+}
+
+TEST(HttpResponse, NoContentLengthWithoutBody)
+{
+  HttpResponse response{{}, StatusCode::NOT_MODIFIED};
+  response.set_header("ETag", "\"x\"");
+
+  EXPECT_EQ(response.header("Content-Length"), std::nullopt);
+  EXPECT_EQ(response.format<std::string>(), "HTTP/1.1 304 Not Modified\r\nETag: \"x\"\r\n\r\n");
+}
+
+TEST(HttpResponse, StatusLines)
+{
+  EXPECT_EQ(get_status_line(Version{1, 1}, StatusCode::OK), "HTTP/1.1 200 OK\r\n");
+  EXPECT_EQ(get_status_line(Version{1, 0}, StatusCode::NON_AUTHORITATIVE_INFO),
+      "HTTP/1.0 203 Non-Authoritative Information\r\n");
+  EXPECT_EQ(get_status_line(Version{1, 1}, StatusCode::HTTP_VERSION_NOT_SUPPORTED),
+      "HTTP/1.1 505 HTTP Version not supported\r\n");
+  EXPECT_EQ(get_status_line(Version{1, 1}, StatusCode::REQUEST_HEADER_FIELDS_TOO_LARGE),
+      "HTTP/1.1 431 Request Header Fields Too Large\r\n");
+  EXPECT_EQ(get_status_line(Version{1, 1}, 299), "");
+  EXPECT_EQ(get_status_line(Version{1, 1}, 1000), "");
+  EXPECT_EQ(get_status_line(Version{2, 0}, StatusCode::OK), "");
+}
+
+TEST(HttpResponse, PinnedHeadersAndDate)
+{
+  PinnedHeaders pinned{{"Server", "microhttp"}, {"X-Frame-Options", "DENY"}};
+  DateCache date{&microloop::EventLoop::instance()};
+
+  HttpResponse response{"ok"};
+  response.pin_headers(pinned);
+  response.set_date(date);
+
+  auto formatted = response.format<std::string>();
+  EXPECT_EQ(formatted.size(), response.head_size() + 2);
+  EXPECT_EQ(formatted,
+      "HTTP/1.1 200 OK\r\nDate: " + std::string{date.value()}
+          + "\r\nServer: microhttp\r\nX-Frame-Options: DENY\r\nContent-Length: 2\r\n\r\nok");
+}
+
+TEST(DateCache, Format)
+{
+  char date[DateCache::IMF_FIXDATE_LEN];
+
+  DateCache::format(784111777, date);
+  EXPECT_EQ(std::string_view(date, sizeof(date)), "Sun, 06 Nov 1994 08:49:37 GMT");
+
+  DateCache::format(951782400, date);
+  EXPECT_EQ(std::string_view(date, sizeof(date)), "Tue, 29 Feb 2000 00:00:00 GMT");
+}
+
+TEST(DateCache, Parse)
+{
+  EXPECT_EQ(DateCache::parse("Sun, 06 Nov 1994 08:49:37 GMT"), 784111777);
+  EXPECT_EQ(DateCache::parse("Sunday, 06-Nov-94 08:49:37 GMT"), 784111777);
+  EXPECT_EQ(DateCache::parse("Sun Nov  6 08:49:37 1994"), 784111777);
+  EXPECT_EQ(DateCache::parse("Tue, 29 Feb 2000 00:00:00 GMT"), 951782400);
+
+  EXPECT_EQ(DateCache::parse(""), std::nullopt);
+  EXPECT_EQ(DateCache::parse("Sun, 06 Nov 1994 08:49:37 UTC"), std::nullopt);
+  EXPECT_EQ(DateCache::parse("Sun, 06 Foo 1994 08:49:37 GMT"), std::nullopt);
+  EXPECT_EQ(DateCache::parse("Sun, 32 Nov 1994 08:49:37 GMT"), std::nullopt);
+  EXPECT_EQ(DateCache::parse("Sun, 06 Nov 1994 24:49:37 GMT"), std::nullopt);
+  EXPECT_EQ(DateCache::parse("1994-11-06T08:49:37Z"), std::nullopt);
+}
+
+TEST(HttpResponse, HeaderNamesIgnoreCase)
+{
+  HttpResponse response{"abc"};
+  response.set_header("content-length", 2);
+  response.set_header("X-Tag", "a");
+  response.set_header("x-tag", "b");
+
+  EXPECT_EQ(response.header("Content-Length"), "2");
+  EXPECT_EQ(response.header("X-TAG"), "b");
+  EXPECT_EQ(response.format<std::string>(),
+      "HTTP/1.1 200 OK\r\ncontent-length: 2\r\nX-Tag: b\r\n\r\nabc");
+
+  EXPECT_EQ(HttpResponse{"abcd"}.header("content-length"), "4");
+}
+
+TEST(SerializedResponse, HeadInPooledBlock)
+{
+  microloop::BufferPool pool{256, 2};
+
+  HttpResponse response{"body"};
+  std::vector<iovec> iov;
+
+  {
+    SerializedResponse serialized{response, pool};
+    EXPECT_EQ(pool.available(), 1u);
+    EXPECT_EQ(serialized.body().data(), response.content().data());
+    EXPECT_EQ(std::string{serialized.head()} + std::string{serialized.body()},
+        response.format<std::string>());
+
+    serialized.append_to(iov);
+    ASSERT_EQ(iov.size(), 2u);
+    EXPECT_EQ(iov[0].iov_base, serialized.head().data());
+    EXPECT_EQ(iov[1].iov_len, 4u);
+
+    auto moved = std::move(serialized);
+    EXPECT_EQ(pool.available(), 1u);
+  }
+
+  EXPECT_EQ(pool.available(), 2u);
+}
+
+TEST(SerializedResponse, OversizedHead)
+{
+  microloop::BufferPool pool{64, 1};
+
+  HttpResponse response;
+  response.set_header("X-Long", std::string(100, 'x'));
+
+  SerializedResponse serialized{response, pool};
+  EXPECT_EQ(pool.capacity(), 0u);
+  EXPECT_EQ(serialized.size(), response.head_size());
+
+  std::vector<iovec> iov;
+  serialized.append_to(iov);
+  EXPECT_EQ(iov.size(), 1u);
+}
+
+}  // namespace microhttp::http
@@ -128,4 +128,371 @@ TEST_P(RequestParserTest, ParseRequest)
 
 INSTANTIATE_TEST_CASE_P(Http, RequestParserTest, testing::ValuesIn(request_parser_provider()));
 
+TEST(RequestParser, ZeroCopyRequest)
+{
+  RequestParser parser{RequestParser::Mode::ZERO_COPY};
+
+  parser.add_chunk("POST /foo HTTP/1.1\r\nHost: example.com\r\n");
+  EXPECT_EQ(parser.get_state(), RequestParser::WAITING_START_LINE);
+
+  parser.add_chunk("Content-Length:  7 \r\n\r\nexam");
+  parser.add_chunk("ple");
+
+  const auto &request = parser.get_parsed_request();
+  EXPECT_EQ(parser.get_state(), RequestParser::DONE);
+  EXPECT_TRUE(request.is_zero_copy());
+  EXPECT_EQ(request.get_http_method(), "post");
+  EXPECT_EQ(request.get_method(), Method::POST);
+  EXPECT_EQ(request.get_uri_view(), "/foo");
+  EXPECT_EQ(request.get_uri(), "/foo");
+  EXPECT_EQ(request.get_http_version(), (Version{1, 1}));
+  EXPECT_TRUE(request.get_headers().empty());
+  EXPECT_EQ(request.get_content_length(), 7u);
+  EXPECT_EQ(request.get_body_string(), "example");
+
+  auto fields = request.get_header_fields();
+  ASSERT_EQ(fields.size(), 2u);
+  EXPECT_EQ(fields[0].name, "Host");
+  EXPECT_EQ(fields[0].value, "example.com");
+  EXPECT_EQ(fields[1].name, "Content-Length");
+  EXPECT_EQ(fields[1].value, "7");
+  EXPECT_EQ(fields[1].id, HeaderId::CONTENT_LENGTH);
+
+  auto raw = request.get_header_block().raw();
+  for (const auto &field : fields)
+  {
+    EXPECT_GE(field.name.data(), raw.data());
+    EXPECT_LE(field.value.data() + field.value.size(), raw.data() + raw.size());
+  }
+
+  EXPECT_EQ(request.find_header("host"), "example.com");
+  EXPECT_EQ(request.find_header("HOST"), "example.com");
+  EXPECT_EQ(request.find_header(HeaderId::HOST), "example.com");
+  EXPECT_FALSE(request.find_header("Accept"));
+  EXPECT_EQ(request.get_header("content-length"), std::make_pair(std::string{"7"}, true));
+}
+
+TEST(RequestParser, ZeroCopyWithoutHeaders)
+{
+  RequestParser parser{RequestParser::Mode::ZERO_COPY};
+
+  parser.add_chunk("GET / HTTP/1.0\r\n\r\n");
+
+  const auto &request = parser.get_parsed_request();
+  EXPECT_EQ(parser.get_state(), RequestParser::DONE);
+  EXPECT_EQ(request.get_http_method(), "get");
+  EXPECT_EQ(request.get_uri_view(), "/");
+  EXPECT_TRUE(request.get_header_fields().empty());
+  EXPECT_FALSE(request.get_content_length());
+}
+
+TEST(RequestParser, ZeroCopyInvalidHeader)
+{
+  RequestParser parser{RequestParser::Mode::ZERO_COPY};
+
+  parser.add_chunk("GET / HTTP/1.1\r\nHost example.com\r\n\r\n");
+
+  EXPECT_EQ(parser.get_state(), RequestParser::ERROR);
+}
+
+class FragmentedRequestTest : public testing::TestWithParam<RequestParser::Mode>
+{};
+
+TEST_P(FragmentedRequestTest, ByteByByte)
+{
+  std::string raw = "POST /foo HTTP/1.1\r\nHost: example.com\r\nContent-Length: 3\r\n\r\nabc";
+
+  RequestParser parser{GetParam()};
+  for (auto c : raw)
+  {
+    parser.add_chunk(microloop::Buffer{&c, 1});
+  }
+
+  const auto &request = parser.get_parsed_request();
+  EXPECT_EQ(parser.get_state(), RequestParser::DONE);
+  EXPECT_EQ(request.get_http_method(), "post");
+  EXPECT_EQ(request.get_uri(), "/foo");
+  EXPECT_EQ(request.find_header("host"), "example.com");
+  EXPECT_EQ(request.get_body_string(), "abc");
+}
+
+TEST_P(FragmentedRequestTest, CrlfSplitBetweenChunks)
+{
+  RequestParser parser{GetParam()};
+
+  parser.add_chunk("GET / HTTP/1.1\r");
+  parser.add_chunk("\nHost: a\r");
+  parser.add_chunk("\n\r");
+  parser.add_chunk("\n");
+
+  EXPECT_EQ(parser.get_state(), RequestParser::DONE);
+  EXPECT_EQ(parser.get_parsed_request().find_header("Host"), "a");
+}
+
+TEST_P(FragmentedRequestTest, RequestLineTooLong)
+{
+  RequestParser parser{GetParam()};
+
+  parser.add_chunk("GET /");
+  parser.add_chunk(std::string(RequestParser::MAX_REQUEST_LINE_LEN, 'a').c_str());
+
+  EXPECT_EQ(parser.get_state(), RequestParser::ERROR);
+  EXPECT_EQ(parser.get_error(), RequestParser::Error::REQUEST_LINE_TOO_LONG);
+}
+
+TEST_P(FragmentedRequestTest, HeaderBlockTooLarge)
+{
+  RequestParser parser{GetParam()};
+
+  parser.add_chunk("GET / HTTP/1.1\r\n");
+
+  std::string header = "X-Filler: " + std::string(1000, 'a') + "\r\n";
+  for (std::size_t size = 0; size <= RequestParser::MAX_HEADER_BLOCK_SIZE; size += header.size())
+  {
+    parser.add_chunk(header.c_str());
+  }
+
+  EXPECT_EQ(parser.get_state(), RequestParser::ERROR);
+  EXPECT_EQ(parser.get_error(), RequestParser::Error::HEADER_BLOCK_TOO_LARGE);
+}
+
+TEST(RequestParser, ErrorStatus)
+{
+  EXPECT_EQ(RequestParser::get_error_status(RequestParser::Error::BAD_REQUEST),
+      StatusCode::BAD_REQUEST);
+  EXPECT_EQ(RequestParser::get_error_status(RequestParser::Error::REQUEST_LINE_TOO_LONG),
+      StatusCode::URI_TOO_LONG);
+  EXPECT_EQ(RequestParser::get_error_status(RequestParser::Error::HEADER_BLOCK_TOO_LARGE),
+      StatusCode::REQUEST_HEADER_FIELDS_TOO_LARGE);
+  EXPECT_EQ(RequestParser::get_error_status(RequestParser::Error::BODY_TOO_LARGE),
+      StatusCode::PAYLOAD_TOO_LARGE);
+  EXPECT_EQ(RequestParser::get_error_status(RequestParser::Error::UNSUPPORTED_TRANSFER_CODING),
+      StatusCode::NOT_IMPLEMENTED);
+}
+
+TEST_P(FragmentedRequestTest, ResetClearsTheError)
+{
+  RequestParser parser{GetParam()};
+
+  parser.add_chunk("GET\r\n\r\n");
+  EXPECT_EQ(parser.get_error(), RequestParser::Error::BAD_REQUEST);
+
+  parser.reset();
+  parser.add_chunk("GET / HTTP/1.1\r\n\r\n");
+  EXPECT_EQ(parser.get_state(), RequestParser::DONE);
+  EXPECT_EQ(parser.get_error(), RequestParser::Error::NONE);
+}
+
+TEST_P(FragmentedRequestTest, PipelinedRequests)
+{
+  RequestParser parser{GetParam()};
+
+  parser.add_chunk("GET /a HTTP/1.1\r\n\r\nPOST /b HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody\r\n"
+                   "GET /c HTTP/1.1\r\nHost: x\r\n");
+
+  auto first = parser.next_request();
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first->get_uri(), "/a");
+
+  auto second = parser.next_request();
+  ASSERT_TRUE(second);
+  EXPECT_EQ(second->get_http_method(), "post");
+  EXPECT_EQ(second->get_uri(), "/b");
+  EXPECT_EQ(second->get_body_string(), "body");
+
+  /*
+   * The third request is incomplete, and the CRLF after the body of the second one is ignored.
+   */
+  auto receiving_headers = GetParam() == RequestParser::Mode::COPY
+      ? RequestParser::WAITING_HEADER_LINE
+      : RequestParser::WAITING_START_LINE;
+  EXPECT_FALSE(parser.next_request());
+  EXPECT_EQ(parser.get_state(), receiving_headers);
+
+  parser.add_chunk("\r\n");
+
+  auto third = parser.next_request();
+  ASSERT_TRUE(third);
+  EXPECT_EQ(third->get_uri(), "/c");
+  EXPECT_EQ(third->find_header("host"), "x");
+  EXPECT_FALSE(parser.next_request());
+  EXPECT_EQ(parser.get_state(), RequestParser::WAITING_START_LINE);
+}
+
+TEST_P(FragmentedRequestTest, ChunkedBody)
+{
+  std::string raw = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                    "5;name=value\r\nhello\r\n"
+                    "1A\r\n, this is a chunked body..\r\n"
+                    "0\r\nX-Checksum: 42\r\n\r\n"
+                    "GET /next HTTP/1.1\r\n\r\n";
+
+  for (std::size_t chunk_size : {raw.size(), std::size_t{1}, std::size_t{7}})
+  {
+    RequestParser parser{GetParam()};
+    for (std::size_t i = 0; i < raw.size(); i += chunk_size)
+    {
+      auto chunk = raw.substr(i, chunk_size);
+      parser.add_chunk(microloop::Buffer{chunk.data(), chunk.size()});
+    }
+
+    auto request = parser.next_request();
+    ASSERT_TRUE(request) << chunk_size;
+    EXPECT_EQ(request->get_body_string(), "hello, this is a chunked body..");
+    EXPECT_EQ(request->find_header("x-checksum"), "42");
+
+    auto next = parser.next_request();
+    ASSERT_TRUE(next) << chunk_size;
+    EXPECT_EQ(next->get_uri(), "/next");
+  }
+}
+
+TEST_P(FragmentedRequestTest, ChunkedBodyErrors)
+{
+  using Error = RequestParser::Error;
+
+  std::vector<std::pair<std::string, Error>> requests = {
+      {"Transfer-Encoding: chunked\r\n\r\nzz\r\n", Error::BAD_REQUEST},
+      {"Transfer-Encoding: chunked\r\n\r\n3 x\r\n", Error::BAD_REQUEST},
+      {"Transfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n", Error::BAD_REQUEST},
+      {"Transfer-Encoding: chunked\r\n\r\n" + std::string(20, 'f') + "\r\n", Error::BODY_TOO_LARGE},
+      {"Transfer-Encoding: chunked\r\n\r\n100001\r\n", Error::BODY_TOO_LARGE},
+      {"Transfer-Encoding: chunked\r\nContent-Length: 3\r\n\r\n", Error::BAD_REQUEST},
+      {"Transfer-Encoding: chunked, gzip\r\n\r\n", Error::UNSUPPORTED_TRANSFER_CODING},
+      {"Content-Length: 2000000\r\n\r\n", Error::BODY_TOO_LARGE},
+  };
+
+  for (const auto &[headers, error] : requests)
+  {
+    RequestParser parser{GetParam()};
+
+    auto raw = "POST / HTTP/1.1\r\n" + headers;
+    parser.add_chunk(raw.c_str());
+
+    EXPECT_EQ(parser.get_state(), RequestParser::ERROR) << headers;
+    EXPECT_EQ(parser.get_error(), error) << headers;
+  }
+}
+
+TEST_P(FragmentedRequestTest, MalformedTypedHeaders)
+{
+  for (std::string headers : {
+           "Content-Length: 3\r\nContent-Length: 3\r\n",
+           "Content-Length: 3, 3\r\n",
+           "Content-Length: -1\r\n",
+           "Content-Length: 18446744073709551616\r\n",
+           "Host: a\r\nHost: b\r\n",
+           "Transfer-Encoding: chunked, chunked\r\n",
+           "Connection: close, \"x\"\r\n",
+       })
+  {
+    RequestParser parser{GetParam()};
+
+    auto raw = "POST / HTTP/1.1\r\n" + headers + "\r\n";
+    parser.add_chunk(raw.c_str());
+
+    EXPECT_EQ(parser.get_error(), RequestParser::Error::BAD_REQUEST) << headers;
+  }
+}
+
+TEST_P(FragmentedRequestTest, TypedHeaders)
+{
+  RequestParser parser{GetParam()};
+
+  parser.add_chunk("POST / HTTP/1.0\r\nHost: example.com\r\nConnection: Keep-Alive\r\n"
+                   "Expect: 100-continue\r\nTransfer-Encoding: chunked\r\n\r\n"
+                   "0\r\nContent-Length: 5\r\n\r\n"
+                   "GET / HTTP/1.0\r\n\r\n");
+
+  auto request = parser.next_request();
+  ASSERT_TRUE(request);
+  EXPECT_EQ(request->get_host(), "example.com");
+  EXPECT_TRUE(request->keep_alive());
+  EXPECT_TRUE(request->expects_continue());
+  EXPECT_EQ(request->get_typed_headers().transfer_coding, TypedHeaders::TransferCoding::CHUNKED);
+
+  /*
+   * The Content-Length trailer is dropped.
+   */
+  EXPECT_FALSE(request->get_content_length());
+  EXPECT_FALSE(request->find_header("content-length"));
+
+  auto next = parser.next_request();
+  ASSERT_TRUE(next);
+  EXPECT_FALSE(next->get_host());
+  EXPECT_FALSE(next->keep_alive());
+}
+
+TEST_P(FragmentedRequestTest, MaxBodySize)
+{
+  RequestParser parser{GetParam()};
+  parser.set_max_body_size(4);
+
+  parser.add_chunk("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n2\r\n");
+
+  EXPECT_EQ(parser.get_error(), RequestParser::Error::BODY_TOO_LARGE);
+}
+
+TEST_P(FragmentedRequestTest, StreamedBody)
+{
+  RequestParser parser{GetParam()};
+
+  std::string uri;
+  std::string body;
+  parser.set_body_handler({
+      [&](HttpRequest &request) { uri = request.get_uri(); },
+      [&](std::string_view slice) {
+        body += slice;
+        return true;
+      },
+  });
+
+  parser.add_chunk("POST /a HTTP/1.1\r\nContent-Length: 6\r\n\r\nabc");
+  EXPECT_EQ(uri, "/a");
+  EXPECT_EQ(body, "abc");
+
+  parser.add_chunk("defPOST /b HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n2\r\ngh\r\n0\r\n\r\n");
+  EXPECT_EQ(body, "abcdef");
+
+  auto first = parser.next_request();
+  ASSERT_TRUE(first);
+  EXPECT_TRUE(first->get_body().empty());
+
+  EXPECT_EQ(uri, "/b");
+  EXPECT_EQ(body, "abcdefgh");
+  EXPECT_TRUE(parser.next_request());
+}
+
+TEST_P(FragmentedRequestTest, PausedByBodyHandler)
+{
+  RequestParser parser{GetParam()};
+
+  std::vector<std::string> slices;
+  parser.set_body_handler({nullptr, [&](std::string_view slice) {
+                             slices.emplace_back(slice);
+                             return false;
+                           }});
+
+  parser.add_chunk("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n");
+  EXPECT_TRUE(parser.is_paused());
+  EXPECT_EQ(slices, std::vector<std::string>{"abc"});
+
+  /*
+   * The bytes received while paused are kept, and only parsed after resuming.
+   */
+  parser.add_chunk("2\r\nde\r\n0\r\n\r\n");
+  EXPECT_EQ(slices.size(), 1u);
+
+  parser.resume();
+  EXPECT_EQ(slices, (std::vector<std::string>{"abc", "de"}));
+  EXPECT_TRUE(parser.is_paused());
+
+  parser.resume();
+  EXPECT_FALSE(parser.is_paused());
+  EXPECT_EQ(parser.get_state(), RequestParser::DONE);
+}
+
+INSTANTIATE_TEST_CASE_P(Http, FragmentedRequestTest,
+    testing::Values(RequestParser::Mode::COPY, RequestParser::Mode::ZERO_COPY));
+
 }  // namespace microhttp::http
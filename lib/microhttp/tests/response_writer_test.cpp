@@ -0,0 +1,198 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/response_writer.h"
+
+#include "gtest/gtest.h"
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief A connection whose peer is the other end of a socket pair, read by the test.
+ */
+class ResponseWriterTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    conn.emplace(nullptr, sockaddr_storage{}, 0, fds[0]);
+    peer = fds[1];
+  }
+
+  void TearDown() override
+  {
+    conn.reset();
+    if (peer != -1)
+    {
+      close(peer);
+    }
+  }
+
+  /**
+   * \brief Read everything the peer received so far.
+   */
+  std::string received()
+  {
+    std::string data;
+    char buf[4096];
+
+    ssize_t nrecv;
+    while ((nrecv = recv(peer, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+      data.append(buf, nrecv);
+    }
+
+    return data;
+  }
+
+  std::optional<microloop::net::TcpServer::PeerConnection> conn;
+  int peer = -1;
+};
+
+TEST_F(ResponseWriterTest, ChunkedWhenLengthIsUnknown)
+{
+  ResponseWriter writer{*conn};
+
+  HttpResponse head;
+  head.set_header("Content-Type", "text/plain");
+
+  EXPECT_TRUE(writer.write_head(head));
+  EXPECT_EQ(received(), "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n");
+
+  std::string large(300, 'x');
+  EXPECT_TRUE(writer.write("hello"));
+  EXPECT_TRUE(writer.write(""));
+  EXPECT_TRUE(writer.write(large));
+  EXPECT_TRUE(writer.finish());
+
+  EXPECT_TRUE(writer.finished());
+  EXPECT_TRUE(writer.keep_alive());
+  EXPECT_EQ(received(), "5\r\nhello\r\n12c\r\n" + large + "\r\n0\r\n\r\n");
+
+  EXPECT_THROW(writer.write("late"), std::logic_error);
+}
+
+TEST_F(ResponseWriterTest, IdentityWhenLengthIsKnown)
+{
+  ResponseWriter writer{*conn};
+
+  HttpResponse head{microloop::Buffer{"he"}};
+  head.set_header("Content-Length", 5);
+
+  EXPECT_THROW(writer.write("early"), std::logic_error);
+
+  writer.write_head(head);
+  writer.write("l");
+  EXPECT_THROW(writer.write("lo!"), std::logic_error);
+  writer.write("lo");
+  writer.finish();
+
+  EXPECT_EQ(received(), "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello");
+  EXPECT_THROW(writer.write_head(head), std::logic_error);
+}
+
+TEST_F(ResponseWriterTest, ShortBody)
+{
+  ResponseWriter writer{*conn};
+
+  HttpResponse head;
+  head.set_header("Content-Length", 5);
+
+  writer.write_head(head);
+  writer.write("hell");
+  EXPECT_THROW(writer.finish(), std::logic_error);
+}
+
+TEST_F(ResponseWriterTest, CloseDelimitedForHttp10)
+{
+  ResponseWriter writer{*conn, Version{1, 0}};
+
+  HttpResponse head;
+  head.set_http_version(Version{1, 0});
+
+  writer.write_head(head);
+  writer.write("hello");
+  writer.finish();
+
+  EXPECT_FALSE(writer.keep_alive());
+  EXPECT_EQ(received(), "HTTP/1.0 200 OK\r\nConnection: close\r\n\r\nhello");
+}
+
+TEST_F(ResponseWriterTest, NoBody)
+{
+  ResponseWriter writer{*conn};
+
+  writer.write_head(HttpResponse{microloop::Buffer{}, StatusCode::NO_CONTENT});
+  EXPECT_THROW(writer.write("x"), std::logic_error);
+  writer.finish();
+
+  EXPECT_TRUE(writer.keep_alive());
+  EXPECT_EQ(received(), "HTTP/1.1 204 No Content\r\n\r\n");
+}
+
+TEST_F(ResponseWriterTest, Backpressure)
+{
+  int sndbuf = 4096;
+  ASSERT_EQ(setsockopt(conn->fd(), SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)), 0);
+  conn->set_high_water_mark(16 * 1024);
+
+  ResponseWriter writer{*conn};
+  auto drained = 0;
+  writer.set_writable_handler([&] { ++drained; });
+
+  std::string expected;
+  std::string part(4096, 'x');
+
+  writer.write_head(HttpResponse{});
+  while (writer.write(part))
+  {
+    expected += "1000\r\n" + part + "\r\n";
+  }
+
+  expected += "1000\r\n" + part + "\r\n";
+  EXPECT_GE(conn->queued_bytes(), 16u * 1024);
+
+  /*
+   * Reading on the peer side makes room in the socket, and the event loop sends the rest of the
+   * queue.
+   */
+  std::string body = received();
+  while (!drained)
+  {
+    microloop::EventLoop::instance().next_tick();
+    body += received();
+  }
+
+  EXPECT_EQ(drained, 1);
+  EXPECT_TRUE(writer.writable());
+  EXPECT_EQ(conn->queued_bytes(), 0u);
+
+  writer.finish();
+  body += received();
+
+  auto head_end = body.find("\r\n\r\n");
+  ASSERT_NE(head_end, std::string::npos);
+  EXPECT_EQ(body.substr(head_end + 4), expected + "0\r\n\r\n");
+}
+
+TEST_F(ResponseWriterTest, PeerGone)
+{
+  close(peer);
+  peer = -1;
+
+  ResponseWriter writer{*conn};
+  EXPECT_FALSE(writer.write_head(HttpResponse{}));
+  EXPECT_FALSE(writer.writable());
+}
+
+}  // namespace microhttp::http
@@ -0,0 +1,287 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/basic_http_server.h"
+#include "microhttp/router.h"
+
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief A handler writing its name and the parameters it got into the response.
+ */
+static Router::Handler named(std::string name)
+{
+  return [name](const HttpRequest &, HttpResponse &response, const RouteParams &params) {
+    std::string content = name;
+    for (const auto &[param, value] : params)
+    {
+      content += " " + std::string{param} + "=" + std::string{value};
+    }
+
+    response.content() = microloop::Buffer{content.c_str()};
+  };
+}
+
+/**
+ * \brief Match a path and run the handler found, if any.
+ * \returns What the handler wrote, or an empty string if there is none.
+ */
+static std::string dispatch(const Router &router, Method method, std::string_view path)
+{
+  auto match = router.match(method, path);
+  if (!match.handler)
+  {
+    return "";
+  }
+
+  HttpResponse response;
+  (*match.handler)(HttpRequest{}, response, match.params);
+
+  return std::string{response.content().str_view()};
+}
+
+TEST(Router, StaticRoutes)
+{
+  Router router;
+  router.add(Method::GET, "/", named("root"));
+  router.add(Method::GET, "/users", named("users"));
+  router.add(Method::GET, "/users/", named("users/"));
+  router.add(Method::GET, "/user", named("user"));
+  router.add(Method::GET, "/usage", named("usage"));
+  router.add(Method::GET, "/users/admin", named("admin"));
+
+  EXPECT_EQ(router.size(), 6u);
+  EXPECT_EQ(dispatch(router, Method::GET, "/"), "root");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users"), "users");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/"), "users/");
+  EXPECT_EQ(dispatch(router, Method::GET, "/user"), "user");
+  EXPECT_EQ(dispatch(router, Method::GET, "/usage"), "usage");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/admin"), "admin");
+
+  EXPECT_EQ(dispatch(router, Method::GET, ""), "");
+  EXPECT_EQ(dispatch(router, Method::GET, "/us"), "");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/admins"), "");
+  EXPECT_EQ(dispatch(router, Method::GET, "/Users"), "");
+}
+
+TEST(Router, Params)
+{
+  Router router;
+  router.add(Method::GET, "/users/:id", named("user"));
+  router.add(Method::GET, "/users/:id/posts/:post", named("post"));
+  router.add(Method::GET, "/users/new", named("new"));
+  router.add(Method::GET, "/users/:id/name", named("name"));
+
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/42"), "user id=42");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/42/posts/7"), "post id=42 post=7");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/new"), "new");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/newer"), "user id=newer");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/42/name"), "name id=42");
+
+  /*
+   * Parameters match whole non-empty segments.
+   */
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/"), "");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/42/posts/"), "");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/42/"), "");
+
+  auto match = router.match(Method::GET, "/users/42/posts/7");
+  EXPECT_EQ(match.params.size(), 2u);
+  EXPECT_EQ(match.params.get("post"), "7");
+  EXPECT_EQ(match.params.get("missing"), std::nullopt);
+}
+
+TEST(Router, Backtracking)
+{
+  Router router;
+  router.add(Method::GET, "/users/new/edit", named("edit new"));
+  router.add(Method::GET, "/users/:id/profile", named("profile"));
+
+  /*
+   * The static segment matches first, but the rest of the path only matches after the parameter.
+   */
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/new/edit"), "edit new");
+  EXPECT_EQ(dispatch(router, Method::GET, "/users/new/profile"), "profile id=new");
+}
+
+TEST(Router, Wildcards)
+{
+  Router router;
+  router.add(Method::GET, "/static/*path", named("static"));
+  router.add(Method::GET, "/static/favicon.ico", named("favicon"));
+  router.add(Method::GET, "/:lang/docs/*page", named("docs"));
+
+  EXPECT_EQ(dispatch(router, Method::GET, "/static/css/site.css"), "static path=css/site.css");
+  EXPECT_EQ(dispatch(router, Method::GET, "/static/"), "static path=");
+  EXPECT_EQ(dispatch(router, Method::GET, "/static/favicon.ico"), "favicon");
+  EXPECT_EQ(dispatch(router, Method::GET, "/static/favicon.icon"), "static path=favicon.icon");
+  EXPECT_EQ(dispatch(router, Method::GET, "/en/docs/a/b"), "docs lang=en page=a/b");
+  EXPECT_EQ(dispatch(router, Method::GET, "/static"), "");
+}
+
+TEST(Router, Methods)
+{
+  Router router;
+  router.add(Method::GET, "/items/:id", named("get"));
+  router.add(Method::PUT, "/items/:id", named("put"));
+  router.add(Method::HEAD, "/head", named("head"));
+
+  EXPECT_EQ(dispatch(router, Method::PUT, "/items/1"), "put id=1");
+  EXPECT_EQ(dispatch(router, Method::HEAD, "/items/1"), "get id=1");
+  EXPECT_EQ(dispatch(router, Method::GET, "/head"), "");
+
+  auto match = router.match(Method::DELETE, "/items/1");
+  EXPECT_EQ(match.handler, nullptr);
+  EXPECT_EQ(match.allowed_methods,
+      (1 << static_cast<int>(Method::GET)) | (1 << static_cast<int>(Method::HEAD))
+          | (1 << static_cast<int>(Method::PUT)));
+
+  EXPECT_EQ(router.match(Method::UNKNOWN, "/items/1").handler, nullptr);
+  EXPECT_EQ(router.match(Method::GET, "/nothing").allowed_methods, 0);
+}
+
+TEST(Router, InvalidRoutes)
+{
+  Router router;
+  router.add(Method::GET, "/users/:id", named("user"));
+
+  EXPECT_THROW(router.add(Method::GET, "users", named("")), std::invalid_argument);
+  EXPECT_THROW(router.add(Method::GET, "", named("")), std::invalid_argument);
+  EXPECT_THROW(router.add(Method::GET, "/users/:", named("")), std::invalid_argument);
+  EXPECT_THROW(router.add(Method::GET, "/files/*path/more", named("")), std::invalid_argument);
+  EXPECT_THROW(router.add(Method::GET, "/users/:name/x", named("")), std::invalid_argument);
+  EXPECT_THROW(router.add(Method::GET, "/users/:id", named("")), std::invalid_argument);
+  EXPECT_THROW(router.add(Method::UNKNOWN, "/other", named("")), std::invalid_argument);
+  EXPECT_THROW(
+      router.add(Method::GET, "/:a/:b/:c/:d/:e/:f/:g/:h/:i", named("")), std::invalid_argument);
+
+  EXPECT_EQ(router.size(), 1u);
+  EXPECT_NO_THROW(router.add(Method::POST, "/users/:id", named("")));
+}
+
+TEST(BasicHttpServer, Respond)
+{
+  BasicHttpServer server{0};
+  server.get("/hello/:name", [](const HttpRequest &, HttpResponse &response, const auto &params) {
+    response.content() = microloop::Buffer{("hello " + std::string{*params.get("name")}).c_str()};
+  });
+  server.post("/fail", [](const HttpRequest &, HttpResponse &, const auto &) {
+    throw std::runtime_error("failure");
+  });
+
+  auto hello = server.respond(HttpRequest{"GET", "/hello/world?x=1"});
+  EXPECT_EQ(hello.status_code(), StatusCode::OK);
+  EXPECT_EQ(hello.content().str_view(), "hello world");
+
+  auto absolute = server.respond(HttpRequest{"GET", "http://example.com/hello/you"});
+  EXPECT_EQ(absolute.content().str_view(), "hello you");
+
+  EXPECT_EQ(server.respond(HttpRequest{"GET", "/missing"}).status_code(), StatusCode::NOT_FOUND);
+  EXPECT_EQ(server.respond(HttpRequest{"POST", "/fail"}).status_code(),
+      StatusCode::INTERNAL_SERVER_ERROR);
+
+  auto not_allowed = server.respond(HttpRequest{"DELETE", "/hello/world"});
+  EXPECT_EQ(not_allowed.status_code(), StatusCode::METHOD_NOT_ALLOWED);
+  EXPECT_EQ(not_allowed.header("Allow"), "GET, HEAD");
+}
+
+
+/**
+ * \brief Connect a client to a server listening on an ephemeral port, over the loopback interface.
+ */
+static int connect_client(const BasicHttpServer &server)
+{
+  sockaddr_storage addr{};
+  socklen_t addrlen = sizeof(addr);
+  EXPECT_EQ(::getsockname(server.fd(), reinterpret_cast<sockaddr *>(&addr), &addrlen), 0);
+  if (addr.ss_family == AF_INET6)
+  {
+    reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_addr = in6addr_loopback;
+  }
+  else
+  {
+    reinterpret_cast<sockaddr_in *>(&addr)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+
+  auto fd = ::socket(addr.ss_family, SOCK_STREAM, 0);
+  EXPECT_EQ(::connect(fd, reinterpret_cast<sockaddr *>(&addr), addrlen), 0);
+
+  return fd;
+}
+
+/**
+ * \brief Send bytes to the server, and run the event loop until the answer ends with the given
+ * text, for a bounded number of ticks.
+ * \returns What the client received.
+ */
+static std::string exchange(int client, std::string_view request, std::string_view until)
+{
+  EXPECT_EQ(::send(client, request.data(), request.size(), 0),
+      static_cast<ssize_t>(request.size()));
+
+  std::string received;
+  for (int tick = 0; tick != 100 && received.find(until) == std::string::npos; ++tick)
+  {
+    microloop::EventLoop::instance().next_tick();
+
+    char buf[1024];
+    for (ssize_t nread; (nread = ::recv(client, buf, sizeof(buf), MSG_DONTWAIT)) > 0;)
+    {
+      received.append(buf, nread);
+    }
+  }
+
+  return received;
+}
+
+TEST(BasicHttpServer, MeetsExpectationsAndRequiresHost)
+{
+  BasicHttpServer server{0};
+  server.post("/echo", [](const HttpRequest &request, HttpResponse &response, const auto &) {
+    response.content() = microloop::Buffer{request.get_body_string().c_str()};
+  });
+
+  auto client = connect_client(server);
+
+  /*
+   * The body is only sent once the server asks for it.
+   */
+  auto received = exchange(client,
+      "POST /echo HTTP/1.1\r\nHost: a\r\nContent-Length: 5\r\nExpect: 100-continue\r\n\r\n",
+      "\r\n\r\n");
+  EXPECT_EQ(received, "HTTP/1.1 100 Continue\r\n\r\n");
+
+  received = exchange(client, "hello", "hello");
+  EXPECT_EQ(received.rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+  EXPECT_EQ(received.find("100 Continue"), std::string::npos);
+
+  received = exchange(client, "GET /echo HTTP/1.1\r\nHost: a\r\nExpect: x\r\n\r\n", "\r\n\r\n");
+  EXPECT_EQ(received.rfind("HTTP/1.1 417 Expectation Failed\r\n", 0), 0u);
+
+  /*
+   * Expectations are ignored in HTTP/1.0 requests, which do not need a Host either.
+   */
+  received = exchange(client,
+      "POST /echo HTTP/1.0\r\nConnection: keep-alive\r\nExpect: x\r\nContent-Length: 2\r\n\r\nok",
+      "ok");
+  EXPECT_EQ(received.rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+
+  received = exchange(client, "POST /echo HTTP/1.1\r\n\r\n", "\r\n\r\n");
+  EXPECT_EQ(received.rfind("HTTP/1.1 400 Bad Request\r\n", 0), 0u);
+  EXPECT_NE(received.find("Connection: close\r\n"), std::string::npos);
+
+  ::close(client);
+}
+
+}  // namespace microhttp::http
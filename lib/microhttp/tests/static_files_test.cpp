@@ -0,0 +1,430 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/basic_http_server.h"
+#include "microhttp/mime_types.h"
+#include "microhttp/static_files.h"
+
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <filesystem>
+#include <fstream>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace microhttp::http
+{
+
+/**
+ * \brief A temporary document root, removed with everything in it.
+ */
+class DocumentRoot
+{
+public:
+  DocumentRoot()
+  {
+    char dir[] = "/tmp/static_files_testXXXXXX";
+    EXPECT_NE(::mkdtemp(dir), nullptr);
+    path_ = dir;
+  }
+
+  ~DocumentRoot()
+  {
+    std::filesystem::remove_all(path_);
+  }
+
+  void write(const std::string &name, const std::string &content) const
+  {
+    std::filesystem::create_directories((path_ / name).parent_path());
+    std::ofstream{path_ / name, std::ios::trunc} << content;
+  }
+
+  const std::filesystem::path &path() const noexcept
+  {
+    return path_;
+  }
+
+private:
+  std::filesystem::path path_;
+};
+
+/**
+ * \brief Run the event loop once, so that the pending changes to the files are reported.
+ */
+static void report_changes()
+{
+  microloop::EventLoop::instance().next_tick();
+}
+
+static std::string read_body(const StaticFiles::Reply &reply)
+{
+  std::string body(static_cast<std::size_t>(reply.file->st.st_size), '\0');
+  EXPECT_EQ(::pread(reply.file->fd, body.data(), body.size(), 0),
+      static_cast<ssize_t>(body.size()));
+
+  return body;
+}
+
+TEST(StaticFiles, MapToRoot)
+{
+  EXPECT_EQ(map_to_root("/"), "");
+  EXPECT_EQ(map_to_root("/index.html"), "index.html");
+  EXPECT_EQ(map_to_root("/css/site.css?v=2#top"), "css/site.css");
+  EXPECT_EQ(map_to_root("/docs/"), "docs/");
+  EXPECT_EQ(map_to_root("//docs//./guide/"), "docs/guide/");
+  EXPECT_EQ(map_to_root("/docs/guide/../api.html"), "docs/api.html");
+  EXPECT_EQ(map_to_root("/docs/.."), "");
+  EXPECT_EQ(map_to_root("/my%20file.txt"), "my file.txt");
+  EXPECT_EQ(map_to_root("/%64ocs/%2e%2e/a"), "a");
+
+  EXPECT_EQ(map_to_root(""), std::nullopt);
+  EXPECT_EQ(map_to_root("index.html"), std::nullopt);
+  EXPECT_EQ(map_to_root("/.."), std::nullopt);
+  EXPECT_EQ(map_to_root("/docs/../../etc/passwd"), std::nullopt);
+  EXPECT_EQ(map_to_root("/%2e%2e/etc/passwd"), std::nullopt);
+  EXPECT_EQ(map_to_root("/docs%2f..%2f..%2fetc"), std::nullopt);
+  EXPECT_EQ(map_to_root("/index.html%00.txt"), std::nullopt);
+  EXPECT_EQ(map_to_root("/bad%zz"), std::nullopt);
+  EXPECT_EQ(map_to_root("/bad%2"), std::nullopt);
+  EXPECT_EQ(map_to_root("/.git/config"), std::nullopt);
+  EXPECT_EQ(map_to_root("/.env"), std::nullopt);
+}
+
+TEST(StaticFiles, MimeType)
+{
+  EXPECT_EQ(mime_type("index.html"), "text/html; charset=utf-8");
+  EXPECT_EQ(mime_type("css/SITE.CSS"), "text/css; charset=utf-8");
+  EXPECT_EQ(mime_type("img/logo.svg"), "image/svg+xml");
+  EXPECT_EQ(mime_type("fonts/a.woff2"), "font/woff2");
+  EXPECT_EQ(mime_type("archive.tar.gz"), "application/gzip");
+  EXPECT_EQ(mime_type("Makefile"), "application/octet-stream");
+  EXPECT_EQ(mime_type("v1.0/README"), "application/octet-stream");
+  EXPECT_EQ(mime_type("file."), "application/octet-stream");
+  EXPECT_EQ(mime_type("file.unknown"), "application/octet-stream");
+}
+
+TEST(StaticFiles, CacheHitsAndMisses)
+{
+  DocumentRoot root;
+  root.write("a.txt", "first");
+  root.write("dir/b.txt", "second");
+
+  FileCache cache{root.path(), FileCache::Options{}};
+  auto file = cache.open("a.txt");
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(file->st.st_size, 5);
+  EXPECT_EQ(file->mime_type, "text/plain; charset=utf-8");
+  EXPECT_EQ(cache.open("a.txt"), file);
+  EXPECT_NE(cache.open("dir/b.txt"), nullptr);
+
+  EXPECT_EQ(cache.open("missing.txt"), nullptr);
+  EXPECT_EQ(cache.open("dir"), nullptr);
+
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.bytes(), 11u);
+  EXPECT_EQ(cache.hits(), 1u);
+  EXPECT_EQ(cache.misses(), 4u);
+
+  cache.erase("a.txt");
+  EXPECT_EQ(cache.size(), 1u);
+  EXPECT_EQ(cache.bytes(), 6u);
+
+  /*
+   * The files already handed out stay open.
+   */
+  char c;
+  EXPECT_EQ(::pread(file->fd, &c, 1, 0), 1);
+}
+
+TEST(StaticFiles, CacheEvictsLeastRecentlyUsed)
+{
+  DocumentRoot root;
+  root.write("a", "aaaa");
+  root.write("b", "bbbb");
+  root.write("c", "cccc");
+  root.write("large", std::string(64, 'l'));
+
+  FileCache cache{root.path(), FileCache::Options{2, 10}};
+  auto a = cache.open("a");
+  cache.open("b");
+  EXPECT_EQ(cache.open("a"), a);
+
+  cache.open("c");
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.open("a"), a);
+
+  auto misses = cache.misses();
+  cache.open("b");
+  EXPECT_EQ(cache.misses(), misses + 1);
+
+  /*
+   * Files larger than the cache are served, but not kept.
+   */
+  EXPECT_NE(cache.open("large"), nullptr);
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_LE(cache.bytes(), 10u);
+}
+
+TEST(StaticFiles, CacheRefusesLinksOutOfTheRoot)
+{
+  DocumentRoot root, outside;
+  root.write("inside.txt", "inside");
+  outside.write("secret.txt", "secret");
+
+  ASSERT_EQ(::symlink((outside.path() / "secret.txt").c_str(),
+                (root.path() / "secret.txt").c_str()),
+      0);
+  ASSERT_EQ(::symlink("inside.txt", (root.path() / "alias.txt").c_str()), 0);
+
+  FileCache cache{root.path(), FileCache::Options{}};
+  EXPECT_EQ(cache.open("secret.txt"), nullptr);
+  EXPECT_NE(cache.open("alias.txt"), nullptr);
+}
+
+TEST(StaticFiles, CacheRefusesFilesThatAreNotRegular)
+{
+  DocumentRoot root;
+  root.write("docs/index.html", "docs");
+  ASSERT_EQ(::mkfifo((root.path() / "fifo.txt").c_str(), 0600), 0);
+
+  /*
+   * Opening the FIFO would block until a writer opens it.
+   */
+  FileCache cache{root.path(), FileCache::Options{}};
+  EXPECT_EQ(cache.open("fifo.txt"), nullptr);
+  EXPECT_EQ(cache.open("docs"), nullptr);
+  EXPECT_NE(cache.open("docs/index.html"), nullptr);
+}
+
+TEST(StaticFiles, CacheDropsChangedFiles)
+{
+  DocumentRoot root;
+  root.write("page.html", "old");
+  root.write("other.html", "other");
+
+  FileCache cache{root.path(), FileCache::Options{}};
+  auto old = cache.open("page.html");
+  cache.open("other.html");
+
+  root.write("page.html", "new content");
+  report_changes();
+
+  EXPECT_EQ(cache.size(), 1u);
+  auto updated = cache.open("page.html");
+  ASSERT_NE(updated, nullptr);
+  EXPECT_NE(updated, old);
+  EXPECT_EQ(updated->st.st_size, 11);
+
+  /*
+   * Replacing a file by renaming another one over it is the way most tools update files.
+   */
+  root.write("page.html.tmp", "replaced");
+  std::filesystem::rename(root.path() / "page.html.tmp", root.path() / "page.html");
+  report_changes();
+
+  auto replaced = cache.open("page.html");
+  ASSERT_NE(replaced, nullptr);
+  EXPECT_EQ(replaced->st.st_size, 8);
+
+  std::filesystem::remove(root.path() / "page.html");
+  report_changes();
+
+  EXPECT_EQ(cache.open("page.html"), nullptr);
+  EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST(StaticFiles, Respond)
+{
+  DocumentRoot root;
+  root.write("index.html", "<h1>home</h1>");
+  root.write("docs/index.html", "<h1>docs</h1>");
+  root.write("data.json", "{\"key\": \"value\"}");
+
+  StaticFiles files{root.path()};
+
+  auto reply = files.respond(HttpRequest{"GET", "/"});
+  EXPECT_EQ(reply.head.status_code(), StatusCode::OK);
+  EXPECT_EQ(reply.head.header("Content-Type"), "text/html; charset=utf-8");
+  EXPECT_EQ(reply.head.header("Content-Length"), "13");
+  EXPECT_EQ(reply.head.header("Accept-Ranges"), "bytes");
+  ASSERT_TRUE(reply.head.header("ETag"));
+  ASSERT_NE(reply.file, nullptr);
+  EXPECT_EQ(read_body(reply), "<h1>home</h1>");
+
+  reply = files.respond(HttpRequest{"HEAD", "/data.json"});
+  EXPECT_EQ(reply.head.status_code(), StatusCode::OK);
+  EXPECT_EQ(reply.head.header("Content-Type"), "application/json");
+
+  reply = files.respond(HttpRequest{"GET", "/docs/"});
+  ASSERT_NE(reply.file, nullptr);
+  EXPECT_EQ(read_body(reply), "<h1>docs</h1>");
+
+  reply = files.respond(HttpRequest{"GET", "/docs?page=2"});
+  EXPECT_EQ(reply.head.status_code(), StatusCode::MOVED_PERMANENTLY);
+  EXPECT_EQ(reply.head.header("Location"), "/docs/");
+  EXPECT_EQ(reply.file, nullptr);
+
+  EXPECT_EQ(files.respond(HttpRequest{"GET", "/missing"}).head.status_code(),
+      StatusCode::NOT_FOUND);
+  EXPECT_EQ(files.respond(HttpRequest{"GET", "/../index.html"}).head.status_code(),
+      StatusCode::NOT_FOUND);
+
+  reply = files.respond(HttpRequest{"POST", "/"});
+  EXPECT_EQ(reply.head.status_code(), StatusCode::METHOD_NOT_ALLOWED);
+  EXPECT_EQ(reply.head.header("Allow"), "GET, HEAD");
+
+  EXPECT_GE(files.cache().hits(), 1u);
+}
+
+TEST(StaticFiles, RespondToConditionalAndRangeRequests)
+{
+  DocumentRoot root;
+  root.write("alphabet.txt", "abcdefghijklmnopqrstuvwxyz");
+
+  StaticFiles files{root.path()};
+  auto etag = *files.respond(HttpRequest{"GET", "/alphabet.txt"}).head.header("ETag");
+
+  HttpRequest conditional{"GET", "/alphabet.txt"};
+  conditional.set_header("If-None-Match", etag);
+  auto reply = files.respond(conditional);
+  EXPECT_EQ(reply.head.status_code(), StatusCode::NOT_MODIFIED);
+  EXPECT_EQ(reply.file, nullptr);
+
+  HttpRequest ranged{"GET", "/alphabet.txt"};
+  ranged.set_header("Range", "bytes=2-4");
+  reply = files.respond(ranged);
+  EXPECT_EQ(reply.head.status_code(), StatusCode::PARTIAL_CONTENT);
+  EXPECT_EQ(reply.head.header("Content-Range"), "bytes 2-4/26");
+  EXPECT_EQ(reply.head.header("Content-Length"), "3");
+
+  ranged.set_header("Range", "bytes=30-");
+  EXPECT_EQ(files.respond(ranged).head.status_code(), StatusCode::RANGE_NOT_SATISFIABBLE);
+}
+
+
+/**
+ * \brief Connect a client to a server listening on an ephemeral port, over the loopback interface,
+ * and send it a request.
+ */
+static int send_request(const BasicHttpServer &server, std::string_view request)
+{
+  sockaddr_storage addr{};
+  socklen_t addrlen = sizeof(addr);
+  EXPECT_EQ(::getsockname(server.fd(), reinterpret_cast<sockaddr *>(&addr), &addrlen), 0);
+  if (addr.ss_family == AF_INET6)
+  {
+    reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_addr = in6addr_loopback;
+  }
+  else
+  {
+    reinterpret_cast<sockaddr_in *>(&addr)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+
+  auto client = ::socket(addr.ss_family, SOCK_STREAM, 0);
+  EXPECT_EQ(::connect(client, reinterpret_cast<sockaddr *>(&addr), addrlen), 0);
+  EXPECT_EQ(::send(client, request.data(), request.size(), 0),
+      static_cast<ssize_t>(request.size()));
+
+  return client;
+}
+
+/**
+ * \brief Run the event loop until the client received the given text, for a bounded number of
+ * ticks.
+ * \returns What the client received.
+ */
+static std::string receive_until(int client, std::string_view until)
+{
+  std::string received;
+  for (int tick = 0; tick != 100 && received.find(until) == std::string::npos; ++tick)
+  {
+    microloop::EventLoop::instance().next_tick();
+
+    char buf[1024];
+    for (ssize_t nread; (nread = ::recv(client, buf, sizeof(buf), MSG_DONTWAIT)) > 0;)
+    {
+      received.append(buf, nread);
+    }
+  }
+
+  return received;
+}
+
+TEST(StaticFiles, ServedByBasicHttpServer)
+{
+  DocumentRoot root;
+  root.write("index.html", "<h1>home</h1>");
+
+  StaticFiles files{root.path()};
+
+  BasicHttpServer server{0};
+  server.serve_files("/*path", files);
+
+  auto head = server.respond(HttpRequest{"GET", "/"});
+  EXPECT_EQ(head.status_code(), StatusCode::OK);
+  EXPECT_EQ(head.header("Content-Length"), "13");
+  EXPECT_EQ(server.respond(HttpRequest{"POST", "/"}).status_code(),
+      StatusCode::METHOD_NOT_ALLOWED);
+
+  /*
+   * The body is sent from the file, after the head.
+   */
+  auto client =
+      send_request(server, "GET /index.html HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n");
+  auto received = receive_until(client, "<h1>home</h1>");
+
+  EXPECT_EQ(received.rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+  EXPECT_NE(received.find("Content-Length: 13\r\n"), std::string::npos);
+  EXPECT_EQ(received.substr(received.size() - 17), "\r\n\r\n<h1>home</h1>");
+
+  ::close(client);
+}
+
+TEST(StaticFiles, SlowClientsDoNotStallBasicHttpServer)
+{
+  DocumentRoot root;
+  root.write("index.html", "<h1>home</h1>");
+  root.write("large.bin", std::string(16 * 1024 * 1024, 'x'));
+
+  StaticFiles files{root.path()};
+
+  BasicHttpServer server{0};
+  server.serve_files("/*path", files);
+
+  /*
+   * One client does not read the large file it asked for, and another one resets its connection in
+   * the middle of it.
+   */
+  std::string large_request = "GET /large.bin HTTP/1.1\r\nHost: a\r\n\r\n";
+  auto slow = send_request(server, large_request);
+  auto reset = send_request(server, large_request);
+  EXPECT_EQ(receive_until(reset, "\r\n\r\nx").rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+
+  linger abort{1, 0};
+  ASSERT_EQ(::setsockopt(reset, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort)), 0);
+  ::close(reset);
+
+  auto client =
+      send_request(server, "GET /index.html HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n");
+  auto received = receive_until(client, "<h1>home</h1>");
+  EXPECT_EQ(received.rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+  EXPECT_EQ(received.substr(received.size() - 13), "<h1>home</h1>");
+
+  for (int tick = 0; tick != 100 && server.connections_count() != 1; ++tick)
+  {
+    microloop::EventLoop::instance().next_tick();
+  }
+
+  EXPECT_EQ(server.connections_count(), 1u);
+
+  ::close(slow);
+  ::close(client);
+}
+
+}  // namespace microhttp::http
@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/tokenizer.h"
+
+#include "gtest/gtest.h"
+#include <cctype>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace microhttp::http::tokenizer
+{
+
+class TokenizerTest : public testing::TestWithParam<Kernel>
+{
+protected:
+  void SetUp() override
+  {
+    previous_ = get_kernel();
+    ASSERT_TRUE(set_kernel(GetParam()));
+  }
+
+  void TearDown() override
+  {
+    set_kernel(previous_);
+  }
+
+private:
+  Kernel previous_ = Kernel::SCALAR;
+};
+
+TEST(CharClass, Token)
+{
+  for (std::uint32_t c = 0; c != 256; ++c)
+  {
+    auto ch = static_cast<char>(c);
+    auto is_symbol = std::string_view{"!#$%&'*+-.^_`|~"}.find(ch) != std::string_view::npos;
+    bool expected = c < 0x80 && (std::isalnum(c) || is_symbol);
+
+    EXPECT_EQ(TOKEN.contains(ch), expected) << c;
+  }
+}
+
+TEST(CharClass, FieldValueDelimiters)
+{
+  for (std::uint32_t c = 0; c != 256; ++c)
+  {
+    bool expected = (c < 0x20 && c != '\t') || c == 0x7f;
+
+    EXPECT_EQ(FIELD_VALUE_DELIMITERS.contains(static_cast<char>(c)), expected) << c;
+  }
+}
+
+TEST_P(TokenizerTest, ScanMatchesScalarAtEveryPosition)
+{
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<int> byte{0, 255};
+
+  for (auto length : {0, 1, 15, 16, 17, 31, 32, 33, 64, 100})
+  {
+    for (int stop = 0; stop <= length; ++stop)
+    {
+      /*
+       * A run of token characters, then any byte: the scans must stop exactly there.
+       */
+      std::string str(length, 'a');
+      if (stop != length)
+      {
+        str[stop] = static_cast<char>(byte(rng));
+      }
+
+      std::size_t expected_token = 0;
+      while (expected_token != str.size() && TOKEN.contains(str[expected_token]))
+      {
+        ++expected_token;
+      }
+
+      std::size_t expected_value = 0;
+      while (expected_value != str.size() && !FIELD_VALUE_DELIMITERS.contains(str[expected_value]))
+      {
+        ++expected_value;
+      }
+
+      EXPECT_EQ(token_length(str), expected_token);
+      EXPECT_EQ(field_value_length(str), expected_value);
+    }
+  }
+}
+
+TEST_P(TokenizerTest, FieldValueAcceptsObsText)
+{
+  std::string value = "caf\xc3\xa9 \t visible text which is longer than one block\r\n";
+
+  EXPECT_EQ(field_value_length(value), value.size() - 2);
+}
+
+TEST_P(TokenizerTest, FindCrlf)
+{
+  std::string str(70, 'x');
+
+  EXPECT_EQ(find_crlf(str), std::string_view::npos);
+
+  str[20] = '\r';
+  str[40] = '\r';
+  str[41] = '\n';
+  str[69] = '\r';
+
+  EXPECT_EQ(find_crlf(str), 40u);
+  EXPECT_EQ(find_crlf(str, 41), std::string_view::npos);
+  EXPECT_EQ(find_crlf("\r\n"), 0u);
+  EXPECT_EQ(find_crlf("\r\r\n"), 1u);
+  EXPECT_EQ(find_crlf(""), std::string_view::npos);
+}
+
+/**
+ * \brief Only the kernels supported by the CPU running the tests can be checked.
+ */
+std::vector<Kernel> supported_kernels()
+{
+  std::vector<Kernel> kernels;
+  for (auto kernel : {Kernel::SCALAR, Kernel::SSE42, Kernel::AVX2})
+  {
+    if (is_supported(kernel))
+    {
+      kernels.push_back(kernel);
+    }
+  }
+
+  return kernels;
+}
+
+INSTANTIATE_TEST_CASE_P(Http, TokenizerTest, testing::ValuesIn(supported_kernels()));
+
+}  // namespace microhttp::http::tokenizer
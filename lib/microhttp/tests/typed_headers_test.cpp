@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/http_request.h"
+#include "microhttp/typed_headers.h"
+#include "microhttp/version.h"
+
+#include "gtest/gtest.h"
+
+namespace microhttp::http
+{
+
+TEST(TypedHeaders, ContentLength)
+{
+  TypedHeaders headers;
+
+  EXPECT_TRUE(headers.add(HeaderId::CONTENT_LENGTH, "18446744073709551615"));
+  EXPECT_EQ(headers.content_length, 18446744073709551615u);
+  EXPECT_FALSE(headers.add(HeaderId::CONTENT_LENGTH, "1"));
+
+  headers.reset(HeaderId::CONTENT_LENGTH);
+  EXPECT_FALSE(headers.content_length);
+
+  EXPECT_FALSE(headers.add(HeaderId::CONTENT_LENGTH, ""));
+  EXPECT_FALSE(headers.add(HeaderId::CONTENT_LENGTH, "+1"));
+  EXPECT_FALSE(headers.add(HeaderId::CONTENT_LENGTH, "1 "));
+  EXPECT_FALSE(headers.add(HeaderId::CONTENT_LENGTH, "0x10"));
+  EXPECT_FALSE(headers.add(HeaderId::CONTENT_LENGTH, "18446744073709551616"));
+  EXPECT_FALSE(headers.content_length);
+}
+
+TEST(TypedHeaders, Connection)
+{
+  TypedHeaders headers;
+
+  EXPECT_TRUE(headers.add(HeaderId::CONNECTION, "Keep-Alive, Upgrade"));
+  EXPECT_EQ(headers.connection, TypedHeaders::Connection::KEEP_ALIVE);
+
+  EXPECT_TRUE(headers.add(HeaderId::CONNECTION, ", close ,"));
+  EXPECT_EQ(headers.connection, TypedHeaders::Connection::CLOSE);
+
+  EXPECT_TRUE(headers.add(HeaderId::CONNECTION, "keep-alive"));
+  EXPECT_EQ(headers.connection, TypedHeaders::Connection::CLOSE);
+
+  EXPECT_FALSE(headers.add(HeaderId::CONNECTION, "a b"));
+}
+
+TEST(TypedHeaders, TransferEncoding)
+{
+  TypedHeaders headers;
+
+  EXPECT_TRUE(headers.add(HeaderId::TRANSFER_ENCODING, "gzip"));
+  EXPECT_EQ(headers.transfer_coding, TypedHeaders::TransferCoding::UNSUPPORTED);
+
+  EXPECT_TRUE(headers.add(HeaderId::TRANSFER_ENCODING, "Chunked ; ext=1"));
+  EXPECT_EQ(headers.transfer_coding, TypedHeaders::TransferCoding::CHUNKED);
+
+  EXPECT_FALSE(headers.add(HeaderId::TRANSFER_ENCODING, "chunked"));
+
+  headers.reset(HeaderId::TRANSFER_ENCODING);
+  EXPECT_FALSE(headers.add(HeaderId::TRANSFER_ENCODING, " , "));
+  EXPECT_FALSE(headers.add(HeaderId::TRANSFER_ENCODING, ";x=1"));
+}
+
+TEST(TypedHeaders, ExpectAndHost)
+{
+  TypedHeaders headers;
+
+  EXPECT_TRUE(headers.add(HeaderId::EXPECT, "100-Continue"));
+  EXPECT_EQ(headers.expectation, TypedHeaders::Expectation::CONTINUE);
+  EXPECT_TRUE(headers.add(HeaderId::EXPECT, "something-else"));
+  EXPECT_EQ(headers.expectation, TypedHeaders::Expectation::UNSUPPORTED);
+
+  EXPECT_TRUE(headers.add(HeaderId::HOST, "example.com"));
+  EXPECT_TRUE(headers.has_host);
+  EXPECT_FALSE(headers.add(HeaderId::HOST, "example.com"));
+}
+
+TEST(TypedHeaders, UntypedHeadersAreIgnored)
+{
+  TypedHeaders headers;
+
+  EXPECT_TRUE(headers.add(HeaderId::ACCEPT, "*/*"));
+  EXPECT_TRUE(headers.add(HeaderId::UNKNOWN, ""));
+  EXPECT_FALSE(TypedHeaders::is_typed(HeaderId::ACCEPT));
+  EXPECT_TRUE(TypedHeaders::is_typed(HeaderId::HOST));
+}
+
+TEST(TypedHeaders, SetHeaderUpdatesTheRequest)
+{
+  HttpRequest req;
+  req.set_http_version(Version{1, 0});
+
+  EXPECT_FALSE(req.keep_alive());
+
+  req.set_header("Connection", "keep-alive");
+  EXPECT_TRUE(req.keep_alive());
+
+  req.set_header("Content-Length", "12");
+  req.set_header("Content-Length", "13");
+  EXPECT_EQ(req.get_content_length(), 13u);
+
+  req.set_header("Content-Length", "x");
+  EXPECT_FALSE(req.get_content_length());
+  EXPECT_EQ(req.find_header("content-length"), "x");
+
+  req.remove_header("connection");
+  EXPECT_FALSE(req.keep_alive());
+}
+
+}  // namespace microhttp::http
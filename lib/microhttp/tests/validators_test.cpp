@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/validators.h"
+
+#include "gtest/gtest.h"
+#include <string>
+
+namespace microhttp::http
+{
+
+static HttpRequest conditional(std::string_view name, std::string value, std::string method = "GET")
+{
+  HttpRequest request{method, "/"};
+  request.set_header(name, std::move(value));
+
+  return request;
+}
+
+TEST(Validators, FromStat)
+{
+  struct stat st
+  {};
+  st.st_ino = 0x1234;
+  st.st_size = 0x100;
+  st.st_mtim.tv_sec = 784111777;
+  st.st_mtim.tv_nsec = 5;
+
+  auto validators = Validators::from_stat(st);
+  EXPECT_EQ(validators.etag(), "\"1234-ae1b981bc490a05-100\"");
+  EXPECT_EQ(validators.last_modified(), 784111777);
+
+  HttpResponse response;
+  validators.apply(response);
+  EXPECT_EQ(response.header("ETag"), "\"1234-ae1b981bc490a05-100\"");
+  EXPECT_EQ(response.header("Last-Modified"), "Sun, 06 Nov 1994 08:49:37 GMT");
+
+  st.st_mtim.tv_nsec = 6;
+  EXPECT_NE(Validators::from_stat(st).etag(), validators.etag());
+}
+
+TEST(Validators, FromContent)
+{
+  auto validators = Validators::from_content("hello");
+
+  EXPECT_EQ(validators.etag(), "\"a430d84680aabd0b\"");
+  EXPECT_EQ(validators.last_modified(), std::nullopt);
+  EXPECT_NE(Validators::from_content("hellp").etag(), validators.etag());
+
+  HttpResponse response;
+  validators.apply(response);
+  EXPECT_EQ(response.header("Last-Modified"), std::nullopt);
+}
+
+TEST(Validators, IfNoneMatch)
+{
+  auto validators = Validators::from_content("hello", 784111777);
+  std::string etag{validators.etag()};
+
+  EXPECT_FALSE(validators.not_modified(HttpRequest{"GET", "/"}));
+  EXPECT_TRUE(validators.not_modified(conditional("If-None-Match", etag)));
+  EXPECT_TRUE(validators.not_modified(conditional("If-None-Match", "W/" + etag)));
+  EXPECT_TRUE(validators.not_modified(conditional("If-None-Match", "\"other\", " + etag)));
+  EXPECT_TRUE(validators.not_modified(conditional("If-None-Match", "*")));
+  EXPECT_TRUE(validators.not_modified(conditional("If-None-Match", etag, "HEAD")));
+
+  EXPECT_FALSE(validators.not_modified(conditional("If-None-Match", "\"other\"")));
+  EXPECT_FALSE(validators.not_modified(conditional("If-None-Match", etag, "POST")));
+
+  /*
+   * If-Modified-Since is ignored when If-None-Match is present.
+   */
+  auto request = conditional("If-None-Match", "\"other\"");
+  request.set_header("If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT");
+  EXPECT_FALSE(validators.not_modified(request));
+}
+
+TEST(Validators, IfModifiedSince)
+{
+  auto validators = Validators::from_content("hello", 784111777);
+
+  EXPECT_TRUE(
+      validators.not_modified(conditional("If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT")));
+  EXPECT_TRUE(
+      validators.not_modified(conditional("If-Modified-Since", "Sun Nov  6 08:49:38 1994")));
+  EXPECT_FALSE(
+      validators.not_modified(conditional("If-Modified-Since", "Sun, 06 Nov 1994 08:49:36 GMT")));
+  EXPECT_FALSE(validators.not_modified(conditional("If-Modified-Since", "yesterday")));
+
+  EXPECT_FALSE(Validators::from_content("hello").not_modified(
+      conditional("If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT")));
+}
+
+TEST(Validators, IfRange)
+{
+  auto validators = Validators::from_content("hello", 784111777);
+  std::string etag{validators.etag()};
+
+  EXPECT_TRUE(validators.range_applies(HttpRequest{"GET", "/"}));
+  EXPECT_TRUE(validators.range_applies(conditional("If-Range", etag)));
+  EXPECT_TRUE(validators.range_applies(conditional("If-Range", "Sun, 06 Nov 1994 08:49:37 GMT")));
+
+  EXPECT_FALSE(validators.range_applies(conditional("If-Range", "W/" + etag)));
+  EXPECT_FALSE(validators.range_applies(conditional("If-Range", "\"other\"")));
+  EXPECT_FALSE(validators.range_applies(conditional("If-Range", "Sun, 06 Nov 1994 08:49:38 GMT")));
+}
+
+TEST(Validators, NotModifiedResponse)
+{
+  auto validators = Validators::from_content("hello", 784111777);
+
+  EXPECT_EQ(validators.not_modified_response().format<std::string>(),
+      "HTTP/1.1 304 Not Modified\r\nETag: " + std::string{validators.etag()} + "\r\n\r\n");
+}
+
+}  // namespace microhttp::http
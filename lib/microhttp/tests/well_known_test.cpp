@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microhttp/well_known.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+namespace microhttp::http
+{
+
+TEST(WellKnown, MethodsRoundTrip)
+{
+  for (std::size_t i = 0; i != METHODS_COUNT; ++i)
+  {
+    auto method = static_cast<Method>(i);
+    std::string name{method_name(method)};
+    ASSERT_FALSE(name.empty());
+
+    EXPECT_EQ(method_from_string(name), method);
+
+    std::transform(name.begin(), name.end(), name.begin(), [](auto c) { return std::toupper(c); });
+    EXPECT_EQ(method_from_string(name), method);
+  }
+
+  EXPECT_EQ(method_name(Method::UNKNOWN), "");
+}
+
+TEST(WellKnown, UnknownMethods)
+{
+  EXPECT_EQ(method_from_string(""), Method::UNKNOWN);
+  EXPECT_EQ(method_from_string("GE"), Method::UNKNOWN);
+  EXPECT_EQ(method_from_string("GETS"), Method::UNKNOWN);
+  EXPECT_EQ(method_from_string("PROPFIND"), Method::UNKNOWN);
+  EXPECT_EQ(method_from_string("G\x05T"), Method::UNKNOWN);
+}
+
+TEST(WellKnown, HeaderIdsRoundTrip)
+{
+  for (std::size_t i = 0; i != HEADER_IDS_COUNT; ++i)
+  {
+    auto id = static_cast<HeaderId>(i);
+    std::string name{header_name(id)};
+    ASSERT_FALSE(name.empty());
+
+    EXPECT_EQ(header_id(name), id) << name;
+
+    std::transform(name.begin(), name.end(), name.begin(), [](auto c) { return std::toupper(c); });
+    EXPECT_EQ(header_id(name), id) << name;
+  }
+
+  EXPECT_EQ(header_id("Content-Length"), HeaderId::CONTENT_LENGTH);
+  EXPECT_EQ(header_name(HeaderId::HOST), "host");
+  EXPECT_EQ(header_name(HeaderId::UNKNOWN), "");
+}
+
+TEST(WellKnown, UnknownHeaderNames)
+{
+  EXPECT_EQ(header_id(""), HeaderId::UNKNOWN);
+  EXPECT_EQ(header_id("hos"), HeaderId::UNKNOWN);
+  EXPECT_EQ(header_id("hosts"), HeaderId::UNKNOWN);
+  EXPECT_EQ(header_id("content_length"), HeaderId::UNKNOWN);
+  EXPECT_EQ(header_id("X-Custom-Header"), HeaderId::UNKNOWN);
+  EXPECT_EQ(header_id(std::string(1000, 'a')), HeaderId::UNKNOWN);
+}
+
+}  // namespace microhttp::http
@@ -139,6 +139,12 @@ public:
    */
   Buffer &concat(const Buffer &other, std::size_t count = -1);
 
+  /**
+   * \brief Append a range of bytes to the end of this buffer. Unlike the C string constructor,
+   * this does not stop at NUL bytes.
+   */
+  Buffer &append(std::string_view bytes);
+
   /**
    * \brief Concatenate another buffer to the end of this one.
    */
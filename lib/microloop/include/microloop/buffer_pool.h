@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace microloop
+{
+
+/**
+ * \brief A pool of fixed-size memory blocks.
+ *
+ * Blocks are carved out of larger slabs which are never returned to the system while the pool is
+ * alive, so that acquiring and releasing a block in steady state does not touch the allocator. The
+ * pool is not thread-safe; it is meant to be owned by an event source running on the loop thread.
+ */
+class BufferPool
+{
+public:
+  static constexpr std::size_t DEFAULT_BLOCKS_PER_SLAB = 64;
+
+  /**
+   * \brief Create a buffer pool.
+   * \param block_size The size in bytes of every block handed out by this pool.
+   * \param blocks_per_slab How many blocks to allocate at once when the pool runs out of blocks.
+   * \param numa_node The NUMA node to allocate the slabs on, usually the node of the thread owning
+   * the pool. When not given, the pages come from the node of the thread first touching them.
+   */
+  BufferPool(std::size_t block_size, std::size_t blocks_per_slab = DEFAULT_BLOCKS_PER_SLAB,
+      std::optional<std::uint32_t> numa_node = std::nullopt);
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  /**
+   * \brief Get a block of \p block_size() bytes. The contents of the block are unspecified.
+   */
+  char *acquire();
+
+  /**
+   * \brief Return a block to the pool. The block must have been acquired from this pool.
+   */
+  void release(char *block) noexcept;
+
+  /**
+   * \brief Get the size of the blocks handed out by this pool.
+   */
+  std::size_t block_size() const noexcept
+  {
+    return block_size_;
+  }
+
+  /**
+   * \brief Get how many blocks can be acquired before a new slab is allocated.
+   */
+  std::size_t available() const noexcept
+  {
+    return free_blocks_.size();
+  }
+
+  /**
+   * \brief Get how many blocks have been allocated by this pool in total.
+   */
+  std::size_t capacity() const noexcept
+  {
+    return slabs_.size() * blocks_per_slab_;
+  }
+
+private:
+  /**
+   * \brief Frees a slab, which is either mapped directly when bound to a NUMA node or allocated on
+   * the heap.
+   */
+  struct SlabDeleter
+  {
+    std::size_t mapped_size = 0;
+
+    void operator()(char *slab) const noexcept;
+  };
+
+  using Slab = std::unique_ptr<char[], SlabDeleter>;
+
+  /**
+   * \brief Allocate a new slab and add its blocks to the free list.
+   */
+  void grow();
+
+  std::size_t block_size_;
+  std::size_t blocks_per_slab_;
+  std::optional<std::uint32_t> numa_node_;
+  std::vector<Slab> slabs_;
+  std::vector<char *> free_blocks_;
+};
+
+}  // namespace microloop
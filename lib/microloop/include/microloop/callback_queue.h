@@ -0,0 +1,64 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microloop/event_source.h"
+#include "microloop/utils/unique_function.h"
+
+#include <mutex>
+#include <vector>
+
+namespace microloop
+{
+
+/**
+ * \brief Callbacks posted to the event loop from other threads.
+ *
+ * Posting a callback queues it and, if the queue was empty, signals an eventfd watched by the event
+ * loop, which then runs all the queued callbacks on the loop thread.
+ */
+class CallbackQueue : public EventSource
+{
+public:
+  using Callback = utils::UniqueFunction<void()>;
+
+  CallbackQueue();
+
+  ~CallbackQueue();
+
+  /**
+   * Queue a callback to be run on the event loop thread. Can be called from any thread.
+   */
+  void post(Callback &&callback);
+
+  void start() override
+  {}
+
+  /**
+   * Run all the callbacks queued so far.
+   */
+  void run_callback() override;
+
+  std::uint32_t produced_events() const override
+  {
+    return EPOLLIN;
+  }
+
+private:
+  /**
+   * Wake up the event loop.
+   */
+  void notify();
+
+  std::mutex mutex_;
+  std::vector<Callback> pending_;
+
+  /**
+   * The callbacks being run. Swapped with \p pending_ so that both vectors keep their capacity.
+   */
+  std::vector<Callback> running_;
+};
+
+}  // namespace microloop
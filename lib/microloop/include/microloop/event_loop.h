@@ -4,25 +4,36 @@
 
 #pragma once
 
+#include "microloop/callback_queue.h"
 #include "microloop/event_source.h"
 #include "microloop/signals_monitor.h"
+#include "microloop/utils/completion.h"
+#include "microloop/utils/cpu_topology.h"
 #include "microloop/utils/thread_pool.h"
 
+#include <array>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <optional>
+#include <type_traits>
 #include <unistd.h>
 
 namespace microloop
 {
 
-class EventLoop
+class EventLoop : public utils::Executor
 {
+  static constexpr const char *PLACEMENT_ENV_VAR = "MICRO_PLACEMENT";
+
 private:
   /**
    * Create an instance of the event loop. The thread pool is initialized with 4 threads by default.
+   * If the environment variable "MICRO_PLACEMENT" is set, the loop and the workers are placed
+   * accordingly (@see utils::Placement::from_string).
    */
   EventLoop();
 
@@ -43,6 +54,56 @@ public:
     return thread_pool;
   }
 
+  /**
+   * Run a callback on the event loop thread during one of the next ticks. This is the only member
+   * function of the event loop that can be called from any thread.
+   * @param callback The callback to be run.
+   */
+  void post(utils::UniqueFunction<void()> callback) override
+  {
+    callback_queue_->post(std::move(callback));
+  }
+
+  /**
+   * Run a job on the embedded thread pool and get its result back on the event loop thread.
+   * @see utils::ThreadPool::submit_async
+   */
+  template <class Func, class... Args,
+      class = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, utils::ThreadPool::Priority>>>
+  auto offload(Func &&fn, Args &&... args)
+  {
+    return thread_pool.submit_async(*this, std::forward<Func>(fn), std::forward<Args>(args)...);
+  }
+
+  /**
+   * Like `offload(fn, args...)`, for a job of the given priority class. Offloads a request handler
+   * waits on should use `Priority::HIGH`, so that they run ahead of background work.
+   */
+  template <class Func, class... Args>
+  auto offload(utils::ThreadPool::Priority priority, Func &&fn, Args &&... args)
+  {
+    return thread_pool.submit_async(
+        priority, *this, std::forward<Func>(fn), std::forward<Args>(args)...);
+  }
+
+  /**
+   * Pin the event loop thread and the workers of the embedded thread pool. The loop takes the first
+   * slot of the placement and the workers the following ones, so with e.g. one thread per physical
+   * core the loop does not share its core with a worker. The topology of the machine and the chosen
+   * CPUs are reported on stderr.
+   * @param placement Where to run the threads.
+   */
+  void set_placement(const utils::Placement &placement);
+
+  /**
+   * @return The NUMA node the event loop runs on, if it is confined to one. Buffers used by event
+   * sources should be allocated on this node.
+   */
+  std::optional<std::uint32_t> numa_node() const noexcept
+  {
+    return numa_node_;
+  }
+
   /**
    * Add a new event source to the event loop.
    * @param event_source The event source to be added.
@@ -55,6 +116,28 @@ public:
    */
   void remove_event_source(EventSource *event_source);
 
+  /**
+   * Stop watching the file descriptor of an event source without removing it from the event loop.
+   * Events that occur while the event source is paused are reported once it is resumed.
+   * @param event_source The event source to pause.
+   */
+  void pause_event_source(EventSource *event_source);
+
+  /**
+   * Resume watching the file descriptor of a paused event source.
+   * @param event_source The event source to resume.
+   */
+  void resume_event_source(EventSource *event_source);
+
+  /**
+   * @return How far behind the event loop is running. This is a moving average of the time spent
+   * running callbacks in each tick, which is how long a newly ready event may wait to be handled.
+   */
+  std::chrono::nanoseconds lag() const noexcept
+  {
+    return lag_;
+  }
+
   /**
    * Register a new signal handler.
    * @param sig The signal that the handler responds to. This signal will be blocked via the
@@ -76,6 +159,12 @@ public:
 
   ~EventLoop()
   {
+    /*
+     * The jobs the pool drops post their continuations to the callback queue, which must still
+     * exist at that point.
+     */
+    thread_pool.close();
+
     for (auto &[fd, event_source] : event_sources)
     {
       if (auto status = ::close(fd); status != 0)
@@ -101,7 +190,14 @@ private:
   std::int32_t epollfd;
   utils::ThreadPool thread_pool;
   std::uint64_t signals_monitor_fd_;
+  CallbackQueue *callback_queue_;
   std::map<std::uint64_t, std::unique_ptr<EventSource>> event_sources;
+  /// The events of the running tick, whose sources may be removed by earlier callbacks of the tick.
+  std::array<epoll_event, 32> tick_events_{};
+  int tick_ready_ = 0;
+  std::chrono::nanoseconds lag_{0};
+  std::optional<std::uint32_t> numa_node_;
+  pthread_t thread_;
 };
 
 }  // namespace microloop
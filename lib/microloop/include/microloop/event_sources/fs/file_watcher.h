@@ -0,0 +1,89 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microloop/event_source.h"
+
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <sys/inotify.h>
+
+namespace microloop::event_sources::fs
+{
+
+/**
+ * \brief A change to a watched file or directory, as reported by inotify.
+ */
+struct FileEvent
+{
+  /// The watch descriptor returned by \p FileWatcher::watch()
+  int wd;
+
+  /// The `IN_*` flags describing the change
+  std::uint32_t mask;
+
+  /// The name of the entry that changed in a watched directory, empty for the watched file itself
+  std::string_view name;
+};
+
+/**
+ * \brief Reports changes to files and directories with inotify.
+ *
+ * The same watch descriptor is returned for all the paths naming the same inode.
+ */
+class FileWatcher : public microloop::EventSource
+{
+public:
+  using Callback = std::function<void(const FileEvent &)>;
+
+  /**
+   * \throws microloop::KernelException if the inotify instance cannot be created.
+   */
+  FileWatcher();
+
+  ~FileWatcher() override;
+
+  void set_on_event(Callback &&on_event)
+  {
+    this->on_event = std::move(on_event);
+  }
+
+  /**
+   * \brief Start watching a file or directory, or change the events watched for it.
+   * \param mask The `IN_*` events to report.
+   * \return The watch descriptor, or -1 if the path cannot be watched.
+   */
+  int watch(const char *path, std::uint32_t mask) noexcept;
+
+  /**
+   * \brief Stop watching a file or directory. An `IN_IGNORED` event is reported for it.
+   */
+  void unwatch(int wd) noexcept;
+
+  /**
+   * \brief Read the pending events and run the callback for each of them, without blocking.
+   * \return The number of events read.
+   */
+  std::size_t dispatch();
+
+  std::uint32_t produced_events() const override
+  {
+    return EPOLLIN;
+  }
+
+  void start() override
+  {}
+
+  void run_callback() override
+  {
+    dispatch();
+  }
+
+private:
+  Callback on_event;
+};
+
+}  // namespace microloop::event_sources::fs
@@ -36,9 +36,14 @@ public:
     return EPOLLIN;
   }
 
+  /**
+   * Only a one-shot receive reads from \p start(). The others have nothing to do there, and must
+   * not be started from the thread pool, which could run \p start() after the connection was closed
+   * and the event source deleted.
+   */
   bool native_async() const override
   {
-    return false;
+    return !oneshot;
   }
 
   void start() override
@@ -71,7 +76,16 @@ private:
         return;
       }
 
-      throw microloop::KernelException(errno);
+      if (errno != ECONNRESET && errno != ETIMEDOUT)
+      {
+        throw microloop::KernelException(errno);
+      }
+
+      /*
+       * The connection is gone, which is reported like an orderly shutdown by the peer: the owner
+       * closes it, instead of the error unwinding the event loop.
+       */
+      nrecv = 0;
     }
 
     buf.resize(nrecv);
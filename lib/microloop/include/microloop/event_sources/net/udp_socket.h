@@ -0,0 +1,189 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microloop/buffer_pool.h"
+#include "microloop/event_source.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <sys/socket.h>
+#include <utility>
+#include <vector>
+
+namespace microloop::event_sources::net
+{
+
+/**
+ * \brief A datagram received on a UDP socket. The payload points into memory owned by the socket
+ * and is only valid for the duration of the receive callback.
+ */
+struct Datagram
+{
+  /// The payload of the datagram
+  std::string_view payload;
+
+  /// The address of the sender
+  const sockaddr_storage *addr;
+
+  /// The size of the sender address
+  socklen_t addrlen;
+};
+
+/**
+ * \brief A datagram to be sent from a UDP socket.
+ */
+struct OutgoingDatagram
+{
+  /// The address of the receiver
+  const sockaddr *addr;
+
+  /// The size of the receiver address
+  socklen_t addrlen;
+
+  /// The payload of the datagram
+  std::string_view payload;
+};
+
+class UdpSocket : public microloop::EventSource
+{
+public:
+  /**
+   * \brief Callback receiving all the datagrams read in one batch.
+   */
+  using Callback = std::function<void(const std::vector<Datagram> &)>;
+
+  struct Options
+  {
+    /// How many datagrams to read with a single `recvmmsg` call
+    std::uint32_t batch_size = 64;
+
+    /// How many `recvmmsg` calls to make at most every time the socket becomes readable, so that
+    /// a busy socket cannot starve the other event sources
+    std::uint32_t max_batches_per_tick = 8;
+
+    /// The largest datagram that can be received; larger ones are dropped, see \p truncated()
+    std::uint32_t max_datagram_size = 2048;
+
+    /// Let the kernel coalesce consecutive datagrams of a flow into a single receive (UDP_GRO).
+    /// This raises the receive buffer size to the largest possible UDP payload
+    bool gro = false;
+
+    /// If not zero, every payload larger than this is split by the kernel into datagrams of this
+    /// size when sent (UDP_SEGMENT)
+    std::uint16_t gso_segment_size = 0;
+
+    /// The NUMA node to allocate the receive buffers on when the socket owns its buffer pool,
+    /// usually `EventLoop::numa_node()`
+    std::optional<std::uint32_t> numa_node;
+  };
+
+  /**
+   * \brief Create a UDP socket bound to the given port on an unspecified address.
+   * \param port The port to bind to. If zero, an ephemeral port is chosen.
+   * \param options Batching and offload options.
+   * \param pool The pool the receive buffers are taken from. It must outlive this socket and have a
+   * block size of at least the receive buffer size. If null, the socket uses a pool of its own.
+   */
+  UdpSocket(std::uint16_t port, Options options, BufferPool *pool = nullptr);
+
+  explicit UdpSocket(std::uint16_t port) : UdpSocket{port, Options{}}
+  {}
+
+  ~UdpSocket() override;
+
+  void set_on_recv(Callback &&on_recv)
+  {
+    this->on_recv = std::move(on_recv);
+  }
+
+  /**
+   * \brief Get the number of datagrams dropped because they did not fit in a receive buffer.
+   */
+  std::uint64_t truncated() const noexcept
+  {
+    return truncated_count;
+  }
+
+  /**
+   * \brief Get the address this socket is bound to.
+   */
+  std::pair<sockaddr_storage, socklen_t> local_address() const;
+
+  /**
+   * \brief Send many datagrams using as few `sendmmsg` calls as possible.
+   * \return How many of the given datagrams were sent. This is less than the number of datagrams
+   * if the socket send buffer is full.
+   */
+  std::size_t send_batch(const std::vector<OutgoingDatagram> &datagrams);
+
+  /**
+   * \brief Send a large payload in a single system call, letting the kernel (or the NIC) split it
+   * into datagrams of \p segment_size bytes each (UDP_SEGMENT).
+   * \return Whether the payload was handed to the kernel.
+   */
+  bool send_segmented(const sockaddr *addr, socklen_t addrlen, std::string_view payload,
+      std::uint16_t segment_size);
+
+  std::uint32_t produced_events() const override
+  {
+    return EPOLLIN;
+  }
+
+  void start() override
+  {}
+
+  /**
+   * At this point the socket has at least one datagram queued. Datagrams are read in batches until
+   * the socket is drained or the per-tick limit is reached.
+   */
+  void run_callback() override;
+
+private:
+  /**
+   * \brief Create a non-blocking datagram socket bound to an unspecified address.
+   */
+  static std::uint32_t create_socket(std::uint16_t port);
+
+  /**
+   * \brief Enable the socket options requested in \p options.
+   */
+  void configure_offloads();
+
+  /**
+   * \brief Prepare the headers for the next `recvmmsg` call.
+   */
+  void reset_recv_headers();
+
+  /**
+   * \brief Append the datagrams in a received message to \p datagrams, splitting coalesced GRO
+   * payloads into the original datagrams. Truncated messages are dropped.
+   */
+  void collect(const mmsghdr &msg, std::size_t idx);
+
+  Options options;
+  std::size_t recv_buffer_size;
+
+  std::unique_ptr<BufferPool> own_pool;
+  BufferPool *pool;
+
+  std::vector<char *> blocks;
+  std::vector<mmsghdr> recv_headers;
+  std::vector<iovec> recv_iovecs;
+  std::vector<sockaddr_storage> recv_addrs;
+  std::vector<char> recv_control;
+
+  std::vector<mmsghdr> send_headers;
+  std::vector<iovec> send_iovecs;
+
+  std::vector<Datagram> datagrams;
+  std::uint64_t truncated_count = 0;
+  Callback on_recv;
+};
+
+}  // namespace microloop::event_sources::net
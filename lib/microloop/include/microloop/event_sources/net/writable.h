@@ -0,0 +1,49 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microloop/event_source.h"
+
+#include <cstdint>
+#include <functional>
+
+namespace microloop::event_sources::net
+{
+
+/**
+ * \brief Reports a socket that can take more data without blocking.
+ *
+ * The event loop keeps a single event source per file descriptor, so a socket that is also read
+ * from is watched for writability through a duplicate of its descriptor.
+ */
+class Writable : public microloop::EventSource, public microloop::TypeHelper<>
+{
+public:
+  Writable(std::uint32_t sock) : EventSource{sock}
+  {}
+
+  void set_on_writable(Callback &&on_writable)
+  {
+    this->on_writable = std::move(on_writable);
+  }
+
+  std::uint32_t produced_events() const override
+  {
+    return EPOLLOUT;
+  }
+
+  void start() override
+  {}
+
+  void run_callback() override
+  {
+    on_writable();
+  }
+
+private:
+  Callback on_writable;
+};
+
+}  // namespace microloop::event_sources::net
@@ -106,7 +106,7 @@ public:
       value{value},
       type{type},
       callback{callback},
-      controller{this, microloop::EventLoop::get_main()}
+      controller{this, event_loop}
   {
     static_assert(std::is_invocable_v<Callback, TimerController &>);
 
@@ -198,6 +198,8 @@ protected:
     case TimerType::INTERVAL:
       return EPOLLIN;
     }
+
+    __builtin_unreachable();
   }
 
 private:
@@ -8,13 +8,19 @@
 #include "microloop/event_sources/net/await_connections.h"
 #include "microloop/event_sources/net/receive.h"
 
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
 #include <functional>
 #include <map>
+#include <memory>
+#include <optional>
 #include <signal.h>
 #include <string>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
 
 namespace microloop::net
 {
@@ -25,6 +31,11 @@ public:
   class PeerConnection
   {
   public:
+    /// How many bytes may wait in the output queue before the connection stops being writable
+    static constexpr std::size_t DEFAULT_HIGH_WATER_MARK = 64 * 1024;
+
+    using DrainHandler = std::function<void(PeerConnection &)>;
+
     PeerConnection(TcpServer *server, sockaddr_storage addr, socklen_t addrlen, std::uint32_t fd) :
         server_{server}, addr_{addr}, addrlen_{addrlen}, fd_{fd}
     {}
@@ -44,6 +55,22 @@ public:
      */
     bool send(const microloop::Buffer &);
 
+    /**
+     * \brief Send several buffers to the peer socket of this connection, in order, with as few
+     * system calls as possible. This is how the responses to pipelined requests are sent.
+     * \return Whether all the buffers were sent.
+     */
+    bool send(const std::vector<microloop::Buffer> &bufs);
+
+    /**
+     * \brief Send several byte ranges to the peer socket of this connection, in order, gathering
+     * them from wherever they are instead of copying them into a single buffer.
+     * \param more Whether more data follows right away, e.g. a file sent with \p send_file(). The
+     * kernel then holds back a partial segment instead of sending it on its own.
+     * \return Whether all the bytes were sent.
+     */
+    bool send(std::vector<iovec> iov, bool more = false);
+
     /**
      * Send the file identified by \p path parameter to the peer socket of this connection.
      * \param path The path in a reachable file system for the file to be sent.
@@ -51,6 +78,97 @@ public:
      */
     bool send_file(const std::filesystem::path &path);
 
+    /**
+     * \brief Send a range of an open file to the peer socket of this connection, straight from the
+     * page cache, without copying it through user space.
+     * \param file_fd The file to send from. Its file offset is not changed.
+     * \param offset Where the range starts in the file.
+     * \param count The number of bytes to send.
+     * \return Whether the whole range was sent.
+     */
+    bool send_file(int file_fd, off_t offset, std::size_t count);
+
+    /**
+     * \brief Queue a buffer to be sent to the peer socket without blocking.
+     *
+     * As much as the socket takes right away is sent immediately. The rest waits in the output
+     * queue, in order, and is sent by the event loop as the socket becomes writable. The blocking
+     * \p send() functions must not be used while output is queued.
+     *
+     * \return Whether the connection is still writable. Once it returns `false`, the producer
+     * should stop writing until the drain handler runs, so that memory use stays bounded.
+     */
+    bool write(microloop::Buffer buf);
+
+    /**
+     * \brief Queue several byte ranges to be sent without blocking, gathering them from wherever
+     * they are. What the socket does not take right away is copied into the output queue, so the
+     * ranges need not outlive the call.
+     * \param more Whether more data follows right away, as for \p send().
+     * \return Whether the connection is still writable, as for \p write(microloop::Buffer).
+     */
+    bool write(std::vector<iovec> iov, bool more = false);
+
+    /**
+     * \brief Queue a range of an open file to be sent without blocking, straight from the page
+     * cache. It is sent with `sendfile` as the socket takes more, after what is queued before it.
+     * \param file Keeps the file open until the range is sent. May be null if the caller keeps it
+     * open otherwise.
+     * \param file_fd The file to send from. Its file offset is not changed.
+     * \param offset Where the range starts in the file.
+     * \param count The number of bytes to send. A file shorter than the range fails the output.
+     * \return Whether the connection is still writable, as for \p write(microloop::Buffer). The
+     * range counts as queued until it is sent.
+     */
+    bool write_file(
+        std::shared_ptr<const void> file, int file_fd, off_t offset, std::size_t count);
+
+    /**
+     * \brief Whether the output queue is below the high-water mark and no send failed so far.
+     */
+    bool writable() const noexcept
+    {
+      return !output_failed_ && queued_bytes_ < high_water_mark_;
+    }
+
+    /**
+     * \brief Get the number of bytes waiting in the output queue.
+     */
+    std::size_t queued_bytes() const noexcept
+    {
+      return queued_bytes_;
+    }
+
+    /**
+     * \brief Set how many bytes may wait in the output queue before \p writable() reports `false`.
+     */
+    void set_high_water_mark(std::size_t bytes) noexcept
+    {
+      high_water_mark_ = bytes;
+    }
+
+    /**
+     * \brief Set the function called every time the output queue has been sent entirely after the
+     * socket was not able to take all of it right away, or could not be sent at all because the
+     * peer went away. In the latter case \p writable() stays `false`.
+     */
+    void set_drain_handler(DrainHandler on_drain)
+    {
+      on_drain_ = std::move(on_drain);
+    }
+
+    /**
+     * \brief Stop reading from the peer socket, e.g. while a slow consumer catches up. The data
+     * sent by the peer waits in the socket receive buffer, and once it is full TCP flow control
+     * stops the peer.
+     */
+    void pause_reading();
+
+    /**
+     * \brief Resume reading from the peer socket after \p pause_reading().
+     */
+    void resume_reading();
+
     /**
      * \brief Get a string representation of this peer connection. The representation will contain
      * a pretty representation of the socket address.
@@ -77,11 +195,86 @@ public:
      */
     void close();
 
+    /**
+     * \brief A part of the output queue: either bytes, or a range of an open file.
+     */
+    struct Output
+    {
+      microloop::Buffer buf;
+
+      /// The file the range is read from, or -1 for bytes
+      int file_fd = -1;
+      off_t file_offset = 0;
+      std::size_t file_count = 0;
+
+      /// Keeps the file open until its range is sent
+      std::shared_ptr<const void> file;
+
+      bool is_file() const noexcept
+      {
+        return file_fd != -1;
+      }
+
+      std::size_t size() const noexcept
+      {
+        return is_file() ? file_count : buf.size();
+      }
+    };
+
+    /**
+     * \brief Add a part to the output queue, and send it right away unless the socket is known to
+     * be full.
+     */
+    bool enqueue(Output output);
+
+    /**
+     * \brief Send as much of the output queue as the socket takes without blocking, and watch the
+     * socket for writability while anything is left.
+     */
+    void flush();
+
+    /**
+     * \brief Send the bytes at the front of the output queue, up to the first file range, without
+     * blocking.
+     * \return What `sendmsg` returns.
+     */
+    ssize_t flush_bytes();
+
+    /**
+     * \brief Send the file range at the front of the output queue, without blocking.
+     * \return What `sendfile` returns.
+     */
+    ssize_t flush_file();
+
+    /**
+     * \brief Drop the output queue once a send failed. Nothing is sent anymore.
+     */
+    void fail_output() noexcept;
+
+    /**
+     * \brief Start or stop watching the socket for writability.
+     */
+    void watch_writable(bool watch);
+
   private:
     friend class TcpServer;
 
     TcpServer *server_;
     microloop::EventSource *event_source_ = nullptr;
+    bool reading_paused_ = false;
+
+    /// The parts waiting to be sent, and how much of the first one was sent already
+    std::deque<Output> output_;
+    std::size_t output_offset_ = 0;
+    std::size_t queued_bytes_ = 0;
+    std::size_t high_water_mark_ = DEFAULT_HIGH_WATER_MARK;
+    bool output_failed_ = false;
+    DrainHandler on_drain_;
+
+    /// Watches a duplicate of the socket descriptor for writability, once output had to be queued
+    microloop::EventSource *writable_source_ = nullptr;
+    std::int32_t writable_fd_ = -1;
+    bool watching_writable_ = false;
     sockaddr_storage addr_;
     socklen_t addrlen_;
     std::uint32_t fd_;
@@ -90,9 +283,53 @@ public:
   using ConnectionHandler = std::function<void(PeerConnection &)>;
   using DataHandler = std::function<void(PeerConnection &, const microloop::Buffer &)>;
 
+  /**
+   * \brief Limits applied to incoming connections so that an overloaded server keeps serving the
+   * connections it already has instead of slowing down for everyone.
+   */
+  struct AdmissionPolicy
+  {
+    /// The maximum number of concurrent connections. Zero means unlimited.
+    std::size_t max_connections = 0;
+
+    /// Stop accepting connections while the event loop lag is above this value. Zero disables
+    /// the check.
+    std::chrono::microseconds max_loop_lag{0};
+
+    /// How often to check whether a paused listener can be resumed.
+    std::chrono::milliseconds resume_check_interval{10};
+
+    /// If set, excess connections are accepted, sent this response and closed immediately instead
+    /// of being left in the kernel backlog while the listener is paused.
+    std::optional<microloop::Buffer> reject_response;
+  };
+
+  /**
+   * \brief Counters describing the work shed by the admission policy.
+   */
+  struct AdmissionStats
+  {
+    /// How many connections were accepted and closed right away because the server was overloaded
+    std::uint64_t rejected_connections = 0;
+
+    /// How many times the listener stopped accepting connections
+    std::uint64_t listener_pauses = 0;
+
+    /// Whether the listener is currently paused
+    bool listener_paused = false;
+  };
+
 public:
   TcpServer(std::uint16_t port);
 
+  TcpServer(const TcpServer &) = delete;
+
+  /**
+   * \brief Stop listening and cancel the pending admission check, whose callback refers to this
+   * server. The open connections are closed.
+   */
+  ~TcpServer();
+
   template <class Func, class... Args>
   void set_connection_callback(Func &&func, Args &&... args)
   {
@@ -119,6 +356,27 @@ public:
    */
   void close_conn(PeerConnection &conn);
 
+  /**
+   * \brief Set the limits applied to incoming connections.
+   */
+  void set_admission_policy(AdmissionPolicy policy);
+
+  /**
+   * \brief Get the counters of the work shed so far by the admission policy.
+   */
+  const AdmissionStats &admission_stats() const noexcept
+  {
+    return admission_stats_;
+  }
+
+  /**
+   * \brief Get the number of currently open connections.
+   */
+  std::size_t connections_count() const noexcept
+  {
+    return peer_connections.size();
+  }
+
   /**
    * \brief Get the file descriptor of the TCP server.
    *
@@ -147,10 +405,33 @@ private:
    */
   void handle_connection(std::uint32_t fd, sockaddr_storage addr, socklen_t addrlen);
 
+  /**
+   * \brief Whether accepting another connection would exceed the admission policy.
+   */
+  bool overloaded() const noexcept;
+
+  /**
+   * \brief Pause or resume the listener according to the current load.
+   */
+  void update_admission();
+
+  /**
+   * \brief Send the pre-serialized rejection response to a freshly accepted connection and close
+   * it, without blocking.
+   */
+  void reject(std::uint32_t fd);
+
 private:
   std::uint16_t port;
   std::uint32_t fd_;
 
+  microloop::EventSource *listener_ = nullptr;
+  AdmissionPolicy admission_policy_;
+  AdmissionStats admission_stats_;
+
+  /// The one-shot timer checking whether the paused listener can be resumed, while it is pending
+  microloop::EventSource *resume_check_ = nullptr;
+
   std::map<std::uint32_t, PeerConnection> peer_connections;
 
   ConnectionHandler on_conn;
@@ -0,0 +1,246 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include "microloop/utils/unique_function.h"
+
+#include <atomic>
+#include <exception>
+#include <future>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace microloop::utils
+{
+
+/**
+ * \brief Something that can run callbacks posted from any thread, e.g. an event loop.
+ */
+class Executor
+{
+public:
+  /**
+   * \brief Schedule a callback to be run by this executor. Must be thread-safe.
+   */
+  virtual void post(UniqueFunction<void()> callback) = 0;
+
+protected:
+  ~Executor() = default;
+};
+
+namespace detail
+{
+
+/**
+ * \brief The state shared between a job running on a thread pool and the handle to its completion.
+ *
+ * The job and the handle race to reach the state first: whichever of them comes second (the job
+ * finishing or the continuation being attached) posts the continuation to the executor. There is no
+ * lock involved, just one atomic exchange on each side.
+ */
+template <class T>
+class CompletionState : public std::enable_shared_from_this<CompletionState<T>>
+{
+  enum Stage : int
+  {
+    PENDING,
+    CONTINUATION_SET,
+    DONE,
+  };
+
+  /**
+   * What to store as the result of jobs returning nothing.
+   */
+  using Stored = std::conditional_t<std::is_void_v<T>, char, T>;
+
+public:
+  using Continuation = UniqueFunction<void(CompletionState &)>;
+
+  explicit CompletionState(Executor &resume_on) : resume_on_{resume_on}
+  {}
+
+  /**
+   * \brief Run the job and store its result or the exception it threw. Called on the worker.
+   */
+  template <class Func>
+  void complete(Func &fn) noexcept
+  {
+    try
+    {
+      if constexpr (std::is_void_v<T>)
+      {
+        fn();
+      }
+      else
+      {
+        value_.emplace(fn());
+      }
+    }
+    catch (...)
+    {
+      error_ = std::current_exception();
+    }
+
+    if (stage_.exchange(DONE, std::memory_order_acq_rel) == CONTINUATION_SET)
+    {
+      resume();
+    }
+  }
+
+  /**
+   * \brief Complete the state of a job that will never run, e.g. because the thread pool was closed
+   * before it got to it, with a `std::future_error` (broken promise).
+   */
+  void abandon() noexcept
+  {
+    auto broken = []() -> T { throw std::future_error{std::future_errc::broken_promise}; };
+    complete(broken);
+  }
+
+  /**
+   * \brief Attach the continuation. Called at most once, on any thread.
+   */
+  void set_continuation(Continuation &&continuation)
+  {
+    continuation_ = std::move(continuation);
+
+    if (stage_.exchange(CONTINUATION_SET, std::memory_order_acq_rel) == DONE)
+    {
+      resume();
+    }
+  }
+
+  bool ready() const noexcept
+  {
+    return stage_.load(std::memory_order_acquire) == DONE;
+  }
+
+  std::exception_ptr error() const noexcept
+  {
+    return error_;
+  }
+
+  std::optional<Stored> &value() noexcept
+  {
+    return value_;
+  }
+
+private:
+  void resume()
+  {
+    resume_on_.post([self = this->shared_from_this()] { self->continuation_(*self); });
+  }
+
+  Executor &resume_on_;
+  std::atomic<int> stage_{PENDING};
+  std::optional<Stored> value_;
+  std::exception_ptr error_;
+  Continuation continuation_;
+};
+
+/**
+ * \brief The reference a queued job holds to its completion state.
+ *
+ * A job is not always run: the thread pool drops the jobs still queued when it is closed. If the
+ * job is destroyed before completing the state, the state is abandoned, so that its continuation
+ * still runs exactly once instead of being waited for forever.
+ */
+template <class T>
+class PendingCompletion
+{
+public:
+  explicit PendingCompletion(std::shared_ptr<CompletionState<T>> state) noexcept :
+      state_{std::move(state)}
+  {}
+
+  PendingCompletion(PendingCompletion &&other) noexcept = default;
+  PendingCompletion &operator=(PendingCompletion &&other) = delete;
+
+  ~PendingCompletion()
+  {
+    if (state_)
+    {
+      state_->abandon();
+    }
+  }
+
+  template <class Func>
+  void complete(Func &fn) noexcept
+  {
+    std::exchange(state_, nullptr)->complete(fn);
+  }
+
+private:
+  std::shared_ptr<CompletionState<T>> state_;
+};
+
+}  // namespace detail
+
+/**
+ * \brief A handle to the result of a job submitted with `ThreadPool::submit_async()`.
+ *
+ * The continuation attached with `then()` runs on the executor given at submission (usually the
+ * event loop that submitted the job), so it can safely touch state owned by that loop.
+ */
+template <class T>
+class Completion
+{
+  using State = detail::CompletionState<T>;
+
+public:
+  explicit Completion(std::shared_ptr<State> state) : state_{std::move(state)}
+  {}
+
+  /**
+   * \brief Whether the job finished.
+   */
+  bool ready() const noexcept
+  {
+    return state_->ready();
+  }
+
+  /**
+   * \brief Attach the function to be called with the result of the job. If the job throws, the
+   * exception is rethrown on the executor when the continuation would have run. Must be called at
+   * most once.
+   */
+  template <class OnDone>
+  void then(OnDone &&on_done)
+  {
+    then(std::forward<OnDone>(on_done),
+        [](std::exception_ptr error) { std::rethrow_exception(error); });
+  }
+
+  /**
+   * \brief Attach the functions to be called with the result of the job, or with the exception it
+   * threw. Must be called at most once.
+   */
+  template <class OnDone, class OnError>
+  void then(OnDone &&on_done, OnError &&on_error)
+  {
+    state_->set_continuation([on_done = std::forward<OnDone>(on_done),
+                                 on_error = std::forward<OnError>(on_error)](State &state) mutable {
+      if (auto error = state.error(); error)
+      {
+        on_error(error);
+      }
+      else if constexpr (std::is_void_v<T>)
+      {
+        on_done();
+      }
+      else
+      {
+        on_done(std::move(*state.value()));
+      }
+    });
+  }
+
+private:
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace microloop::utils
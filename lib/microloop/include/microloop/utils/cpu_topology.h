@@ -0,0 +1,168 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <pthread.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace microloop::utils
+{
+
+/**
+ * \brief Where a logical CPU sits in the machine.
+ */
+struct CpuInfo
+{
+  /// The logical CPU number, as used by the scheduler
+  std::uint32_t id;
+
+  /// The physical core the CPU belongs to, unique within its package
+  std::uint32_t core;
+
+  /// The physical package (socket) the CPU belongs to
+  std::uint32_t package;
+
+  /// The NUMA node the CPU belongs to
+  std::uint32_t node;
+};
+
+/**
+ * \brief The CPUs this process may run on, as described by sysfs.
+ */
+class CpuTopology
+{
+public:
+  /**
+   * \brief Read the topology of the online CPUs in the affinity mask of the calling thread.
+   */
+  static CpuTopology detect();
+
+  const std::vector<CpuInfo> &cpus() const noexcept
+  {
+    return cpus_;
+  }
+
+  /**
+   * \brief Get the ids of all the CPUs.
+   */
+  std::vector<std::uint32_t> all() const;
+
+  /**
+   * \brief Get one CPU of every physical core, so that no two of them are hyper-threading siblings.
+   */
+  std::vector<std::uint32_t> one_per_core() const;
+
+  /**
+   * \brief Get the CPUs of the given NUMA node.
+   */
+  std::vector<std::uint32_t> node_cpus(std::uint32_t node) const;
+
+  /**
+   * \brief Get the number of NUMA nodes the CPUs belong to.
+   */
+  std::size_t nodes_count() const;
+
+  /**
+   * \brief Get a human-readable summary, e.g. "2 NUMA nodes, 2 packages, 16 cores, 32 CPUs".
+   */
+  std::string str() const;
+
+private:
+  std::vector<CpuInfo> cpus_;
+};
+
+/**
+ * \brief How threads are placed on the CPUs of the machine.
+ */
+struct Placement
+{
+  enum class Policy
+  {
+    /// Threads are not pinned; the scheduler places them
+    ANY,
+
+    /// Every thread is pinned to one CPU of an explicit list, round-robin
+    CPUS,
+
+    /// Every thread is pinned to its own physical core, round-robin
+    PHYSICAL_CORES,
+
+    /// Threads may run on any CPU of one NUMA node
+    NUMA_NODE,
+  };
+
+  Policy policy = Policy::ANY;
+
+  /// The CPUs to use with the CPUS policy
+  std::vector<std::uint32_t> cpus;
+
+  /// The node to use with the NUMA_NODE policy
+  std::uint32_t node = 0;
+
+  /**
+   * \brief Parse a placement from one of the following formats:
+   *  - "any",
+   *  - "cpus:<list>", where the list has the sysfs format, e.g. "0-3,8",
+   *  - "cores",
+   *  - "node:<n>".
+   * \return The placement, or nothing if the string is not valid.
+   */
+  static std::optional<Placement> from_string(std::string_view str);
+
+  /**
+   * \brief Parse a placement as above, and check that it can be applied on the given topology,
+   * i.e. that its CPUs are all in the topology, or that its node has CPUs in it.
+   * \return The placement, or nothing if the string is not valid or the placement cannot be
+   * applied.
+   */
+  static std::optional<Placement> from_string(std::string_view str, const CpuTopology &topology);
+
+  /**
+   * \brief Get the CPUs each of \p count threads may run on. Threads that are not pinned get all
+   * the CPUs of the topology.
+   * \param topology The topology of the machine.
+   * \param count How many threads to place.
+   * \param first_slot The slot of the first thread. Threads placed by separate calls get distinct
+   * CPUs when given distinct slots (e.g. the event loop gets slot 0 and the workers the next ones).
+   */
+  std::vector<std::vector<std::uint32_t>> assign(
+      const CpuTopology &topology, std::size_t count, std::size_t first_slot = 0) const;
+
+  /**
+   * \brief Get the NUMA node the placed threads run on, if they are confined to a single one.
+   */
+  std::optional<std::uint32_t> numa_node(const CpuTopology &topology) const;
+
+  std::string str() const;
+};
+
+/**
+ * \brief Parse a list of CPUs or nodes in the sysfs format, e.g. "0-3,8,10-11".
+ * \return The ids in the list, or nothing if the list is not valid or has an id of \p CPU_SETSIZE
+ * or more.
+ */
+std::optional<std::vector<std::uint32_t>> parse_cpu_list(std::string_view str);
+
+/**
+ * \brief Format a list of ids in the sysfs format, collapsing consecutive ids into ranges.
+ */
+std::string format_cpu_list(const std::vector<std::uint32_t> &ids);
+
+/**
+ * \brief Restrict a thread to the given CPUs. Does nothing if the set is empty.
+ */
+void pin_thread(pthread_t thread, const std::vector<std::uint32_t> &cpus);
+
+/**
+ * \brief Ask the kernel to back the given memory range with pages from the given NUMA node.
+ * Must be called before the memory is first touched.
+ */
+void bind_to_node(void *addr, std::size_t len, std::uint32_t node);
+
+}  // namespace microloop::utils
@@ -0,0 +1,36 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace microloop::utils::futex
+{
+
+/**
+ * Block the calling thread as long as \p word holds the \p expected value. The function may return
+ * spuriously, so callers must re-check their wake-up condition.
+ * @param word The futex word.
+ * @param expected The value the futex word is expected to hold for the thread to go to sleep.
+ */
+void wait(std::atomic<std::uint32_t> &word, std::uint32_t expected);
+
+/**
+ * Like `wait()`, but give up after \p timeout.
+ * @return `false` if the timeout expired, `true` otherwise (including spurious wake-ups).
+ */
+bool wait_for(
+    std::atomic<std::uint32_t> &word, std::uint32_t expected, std::chrono::nanoseconds timeout);
+
+/**
+ * Wake up at most \p count threads blocked on \p word.
+ * @param word The futex word.
+ * @param count How many threads to wake up.
+ */
+void wake(std::atomic<std::uint32_t> &word, std::uint32_t count);
+
+}  // namespace microloop::utils::futex
@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace microloop::utils
+{
+
+/**
+ * \brief A histogram of durations with power-of-two buckets.
+ *
+ * Recording a sample is a couple of relaxed memory accesses, without read-modify-write operations,
+ * so every histogram must have a single writer. Any thread can read it, and the histograms of
+ * several writers are combined into a Snapshot to compute percentiles.
+ */
+class LatencyHistogram
+{
+public:
+  /// Bucket \p i counts the samples below 2^i nanoseconds not counted by the previous buckets
+  static constexpr std::size_t BUCKETS_COUNT = 64;
+
+  /**
+   * \brief A point-in-time copy of one or more histograms.
+   */
+  class Snapshot
+  {
+  public:
+    /**
+     * \brief Add the samples of a histogram to this snapshot.
+     */
+    Snapshot &add(const LatencyHistogram &histogram) noexcept
+    {
+      for (std::size_t i = 0; i != BUCKETS_COUNT; ++i)
+      {
+        auto count = histogram.buckets_[i].load(std::memory_order_relaxed);
+        buckets_[i] += count;
+        samples_ += count;
+      }
+
+      return *this;
+    }
+
+    std::uint64_t samples() const noexcept
+    {
+      return samples_;
+    }
+
+    /**
+     * \brief Get an upper bound of the given percentile of the samples, within a factor of two.
+     * \param percentile The percentile, between 0 and 100.
+     */
+    std::chrono::nanoseconds percentile(double percentile) const noexcept
+    {
+      if (!samples_)
+      {
+        return std::chrono::nanoseconds{0};
+      }
+
+      auto rank = static_cast<std::uint64_t>(samples_ * percentile / 100);
+      std::uint64_t seen = 0;
+      for (std::size_t i = 0; i != BUCKETS_COUNT; ++i)
+      {
+        seen += buckets_[i];
+        if (seen > rank || seen == samples_)
+        {
+          return bucket_bound(i);
+        }
+      }
+
+      return bucket_bound(BUCKETS_COUNT - 1);
+    }
+
+  private:
+    std::array<std::uint64_t, BUCKETS_COUNT> buckets_{};
+    std::uint64_t samples_ = 0;
+  };
+
+  /**
+   * \brief Record a sample. Must only be called by the owner of the histogram.
+   */
+  void record(std::chrono::nanoseconds duration) noexcept
+  {
+    auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0));
+    auto idx = ns ? std::min<std::size_t>(64 - __builtin_clzll(ns), BUCKETS_COUNT - 1) : 0;
+
+    auto &bucket = buckets_[idx];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+private:
+  static std::chrono::nanoseconds bucket_bound(std::size_t idx) noexcept
+  {
+    return std::chrono::nanoseconds{idx ? (std::int64_t{1} << std::min<std::size_t>(idx, 62)) : 1};
+  }
+
+  std::array<std::atomic<std::uint64_t>, BUCKETS_COUNT> buckets_{};
+};
+
+}  // namespace microloop::utils
@@ -5,15 +5,29 @@
 #pragma once
 
 #include "microloop/kernel_exception.h"
-
+#include "microloop/utils/completion.h"
+#include "microloop/utils/cpu_topology.h"
+#include "microloop/utils/latency_histogram.h"
+#include "microloop/utils/unique_function.h"
+#include "microloop/utils/work_stealing_deque.h"
+
+#include <algorithm>
+#include <array>
 #include <atomic>
-#include <condition_variable>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <functional>
+#include <future>
+#include <iterator>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
 #include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #ifndef THREADPOOL_MAX_WORKERS
 #define THREADPOOL_MAX_WORKERS (std::thread::hardware_concurrency() - 1)
@@ -22,17 +36,263 @@
 namespace microloop::utils
 {
 
+/**
+ * \brief Thrown when a job is submitted to a full queue whose overflow policy is to reject jobs.
+ */
+class QueueFullError : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+namespace detail
+{
+
+/**
+ * \brief The state shared by the jobs of a batch.
+ *
+ * This is a latch counting down the jobs of the batch which did not finish yet. The job finishing
+ * last completes the batch, which resumes its continuation on the executor given at submission, so
+ * nothing ever blocks waiting for the batch. The batch deletes itself at that point.
+ */
+template <class Body>
+class Batch
+{
+public:
+  Batch(Executor &resume_on, std::size_t count, Body &&body) :
+      completion_{std::make_shared<CompletionState<void>>(resume_on)},
+      remaining_{count},
+      body_{std::move(body)}
+  {}
+
+  std::shared_ptr<CompletionState<void>> completion() const
+  {
+    return completion_;
+  }
+
+  /**
+   * \brief Run the part of the batch identified by the given arguments and count it down.
+   */
+  template <class... Args>
+  void run(Args... args) noexcept
+  {
+    try
+    {
+      body_(args...);
+    }
+    catch (...)
+    {
+      fail(std::current_exception());
+    }
+
+    count_down(1);
+  }
+
+  /**
+   * \brief Record the error the batch completes with. Only the first error is kept.
+   */
+  void fail(std::exception_ptr error) noexcept
+  {
+    if (!failed_.exchange(true, std::memory_order_relaxed))
+    {
+      error_ = std::move(error);
+    }
+  }
+
+  /**
+   * \brief Count down \p count parts of the batch, completing the batch if they were the last ones.
+   */
+  void count_down(std::size_t count) noexcept
+  {
+    if (remaining_.fetch_sub(count, std::memory_order_acq_rel) != count)
+    {
+      return;
+    }
+
+    auto finish = [this] {
+      if (error_)
+      {
+        std::rethrow_exception(error_);
+      }
+    };
+
+    completion_->complete(finish);
+    delete this;
+  }
+
+private:
+  std::shared_ptr<CompletionState<void>> completion_;
+  std::atomic<std::size_t> remaining_;
+  std::atomic_bool failed_{false};
+  std::exception_ptr error_;
+  Body body_;
+};
+
+/**
+ * \brief A job of a batch, as queued. If it is destroyed without having run, e.g. because the
+ * thread pool was closed, its part of the batch is counted down with a broken promise error, so
+ * that the batch still completes.
+ */
+template <class Body, class Func>
+class BatchPart
+{
+public:
+  BatchPart(Batch<Body> *batch, Func &&fn) : batch_{batch}, fn_{std::move(fn)}
+  {}
+
+  BatchPart(BatchPart &&other) noexcept :
+      batch_{std::exchange(other.batch_, nullptr)}, fn_{std::move(other.fn_)}
+  {}
+
+  BatchPart &operator=(BatchPart &&other) = delete;
+
+  ~BatchPart()
+  {
+    if (batch_)
+    {
+      batch_->fail(std::make_exception_ptr(std::future_error{std::future_errc::broken_promise}));
+      batch_->count_down(1);
+    }
+  }
+
+  void operator()()
+  {
+    batch_ = nullptr;
+    fn_();
+  }
+
+private:
+  Batch<Body> *batch_;
+  Func fn_;
+};
+
+}  // namespace detail
+
+/**
+ * \brief A work-stealing thread pool.
+ *
+ * Every worker owns a Chase-Lev deque. Jobs submitted from a worker (i.e. from within another job)
+ * are pushed to that worker's deque, while jobs submitted from any other thread go to a global
+ * injection queue. An idle worker takes jobs from its own deque first, then from the injection
+ * queue, and finally steals from the other workers. Workers with nothing to do park on a futex.
+ *
+ * Jobs belong to a priority class. High priority jobs are taken before anything else and low
+ * priority jobs only when there is nothing else to do. The number of queued jobs of every class can
+ * be bounded, in which case submitting to a full class either fails or blocks.
+ *
+ * An elastic pool starts with its minimum number of workers and spawns more, up to its maximum,
+ * while jobs wait in the queues for longer than a target; workers idle for long enough retire.
+ */
 class ThreadPool
 {
-  class Job
+public:
+  /**
+   * \brief The priority classes of jobs.
+   */
+  enum class Priority : std::uint8_t
+  {
+    /// Latency-sensitive jobs, e.g. the ones a request handler waits on
+    HIGH,
+
+    /// The default class
+    NORMAL,
+
+    /// Background jobs, run when no other job is queued
+    LOW,
+  };
+
+  static constexpr std::size_t PRIORITIES_COUNT = 3;
+
+  /**
+   * \brief What happens to jobs submitted to a full queue.
+   */
+  enum class Overflow
+  {
+    /// The submission throws a QueueFullError
+    REJECT,
+
+    /// The submitting thread waits until a job of the class starts running. Jobs submitted from a
+    /// worker of the pool are run in place instead, since the worker would otherwise wait for
+    /// itself.
+    BLOCK,
+  };
+
+  /**
+   * \brief The bound on the jobs queued in a priority class.
+   */
+  struct QueueLimit
+  {
+    /// How many jobs of the class may be queued at once, or 0 for no limit
+    std::size_t capacity = 0;
+
+    Overflow overflow = Overflow::REJECT;
+  };
+
+  /**
+   * \brief The state of the queue of a priority class.
+   */
+  struct QueueStats
+  {
+    /// How many jobs of the class are queued and did not start yet
+    std::size_t depth;
+
+    /// How many jobs of the class were rejected because the queue was full
+    std::uint64_t rejected;
+
+    /// How many submissions of the class had to wait for room in the queue
+    std::uint64_t blocked;
+  };
+
+  /**
+   * \brief The bounds and the triggers of an elastic pool.
+   */
+  struct ElasticOptions
+  {
+    /// How many workers to keep, even when idle. At least one worker is kept.
+    std::uint32_t min_workers = 1;
+
+    /// How many workers to spawn at most
+    std::uint32_t max_workers = 1;
+
+    /// Spawn a worker when jobs wait this long to start and no worker is idle
+    std::chrono::microseconds target_wait{1000};
+
+    /// Retire workers idle for this long, down to \p min_workers
+    std::chrono::milliseconds idle_timeout{5000};
+  };
+
+  /**
+   * \brief The distribution of the time jobs waited in the queues before starting.
+   */
+  struct WaitTimeStats
+  {
+    std::uint64_t samples;
+    std::chrono::nanoseconds p50;
+    std::chrono::nanoseconds p90;
+    std::chrono::nanoseconds p99;
+  };
+
+  /**
+   * \brief A job of a batch.
+   */
+  using Task = UniqueFunction<void()>;
+
+private:
+  /**
+   * \brief A job scheduled on the pool.
+   *
+   * Small callables are stored inline and the job nodes themselves come from a free list shared by
+   * all the pools, so submitting a small job does not allocate in steady state.
+   */
+  class Job final
   {
   public:
-    using Func = std::function<void()>;
+    using Func = UniqueFunction<void()>;
 
     Job(const Job &) = delete;
     Job &operator=(const Job &) = delete;
 
-    Job(Func &&fn) : fn{fn}
+    Job(Func &&fn, Priority priority) : priority{priority}, fn{std::move(fn)}
     {}
 
     void run()
@@ -40,95 +300,202 @@ class ThreadPool
       fn();
     }
 
-    ~Job()
-    {}
+    static void *operator new(std::size_t size);
+    static void operator delete(void *ptr) noexcept;
+
+    /**
+     * The next job in the injection queue.
+     */
+    Job *next = nullptr;
+
+    Priority priority;
+
+    /**
+     * When the job was queued, to measure how long it waited, or the epoch if its wait time is not
+     * measured.
+     */
+    std::chrono::steady_clock::time_point queued_at;
 
   private:
     Func fn;
   };
 
-  template <class JobType>
-  class JobsQueue
+  /**
+   * \brief The queue receiving the jobs submitted from outside the pool. Jobs are linked through
+   * their \p next pointers, so queueing a job does not allocate.
+   */
+  class InjectionQueue
   {
   public:
-    ~JobsQueue()
-    {
-      invalidate();
-    }
-
-    std::optional<JobType> try_pop()
+    void push(Job *job)
     {
       std::lock_guard<std::mutex> lock{mutex_};
-      if (queue_.empty() || !valid_)
+
+      job->next = nullptr;
+      if (tail_)
+      {
+        tail_->next = job;
+      }
+      else
       {
-        return std::nullopt;
+        head_ = job;
       }
 
-      return std::move(queue_.front());
-      queue_.pop();
+      tail_ = job;
+      size_.store(size_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
     }
 
-    std::optional<JobType> wait_pop()
+    /**
+     * \brief Append a chain of \p count jobs linked through their \p next pointers, under a single
+     * lock acquisition.
+     */
+    void push_chain(Job *head, Job *tail, std::size_t count)
     {
-      std::unique_lock<std::mutex> lock{mutex_};
-      condition_.wait(lock, [&] { return !queue_.empty() || !valid_; });
+      std::lock_guard<std::mutex> lock{mutex_};
 
-      if (!valid_)
+      tail->next = nullptr;
+      if (tail_)
       {
-        return std::nullopt;
+        tail_->next = head;
+      }
+      else
+      {
+        head_ = head;
       }
 
-      auto elem = std::move(queue_.front());
-      queue_.pop();
-
-      return std::make_optional(std::move(elem));
+      tail_ = tail;
+      size_.store(size_.load(std::memory_order_relaxed) + count, std::memory_order_release);
     }
 
-    void push(JobType &&job)
+    Job *try_pop()
     {
-      std::lock_guard<std::mutex> lock{mutex_};
-      queue_.push(std::move(job));
-      condition_.notify_one();
-    }
+      /*
+       * Checking the size first keeps idle workers from hammering the mutex.
+       */
+      if (empty())
+      {
+        return nullptr;
+      }
 
-    bool empty() const
-    {
       std::lock_guard<std::mutex> lock{mutex_};
-      return queue_.empty();
+      return pop_locked();
     }
 
-    void clear()
+    /**
+     * \brief Move up to \p max_count jobs into the given deque, under a single lock acquisition.
+     * \return The first of the moved jobs, which is not pushed to the deque, or `nullptr` if the
+     * queue was empty.
+     */
+    Job *try_pop_batch(WorkStealingDeque<Job *> &deque, std::size_t max_count)
     {
+      if (empty())
+      {
+        return nullptr;
+      }
+
       std::lock_guard<std::mutex> lock{mutex_};
-      while (!queue_.empty())
+
+      auto first = pop_locked();
+      for (std::size_t i = 1; first && i < max_count && head_; ++i)
       {
-        queue_.pop();
+        deque.push(pop_locked());
       }
 
-      condition_.notify_all();
+      return first;
     }
 
-    void invalidate()
+    bool empty() const noexcept
     {
-      std::lock_guard<std::mutex> lock{mutex_};
-      valid_ = false;
-      condition_.notify_all();
+      return size_.load(std::memory_order_acquire) == 0;
     }
 
-    bool valid() const
+  private:
+    Job *pop_locked() noexcept
     {
-      std::lock_guard<std::mutex> lock{mutex_};
-      return valid_;
+      auto job = head_;
+      if (!job)
+      {
+        return nullptr;
+      }
+
+      head_ = job->next;
+      if (!head_)
+      {
+        tail_ = nullptr;
+      }
+
+      size_.store(size_.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+
+      return job;
     }
 
-  private:
-    std::atomic_bool valid_{true};
-    mutable std::mutex mutex_;
-    std::queue<JobType> queue_;
-    std::condition_variable condition_;
+    alignas(CACHE_LINE_SIZE) std::mutex mutex_;
+    Job *head_ = nullptr;
+    Job *tail_ = nullptr;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> size_{0};
+  };
+
+  /**
+   * \brief The queue and the bound of a priority class.
+   */
+  struct alignas(CACHE_LINE_SIZE) PriorityClass
+  {
+    /**
+     * Jobs of the class submitted from outside the pool (or from workers, for classes other than
+     * NORMAL).
+     */
+    InjectionQueue injected;
+
+    /**
+     * The jobs of the class submitted but not started yet, wherever they are queued.
+     */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> depth{0};
+
+    std::atomic<std::size_t> capacity{0};
+    std::atomic<Overflow> overflow{Overflow::REJECT};
+    std::atomic<std::uint64_t> rejected{0};
+    std::atomic<std::uint64_t> blocked{0};
+
+    /**
+     * The futex word blocked submitters wait on, bumped when a job of the class starts running
+     * while there are \p waiters.
+     */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> space{0};
+    std::atomic<std::uint32_t> waiters{0};
+  };
+
+  /**
+   * \brief The state owned by a worker thread, padded so that workers do not share cache lines.
+   */
+  struct alignas(CACHE_LINE_SIZE) Worker
+  {
+    WorkStealingDeque<Job *> jobs;
+    std::thread thread;
+
+    /**
+     * Whether a thread runs this worker. Slots of elastic pools are reused by the workers spawned
+     * after others retired. Only changed under \p spawn_mutex_.
+     */
+    std::atomic_bool active{false};
+
+    /**
+     * The CPUs the thread of this worker is pinned to, if any. Only accessed under \p spawn_mutex_.
+     */
+    std::vector<std::uint32_t> cpus;
+
+    /**
+     * How long the jobs started by this worker waited in the queues.
+     */
+    LatencyHistogram wait_times;
+
+    /**
+     * The futex word the worker sleeps on while parked: 1 while parked, 0 once woken up.
+     */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> parked{0};
   };
 
-  static constexpr char *MAX_WORKERS_ENV_VAR = "MICRO_MAX_WORKERS";
+  static constexpr const char *MAX_WORKERS_ENV_VAR = "MICRO_MAX_WORKERS";
+  static constexpr const char *MIN_WORKERS_ENV_VAR = "MICRO_MIN_WORKERS";
 
 public:
   /**
@@ -137,6 +504,8 @@ public:
    *  1) The environment variable "MICRO_MAX_WORKERS",
    *  2) The compile-time define "THREADPOOL_MAX_WORKERS",
    *  3) The maximum hardware supported threads.
+   * If the environment variable "MICRO_MIN_WORKERS" is also set, the pool is elastic, between that
+   * many workers and the number above.
    */
   ThreadPool();
 
@@ -148,6 +517,13 @@ public:
    */
   ThreadPool(std::uint32_t threads_count);
 
+  /**
+   * Constructs an elastic thread pool.
+   * @param options The bounds of the pool. The maximum is capped like the number of threads of a
+   * fixed-size pool.
+   */
+  ThreadPool(const ElasticOptions &options);
+
   ThreadPool(const ThreadPool &other) = delete;
   ThreadPool &operator=(const ThreadPool &other) = delete;
 
@@ -156,14 +532,223 @@ public:
    * processing the results of the job function.
    * @param fn The function representing the job.
    * @param args Arguments to pass to the given function.
+   * @throw QueueFullError If the queue of normal priority jobs is full and rejects jobs.
    */
-  template <class Func, class... Args>
+  template <class Func, class... Args,
+      class = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, Priority>>>
   void submit(Func &&fn, Args &&... args)
   {
-    auto bound_fn = std::bind(std::forward<Func>(fn), std::forward<Args>(args)...);
-    jobs.push(std::make_unique<Job>(std::move(bound_fn)));
+    submit(Priority::NORMAL, std::forward<Func>(fn), std::forward<Args>(args)...);
+  }
+
+  /**
+   * Submit a new job of the given priority class to the thread pool.
+   * @param priority The priority class of the job.
+   * @param fn The function representing the job.
+   * @param args Arguments to pass to the given function.
+   * @throw QueueFullError If the queue of the class is full and rejects jobs.
+   */
+  template <class Func, class... Args>
+  void submit(Priority priority, Func &&fn, Args &&... args)
+  {
+    auto job = bind_job(std::forward<Func>(fn), std::forward<Args>(args)...);
+    if (!reserve(priority, true))
+    {
+      /*
+       * A worker blocking on its own pool could wait forever, so it runs the job itself. Jobs
+       * submitted while the pool is destroyed are dropped, like the queued ones.
+       */
+      if (!done_.load(std::memory_order_acquire))
+      {
+        job();
+      }
+
+      return;
+    }
+
+    try
+    {
+      schedule(new Job{std::move(job), priority});
+    }
+    catch (...)
+    {
+      release(priority);
+      throw;
+    }
+  }
+
+  /**
+   * Submit a new job of the given priority class to the thread pool, unless its queue is full. This
+   * never blocks nor throws because of the queue bound, whatever the overflow policy of the class.
+   * @return Whether the job was queued.
+   */
+  template <class Func, class... Args>
+  bool try_submit(Priority priority, Func &&fn, Args &&... args)
+  {
+    if (!reserve(priority, false))
+    {
+      return false;
+    }
+
+    try
+    {
+      schedule(new Job{bind_job(std::forward<Func>(fn), std::forward<Args>(args)...), priority});
+    }
+    catch (...)
+    {
+      release(priority);
+      throw;
+    }
+
+    return true;
+  }
+
+  /**
+   * Submit a new job to the thread pool and get a handle to its result. The continuation attached
+   * to the handle runs on \p resume_on, so a handler running on the event loop can offload work and
+   * pick up the result on the loop again, without blocking it.
+   * @param resume_on The executor running the continuation, usually the event loop.
+   * @param fn The function representing the job.
+   * @param args Arguments to pass to the given function.
+   * @return The handle to the result of the job.
+   */
+  template <class Func, class... Args>
+  auto submit_async(Executor &resume_on, Func &&fn, Args &&... args)
+  {
+    return submit_async(
+        Priority::NORMAL, resume_on, std::forward<Func>(fn), std::forward<Args>(args)...);
+  }
+
+  /**
+   * Like `submit_async(resume_on, fn, args...)`, for a job of the given priority class.
+   */
+  template <class Func, class... Args>
+  auto submit_async(Priority priority, Executor &resume_on, Func &&fn, Args &&... args)
+  {
+    using Result = std::invoke_result_t<std::decay_t<Func> &, std::decay_t<Args> &...>;
+
+    auto state = std::make_shared<detail::CompletionState<Result>>(resume_on);
+    auto pending = detail::PendingCompletion<Result>{state};
+    submit(priority, [pending = std::move(pending), fn = std::forward<Func>(fn),
+                         args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+      auto call = [&]() -> Result { return std::apply(fn, args); };
+      pending.complete(call);
+    });
+
+    return Completion<Result>{std::move(state)};
+  }
+
+  /**
+   * Submit a batch of jobs at once. The jobs are queued with a single lock acquisition (or none,
+   * when submitting from a worker) and the batch completes once all of them finished, without
+   * blocking any thread.
+   * @param resume_on The executor running the continuation of the batch, usually the event loop.
+   * @param first,last The jobs, callable without arguments. They are moved out of the range.
+   * @param priority The priority class of the jobs.
+   * @return The handle to the completion of the batch. If any job throws, the batch completes with
+   * the first exception thrown.
+   * @throw QueueFullError If the queue of the class is full and rejects jobs. A batch larger than
+   * the capacity of the queue is only accepted when the queue is empty.
+   */
+  template <class It>
+  Completion<void> submit_batch(
+      Executor &resume_on, It first, It last, Priority priority = Priority::NORMAL)
+  {
+    std::vector<Task> tasks;
+    tasks.reserve(std::distance(first, last));
+    for (; first != last; ++first)
+    {
+      tasks.emplace_back(std::move(*first));
+    }
+
+    auto count = tasks.size();
+    auto body = [tasks = std::move(tasks)](std::size_t idx) mutable { tasks[idx](); };
+
+    return schedule_batch(resume_on, count, std::move(body), priority,
+        [](auto *batch, std::size_t idx) { return [batch, idx] { batch->run(idx); }; });
+  }
+
+  /**
+   * Run a function over a range of indices, split in chunks run in parallel on the pool. Useful to
+   * e.g. checksum or compress the segments of a buffer.
+   * @param resume_on The executor running the continuation of the loop, usually the event loop.
+   * @param begin,end The range of indices.
+   * @param grain How many indices each chunk covers at most. If 0, the range is split in four
+   * chunks per worker.
+   * @param fn The function to call for each chunk, with the bounds `(chunk_begin, chunk_end)` of
+   * the chunk. It is called concurrently from several threads.
+   * @param priority The priority class of the chunks.
+   * @return The handle to the completion of the loop. If any chunk throws, the loop completes with
+   * the first exception thrown.
+   */
+  template <class Func>
+  Completion<void> parallel_for(Executor &resume_on, std::size_t begin, std::size_t end,
+      std::size_t grain, Func &&fn, Priority priority = Priority::NORMAL)
+  {
+    auto length = end > begin ? end - begin : 0;
+    if (!grain)
+    {
+      grain = std::max<std::size_t>(length / (4 * std::max<std::size_t>(size(), 1)), 1);
+    }
+
+    auto count = (length + grain - 1) / grain;
+    auto body = [fn = std::forward<Func>(fn)](std::size_t from, std::size_t to) mutable {
+      fn(from, to);
+    };
+
+    return schedule_batch(resume_on, count, std::move(body), priority,
+        [begin, end, grain](auto *batch, std::size_t idx) {
+          auto from = begin + idx * grain;
+          auto to = std::min(from + grain, end);
+          return [batch, from, to] { batch->run(from, to); };
+        });
+  }
+
+  /**
+   * Bound the number of queued jobs of a priority class. Lowering the capacity below the current
+   * depth does not drop jobs; submissions are refused until the depth falls below it.
+   */
+  void set_queue_limit(Priority priority, QueueLimit limit);
+
+  /**
+   * @return The state of the queue of the given priority class.
+   */
+  QueueStats queue_stats(Priority priority) const;
+
+  /**
+   * Pin the worker threads according to the given placement. Can be called at any time; the workers
+   * migrate as soon as the scheduler gets to them.
+   * @param placement Where to run the workers.
+   * @param topology The topology of the machine.
+   * @param first_slot The placement slot of the first worker. Slots before it are left for other
+   * threads, such as the event loop.
+   * @return The CPUs assigned to each worker.
+   */
+  std::vector<std::vector<std::uint32_t>> set_placement(
+      const Placement &placement, const CpuTopology &topology, std::size_t first_slot = 0);
+
+  /**
+   * \return The number of worker threads currently running.
+   */
+  std::size_t size() const noexcept
+  {
+    return active_count_.load(std::memory_order_relaxed);
   }
 
+  /**
+   * \return The number of worker threads the pool can grow to.
+   */
+  std::size_t max_size() const noexcept
+  {
+    return workers.size();
+  }
+
+  /**
+   * \return The distribution of the time the jobs started so far waited in the queues, measured on
+   * a sample of the jobs.
+   */
+  WaitTimeStats wait_time_stats() const;
+
   /**
    * Close the thread pool.
    */
@@ -178,13 +763,199 @@ public:
   }
 
 private:
+  /**
+   * Bind the arguments of a job to its function. Like `std::bind`, the function and the arguments
+   * are stored by value and the arguments are passed as lvalues, but a job without arguments is
+   * stored as is and no intermediate `std::function` is created.
+   */
+  template <class Func, class... Args>
+  static Job::Func bind_job(Func &&fn, Args &&... args)
+  {
+    if constexpr (sizeof...(Args) == 0)
+    {
+      return Job::Func{std::forward<Func>(fn)};
+    }
+    else
+    {
+      return Job::Func{[fn = std::forward<Func>(fn),
+                           args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+        std::apply(fn, args);
+      }};
+    }
+  }
+
+  /**
+   * Create the worker slots and spawn the minimum number of worker threads.
+   */
+  void spawn_workers(const ElasticOptions &options);
+
+  /**
+   * Start a thread for the worker in the given slot. Must be called under \p spawn_mutex_.
+   */
+  void start_worker(std::size_t idx);
+
+  /**
+   * Spawn one more worker if the pool is elastic, below its maximum size, has no idle worker and
+   * did not grow during the last target wait time.
+   */
+  void maybe_grow(std::chrono::steady_clock::time_point now);
+
+  /**
+   * Retire the calling worker if the pool is above its minimum size and nothing woke the worker up.
+   * @return Whether the worker retired.
+   */
+  bool try_retire(Worker &self);
+
+  bool elastic() const noexcept
+  {
+    return options_.min_workers < options_.max_workers;
+  }
+
   /**
    * The thread worker. This function is responsible for:
    *  1) Blocking all the signals on the thread it represents. (This is required in the context of
    *     the SignalsMonitor)
-   *  2) Waiting for new jobs and completing them when woke up.
+   *  2) Running jobs from its own deque, the injection queue or other workers, and parking when
+   *     there are none.
    */
-  void worker();
+  void worker(std::size_t idx);
+
+  /**
+   * Create the jobs of a batch and queue them.
+   * @param count How many jobs the batch has.
+   * @param body The state shared by the jobs, called by each of them.
+   * @param make_job Creates the function of a job, given the batch and the index of the job.
+   */
+  template <class Body, class MakeJob>
+  Completion<void> schedule_batch(
+      Executor &resume_on, std::size_t count, Body &&body, Priority priority, MakeJob make_job)
+  {
+    if (!count)
+    {
+      auto state = std::make_shared<detail::CompletionState<void>>(resume_on);
+      auto nothing = [] {};
+      state->complete(nothing);
+
+      return Completion<void>{std::move(state)};
+    }
+
+    auto batch = new detail::Batch<Body>{resume_on, count, std::move(body)};
+    auto completion = Completion<void>{batch->completion()};
+
+    if (!reserve(priority, true, count))
+    {
+      /*
+       * Like for single jobs, a worker which would block runs the batch itself.
+       */
+      if (done_.load(std::memory_order_acquire))
+      {
+        batch->fail(std::make_exception_ptr(std::runtime_error{"the thread pool is closed"}));
+        batch->count_down(count);
+      }
+      else
+      {
+        for (std::size_t i = 0; i != count; ++i)
+        {
+          make_job(batch, i)();
+        }
+      }
+
+      return completion;
+    }
+
+    Job *head = nullptr;
+    Job *tail = nullptr;
+    std::size_t parts = 0;
+    try
+    {
+      for (std::size_t i = 0; i != count; ++i)
+      {
+        detail::BatchPart part{batch, make_job(batch, i)};
+        ++parts;
+
+        auto job = new Job{Job::Func{std::move(part)}, priority};
+        (tail ? tail->next : head) = job;
+        tail = job;
+      }
+    }
+    catch (...)
+    {
+      /*
+       * The parts created so far count themselves down when destroyed, and the batch deletes itself
+       * once the parts never created are counted down too.
+       */
+      while (head)
+      {
+        delete std::exchange(head, head->next);
+      }
+
+      release(priority, count);
+      if (parts != count)
+      {
+        batch->count_down(count - parts);
+      }
+
+      throw;
+    }
+
+    schedule_chain(head, tail, count, priority);
+
+    return completion;
+  }
+
+  /**
+   * Take slots in the queue of the given class.
+   * @param blocking Whether to apply the overflow policy of the class when its queue is full.
+   * Otherwise, the slots are not taken.
+   * @param count How many slots to take at once. More slots than the capacity of the queue can only
+   * be taken when the queue is empty.
+   * @return Whether the slots were taken. When blocking, `false` means that the jobs must be run in
+   * place or dropped because the pool is being destroyed.
+   */
+  bool reserve(Priority priority, bool blocking, std::size_t count = 1);
+
+  /**
+   * Free slots of the queue of the given class, once some of its jobs are started.
+   */
+  void release(Priority priority, std::size_t count = 1) noexcept;
+
+  PriorityClass &priority_class(Priority priority) noexcept
+  {
+    return classes[static_cast<std::size_t>(priority)];
+  }
+
+  /**
+   * Queue a job, taking ownership of it, and wake up a parked worker if there is one.
+   */
+  void schedule(Job *job);
+
+  /**
+   * Queue a chain of \p count jobs of the given class, linked through their \p next pointers, and
+   * wake up as many parked workers.
+   */
+  void schedule_chain(Job *head, Job *tail, std::size_t count, Priority priority);
+
+  /**
+   * Wake up at most \p count parked workers.
+   */
+  void notify(std::size_t count = 1);
+
+  /**
+   * Find a job for the given worker to run.
+   * @return The job, or `nullptr` if no job was found.
+   */
+  Job *find_job(Worker &self);
+
+  /**
+   * Park the calling worker until a new job is scheduled or the pool is destroyed.
+   * @return `false` if the worker retired while parked, `true` otherwise.
+   */
+  bool park(Worker &self);
+
+  /**
+   * Whether any queue of the pool holds a job.
+   */
+  bool has_jobs() const noexcept;
 
   /**
    * Destroys the thread pool (closing all the threads and clearing jobs).
@@ -192,16 +963,44 @@ private:
   void destroy();
 
   /**
-   * Vector of created threads.
+   * The worker slots of the pool, as many as the maximum number of workers. The vector is never
+   * resized while the workers are running.
+   */
+  std::vector<std::unique_ptr<Worker>> workers{};
+
+  ElasticOptions options_{};
+
+  /**
+   * Serializes spawning and retiring workers.
+   */
+  std::mutex spawn_mutex_;
+  std::atomic<std::size_t> active_count_{0};
+
+  /**
+   * When a worker last started a job and when the pool last grew, in nanoseconds of the steady
+   * clock. Only maintained by elastic pools.
+   */
+  alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> last_start_{0};
+  std::atomic<std::int64_t> last_growth_{0};
+
+  /**
+   * The queues of the priority classes, indexed by priority.
+   */
+  std::array<PriorityClass, PRIORITIES_COUNT> classes{};
+
+  /**
+   * The parked workers. A worker is removed from here by the thread waking it up, so that the
+   * following submissions do not try to wake it up again.
    */
-  std::vector<std::thread> threads{};
+  alignas(CACHE_LINE_SIZE) std::mutex idle_mutex_;
+  std::vector<Worker *> idle_;
 
   /**
-   * Jobs to be executed by worker threads.
+   * The size of \p idle_, readable without taking the lock.
    */
-  JobsQueue<std::unique_ptr<Job>> jobs{};
+  alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> idle_count_{0};
 
-  std::atomic_bool done_ = false;
+  alignas(CACHE_LINE_SIZE) std::atomic_bool done_ = false;
 };
 
 }  // namespace microloop::utils
@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace microloop::utils
+{
+
+template <class Signature, std::size_t InlineSize = 48>
+class UniqueFunction;
+
+/**
+ * \brief A move-only replacement for `std::function` that stores small callables inline.
+ *
+ * Callables of at most \p InlineSize bytes which can be moved without throwing are stored inside
+ * the object itself, so wrapping a small lambda does not allocate. Larger callables are moved to
+ * the heap. Unlike `std::function`, the wrapped callable does not need to be copyable.
+ */
+template <class R, class... Args, std::size_t InlineSize>
+class UniqueFunction<R(Args...), InlineSize>
+{
+  struct Ops
+  {
+    R (*invoke)(void *storage, Args &&... args);
+    void (*move)(void *dst, void *src) noexcept;
+    void (*destroy)(void *storage) noexcept;
+  };
+
+  template <class F>
+  static constexpr bool stored_inline = sizeof(F) <= InlineSize
+      && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+
+  template <class F>
+  static const Ops *ops_for() noexcept
+  {
+    if constexpr (stored_inline<F>)
+    {
+      static constexpr Ops ops{
+          [](void *storage, Args &&... args) -> R {
+            return std::invoke(*static_cast<F *>(storage), std::forward<Args>(args)...);
+          },
+          [](void *dst, void *src) noexcept {
+            new (dst) F{std::move(*static_cast<F *>(src))};
+            static_cast<F *>(src)->~F();
+          },
+          [](void *storage) noexcept { static_cast<F *>(storage)->~F(); },
+      };
+
+      return &ops;
+    }
+    else
+    {
+      static constexpr Ops ops{
+          [](void *storage, Args &&... args) -> R {
+            return std::invoke(**static_cast<F **>(storage), std::forward<Args>(args)...);
+          },
+          [](void *dst, void *src) noexcept {
+            *static_cast<F **>(dst) = *static_cast<F **>(src);
+          },
+          [](void *storage) noexcept { delete *static_cast<F **>(storage); },
+      };
+
+      return &ops;
+    }
+  }
+
+public:
+  UniqueFunction() noexcept = default;
+
+  UniqueFunction(std::nullptr_t) noexcept
+  {}
+
+  template <class F, class Fn = std::decay_t<F>,
+      class = std::enable_if_t<!std::is_same_v<Fn, UniqueFunction>
+          && std::is_invocable_r_v<R, Fn &, Args...>>>
+  UniqueFunction(F &&fn)
+  {
+    if constexpr (stored_inline<Fn>)
+    {
+      new (storage_) Fn{std::forward<F>(fn)};
+    }
+    else
+    {
+      *reinterpret_cast<Fn **>(storage_) = new Fn{std::forward<F>(fn)};
+    }
+
+    ops_ = ops_for<Fn>();
+  }
+
+  UniqueFunction(const UniqueFunction &) = delete;
+  UniqueFunction &operator=(const UniqueFunction &) = delete;
+
+  UniqueFunction(UniqueFunction &&other) noexcept : ops_{other.ops_}
+  {
+    if (ops_)
+    {
+      ops_->move(storage_, other.storage_);
+      other.ops_ = nullptr;
+    }
+  }
+
+  UniqueFunction &operator=(UniqueFunction &&other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+
+      if (other.ops_)
+      {
+        other.ops_->move(storage_, other.storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+
+    return *this;
+  }
+
+  ~UniqueFunction()
+  {
+    reset();
+  }
+
+  /**
+   * \brief Whether this object wraps a callable.
+   */
+  explicit operator bool() const noexcept
+  {
+    return ops_ != nullptr;
+  }
+
+  /**
+   * \brief Call the wrapped callable. The behavior is undefined if there is none.
+   */
+  R operator()(Args... args)
+  {
+    return ops_->invoke(storage_, std::forward<Args>(args)...);
+  }
+
+  /**
+   * \brief Destroy the wrapped callable, if any.
+   */
+  void reset() noexcept
+  {
+    if (ops_)
+    {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+private:
+  alignas(std::max_align_t) unsigned char storage_[InlineSize];
+  const Ops *ops_ = nullptr;
+};
+
+}  // namespace microloop::utils
@@ -0,0 +1,202 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+namespace microloop::utils
+{
+
+/**
+ * \brief The size of a cache line on the supported platforms. Data written by different threads is
+ * aligned to this so that it does not share cache lines.
+ */
+static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * \brief A Chase-Lev work-stealing deque.
+ *
+ * A single owner thread pushes and pops elements at the bottom of the deque, while any other
+ * thread can steal elements from the top. The implementation follows "Correct and Efficient
+ * Work-Stealing for Weak Memory Models" (Lê et al., 2013). The buffer grows when full; old buffers
+ * are kept until the deque is destroyed because thieves may still be reading from them.
+ */
+template <class T>
+class WorkStealingDeque
+{
+  static_assert(std::is_trivially_copyable_v<T>, "elements must be trivially copyable");
+
+  class Array
+  {
+  public:
+    explicit Array(std::int64_t capacity) :
+        capacity_{capacity},
+        mask_{capacity - 1},
+        data_{std::make_unique<std::atomic<T>[]>(capacity)}
+    {}
+
+    std::int64_t capacity() const noexcept
+    {
+      return capacity_;
+    }
+
+    void put(std::int64_t idx, T value) noexcept
+    {
+      data_[idx & mask_].store(value, std::memory_order_relaxed);
+    }
+
+    T get(std::int64_t idx) const noexcept
+    {
+      return data_[idx & mask_].load(std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<Array> grow(std::int64_t bottom, std::int64_t top) const
+    {
+      auto next = std::make_unique<Array>(capacity_ * 2);
+      for (auto i = top; i != bottom; ++i)
+      {
+        next->put(i, get(i));
+      }
+
+      return next;
+    }
+
+  private:
+    std::int64_t capacity_;
+    std::int64_t mask_;
+    std::unique_ptr<std::atomic<T>[]> data_;
+  };
+
+public:
+  static constexpr std::int64_t DEFAULT_CAPACITY = 256;
+
+  /**
+   * \brief Create a deque.
+   * \param capacity The initial capacity of the deque. Must be a power of two.
+   */
+  explicit WorkStealingDeque(std::int64_t capacity = DEFAULT_CAPACITY)
+  {
+    arrays_.push_back(std::make_unique<Array>(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  /**
+   * \brief Push an element at the bottom of the deque. Must only be called by the owner.
+   */
+  void push(T value)
+  {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto t = top_.load(std::memory_order_acquire);
+    auto a = array_.load(std::memory_order_relaxed);
+
+    if (b - t > a->capacity() - 1)
+    {
+      arrays_.push_back(a->grow(b, t));
+      a = arrays_.back().get();
+      array_.store(a, std::memory_order_release);
+    }
+
+    a->put(b, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * \brief Pop the most recently pushed element. Must only be called by the owner.
+   */
+  std::optional<T> pop()
+  {
+    auto b = bottom_.load(std::memory_order_relaxed) - 1;
+    auto a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top_.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+
+    std::optional<T> value = a->get(b);
+    if (t == b)
+    {
+      /*
+       * This is the last element, so we race with the thieves for it.
+       */
+      if (!top_.compare_exchange_strong(
+              t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      {
+        value = std::nullopt;
+      }
+
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    return value;
+  }
+
+  /**
+   * \brief Steal the least recently pushed element. Can be called by any thread.
+   * \return The stolen element, or nothing if the deque is empty or another thread won the race.
+   */
+  std::optional<T> steal()
+  {
+    auto t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom_.load(std::memory_order_acquire);
+
+    if (t >= b)
+    {
+      return std::nullopt;
+    }
+
+    auto a = array_.load(std::memory_order_acquire);
+    T value = a->get(t);
+    if (!top_.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+      return std::nullopt;
+    }
+
+    return value;
+  }
+
+  /**
+   * \brief Get an estimate of the number of elements in the deque.
+   */
+  std::int64_t size() const noexcept
+  {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto t = top_.load(std::memory_order_relaxed);
+
+    return b > t ? b - t : 0;
+  }
+
+  bool empty() const noexcept
+  {
+    return size() == 0;
+  }
+
+private:
+  alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> top_{0};
+  alignas(CACHE_LINE_SIZE) std::atomic<std::int64_t> bottom_{0};
+  alignas(CACHE_LINE_SIZE) std::atomic<Array *> array_{nullptr};
+
+  /**
+   * All the buffers ever used by this deque. Only accessed by the owner.
+   */
+  std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+}  // namespace microloop::utils
@@ -140,6 +140,16 @@ Buffer &Buffer::concat(const Buffer &other, std::size_t count)
   return *this;
 }
 
+Buffer &Buffer::append(std::string_view bytes)
+{
+  auto prev_size = size_;
+
+  resize(prev_size + bytes.size());
+  std::copy_n(bytes.data(), bytes.size(), data_.get() + prev_size);
+
+  return *this;
+}
+
 Buffer &Buffer::operator+=(const Buffer &other)
 {
   concat(other);
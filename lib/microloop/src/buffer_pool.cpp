@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/buffer_pool.h"
+
+#include "microloop/kernel_exception.h"
+#include "microloop/utils/cpu_topology.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <stdexcept>
+#include <sys/mman.h>
+
+namespace microloop
+{
+
+void BufferPool::SlabDeleter::operator()(char *slab) const noexcept
+{
+  if (mapped_size)
+  {
+    ::munmap(slab, mapped_size);
+  }
+  else
+  {
+    delete[] slab;
+  }
+}
+
+BufferPool::BufferPool(
+    std::size_t block_size, std::size_t blocks_per_slab, std::optional<std::uint32_t> numa_node) :
+    block_size_{block_size},
+    blocks_per_slab_{std::max<std::size_t>(blocks_per_slab, 1)},
+    numa_node_{numa_node}
+{
+  if (!block_size_)
+  {
+    throw std::invalid_argument("the block size of a buffer pool cannot be zero");
+  }
+}
+
+char *BufferPool::acquire()
+{
+  if (free_blocks_.empty())
+  {
+    grow();
+  }
+
+  char *block = free_blocks_.back();
+  free_blocks_.pop_back();
+
+  return block;
+}
+
+void BufferPool::release(char *block) noexcept
+{
+  /*
+   * The free list never holds more entries than the blocks allocated so far and its capacity is
+   * reserved in grow(), so this push cannot allocate.
+   */
+  free_blocks_.push_back(block);
+}
+
+void BufferPool::grow()
+{
+  free_blocks_.reserve(capacity() + blocks_per_slab_);
+  slabs_.reserve(slabs_.size() + 1);
+
+  auto slab_size = block_size_ * blocks_per_slab_;
+  if (numa_node_)
+  {
+    /*
+     * The memory policy applies to pages not yet touched, so the slab is mapped directly instead of
+     * coming from the heap, where it could share pages with other allocations.
+     */
+    auto addr = ::mmap(
+        nullptr, slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+    {
+      throw KernelException(errno, __PRETTY_FUNCTION__);
+    }
+
+    Slab slab{static_cast<char *>(addr), SlabDeleter{slab_size}};
+    utils::bind_to_node(addr, slab_size, *numa_node_);
+    slabs_.push_back(std::move(slab));
+  }
+  else
+  {
+    slabs_.push_back(Slab{new char[slab_size]});
+  }
+
+  char *slab = slabs_.back().get();
+  for (std::size_t i = blocks_per_slab_; i != 0; --i)
+  {
+    free_blocks_.push_back(slab + (i - 1) * block_size_);
+  }
+}
+
+}  // namespace microloop
@@ -0,0 +1,104 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/callback_queue.h"
+
+#include "microloop/kernel_exception.h"
+
+#include <cstdint>
+#include <errno.h>
+#include <iterator>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace microloop
+{
+
+CallbackQueue::CallbackQueue() : EventSource{0}
+{
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd == -1)
+  {
+    throw KernelException(errno);
+  }
+
+  set_fd(fd);
+}
+
+CallbackQueue::~CallbackQueue()
+{
+  close(get_fd());
+}
+
+void CallbackQueue::post(Callback &&callback)
+{
+  bool was_empty;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    was_empty = pending_.empty();
+    pending_.push_back(std::move(callback));
+  }
+
+  /*
+   * The loop drains the whole queue when woken up, so only the first callback of a batch needs to
+   * wake it up.
+   */
+  if (was_empty)
+  {
+    notify();
+  }
+}
+
+void CallbackQueue::run_callback()
+{
+  std::uint64_t count;
+  if (read(get_fd(), &count, sizeof(count)) == -1 && errno != EAGAIN)
+  {
+    throw KernelException(errno, __PRETTY_FUNCTION__);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    running_.swap(pending_);
+  }
+
+  std::size_t idx = 0;
+  try
+  {
+    for (; idx != running_.size(); ++idx)
+    {
+      running_[idx]();
+    }
+  }
+  catch (...)
+  {
+    /*
+     * The callbacks after the one that threw are put back at the front of the queue, so that they
+     * run on the next tick.
+     */
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      pending_.insert(pending_.begin(), std::make_move_iterator(running_.begin() + idx + 1),
+          std::make_move_iterator(running_.end()));
+    }
+
+    running_.clear();
+    notify();
+
+    throw;
+  }
+
+  running_.clear();
+}
+
+void CallbackQueue::notify()
+{
+  std::uint64_t one = 1;
+  if (write(get_fd(), &one, sizeof(one)) == -1 && errno != EAGAIN)
+  {
+    throw KernelException(errno, __PRETTY_FUNCTION__);
+  }
+}
+
+}  // namespace microloop
@@ -4,13 +4,14 @@
 
 #include "microloop/kernel_exception.h"
 
+#include <cstdlib>
 #include <errno.h>
 #include <sys/epoll.h>
 
 namespace microloop
 {
 
-EventLoop::EventLoop()
+EventLoop::EventLoop() : thread_{pthread_self()}
 {
   epollfd = epoll_create(1);
   if (epollfd == -1)
@@ -22,6 +23,27 @@ EventLoop::EventLoop()
   add_event_source(signals_monitor);
 
   signals_monitor_fd_ = signals_monitor->get_fd();
+
+  callback_queue_ = new CallbackQueue();
+  add_event_source(callback_queue_);
+
+  if (const char *val = std::getenv(PLACEMENT_ENV_VAR); val != nullptr)
+  {
+    /*
+     * A placement the thread cannot be pinned according to is ignored, rather than failing the
+     * construction of the event loop.
+     */
+    auto placement = utils::Placement::from_string(val, utils::CpuTopology::detect());
+    if (placement)
+    {
+      set_placement(*placement);
+    }
+    else
+    {
+      std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] Ignoring invalid " << PLACEMENT_ENV_VAR
+                << " \"" << val << "\"\n";
+    }
+  }
 }
 
 EventLoop &EventLoop::instance()
@@ -30,6 +52,25 @@ EventLoop &EventLoop::instance()
   return instance_;
 }
 
+void EventLoop::set_placement(const utils::Placement &placement)
+{
+  auto topology = utils::CpuTopology::detect();
+
+  auto loop_cpus = placement.assign(topology, 1).front();
+  utils::pin_thread(thread_, loop_cpus);
+  auto workers_cpus = thread_pool.set_placement(placement, topology, 1);
+
+  numa_node_ = placement.numa_node(topology);
+
+  std::cerr << "[microloop] " << topology.str() << "; placement " << placement.str()
+            << ": loop on CPUs " << utils::format_cpu_list(loop_cpus);
+  for (std::size_t i = 0; i != workers_cpus.size(); ++i)
+  {
+    std::cerr << ", worker " << i << " on CPUs " << utils::format_cpu_list(workers_cpus[i]);
+  }
+  std::cerr << "\n";
+}
+
 void EventLoop::add_event_source(EventSource *event_source)
 {
   std::uint32_t fd = event_source->get_fd();
@@ -68,22 +109,68 @@ void EventLoop::remove_event_source(EventSource *event_source)
     throw KernelException(errno);
   }
 
+  /*
+   * Another source of the running tick may be ready too, and its callback may remove this one, e.g.
+   * by closing the connection both belong to. Its event must not reach the deleted source.
+   */
+  for (int i = 0; i < tick_ready_; i++)
+  {
+    if (tick_events_[i].data.ptr == event_source)
+    {
+      tick_events_[i].data.ptr = nullptr;
+    }
+  }
+
   event_sources.erase(event_source->get_fd());
 }
 
+void EventLoop::pause_event_source(EventSource *event_source)
+{
+  epoll_event ev{};
+  ev.events = 0;
+  ev.data.ptr = static_cast<void *>(event_source);
+
+  if (epoll_ctl(epollfd, EPOLL_CTL_MOD, event_source->get_fd(), &ev) == -1)
+  {
+    throw KernelException(errno);
+  }
+}
+
+void EventLoop::resume_event_source(EventSource *event_source)
+{
+  epoll_event ev{};
+  ev.events = event_source->produced_events();
+  ev.data.ptr = static_cast<void *>(event_source);
+
+  if (epoll_ctl(epollfd, EPOLL_CTL_MOD, event_source->get_fd(), &ev) == -1)
+  {
+    throw KernelException(errno);
+  }
+}
+
 bool EventLoop::next_tick()
 {
-  epoll_event events_list[32]{};
+  tick_ready_ = 0;
 
-  auto ready = epoll_pwait(epollfd, events_list, 32, -1, &signals_monitor().get_sigmask());
+  auto ready = epoll_pwait(epollfd, tick_events_.data(), tick_events_.size(), -1,
+      &signals_monitor().get_sigmask());
   if (ready < 0)
   {
     return false;
   }
 
+  auto tick_start = std::chrono::steady_clock::now();
+
+  tick_ready_ = ready;
+
   for (int i = 0; i < ready; i++)
   {
-    auto &event = events_list[i];
+    auto &event = tick_events_[i];
+    if (!event.data.ptr)
+    {
+      continue;
+    }
+
     auto event_source = reinterpret_cast<EventSource *>(event.data.ptr);
     auto fd = event_source->get_fd();
     auto delete_event_source = false;
@@ -122,6 +209,15 @@ bool EventLoop::next_tick()
     }
   }
 
+  tick_ready_ = 0;
+
+  /*
+   * Events that became ready while the callbacks above were running wait at least that long before
+   * the next tick picks them up. A moving average smooths out single slow callbacks.
+   */
+  auto busy = std::chrono::steady_clock::now() - tick_start;
+  lag_ += (busy - lag_) / 4;
+
   return true;
 }
 
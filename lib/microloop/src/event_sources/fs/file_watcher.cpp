@@ -0,0 +1,94 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/event_sources/fs/file_watcher.h"
+
+#include "microloop/kernel_exception.h"
+
+#include <cstring>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+namespace microloop::event_sources::fs
+{
+
+namespace
+{
+
+std::uint32_t create_inotify()
+{
+  auto fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd == -1)
+  {
+    throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+  }
+
+  return fd;
+}
+
+}  // namespace
+
+FileWatcher::FileWatcher() : EventSource{create_inotify()}
+{}
+
+FileWatcher::~FileWatcher()
+{
+  ::close(get_fd());
+}
+
+int FileWatcher::watch(const char *path, std::uint32_t mask) noexcept
+{
+  return inotify_add_watch(get_fd(), path, mask);
+}
+
+void FileWatcher::unwatch(int wd) noexcept
+{
+  inotify_rm_watch(get_fd(), wd);
+}
+
+std::size_t FileWatcher::dispatch()
+{
+  /*
+   * Large enough for many events at once, and aligned for the events it holds.
+   */
+  alignas(inotify_event) char buf[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+
+  std::size_t count = 0;
+  while (true)
+  {
+    auto nread = ::read(get_fd(), buf, sizeof(buf));
+    if (nread == -1)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        return count;
+      }
+
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+    }
+
+    for (auto ptr = buf; ptr < buf + nread;)
+    {
+      inotify_event event;
+      std::memcpy(&event, ptr, sizeof(event));
+
+      auto name = ptr + sizeof(event);
+      ptr += sizeof(event) + event.len;
+      ++count;
+
+      if (on_event)
+      {
+        on_event(FileEvent{event.wd, event.mask, {name, ::strnlen(name, event.len)}});
+      }
+    }
+  }
+}
+
+}  // namespace microloop::event_sources::fs
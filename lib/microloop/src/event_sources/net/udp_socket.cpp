@@ -0,0 +1,395 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/event_sources/net/udp_socket.h"
+
+#include "microloop/kernel_exception.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+namespace microloop::event_sources::net
+{
+
+namespace
+{
+
+/**
+ * The largest payload a UDP datagram (or a GRO-coalesced train of datagrams) can carry.
+ */
+constexpr std::uint32_t max_udp_payload = 65535;
+
+/**
+ * Space for the single control message we expect on receive (the GRO segment size).
+ */
+constexpr std::size_t recv_control_size = CMSG_SPACE(sizeof(int));
+
+}  // namespace
+
+UdpSocket::UdpSocket(std::uint16_t port, Options options, BufferPool *pool) :
+    EventSource{create_socket(port)},
+    options{options},
+    recv_buffer_size{options.gro ? max_udp_payload : options.max_datagram_size},
+    pool{pool}
+{
+  if (!this->options.batch_size)
+  {
+    this->options.batch_size = 1;
+  }
+
+  try
+  {
+    if (!this->pool)
+    {
+      own_pool = std::make_unique<BufferPool>(
+          recv_buffer_size, this->options.batch_size, this->options.numa_node);
+      this->pool = own_pool.get();
+    }
+    else if (this->pool->block_size() < recv_buffer_size)
+    {
+      throw std::invalid_argument("the buffer pool blocks are too small for the receive buffers");
+    }
+
+    configure_offloads();
+
+    auto batch_size = this->options.batch_size;
+
+    blocks.reserve(batch_size);
+    for (std::uint32_t i = 0; i != batch_size; ++i)
+    {
+      blocks.push_back(this->pool->acquire());
+    }
+
+    recv_headers.resize(batch_size);
+    recv_iovecs.resize(batch_size);
+    recv_addrs.resize(batch_size);
+    recv_control.resize(batch_size * recv_control_size);
+    datagrams.reserve(batch_size);
+  }
+  catch (...)
+  {
+    for (auto block : blocks)
+    {
+      this->pool->release(block);
+    }
+
+    ::close(get_fd());
+
+    throw;
+  }
+}
+
+UdpSocket::~UdpSocket()
+{
+  for (auto block : blocks)
+  {
+    pool->release(block);
+  }
+
+  ::close(get_fd());
+}
+
+std::uint32_t UdpSocket::create_socket(std::uint16_t port)
+{
+  auto port_str = std::to_string(port);
+
+  addrinfo *results;
+  addrinfo hints{};
+  hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  auto err_code = getaddrinfo(nullptr, port_str.c_str(), &hints, &results);
+  if (err_code != 0)
+  {
+    std::stringstream err;
+    err << __PRETTY_FUNCTION__ << ": " << gai_strerror(err_code);
+
+    throw std::runtime_error(err.str());
+  }
+
+  std::int32_t fd = -1;
+  auto r = results;
+  for (; r != nullptr; r = r->ai_next)
+  {
+    fd = socket(r->ai_family, r->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, r->ai_protocol);
+    if (fd < 0)
+    {
+      continue;
+    }
+
+    if (bind(fd, r->ai_addr, r->ai_addrlen) == 0)
+    {
+      break;
+    }
+
+    close(fd);
+  }
+
+  freeaddrinfo(results);
+
+  if (r == nullptr)
+  {
+    std::stringstream err;
+    err << __PRETTY_FUNCTION__ << ": "
+        << "Failed to bind to port " << port;
+
+    throw std::runtime_error(err.str());
+  }
+
+  return static_cast<std::uint32_t>(fd);
+}
+
+void UdpSocket::configure_offloads()
+{
+  if (options.gro)
+  {
+    int val = 1;
+    if (setsockopt(get_fd(), SOL_UDP, UDP_GRO, &val, sizeof(val)) == -1)
+    {
+      throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+    }
+  }
+
+  if (options.gso_segment_size)
+  {
+    int val = options.gso_segment_size;
+    if (setsockopt(get_fd(), SOL_UDP, UDP_SEGMENT, &val, sizeof(val)) == -1)
+    {
+      throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+    }
+  }
+}
+
+std::pair<sockaddr_storage, socklen_t> UdpSocket::local_address() const
+{
+  sockaddr_storage addr{};
+  socklen_t addrlen = sizeof(addr);
+
+  if (getsockname(get_fd(), reinterpret_cast<sockaddr *>(&addr), &addrlen) == -1)
+  {
+    throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+  }
+
+  return std::make_pair(addr, addrlen);
+}
+
+void UdpSocket::reset_recv_headers()
+{
+  for (std::size_t i = 0; i != recv_headers.size(); ++i)
+  {
+    recv_iovecs[i].iov_base = blocks[i];
+    recv_iovecs[i].iov_len = recv_buffer_size;
+
+    auto &hdr = recv_headers[i].msg_hdr;
+    hdr.msg_name = &recv_addrs[i];
+    hdr.msg_namelen = sizeof(sockaddr_storage);
+    hdr.msg_iov = &recv_iovecs[i];
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = options.gro ? &recv_control[i * recv_control_size] : nullptr;
+    hdr.msg_controllen = options.gro ? recv_control_size : 0;
+    hdr.msg_flags = 0;
+
+    recv_headers[i].msg_len = 0;
+  }
+}
+
+void UdpSocket::collect(const mmsghdr &msg, std::size_t idx)
+{
+  if (msg.msg_hdr.msg_flags & MSG_TRUNC)
+  {
+    /*
+     * Part of the datagram was discarded by the kernel; delivering the rest would pass a corrupt
+     * payload off as a complete one.
+     */
+    ++truncated_count;
+    return;
+  }
+
+  std::string_view payload{blocks[idx], msg.msg_len};
+  const auto *addr = &recv_addrs[idx];
+  auto addrlen = msg.msg_hdr.msg_namelen;
+
+  std::size_t segment_size = 0;
+  if (options.gro)
+  {
+    auto hdr = const_cast<msghdr *>(&msg.msg_hdr);
+    for (auto cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+      {
+        int val = 0;
+        std::copy_n(CMSG_DATA(cmsg), sizeof(val), reinterpret_cast<unsigned char *>(&val));
+        segment_size = static_cast<std::size_t>(val);
+      }
+    }
+  }
+
+  if (!segment_size || payload.size() <= segment_size)
+  {
+    datagrams.push_back(Datagram{payload, addr, addrlen});
+    return;
+  }
+
+  /*
+   * The kernel coalesced several datagrams of the same flow into this buffer. All of them have the
+   * same size, except possibly the last one.
+   */
+  while (!payload.empty())
+  {
+    auto segment = payload.substr(0, segment_size);
+    payload.remove_prefix(segment.size());
+
+    datagrams.push_back(Datagram{segment, addr, addrlen});
+  }
+}
+
+void UdpSocket::run_callback()
+{
+  for (std::uint32_t batch = 0; batch != options.max_batches_per_tick; ++batch)
+  {
+    reset_recv_headers();
+
+    int nrecv
+        = recvmmsg(get_fd(), recv_headers.data(), recv_headers.size(), MSG_DONTWAIT, nullptr);
+    if (nrecv == -1)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      {
+        return;
+      }
+
+      throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+    }
+
+    datagrams.clear();
+    for (int i = 0; i != nrecv; ++i)
+    {
+      collect(recv_headers[i], i);
+    }
+
+    if (on_recv && !datagrams.empty())
+    {
+      on_recv(datagrams);
+    }
+
+    if (static_cast<std::size_t>(nrecv) < recv_headers.size())
+    {
+      /*
+       * A short batch means the socket receive queue has been drained.
+       */
+      return;
+    }
+  }
+}
+
+std::size_t UdpSocket::send_batch(const std::vector<OutgoingDatagram> &outgoing)
+{
+  if (send_headers.size() < outgoing.size())
+  {
+    send_headers.resize(outgoing.size());
+    send_iovecs.resize(outgoing.size());
+  }
+
+  for (std::size_t i = 0; i != outgoing.size(); ++i)
+  {
+    const auto &d = outgoing[i];
+
+    send_iovecs[i].iov_base = const_cast<char *>(d.payload.data());
+    send_iovecs[i].iov_len = d.payload.size();
+
+    auto &hdr = send_headers[i].msg_hdr;
+    hdr = msghdr{};
+    hdr.msg_name = const_cast<sockaddr *>(d.addr);
+    hdr.msg_namelen = d.addrlen;
+    hdr.msg_iov = &send_iovecs[i];
+    hdr.msg_iovlen = 1;
+  }
+
+  std::size_t total_sent = 0;
+  while (total_sent != outgoing.size())
+  {
+    int nsent = sendmmsg(get_fd(), send_headers.data() + total_sent, outgoing.size() - total_sent,
+        MSG_DONTWAIT);
+    if (nsent == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        break;
+      }
+
+      throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+    }
+
+    total_sent += nsent;
+  }
+
+  return total_sent;
+}
+
+bool UdpSocket::send_segmented(const sockaddr *addr, socklen_t addrlen, std::string_view payload,
+    std::uint16_t segment_size)
+{
+  iovec iov{const_cast<char *>(payload.data()), payload.size()};
+
+  msghdr hdr{};
+  hdr.msg_name = const_cast<sockaddr *>(addr);
+  hdr.msg_namelen = addrlen;
+  hdr.msg_iov = &iov;
+  hdr.msg_iovlen = 1;
+
+  char control[CMSG_SPACE(sizeof(std::uint16_t))]{};
+  if (segment_size && payload.size() > segment_size)
+  {
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    auto cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+    std::copy_n(reinterpret_cast<const unsigned char *>(&segment_size), sizeof(segment_size),
+        CMSG_DATA(cmsg));
+  }
+
+  while (sendmsg(get_fd(), &hdr, MSG_DONTWAIT) == -1)
+  {
+    if (errno == EINTR)
+    {
+      continue;
+    }
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+      return false;
+    }
+
+    throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+  }
+
+  return true;
+}
+
+}  // namespace microloop::event_sources::net
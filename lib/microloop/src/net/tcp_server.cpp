@@ -4,12 +4,17 @@
 
 #include "microloop/net/tcp_server.h"
 
+#include "microloop/event_sources/net/writable.h"
+#include "microloop/microloop.h"
 #include "microloop/utils/error.h"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <functional>
+#include <iostream>
+#include <limits.h>
 #include <netdb.h>
 #include <sstream>
 #include <stdexcept>
@@ -18,15 +23,57 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <utility>
 
 namespace microloop::net
 {
 
+namespace
+{
+
+/**
+ * \brief Skip the buffers sent entirely, and the sent prefix of a buffer sent partially.
+ */
+void skip_sent(std::vector<iovec>::iterator &first, std::vector<iovec>::iterator last,
+    std::size_t sent) noexcept
+{
+  while (first != last && sent >= first->iov_len)
+  {
+    sent -= first->iov_len;
+    ++first;
+  }
+
+  if (sent)
+  {
+    first->iov_base = static_cast<char *>(first->iov_base) + sent;
+    first->iov_len -= sent;
+  }
+}
+
+}  // namespace
+
 void TcpServer::PeerConnection::close()
 {
-  EventLoop::instance().remove_event_source(event_source_);
-  event_source_ = nullptr;
+  auto &event_loop = EventLoop::instance();
+
+  if (writable_source_)
+  {
+    event_loop.remove_event_source(writable_source_);
+    writable_source_ = nullptr;
+
+    if (::close(writable_fd_) == -1)
+    {
+      throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+    }
+  }
+
+  if (event_source_)
+  {
+    event_loop.remove_event_source(event_source_);
+    event_source_ = nullptr;
+  }
 
   if (::close(fd_) == -1)
   {
@@ -41,7 +88,7 @@ bool TcpServer::PeerConnection::send(const microloop::Buffer &buf)
   while (total_sent != buf.size())
   {
     const std::uint8_t *data = static_cast<const std::uint8_t *>(buf.data());
-    ssize_t nsent = ::send(fd_, data + total_sent, buf.size() - total_sent, 0);
+    ssize_t nsent = ::send(fd_, data + total_sent, buf.size() - total_sent, MSG_NOSIGNAL);
     if (nsent == -1)
     {
       /*
@@ -57,6 +104,51 @@ bool TcpServer::PeerConnection::send(const microloop::Buffer &buf)
   return true;
 }
 
+bool TcpServer::PeerConnection::send(const std::vector<microloop::Buffer> &bufs)
+{
+  std::vector<iovec> iov;
+  iov.reserve(bufs.size());
+  for (const auto &buf : bufs)
+  {
+    if (!buf.empty())
+    {
+      iov.push_back(iovec{const_cast<void *>(buf.data()), buf.size()});
+    }
+  }
+
+  return send(std::move(iov));
+}
+
+bool TcpServer::PeerConnection::send(std::vector<iovec> iov, bool more)
+{
+  auto first = iov.begin();
+  while (first != iov.end())
+  {
+    msghdr msg{};
+    msg.msg_iov = &*first;
+    msg.msg_iovlen = std::min<std::size_t>(iov.end() - first, IOV_MAX);
+
+    ssize_t nsent = ::sendmsg(fd_, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+    if (nsent == -1 && errno == EINTR)
+    {
+      continue;
+    }
+
+    if (nsent == -1)
+    {
+      /*
+       * The peer is gone, or the connection failed. With MSG_NOSIGNAL, a connection closed by the
+       * peer fails with EPIPE instead of raising SIGPIPE.
+       */
+      return false;
+    }
+
+    skip_sent(first, iov.end(), nsent);
+  }
+
+  return true;
+}
+
 bool TcpServer::PeerConnection::send_file(const std::filesystem::path &path)
 {
   auto read_fd = open(path.c_str(), O_RDONLY);
@@ -67,16 +159,303 @@ bool TcpServer::PeerConnection::send_file(const std::filesystem::path &path)
 
   struct stat stat_buf
   {};
-  off_t offset = 0;
-
-  fstat(read_fd, &stat_buf);
 
-  sendfile(fd_, read_fd, &offset, stat_buf.st_size);
+  auto sent = fstat(read_fd, &stat_buf) == 0 && send_file(read_fd, 0, stat_buf.st_size);
   ::close(read_fd);
 
+  return sent;
+}
+
+bool TcpServer::PeerConnection::send_file(int file_fd, off_t offset, std::size_t count)
+{
+  while (count)
+  {
+    ssize_t nsent = sendfile(fd_, file_fd, &offset, count);
+    if (nsent == -1 && errno == EINTR)
+    {
+      continue;
+    }
+
+    if (nsent <= 0)
+    {
+      /*
+       * Either an error or the file got shorter in the meantime.
+       */
+      return false;
+    }
+
+    count -= nsent;
+  }
+
   return true;
 }
 
+bool TcpServer::PeerConnection::write(microloop::Buffer buf)
+{
+  Output output;
+  output.buf = std::move(buf);
+
+  return enqueue(std::move(output));
+}
+
+bool TcpServer::PeerConnection::write(std::vector<iovec> iov, bool more)
+{
+  if (output_failed_)
+  {
+    return false;
+  }
+
+  /*
+   * With nothing queued, the ranges are sent from where they are, and only what the socket does
+   * not take right away is copied.
+   */
+  auto first = iov.begin();
+  while (output_.empty() && first != iov.end())
+  {
+    msghdr msg{};
+    msg.msg_iov = &*first;
+    msg.msg_iovlen = std::min<std::size_t>(iov.end() - first, IOV_MAX);
+
+    ssize_t nsent = ::sendmsg(fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+    if (nsent == -1 && errno == EINTR)
+    {
+      continue;
+    }
+
+    if (nsent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      break;
+    }
+
+    if (nsent == -1)
+    {
+      fail_output();
+      return false;
+    }
+
+    skip_sent(first, iov.end(), nsent);
+  }
+
+  std::size_t rest = 0;
+  for (auto it = first; it != iov.end(); ++it)
+  {
+    rest += it->iov_len;
+  }
+
+  microloop::Buffer buf{rest};
+  auto data = static_cast<char *>(buf.data());
+  for (auto it = first; it != iov.end(); ++it)
+  {
+    data = std::copy_n(static_cast<const char *>(it->iov_base), it->iov_len, data);
+  }
+
+  Output output;
+  output.buf = std::move(buf);
+
+  return enqueue(std::move(output));
+}
+
+bool TcpServer::PeerConnection::write_file(
+    std::shared_ptr<const void> file, int file_fd, off_t offset, std::size_t count)
+{
+  Output output;
+  output.file_fd = file_fd;
+  output.file_offset = offset;
+  output.file_count = count;
+  output.file = std::move(file);
+
+  return enqueue(std::move(output));
+}
+
+bool TcpServer::PeerConnection::enqueue(Output output)
+{
+  if (output_failed_)
+  {
+    return false;
+  }
+
+  if (output.size())
+  {
+    queued_bytes_ += output.size();
+    output_.push_back(std::move(output));
+
+    /*
+     * While the socket is watched for writability it is known to be full, and the event loop
+     * sends the queue as soon as it can take more.
+     */
+    if (!watching_writable_)
+    {
+      flush();
+    }
+  }
+
+  return writable();
+}
+
+void TcpServer::PeerConnection::flush()
+{
+  auto waited = watching_writable_;
+  while (!output_.empty())
+  {
+    auto is_file = output_.front().is_file();
+    auto nsent = is_file ? flush_file() : flush_bytes();
+    if (nsent == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        watch_writable(true);
+        return;
+      }
+    }
+
+    if (nsent == -1 || (nsent == 0 && is_file))
+    {
+      /*
+       * The peer is gone, or the file got shorter than its range, so the rest of the queue cannot
+       * be sent anymore.
+       */
+      fail_output();
+      break;
+    }
+
+    queued_bytes_ -= nsent;
+
+    /*
+     * Drop the parts sent entirely, and remember the sent prefix of a part sent partially.
+     */
+    auto sent = output_offset_ + static_cast<std::size_t>(nsent);
+    while (!output_.empty() && sent >= output_.front().size())
+    {
+      sent -= output_.front().size();
+      output_.pop_front();
+    }
+
+    output_offset_ = sent;
+  }
+
+  watch_writable(false);
+
+  if (waited && on_drain_)
+  {
+    on_drain_(*this);
+  }
+}
+
+ssize_t TcpServer::PeerConnection::flush_bytes()
+{
+  static constexpr std::size_t max_iov = 64;
+
+  iovec iov[max_iov];
+  std::size_t iovcnt = 0;
+  for (auto it = output_.begin(); it != output_.end() && !it->is_file() && iovcnt != max_iov;
+       ++it, ++iovcnt)
+  {
+    auto offset = iovcnt ? 0 : output_offset_;
+    iov[iovcnt].iov_base = static_cast<char *>(const_cast<void *>(it->buf.data())) + offset;
+    iov[iovcnt].iov_len = it->buf.size() - offset;
+  }
+
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iovcnt;
+
+  return ::sendmsg(fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+ssize_t TcpServer::PeerConnection::flush_file()
+{
+  const auto &output = output_.front();
+  off_t offset = output.file_offset + output_offset_;
+
+  /*
+   * sendfile has no MSG_DONTWAIT, so the socket is non-blocking for the duration of the call. The
+   * blocking sends are not used while output is queued.
+   */
+  auto flags = ::fcntl(fd_, F_GETFL);
+  if (flags == -1 || ::fcntl(fd_, F_SETFL, flags | O_NONBLOCK) == -1)
+  {
+    return -1;
+  }
+
+  auto nsent = ::sendfile(fd_, output.file_fd, &offset, output.file_count - output_offset_);
+  auto sendfile_errno = errno;
+  ::fcntl(fd_, F_SETFL, flags);
+  errno = sendfile_errno;
+
+  return nsent;
+}
+
+void TcpServer::PeerConnection::fail_output() noexcept
+{
+  output_failed_ = true;
+  output_.clear();
+  output_offset_ = 0;
+  queued_bytes_ = 0;
+}
+
+void TcpServer::PeerConnection::watch_writable(bool watch)
+{
+  using microloop::event_sources::net::Writable;
+
+  if (watch == watching_writable_)
+  {
+    return;
+  }
+
+  auto &event_loop = EventLoop::instance();
+  if (!watch)
+  {
+    event_loop.pause_event_source(writable_source_);
+  }
+  else if (writable_source_)
+  {
+    event_loop.resume_event_source(writable_source_);
+  }
+  else
+  {
+    writable_fd_ = ::dup(fd_);
+    if (writable_fd_ == -1)
+    {
+      throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+    }
+
+    auto writable_source = new Writable(writable_fd_);
+    writable_source->set_on_writable([this] { flush(); });
+
+    writable_source_ = writable_source;
+    event_loop.add_event_source(writable_source);
+  }
+
+  watching_writable_ = watch;
+}
+
+void TcpServer::PeerConnection::pause_reading()
+{
+  if (reading_paused_ || !event_source_)
+  {
+    return;
+  }
+
+  EventLoop::instance().pause_event_source(event_source_);
+  reading_paused_ = true;
+}
+
+void TcpServer::PeerConnection::resume_reading()
+{
+  if (!reading_paused_)
+  {
+    return;
+  }
+
+  EventLoop::instance().resume_event_source(event_source_);
+  reading_paused_ = false;
+}
+
 std::string TcpServer::PeerConnection::str(bool include_fd) const
 {
   static constexpr std::size_t port_strlen = 8;
@@ -114,7 +493,8 @@ TcpServer::TcpServer(std::uint16_t port) : port{port}
   auto server_fd = create_passive_socket(port);
 
   auto connection_handler = std::bind(&TcpServer::handle_connection, this, _1, _2, _3);
-  EventLoop::instance().add_event_source(new AwaitConnections(server_fd, connection_handler));
+  listener_ = new AwaitConnections(server_fd, connection_handler);
+  EventLoop::instance().add_event_source(listener_);
 
   microloop::EventLoop::instance().register_signal_handler(SIGINT, [](std::uint32_t) {
     /*
@@ -124,16 +504,49 @@ TcpServer::TcpServer(std::uint16_t port) : port{port}
     return true;
   });
 
+  /*
+   * A peer closing its connection while the server writes to it must fail the write, not kill the
+   * process. The sends pass MSG_NOSIGNAL, but sendfile has no such flag.
+   */
+  ::signal(SIGPIPE, SIG_IGN);
+
   fd_ = server_fd;
 }
 
+TcpServer::~TcpServer()
+{
+  auto &event_loop = EventLoop::instance();
+
+  /*
+   * Nothing useful can be done if the event loop fails to forget a source while the server goes
+   * away, and throwing from a destructor would terminate the process.
+   */
+  try
+  {
+    if (resume_check_)
+    {
+      event_loop.remove_event_source(resume_check_);
+    }
+
+    event_loop.remove_event_source(listener_);
+  }
+  catch (const microloop::KernelException &e)
+  {
+    std::cerr << "[" << __FILE__ << ":" << __LINE__ << "] " << e.what() << "\n";
+  }
+
+  ::close(fd_);
+}
+
 std::uint32_t TcpServer::create_passive_socket(std::uint16_t port)
 {
   auto port_str = std::to_string(port);
 
   addrinfo *results;
-  addrinfo hints{
-      .ai_flags = AI_PASSIVE | AI_NUMERICSERV, .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+  addrinfo hints{};
+  hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
 
   auto err_code = getaddrinfo(nullptr, port_str.c_str(), &hints, &results);
   if (err_code != 0)
@@ -199,6 +612,19 @@ void TcpServer::handle_connection(std::uint32_t fd, sockaddr_storage addr, sockl
   using microloop::event_sources::net::Receive;
   using namespace std::placeholders;
 
+  if (overloaded())
+  {
+    /*
+     * The connection was accepted before the listener could be paused (e.g. the loop started
+     * lagging in the meantime) or the policy asks for excess connections to be rejected explicitly.
+     */
+    reject(fd);
+    ++admission_stats_.rejected_connections;
+
+    update_admission();
+    return;
+  }
+
   auto [it, inserted] = peer_connections.try_emplace(fd, this, addr, addrlen, fd);
   if (!inserted)
   {
@@ -213,12 +639,102 @@ void TcpServer::handle_connection(std::uint32_t fd, sockaddr_storage addr, sockl
 
   EventLoop::instance().add_event_source(event_source);
 
+  update_admission();
+
   on_conn(peer_conn);
 }
 
 void TcpServer::close_conn(TcpServer::PeerConnection &conn)
 {
   peer_connections.erase(conn.fd());
+
+  update_admission();
+}
+
+void TcpServer::set_admission_policy(AdmissionPolicy policy)
+{
+  admission_policy_ = std::move(policy);
+
+  update_admission();
+}
+
+bool TcpServer::overloaded() const noexcept
+{
+  const auto &policy = admission_policy_;
+
+  if (policy.max_connections && peer_connections.size() >= policy.max_connections)
+  {
+    return true;
+  }
+
+  if (policy.max_loop_lag.count() && EventLoop::instance().lag() > policy.max_loop_lag)
+  {
+    return true;
+  }
+
+  return false;
+}
+
+void TcpServer::update_admission()
+{
+  auto &event_loop = EventLoop::instance();
+  auto &stats = admission_stats_;
+
+  /*
+   * When excess connections are rejected explicitly the listener must keep accepting them.
+   */
+  bool should_pause = !admission_policy_.reject_response && overloaded();
+
+  if (should_pause && !stats.listener_paused)
+  {
+    event_loop.pause_event_source(listener_);
+
+    stats.listener_paused = true;
+    ++stats.listener_pauses;
+  }
+  else if (!should_pause && stats.listener_paused)
+  {
+    event_loop.resume_event_source(listener_);
+
+    stats.listener_paused = false;
+  }
+
+  if (!stats.listener_paused || resume_check_)
+  {
+    return;
+  }
+
+  /*
+   * A lagging loop recovers without any connection being closed, so the listener is resumed from a
+   * timer rather than only from close_conn(). The timer is kept, so that the destructor can cancel
+   * it; the event loop deletes it once it has expired.
+   */
+  auto on_timeout = [this](auto &) {
+    resume_check_ = nullptr;
+    update_admission();
+  };
+
+  using ResumeCheck = microloop::event_sources::Timer<decltype(on_timeout)>;
+  resume_check_ = new ResumeCheck(admission_policy_.resume_check_interval,
+      microloop::event_sources::TimerType::TIMEOUT, &event_loop, on_timeout);
+  event_loop.add_event_source(resume_check_);
+}
+
+void TcpServer::reject(std::uint32_t fd)
+{
+  if (const auto &response = admission_policy_.reject_response; response)
+  {
+    /*
+     * The response is small enough to fit in the socket send buffer of a fresh connection, so a
+     * single non-blocking send is enough. If it fails, the peer just sees the connection closed.
+     */
+    ::send(fd, response->data(), response->size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
+
+  if (::close(fd) == -1)
+  {
+    throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+  }
 }
 
 }  // namespace microloop::net
@@ -0,0 +1,424 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/utils/cpu_topology.h"
+
+#include "microloop/kernel_exception.h"
+
+#include <algorithm>
+#include <charconv>
+#include <errno.h>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <map>
+#include <sched.h>
+#include <set>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace microloop::utils
+{
+
+namespace
+{
+
+std::optional<std::string> read_line(const std::string &path)
+{
+  std::ifstream file{path};
+  std::string line;
+  if (!file || !std::getline(file, line))
+  {
+    return std::nullopt;
+  }
+
+  return line;
+}
+
+std::optional<std::uint32_t> parse_uint(std::string_view str)
+{
+  std::uint32_t value = 0;
+  auto [end, err] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (err != std::errc{} || end != str.data() + str.size())
+  {
+    return std::nullopt;
+  }
+
+  return value;
+}
+
+std::uint32_t read_id(const std::string &path, std::uint32_t fallback)
+{
+  auto line = read_line(path);
+  if (!line)
+  {
+    return fallback;
+  }
+
+  return parse_uint(*line).value_or(fallback);
+}
+
+}  // namespace
+
+std::optional<std::vector<std::uint32_t>> parse_cpu_list(std::string_view str)
+{
+  std::vector<std::uint32_t> ids;
+
+  while (!str.empty())
+  {
+    auto comma = str.find(',');
+    auto item = str.substr(0, comma);
+    str.remove_prefix(comma == std::string_view::npos ? str.size() : comma + 1);
+
+    auto dash = item.find('-');
+    auto first = parse_uint(item.substr(0, dash));
+    auto last = dash == std::string_view::npos ? first : parse_uint(item.substr(dash + 1));
+    if (!first || !last || *first > *last || *last >= CPU_SETSIZE)
+    {
+      return std::nullopt;
+    }
+
+    for (auto id = *first; id <= *last; ++id)
+    {
+      ids.push_back(id);
+    }
+  }
+
+  return ids;
+}
+
+std::string format_cpu_list(const std::vector<std::uint32_t> &ids)
+{
+  std::ostringstream ss;
+
+  for (std::size_t i = 0; i < ids.size();)
+  {
+    auto j = i;
+    while (j + 1 < ids.size() && ids[j + 1] == ids[j] + 1)
+    {
+      ++j;
+    }
+
+    ss << (i ? "," : "") << ids[i];
+    if (j != i)
+    {
+      ss << "-" << ids[j];
+    }
+
+    i = j + 1;
+  }
+
+  return ss.str();
+}
+
+CpuTopology CpuTopology::detect()
+{
+  static const std::string sysfs_cpu = "/sys/devices/system/cpu/";
+  static const std::string sysfs_node = "/sys/devices/system/node/";
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+  {
+    throw KernelException(errno, __PRETTY_FUNCTION__);
+  }
+
+  std::map<std::uint32_t, std::uint32_t> node_of;
+  if (auto possible = read_line(sysfs_node + "possible"); possible)
+  {
+    for (auto node : parse_cpu_list(*possible).value_or(std::vector<std::uint32_t>{}))
+    {
+      auto cpulist = read_line(sysfs_node + "node" + std::to_string(node) + "/cpulist");
+      if (!cpulist)
+      {
+        continue;
+      }
+
+      for (auto cpu : parse_cpu_list(*cpulist).value_or(std::vector<std::uint32_t>{}))
+      {
+        node_of[cpu] = node;
+      }
+    }
+  }
+
+  CpuTopology topology;
+  for (std::uint32_t cpu = 0; cpu != CPU_SETSIZE; ++cpu)
+  {
+    if (!CPU_ISSET(cpu, &allowed))
+    {
+      continue;
+    }
+
+    auto dir = sysfs_cpu + "cpu" + std::to_string(cpu) + "/topology/";
+    auto node = node_of.find(cpu);
+
+    topology.cpus_.push_back(CpuInfo{cpu, read_id(dir + "core_id", cpu),
+        read_id(dir + "physical_package_id", 0), node == node_of.end() ? 0 : node->second});
+  }
+
+  return topology;
+}
+
+std::vector<std::uint32_t> CpuTopology::all() const
+{
+  std::vector<std::uint32_t> ids;
+  for (const auto &cpu : cpus_)
+  {
+    ids.push_back(cpu.id);
+  }
+
+  return ids;
+}
+
+std::vector<std::uint32_t> CpuTopology::one_per_core() const
+{
+  std::set<std::pair<std::uint32_t, std::uint32_t>> seen;
+  std::vector<std::uint32_t> ids;
+
+  for (const auto &cpu : cpus_)
+  {
+    if (seen.emplace(cpu.package, cpu.core).second)
+    {
+      ids.push_back(cpu.id);
+    }
+  }
+
+  return ids;
+}
+
+std::vector<std::uint32_t> CpuTopology::node_cpus(std::uint32_t node) const
+{
+  std::vector<std::uint32_t> ids;
+  for (const auto &cpu : cpus_)
+  {
+    if (cpu.node == node)
+    {
+      ids.push_back(cpu.id);
+    }
+  }
+
+  return ids;
+}
+
+std::size_t CpuTopology::nodes_count() const
+{
+  std::set<std::uint32_t> nodes;
+  for (const auto &cpu : cpus_)
+  {
+    nodes.insert(cpu.node);
+  }
+
+  return nodes.size();
+}
+
+std::string CpuTopology::str() const
+{
+  std::set<std::uint32_t> packages;
+  for (const auto &cpu : cpus_)
+  {
+    packages.insert(cpu.package);
+  }
+
+  std::ostringstream ss;
+  ss << nodes_count() << " NUMA node(s), " << packages.size() << " package(s), "
+     << one_per_core().size() << " core(s), " << cpus_.size() << " CPU(s)";
+
+  return ss.str();
+}
+
+std::optional<Placement> Placement::from_string(std::string_view str)
+{
+  Placement placement;
+
+  if (str == "any")
+  {
+    return placement;
+  }
+
+  if (str == "cores")
+  {
+    placement.policy = Policy::PHYSICAL_CORES;
+    return placement;
+  }
+
+  if (str.substr(0, 5) == "cpus:")
+  {
+    auto cpus = parse_cpu_list(str.substr(5));
+    if (!cpus || cpus->empty())
+    {
+      return std::nullopt;
+    }
+
+    placement.policy = Policy::CPUS;
+    placement.cpus = std::move(*cpus);
+    return placement;
+  }
+
+  if (str.substr(0, 5) == "node:")
+  {
+    auto node = parse_uint(str.substr(5));
+    if (!node)
+    {
+      return std::nullopt;
+    }
+
+    placement.policy = Policy::NUMA_NODE;
+    placement.node = *node;
+    return placement;
+  }
+
+  return std::nullopt;
+}
+
+std::optional<Placement> Placement::from_string(std::string_view str, const CpuTopology &topology)
+{
+  auto placement = from_string(str);
+  if (!placement)
+  {
+    return std::nullopt;
+  }
+
+  switch (placement->policy)
+  {
+  case Policy::CPUS:
+    for (auto cpu : placement->cpus)
+    {
+      const auto &cpus = topology.cpus();
+      auto in_topology = [cpu](const auto &info) { return info.id == cpu; };
+      if (std::none_of(cpus.begin(), cpus.end(), in_topology))
+      {
+        return std::nullopt;
+      }
+    }
+    break;
+  case Policy::NUMA_NODE:
+    if (topology.node_cpus(placement->node).empty())
+    {
+      return std::nullopt;
+    }
+    break;
+  default:
+    break;
+  }
+
+  return placement;
+}
+
+std::vector<std::vector<std::uint32_t>> Placement::assign(
+    const CpuTopology &topology, std::size_t count, std::size_t first_slot) const
+{
+  std::vector<std::vector<std::uint32_t>> sets(count, topology.all());
+
+  std::vector<std::uint32_t> cpus;
+  switch (policy)
+  {
+  case Policy::ANY:
+    return sets;
+  case Policy::CPUS:
+    cpus = this->cpus;
+    break;
+  case Policy::PHYSICAL_CORES:
+    cpus = topology.one_per_core();
+    break;
+  case Policy::NUMA_NODE:
+    std::fill(sets.begin(), sets.end(), topology.node_cpus(node));
+    return sets;
+  }
+
+  if (cpus.empty())
+  {
+    return sets;
+  }
+
+  for (std::size_t i = 0; i != count; ++i)
+  {
+    sets[i] = {cpus[(first_slot + i) % cpus.size()]};
+  }
+
+  return sets;
+}
+
+std::optional<std::uint32_t> Placement::numa_node(const CpuTopology &topology) const
+{
+  if (policy == Policy::NUMA_NODE)
+  {
+    return node;
+  }
+
+  if (policy != Policy::CPUS)
+  {
+    return std::nullopt;
+  }
+
+  std::set<std::uint32_t> nodes;
+  for (const auto &cpu : topology.cpus())
+  {
+    if (std::find(cpus.begin(), cpus.end(), cpu.id) != cpus.end())
+    {
+      nodes.insert(cpu.node);
+    }
+  }
+
+  if (nodes.size() != 1)
+  {
+    return std::nullopt;
+  }
+
+  return *nodes.begin();
+}
+
+std::string Placement::str() const
+{
+  switch (policy)
+  {
+  case Policy::CPUS:
+    return "cpus:" + format_cpu_list(cpus);
+  case Policy::PHYSICAL_CORES:
+    return "cores";
+  case Policy::NUMA_NODE:
+    return "node:" + std::to_string(node);
+  default:
+    return "any";
+  }
+}
+
+void pin_thread(pthread_t thread, const std::vector<std::uint32_t> &cpus)
+{
+  if (cpus.empty())
+  {
+    return;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus)
+  {
+    CPU_SET(cpu, &set);
+  }
+
+  if (auto err = pthread_setaffinity_np(thread, sizeof(set), &set); err != 0)
+  {
+    throw KernelException(err, __PRETTY_FUNCTION__);
+  }
+}
+
+void bind_to_node(void *addr, std::size_t len, std::uint32_t node)
+{
+  static constexpr std::size_t bits_per_word = 8 * sizeof(unsigned long);
+
+  std::vector<unsigned long> nodemask(node / bits_per_word + 1);
+  nodemask[node / bits_per_word] |= 1UL << (node % bits_per_word);
+
+  /*
+   * MPOL_PREFERRED rather than MPOL_BIND, so that allocations fall back to other nodes instead of
+   * failing when the node runs out of memory.
+   */
+  auto maxnode = nodemask.size() * bits_per_word;
+  if (syscall(SYS_mbind, addr, len, MPOL_PREFERRED, nodemask.data(), maxnode, 0) == -1)
+  {
+    throw KernelException(errno, __PRETTY_FUNCTION__);
+  }
+}
+
+}  // namespace microloop::utils
@@ -0,0 +1,66 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/utils/futex.h"
+
+#include "microloop/kernel_exception.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <limits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace microloop::utils::futex
+{
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+    "the futex word must be a plain 32-bit integer");
+
+void wait(std::atomic<std::uint32_t> &word, std::uint32_t expected)
+{
+  auto r = syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT_PRIVATE,
+      expected, nullptr, nullptr, 0);
+  if (r == -1 && errno != EAGAIN && errno != EINTR)
+  {
+    throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+  }
+}
+
+bool wait_for(
+    std::atomic<std::uint32_t> &word, std::uint32_t expected, std::chrono::nanoseconds timeout)
+{
+  auto seconds = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  timespec ts{static_cast<time_t>(seconds.count()), static_cast<long>((timeout - seconds).count())};
+
+  auto r = syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAIT_PRIVATE,
+      expected, &ts, nullptr, 0);
+  if (r == -1 && errno == ETIMEDOUT)
+  {
+    return false;
+  }
+
+  if (r == -1 && errno != EAGAIN && errno != EINTR)
+  {
+    throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+  }
+
+  return true;
+}
+
+void wake(std::atomic<std::uint32_t> &word, std::uint32_t count)
+{
+  count = std::min<std::uint32_t>(count, std::numeric_limits<int>::max());
+
+  auto r = syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word), FUTEX_WAKE_PRIVATE, count,
+      nullptr, nullptr, 0);
+  if (r == -1)
+  {
+    throw microloop::KernelException(errno, __PRETTY_FUNCTION__);
+  }
+}
+
+}  // namespace microloop::utils::futex
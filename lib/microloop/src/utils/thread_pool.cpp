@@ -4,14 +4,234 @@
 
 #include "microloop/utils/thread_pool.h"
 
+#include "microloop/utils/futex.h"
+
+#include <algorithm>
 #include <charconv>
 #include <cstdlib>
+#include <cstring>
 #include <pthread.h>
 #include <signal.h>
+#include <sstream>
 
 namespace microloop::utils
 {
 
+namespace
+{
+
+/**
+ * The worker running on the current thread, if the current thread belongs to a thread pool.
+ */
+struct CurrentWorker
+{
+  const ThreadPool *pool = nullptr;
+  void *worker = nullptr;
+};
+
+thread_local CurrentWorker current_worker;
+
+/**
+ * A cheap per-thread pseudo-random generator used to pick the victims of steal attempts.
+ */
+std::size_t next_random()
+{
+  thread_local std::uint64_t state
+      = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+
+  return static_cast<std::size_t>(state);
+}
+
+/**
+ * How many jobs a worker moves from the injection queue to its own deque at once.
+ */
+constexpr std::size_t INJECTION_BATCH_SIZE = 32;
+
+/**
+ * One job out of this many submitted by a thread has its queue wait time measured. Reading the
+ * clock costs about as much as the rest of submitting and running a small job.
+ */
+constexpr std::uint32_t WAIT_SAMPLING_PERIOD = 16;
+
+bool sample_wait_time() noexcept
+{
+  thread_local std::uint32_t submitted = 0;
+  return submitted++ % WAIT_SAMPLING_PERIOD == 0;
+}
+
+/**
+ * \brief A free list of fixed-size nodes, used for the jobs of all the thread pools.
+ *
+ * Jobs are usually allocated on one thread (e.g. the event loop) and freed on another (a worker),
+ * so every thread keeps a cache of free nodes and exchanges whole chains of nodes with a global
+ * list. The global lock is taken once every NODES_PER_CHAIN allocations or frees at most. Memory is
+ * never returned to the system: the free list holds on to as many nodes as were in use at the peak.
+ */
+template <std::size_t NodeSize, std::size_t NodeAlign>
+class NodeFreeList
+{
+  struct Node
+  {
+    Node *next;
+  };
+
+  struct Chain
+  {
+    Node *head;
+    std::size_t count;
+  };
+
+  /**
+   * The nodes cached by the current thread. They are handed back to the global list when the thread
+   * exits.
+   */
+  struct Cache
+  {
+    Node *head = nullptr;
+    std::size_t count = 0;
+
+    ~Cache()
+    {
+      if (head)
+      {
+        NodeFreeList::instance().put_chain(Chain{head, count});
+      }
+    }
+  };
+
+public:
+  static constexpr std::size_t NODES_PER_CHAIN = 64;
+
+  static NodeFreeList &instance()
+  {
+    /*
+     * Never destroyed, so that the caches of threads exiting late can still be given back.
+     */
+    static auto nodes = new NodeFreeList{};
+    return *nodes;
+  }
+
+  void *allocate()
+  {
+    auto &cache = thread_cache();
+    if (!cache.head)
+    {
+      auto chain = take_chain();
+      cache.head = chain.head;
+      cache.count = chain.count;
+    }
+
+    auto node = cache.head;
+    cache.head = node->next;
+    --cache.count;
+
+    return node;
+  }
+
+  void deallocate(void *ptr) noexcept
+  {
+    auto &cache = thread_cache();
+
+    auto node = static_cast<Node *>(ptr);
+    node->next = cache.head;
+    cache.head = node;
+
+    if (++cache.count < 2 * NODES_PER_CHAIN)
+    {
+      return;
+    }
+
+    /*
+     * Keep one chain for the next allocations on this thread and give the other one back.
+     */
+    auto last = cache.head;
+    for (std::size_t i = 1; i != NODES_PER_CHAIN; ++i)
+    {
+      last = last->next;
+    }
+
+    Chain chain{cache.head, NODES_PER_CHAIN};
+    cache.head = last->next;
+    cache.count -= NODES_PER_CHAIN;
+    last->next = nullptr;
+
+    put_chain(chain);
+  }
+
+private:
+  static Cache &thread_cache()
+  {
+    thread_local Cache cache;
+    return cache;
+  }
+
+  Chain take_chain()
+  {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (!chains_.empty())
+      {
+        auto chain = chains_.back();
+        chains_.pop_back();
+
+        return chain;
+      }
+    }
+
+    auto slab = static_cast<char *>(
+        ::operator new(node_size * NODES_PER_CHAIN, std::align_val_t{node_align}));
+
+    Node *head = nullptr;
+    for (std::size_t i = NODES_PER_CHAIN; i != 0; --i)
+    {
+      auto node = reinterpret_cast<Node *>(slab + (i - 1) * node_size);
+      node->next = head;
+      head = node;
+    }
+
+    return Chain{head, NODES_PER_CHAIN};
+  }
+
+  void put_chain(Chain chain) noexcept
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    /*
+     * The global list only grows up to the peak number of chains, so after warming up this does
+     * not allocate. Should it fail to, the nodes are leaked rather than lost mid-free.
+     */
+    try
+    {
+      chains_.push_back(chain);
+    }
+    catch (...)
+    {}
+  }
+
+  static constexpr std::size_t node_align = std::max(NodeAlign, alignof(Node));
+  static constexpr std::size_t node_size
+      = (std::max(NodeSize, sizeof(Node)) + node_align - 1) / node_align * node_align;
+
+  std::mutex mutex_;
+  std::vector<Chain> chains_;
+};
+
+}  // namespace
+
+void *ThreadPool::Job::operator new(std::size_t)
+{
+  return NodeFreeList<sizeof(Job), alignof(Job)>::instance().allocate();
+}
+
+void ThreadPool::Job::operator delete(void *ptr) noexcept
+{
+  NodeFreeList<sizeof(Job), alignof(Job)>::instance().deallocate(ptr);
+}
+
 ThreadPool::ThreadPool()
 {
   std::uint32_t threads_count = 0;
@@ -29,11 +249,72 @@ ThreadPool::ThreadPool()
     threads_count = std::min(threads_count, std::thread::hardware_concurrency() - 1);
   }
 
+  /*
+   * A single CPU leaves no room for a worker besides the event loop, but offloaded jobs still need
+   * one to run on.
+   */
+  threads_count = std::max<std::uint32_t>(threads_count, 1);
+
+  ElasticOptions options{threads_count, threads_count};
+
+  std::uint32_t min_workers = 0;
+  if (const char *val = std::getenv(MIN_WORKERS_ENV_VAR); val != nullptr)
+  {
+    std::from_chars(val, val + std::strlen(val) + 1, min_workers);
+  }
+
+  if (min_workers)
+  {
+    options.min_workers = std::clamp<std::uint32_t>(min_workers, 1, std::max(threads_count, 1u));
+    options.max_workers = std::max(threads_count, options.min_workers);
+  }
+
+  spawn_workers(options);
+}
+
+ThreadPool::ThreadPool(std::uint32_t threads_count)
+{
+  threads_count = std::min(threads_count, std::thread::hardware_concurrency() - 1);
+  threads_count = std::max<std::uint32_t>(threads_count, 1);
+
+  spawn_workers(ElasticOptions{threads_count, threads_count});
+}
+
+ThreadPool::ThreadPool(const ElasticOptions &options)
+{
+  /*
+   * Unlike fixed-size pools, the maximum is not capped to the number of CPUs: the point of growing
+   * is to keep the queues moving while workers are blocked (e.g. on I/O), not using a CPU.
+   */
+  auto bounded = options;
+  bounded.max_workers = std::max<std::uint32_t>(options.max_workers, 1);
+  bounded.min_workers = std::clamp<std::uint32_t>(options.min_workers, 1, bounded.max_workers);
+
+  spawn_workers(bounded);
+}
+
+void ThreadPool::spawn_workers(const ElasticOptions &options)
+{
+  options_ = options;
+
+  /*
+   * All the worker slots must exist before the first thread starts, since workers look at each
+   * other's deques when stealing.
+   */
+  for (std::uint32_t i = 0; i != options_.max_workers; ++i)
+  {
+    workers.push_back(std::make_unique<Worker>());
+  }
+
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  last_start_.store(std::chrono::nanoseconds{now}.count(), std::memory_order_relaxed);
+
   try
   {
-    for (std::uint8_t i = 0; i != threads_count; ++i)
+    std::lock_guard<std::mutex> lock{spawn_mutex_};
+    for (std::size_t i = 0; i != options_.min_workers; ++i)
     {
-      threads.emplace_back(&ThreadPool::worker, this);
+      start_worker(i);
     }
   }
   catch (...)
@@ -44,7 +325,245 @@ ThreadPool::ThreadPool()
   }
 }
 
-void ThreadPool::worker()
+void ThreadPool::start_worker(std::size_t idx)
+{
+  auto &slot = *workers[idx];
+
+  /*
+   * The previous thread of the slot retired, and is at most about to return.
+   */
+  if (slot.thread.joinable())
+  {
+    slot.thread.join();
+  }
+
+  slot.active.store(true, std::memory_order_relaxed);
+  try
+  {
+    slot.thread = std::thread{&ThreadPool::worker, this, idx};
+  }
+  catch (...)
+  {
+    slot.active.store(false, std::memory_order_relaxed);
+    throw;
+  }
+
+  active_count_.fetch_add(1, std::memory_order_relaxed);
+  pin_thread(slot.thread.native_handle(), slot.cpus);
+}
+
+void ThreadPool::maybe_grow(std::chrono::steady_clock::time_point now)
+{
+  if (!elastic() || size() >= workers.size() || idle_count_.load(std::memory_order_relaxed) != 0)
+  {
+    return;
+  }
+
+  auto now_ns = std::chrono::nanoseconds{now.time_since_epoch()}.count();
+  auto target_ns = std::chrono::nanoseconds{options_.target_wait}.count();
+  if (now_ns - last_growth_.load(std::memory_order_relaxed) < target_ns)
+  {
+    return;
+  }
+
+  /*
+   * Whoever is already spawning a worker is doing our job.
+   */
+  std::unique_lock<std::mutex> lock{spawn_mutex_, std::try_to_lock};
+  if (!lock || done_.load(std::memory_order_acquire))
+  {
+    return;
+  }
+
+  for (std::size_t i = 0; i != workers.size(); ++i)
+  {
+    if (!workers[i]->active.load(std::memory_order_relaxed))
+    {
+      last_growth_.store(now_ns, std::memory_order_relaxed);
+
+      /*
+       * Failing to spawn a thread leaves the pool at its current size, which still works.
+       */
+      try
+      {
+        start_worker(i);
+      }
+      catch (const std::exception &)
+      {}
+
+      return;
+    }
+  }
+}
+
+bool ThreadPool::try_retire(Worker &self)
+{
+  std::lock_guard<std::mutex> idle_lock{idle_mutex_};
+
+  /*
+   * A worker no longer in the idle list is being woken up, and has a job to look for.
+   */
+  auto it = std::find(idle_.begin(), idle_.end(), &self);
+  if (it == idle_.end())
+  {
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock{spawn_mutex_, std::try_to_lock};
+  if (!lock || size() <= options_.min_workers)
+  {
+    return false;
+  }
+
+  idle_.erase(it);
+  idle_count_.store(idle_.size(), std::memory_order_relaxed);
+
+  self.parked.store(0, std::memory_order_relaxed);
+  self.active.store(false, std::memory_order_relaxed);
+  active_count_.fetch_sub(1, std::memory_order_relaxed);
+
+  return true;
+}
+
+std::vector<std::vector<std::uint32_t>> ThreadPool::set_placement(
+    const Placement &placement, const CpuTopology &topology, std::size_t first_slot)
+{
+  std::lock_guard<std::mutex> lock{spawn_mutex_};
+
+  auto cpu_sets = placement.assign(topology, workers.size(), first_slot);
+  for (std::size_t i = 0; i != workers.size(); ++i)
+  {
+    workers[i]->cpus = cpu_sets[i];
+    if (workers[i]->active.load(std::memory_order_relaxed))
+    {
+      pin_thread(workers[i]->thread.native_handle(), cpu_sets[i]);
+    }
+  }
+
+  return cpu_sets;
+}
+
+ThreadPool::WaitTimeStats ThreadPool::wait_time_stats() const
+{
+  LatencyHistogram::Snapshot snapshot;
+  for (const auto &worker : workers)
+  {
+    snapshot.add(worker->wait_times);
+  }
+
+  return WaitTimeStats{snapshot.samples(), snapshot.percentile(50), snapshot.percentile(90),
+      snapshot.percentile(99)};
+}
+
+void ThreadPool::set_queue_limit(Priority priority, QueueLimit limit)
+{
+  auto &cls = priority_class(priority);
+  cls.capacity.store(limit.capacity, std::memory_order_relaxed);
+  cls.overflow.store(limit.overflow, std::memory_order_relaxed);
+
+  /*
+   * Blocked submitters re-check the new capacity.
+   */
+  cls.space.fetch_add(1, std::memory_order_seq_cst);
+  futex::wake(cls.space, INT32_MAX);
+}
+
+ThreadPool::QueueStats ThreadPool::queue_stats(Priority priority) const
+{
+  const auto &cls = classes[static_cast<std::size_t>(priority)];
+
+  return QueueStats{cls.depth.load(std::memory_order_relaxed),
+      cls.rejected.load(std::memory_order_relaxed), cls.blocked.load(std::memory_order_relaxed)};
+}
+
+bool ThreadPool::reserve(Priority priority, bool blocking, std::size_t count)
+{
+  auto &cls = priority_class(priority);
+
+  auto try_reserve = [&cls, count] {
+    auto capacity = cls.capacity.load(std::memory_order_relaxed);
+    if (!capacity)
+    {
+      cls.depth.fetch_add(count, std::memory_order_seq_cst);
+      return true;
+    }
+
+    /*
+     * A batch larger than the queue would never fit, so it is let into an empty queue instead.
+     */
+    auto depth = cls.depth.load(std::memory_order_relaxed);
+    while (depth + count <= capacity || depth == 0)
+    {
+      if (cls.depth.compare_exchange_weak(
+              depth, depth + count, std::memory_order_seq_cst, std::memory_order_relaxed))
+      {
+        return true;
+      }
+    }
+
+    return false;
+  };
+
+  if (try_reserve())
+  {
+    return true;
+  }
+
+  if (!blocking)
+  {
+    return false;
+  }
+
+  if (cls.overflow.load(std::memory_order_relaxed) == Overflow::REJECT)
+  {
+    cls.rejected.fetch_add(1, std::memory_order_relaxed);
+
+    std::ostringstream ss;
+    ss << "the queue of priority " << static_cast<int>(priority) << " jobs is full ("
+       << cls.capacity.load(std::memory_order_relaxed) << " jobs)";
+    throw QueueFullError(ss.str());
+  }
+
+  cls.blocked.fetch_add(1, std::memory_order_relaxed);
+  if (current_worker.pool == this)
+  {
+    return false;
+  }
+
+  /*
+   * Announcing ourselves before checking the depth again pairs with release(): either it sees a
+   * waiter and bumps the futex word, or we see the slot it freed.
+   */
+  cls.waiters.fetch_add(1, std::memory_order_seq_cst);
+  auto reserved = false;
+  while (!done_.load(std::memory_order_acquire))
+  {
+    auto seq = cls.space.load(std::memory_order_seq_cst);
+    if ((reserved = try_reserve()))
+    {
+      break;
+    }
+
+    futex::wait(cls.space, seq);
+  }
+  cls.waiters.fetch_sub(1, std::memory_order_relaxed);
+
+  return reserved;
+}
+
+void ThreadPool::release(Priority priority, std::size_t count) noexcept
+{
+  auto &cls = priority_class(priority);
+
+  cls.depth.fetch_sub(count, std::memory_order_seq_cst);
+  if (cls.waiters.load(std::memory_order_seq_cst) != 0)
+  {
+    cls.space.fetch_add(1, std::memory_order_seq_cst);
+    futex::wake(cls.space, count);
+  }
+}
+
+void ThreadPool::worker(std::size_t idx)
 {
   /*
    * We block all signals on the worker threads. Signals will only be received by the rooot thread
@@ -57,34 +576,309 @@ void ThreadPool::worker()
     throw microloop::KernelException(errno);
   }
 
-  while (!done_)
+  auto &self = *workers[idx];
+  current_worker = CurrentWorker{this, &self};
+
+  while (!done_.load(std::memory_order_acquire))
   {
-    auto &&curr_job = jobs.wait_pop();
-    if (curr_job.has_value())
+    if (auto job = find_job(self); job != nullptr)
     {
-      /*
-       * Note that we dereference the std::optional first so we can be able to access the
-       * std::unique_ptr contained within.
-       */
-      (*curr_job)->run();
+      release(job->priority);
+
+      if (job->queued_at != std::chrono::steady_clock::time_point{})
+      {
+        auto now = std::chrono::steady_clock::now();
+        auto waited = now - job->queued_at;
+        self.wait_times.record(waited);
+
+        if (elastic())
+        {
+          last_start_.store(
+              std::chrono::nanoseconds{now.time_since_epoch()}.count(), std::memory_order_relaxed);
+
+          if (waited > options_.target_wait)
+          {
+            maybe_grow(now);
+          }
+        }
+      }
+
+      job->run();
+      delete job;
+
+      continue;
+    }
+
+    if (!park(self))
+    {
+      break;
+    }
+  }
+
+  current_worker = CurrentWorker{};
+}
+
+void ThreadPool::schedule(Job *job)
+{
+  schedule_chain(job, job, 1, job->priority);
+}
+
+void ThreadPool::schedule_chain(Job *head, Job *tail, std::size_t count, Priority priority)
+{
+  auto sampled = sample_wait_time();
+  auto now = sampled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+  head->queued_at = now;
+  for (auto job = head; job != tail; job = job->next)
+  {
+    job->next->queued_at = now;
+  }
+
+  if (current_worker.pool == this && priority == Priority::NORMAL)
+  {
+    /*
+     * Jobs spawned by other jobs stay on the worker that spawned them, where their data is likely
+     * still in cache. Idle workers will steal them if this worker is busy.
+     */
+    auto &jobs = static_cast<Worker *>(current_worker.worker)->jobs;
+    for (auto job = head, end = tail->next; job != end;)
+    {
+      jobs.push(std::exchange(job, job->next));
+    }
+  }
+  else if (count == 1)
+  {
+    priority_class(priority).injected.push(head);
+  }
+  else
+  {
+    priority_class(priority).injected.push_chain(head, tail, count);
+  }
+
+  notify(count);
+
+  /*
+   * If the workers are all busy and none of them picked a job for a while, they are probably
+   * blocked and the waiting jobs will not be picked up by them any time soon.
+   */
+  if (sampled && elastic() && idle_count_.load(std::memory_order_relaxed) == 0
+      && priority_class(priority).depth.load(std::memory_order_relaxed) > count)
+  {
+    auto now_ns = std::chrono::nanoseconds{now.time_since_epoch()}.count();
+    auto target_ns = std::chrono::nanoseconds{options_.target_wait}.count();
+    if (now_ns - last_start_.load(std::memory_order_relaxed) > target_ns)
+    {
+      maybe_grow(now);
+    }
+  }
+}
+
+void ThreadPool::notify(std::size_t count)
+{
+  /*
+   * Pairs with the fence in park(): either the parking worker sees the job that was just queued, or
+   * we see that it is about to sleep and wake it up.
+   */
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (idle_count_.load(std::memory_order_relaxed) == 0)
+  {
+    return;
+  }
+
+  std::array<Worker *, 16> woken;
+  std::size_t woken_count = 0;
+  {
+    std::lock_guard<std::mutex> lock{idle_mutex_};
+
+    woken_count = std::min({count, idle_.size(), woken.size()});
+    for (std::size_t i = 0; i != woken_count; ++i)
+    {
+      woken[i] = idle_.back();
+      idle_.pop_back();
+    }
+
+    idle_count_.store(idle_.size(), std::memory_order_relaxed);
+  }
+
+  /*
+   * Workers finding more jobs than they can take wake up others in turn (see find_job()), so there
+   * is no need to wake up more than a handful here.
+   */
+  for (std::size_t i = 0; i != woken_count; ++i)
+  {
+    woken[i]->parked.store(0, std::memory_order_release);
+    futex::wake(woken[i]->parked, 1);
+  }
+}
+
+ThreadPool::Job *ThreadPool::find_job(Worker &self)
+{
+  /*
+   * High priority jobs are taken one at a time, so that they are spread over the idle workers
+   * rather than queued behind each other on one of them.
+   */
+  if (auto job = priority_class(Priority::HIGH).injected.try_pop(); job != nullptr)
+  {
+    return job;
+  }
+
+  if (auto job = self.jobs.pop(); job)
+  {
+    return *job;
+  }
+
+  /*
+   * Taking a share of the injected jobs at once amortizes the cost of locking the injection queue.
+   * The jobs moved to our deque can still be stolen by the other workers.
+   */
+  auto &normal = priority_class(Priority::NORMAL).injected;
+  if (auto job = normal.try_pop_batch(self.jobs, INJECTION_BATCH_SIZE); job != nullptr)
+  {
+    if (!self.jobs.empty() || !normal.empty())
+    {
+      notify();
+    }
+
+    return job;
+  }
+
+  auto count = workers.size();
+  auto start = next_random() % count;
+  for (std::size_t i = 0; i != count; ++i)
+  {
+    auto &victim = *workers[(start + i) % count];
+    if (&victim == &self)
+    {
+      continue;
+    }
+
+    if (auto job = victim.jobs.steal(); job)
+    {
+      if (!victim.jobs.empty())
+      {
+        notify();
+      }
+
+      return *job;
     }
   }
+
+  return priority_class(Priority::LOW).injected.try_pop();
+}
+
+bool ThreadPool::has_jobs() const noexcept
+{
+  if (std::any_of(
+          classes.begin(), classes.end(), [](const auto &cls) { return !cls.injected.empty(); }))
+  {
+    return true;
+  }
+
+  return std::any_of(
+      workers.begin(), workers.end(), [](const auto &w) { return !w->jobs.empty(); });
+}
+
+bool ThreadPool::park(Worker &self)
+{
+  {
+    std::lock_guard<std::mutex> lock{idle_mutex_};
+    self.parked.store(1, std::memory_order_relaxed);
+    idle_.push_back(&self);
+    idle_count_.store(idle_.size(), std::memory_order_relaxed);
+  }
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  /*
+   * A job may have been scheduled after we last looked for one, but before we announced that we
+   * are going to sleep. In that case the scheduler did not see us, so we must not sleep.
+   */
+  if (has_jobs() || done_.load(std::memory_order_acquire))
+  {
+    std::lock_guard<std::mutex> lock{idle_mutex_};
+    if (auto it = std::find(idle_.begin(), idle_.end(), &self); it != idle_.end())
+    {
+      idle_.erase(it);
+      idle_count_.store(idle_.size(), std::memory_order_relaxed);
+    }
+
+    self.parked.store(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  while (self.parked.load(std::memory_order_acquire) && !done_.load(std::memory_order_acquire))
+  {
+    if (!elastic() || size() <= options_.min_workers)
+    {
+      futex::wait(self.parked, 1);
+    }
+    else if (!futex::wait_for(self.parked, 1, options_.idle_timeout) && try_retire(self))
+    {
+      return false;
+    }
+  }
+
+  return true;
 }
 
 void ThreadPool::destroy()
 {
   done_ = true;
-  jobs.invalidate();
 
-  for (auto &thread : threads)
+  /*
+   * Wait for a worker being spawned, if any. No worker is spawned once the pool is done.
+   */
+  {
+    std::lock_guard<std::mutex> lock{spawn_mutex_};
+  }
+
+  for (auto &cls : classes)
   {
-    if (thread.joinable())
+    cls.space.fetch_add(1, std::memory_order_seq_cst);
+    futex::wake(cls.space, INT32_MAX);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{idle_mutex_};
+    for (auto worker : idle_)
+    {
+      worker->parked.store(0, std::memory_order_release);
+      futex::wake(worker->parked, 1);
+    }
+
+    idle_.clear();
+    idle_count_.store(0, std::memory_order_relaxed);
+  }
+
+  for (auto &worker : workers)
+  {
+    if (worker->thread.joinable())
+    {
+      worker->thread.join();
+    }
+  }
+
+  /*
+   * Jobs that did not get to run are dropped.
+   */
+  for (auto &worker : workers)
+  {
+    while (auto job = worker->jobs.pop())
     {
-      thread.join();
+      delete *job;
     }
   }
 
-  threads.clear();
+  for (auto &cls : classes)
+  {
+    while (auto job = cls.injected.try_pop())
+    {
+      delete job;
+    }
+
+    cls.depth.store(0, std::memory_order_relaxed);
+  }
+
+  workers.clear();
 }
 
 }  // namespace microloop::utils
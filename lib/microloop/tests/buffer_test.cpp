@@ -8,6 +8,7 @@
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <tuple>
 
 namespace microloop
@@ -117,6 +118,18 @@ TEST(Buffer, ConcatOperator)
   ASSERT_EQ(std::memcmp(a.data(), expected_data, a.size()), 0);
 }
 
+TEST(Buffer, AppendKeepsNulBytes)
+{
+  Buffer a{"foo"};
+  const char bytes[] = {'\0', 'b', 'a', 'r'};
+
+  a.append(std::string_view{bytes, sizeof(bytes)});
+
+  const char expected_data[] = {'f', 'o', 'o', '\0', 'b', 'a', 'r'};
+  ASSERT_EQ(a.size(), sizeof(expected_data));
+  ASSERT_EQ(std::memcmp(a.data(), expected_data, a.size()), 0);
+}
+
 TEST(Buffer, RemovePrefix)
 {
   microloop::Buffer buf{"foo bar"};
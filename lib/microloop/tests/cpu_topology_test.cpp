@@ -0,0 +1,149 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/buffer_pool.h"
+#include "microloop/utils/cpu_topology.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+namespace microloop::utils
+{
+
+using Ids = std::vector<std::uint32_t>;
+
+TEST(CpuTopology, ParsesCpuLists)
+{
+  EXPECT_EQ(parse_cpu_list("0"), Ids{0});
+  EXPECT_EQ(parse_cpu_list("0-3,8,10-11"), (Ids{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(parse_cpu_list(""), Ids{});
+
+  EXPECT_FALSE(parse_cpu_list("3-1"));
+  EXPECT_FALSE(parse_cpu_list("a"));
+  EXPECT_FALSE(parse_cpu_list("1,,2"));
+  EXPECT_FALSE(parse_cpu_list("0-" + std::to_string(CPU_SETSIZE)));
+  EXPECT_FALSE(parse_cpu_list("4294967290-4294967295"));
+}
+
+TEST(CpuTopology, FormatsCpuLists)
+{
+  EXPECT_EQ(format_cpu_list({}), "");
+  EXPECT_EQ(format_cpu_list({4}), "4");
+  EXPECT_EQ(format_cpu_list({0, 1, 2, 3, 8, 10, 11}), "0-3,8,10-11");
+}
+
+TEST(CpuTopology, DetectsTheAllowedCpus)
+{
+  auto topology = CpuTopology::detect();
+
+  ASSERT_FALSE(topology.cpus().empty());
+  EXPECT_GE(topology.nodes_count(), 1);
+  EXPECT_LE(topology.one_per_core().size(), topology.cpus().size());
+  EXPECT_FALSE(topology.one_per_core().empty());
+
+  auto cpus = topology.all();
+  EXPECT_NE(std::find(cpus.begin(), cpus.end(), static_cast<std::uint32_t>(sched_getcpu())),
+      cpus.end());
+}
+
+TEST(Placement, ParsesFromString)
+{
+  auto any = Placement::from_string("any");
+  ASSERT_TRUE(any);
+  EXPECT_EQ(any->policy, Placement::Policy::ANY);
+
+  auto cores = Placement::from_string("cores");
+  ASSERT_TRUE(cores);
+  EXPECT_EQ(cores->policy, Placement::Policy::PHYSICAL_CORES);
+
+  auto cpus = Placement::from_string("cpus:1-2,5");
+  ASSERT_TRUE(cpus);
+  EXPECT_EQ(cpus->policy, Placement::Policy::CPUS);
+  EXPECT_EQ(cpus->cpus, (Ids{1, 2, 5}));
+  EXPECT_EQ(cpus->str(), "cpus:1-2,5");
+
+  auto node = Placement::from_string("node:1");
+  ASSERT_TRUE(node);
+  EXPECT_EQ(node->policy, Placement::Policy::NUMA_NODE);
+  EXPECT_EQ(node->node, 1);
+
+  EXPECT_FALSE(Placement::from_string("cpus:"));
+  EXPECT_FALSE(Placement::from_string("node:x"));
+  EXPECT_FALSE(Placement::from_string("everywhere"));
+}
+
+TEST(Placement, ChecksTheCpusAgainstTheTopology)
+{
+  auto topology = CpuTopology::detect();
+  auto cpus = topology.all();
+  auto first = std::to_string(cpus.front());
+
+  auto placement = Placement::from_string("cpus:" + first, topology);
+  ASSERT_TRUE(placement);
+  EXPECT_EQ(placement->cpus, Ids{cpus.front()});
+
+  EXPECT_TRUE(Placement::from_string("cores", topology));
+  EXPECT_TRUE(Placement::from_string("node:" + std::to_string(topology.cpus().front().node),
+      topology));
+
+  auto outside = std::to_string(cpus.back() + 1);
+  EXPECT_FALSE(Placement::from_string("cpus:" + first + "," + outside, topology));
+  EXPECT_FALSE(Placement::from_string("node:" + std::to_string(CPU_SETSIZE), topology));
+  EXPECT_FALSE(Placement::from_string("cpus:4294967290-4294967295", topology));
+}
+
+TEST(Placement, AssignsCpusRoundRobinFromTheFirstSlot)
+{
+  auto topology = CpuTopology::detect();
+  auto placement = *Placement::from_string("cpus:4-6");
+
+  auto sets = placement.assign(topology, 4, 1);
+  ASSERT_EQ(sets.size(), 4);
+  EXPECT_EQ(sets[0], Ids{5});
+  EXPECT_EQ(sets[1], Ids{6});
+  EXPECT_EQ(sets[2], Ids{4});
+  EXPECT_EQ(sets[3], Ids{5});
+}
+
+TEST(Placement, LeavesThreadsOnAllCpusWithoutPolicy)
+{
+  auto topology = CpuTopology::detect();
+
+  for (const auto &set : Placement{}.assign(topology, 3))
+  {
+    EXPECT_EQ(set, topology.all());
+  }
+}
+
+TEST(Placement, PinsTheCallingThread)
+{
+  auto topology = CpuTopology::detect();
+  auto cpu = topology.all().front();
+
+  pin_thread(pthread_self(), {cpu});
+  EXPECT_EQ(static_cast<std::uint32_t>(sched_getcpu()), cpu);
+
+  pin_thread(pthread_self(), topology.all());
+}
+
+TEST(BufferPool, AllocatesOnNumaNode)
+{
+  auto topology = CpuTopology::detect();
+  BufferPool pool{256, 4, topology.cpus().front().node};
+
+  auto block = pool.acquire();
+  std::memset(block, 0xab, pool.block_size());
+  pool.release(block);
+
+  EXPECT_EQ(pool.capacity(), 4);
+  EXPECT_EQ(pool.available(), 4);
+}
+
+}  // namespace microloop::utils
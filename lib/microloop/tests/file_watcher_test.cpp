@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/event_sources/fs/file_watcher.h"
+
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <fstream>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace microloop::event_sources::fs
+{
+
+/**
+ * \brief Create a file with some content in a new temporary directory.
+ * \returns The path of the directory.
+ */
+static std::string make_dir_with_file(const char *name)
+{
+  char dir[] = "/tmp/file_watcher_testXXXXXX";
+  EXPECT_NE(::mkdtemp(dir), nullptr);
+
+  std::ofstream{std::string{dir} + "/" + name} << "content";
+
+  return dir;
+}
+
+TEST(FileWatcher, ReportsChangesToAFile)
+{
+  auto dir = make_dir_with_file("watched");
+  auto path = dir + "/watched";
+
+  FileWatcher watcher;
+  std::vector<FileEvent> events;
+  watcher.set_on_event([&events](const auto &event) { events.push_back(event); });
+
+  auto wd = watcher.watch(path.c_str(), IN_MODIFY | IN_DELETE_SELF);
+  ASSERT_NE(wd, -1);
+  EXPECT_EQ(watcher.watch(path.c_str(), IN_MODIFY | IN_DELETE_SELF), wd);
+  EXPECT_EQ(watcher.dispatch(), 0u);
+
+  std::ofstream{path, std::ios::app} << " changed";
+  EXPECT_GE(watcher.dispatch(), 1u);
+  ASSERT_FALSE(events.empty());
+  EXPECT_EQ(events[0].wd, wd);
+  EXPECT_TRUE(events[0].mask & IN_MODIFY);
+  EXPECT_TRUE(events[0].name.empty());
+
+  events.clear();
+  ASSERT_EQ(::unlink(path.c_str()), 0);
+  watcher.dispatch();
+
+  /*
+   * Deleting the file removes the watch, which is reported after the deletion.
+   */
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_TRUE(events[0].mask & IN_DELETE_SELF);
+  EXPECT_TRUE(events[1].mask & IN_IGNORED);
+
+  ::rmdir(dir.c_str());
+}
+
+TEST(FileWatcher, ReportsNamesInADirectory)
+{
+  auto dir = make_dir_with_file("first");
+
+  FileWatcher watcher;
+  std::vector<std::pair<std::string, std::uint32_t>> events;
+  watcher.set_on_event(
+      [&events](const auto &event) { events.emplace_back(event.name, event.mask); });
+
+  auto wd = watcher.watch(dir.c_str(), IN_CREATE | IN_DELETE);
+  ASSERT_NE(wd, -1);
+
+  std::ofstream{dir + "/second"} << "content";
+  ASSERT_EQ(::unlink((dir + "/first").c_str()), 0);
+  watcher.dispatch();
+
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[0].first, "second");
+  EXPECT_TRUE(events[0].second & IN_CREATE);
+  EXPECT_EQ(events[1].first, "first");
+  EXPECT_TRUE(events[1].second & IN_DELETE);
+
+  /*
+   * Once unwatched, the changes in the directory are no longer reported.
+   */
+  events.clear();
+  watcher.unwatch(wd);
+  ASSERT_EQ(::unlink((dir + "/second").c_str()), 0);
+  watcher.dispatch();
+
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_TRUE(events[0].second & IN_IGNORED);
+
+  ::rmdir(dir.c_str());
+}
+
+TEST(FileWatcher, CannotWatchMissingPaths)
+{
+  FileWatcher watcher;
+  EXPECT_EQ(watcher.watch("/tmp/file_watcher_test_missing/file", IN_MODIFY), -1);
+}
+
+}  // namespace microloop::event_sources::fs
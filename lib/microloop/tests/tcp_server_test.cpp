@@ -0,0 +1,237 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/microloop.h"
+#include "microloop/net/tcp_server.h"
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace microloop::net
+{
+
+/**
+ * \brief A server on an ephemeral port, closing the connections its peers close.
+ */
+class TestServer
+{
+public:
+  TestServer() : server{0}
+  {
+    server.set_connection_callback([this](auto &conn) { conns.push_back(&conn); });
+    server.set_data_callback([this](auto &conn, const auto &buf) {
+      if (buf.empty())
+      {
+        forget(conn);
+        server.close_conn(conn);
+      }
+    });
+  }
+
+  /**
+   * \brief Connect a new client to the server, over the loopback interface.
+   */
+  int connect_client() const
+  {
+    sockaddr_storage addr{};
+    socklen_t addrlen = sizeof(addr);
+    EXPECT_EQ(getsockname(server.fd(), reinterpret_cast<sockaddr *>(&addr), &addrlen), 0);
+
+    if (addr.ss_family == AF_INET6)
+    {
+      reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_addr = in6addr_loopback;
+    }
+    else
+    {
+      reinterpret_cast<sockaddr_in *>(&addr)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+
+    auto fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    EXPECT_EQ(connect(fd, reinterpret_cast<sockaddr *>(&addr), addrlen), 0);
+
+    return fd;
+  }
+
+  void close_first()
+  {
+    auto conn = conns.front();
+    forget(*conn);
+    server.close_conn(*conn);
+  }
+
+  TcpServer server;
+  std::vector<TcpServer::PeerConnection *> conns;
+
+private:
+  void forget(TcpServer::PeerConnection &conn)
+  {
+    conns.erase(std::remove(conns.begin(), conns.end(), &conn), conns.end());
+  }
+};
+
+/**
+ * \brief Run the event loop until the condition holds, for a bounded number of ticks.
+ */
+static bool tick_until(const std::function<bool()> &condition)
+{
+  for (int tick = 0; tick != 1000 && !condition(); ++tick)
+  {
+    EventLoop::instance().next_tick();
+  }
+
+  return condition();
+}
+
+TEST(TcpServer, ConnectionCapPausesTheListener)
+{
+  TestServer test;
+
+  TcpServer::AdmissionPolicy policy;
+  policy.max_connections = 1;
+  test.server.set_admission_policy(policy);
+
+  auto first = test.connect_client();
+  ASSERT_TRUE(tick_until([&] { return test.conns.size() == 1; }));
+
+  const auto &stats = test.server.admission_stats();
+  EXPECT_TRUE(stats.listener_paused);
+  EXPECT_EQ(stats.listener_pauses, 1u);
+
+  /*
+   * The second connection waits in the backlog until the first one is closed.
+   */
+  auto second = test.connect_client();
+  test.close_first();
+  EXPECT_FALSE(stats.listener_paused);
+
+  ASSERT_TRUE(tick_until([&] { return test.conns.size() == 1; }));
+  EXPECT_EQ(test.server.connections_count(), 1u);
+  EXPECT_EQ(stats.rejected_connections, 0u);
+
+  ::close(first);
+  ::close(second);
+}
+
+TEST(TcpServer, RejectsExcessConnections)
+{
+  TestServer test;
+
+  std::string response = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+
+  TcpServer::AdmissionPolicy policy;
+  policy.max_connections = 1;
+  policy.reject_response = microloop::Buffer{response.c_str()};
+  test.server.set_admission_policy(policy);
+
+  auto first = test.connect_client();
+  ASSERT_TRUE(tick_until([&] { return test.conns.size() == 1; }));
+
+  const auto &stats = test.server.admission_stats();
+  EXPECT_FALSE(stats.listener_paused);
+
+  auto second = test.connect_client();
+  ASSERT_TRUE(tick_until([&] { return stats.rejected_connections == 1; }));
+  EXPECT_EQ(test.server.connections_count(), 1u);
+  EXPECT_EQ(stats.listener_pauses, 0u);
+
+  std::string received;
+  char buf[256];
+  for (ssize_t nread; (nread = ::recv(second, buf, sizeof(buf), 0)) > 0;)
+  {
+    received.append(buf, nread);
+  }
+
+  EXPECT_EQ(received, response);
+
+  ::close(first);
+  ::close(second);
+}
+
+TEST(TcpServer, LaggingLoopPausesTheListenerUntilItRecovers)
+{
+  using namespace std::chrono_literals;
+
+  auto &event_loop = EventLoop::instance();
+
+  /*
+   * Slow callbacks raise the lag of the event loop.
+   */
+  int slow_ticks = 0;
+  microloop::timers::set_interval(1ms, &event_loop, [&slow_ticks](auto &controller) {
+    std::this_thread::sleep_for(20ms);
+    if (++slow_ticks == 4)
+    {
+      controller.cancel();
+    }
+  });
+
+  ASSERT_TRUE(tick_until([&] { return slow_ticks == 4; }));
+
+  ASSERT_GT(event_loop.lag(), 5ms);
+
+  TestServer test;
+
+  TcpServer::AdmissionPolicy policy;
+  policy.max_loop_lag = 5ms;
+  policy.resume_check_interval = 1ms;
+  test.server.set_admission_policy(policy);
+
+  const auto &stats = test.server.admission_stats();
+  EXPECT_TRUE(stats.listener_paused);
+  EXPECT_EQ(stats.listener_pauses, 1u);
+
+  /*
+   * Nothing but the admission check runs from now on, so the lag drops and the listener resumes.
+   */
+  ASSERT_TRUE(tick_until([&] { return !stats.listener_paused; }));
+  EXPECT_LE(event_loop.lag(), 5ms);
+  EXPECT_EQ(stats.listener_pauses, 1u);
+
+  auto client = test.connect_client();
+  ASSERT_TRUE(tick_until([&] { return test.conns.size() == 1; }));
+
+  ::close(client);
+}
+
+TEST(TcpServer, DestructorCancelsThePendingAdmissionCheck)
+{
+  using namespace std::chrono_literals;
+
+  auto &event_loop = EventLoop::instance();
+
+  {
+    TestServer test;
+
+    TcpServer::AdmissionPolicy policy;
+    policy.max_connections = 1;
+    policy.resume_check_interval = 1ms;
+    test.server.set_admission_policy(policy);
+
+    auto client = test.connect_client();
+    ASSERT_TRUE(tick_until([&] { return test.server.admission_stats().listener_paused; }));
+
+    ::close(client);
+  }
+
+  /*
+   * The admission check would have expired by now, and must not run on the destroyed server.
+   */
+  std::this_thread::sleep_for(5ms);
+
+  bool expired = false;
+  microloop::timers::set_timeout(10ms, &event_loop, [&expired](auto &) { expired = true; });
+  ASSERT_TRUE(tick_until([&] { return expired; }));
+}
+
+}  // namespace microloop::net
@@ -0,0 +1,785 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/utils/completion.h"
+#include "microloop/utils/latency_histogram.h"
+#include "microloop/utils/thread_pool.h"
+#include "microloop/utils/work_stealing_deque.h"
+
+#include "gtest/gtest.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Count the allocations made by the current thread, so that tests can check that code paths do not
+ * allocate. All the replaceable allocation functions are replaced, so that every allocation is
+ * counted and released by the matching function. They are kept out of line, so that the compiler
+ * does not pair the `malloc` and `free` calls inside them with `new` and `delete` expressions.
+ */
+static thread_local std::uint64_t allocations_count = 0;
+
+[[gnu::noinline]] static void *counted_alloc(std::size_t size) noexcept
+{
+  ++allocations_count;
+  return std::malloc(size ? size : 1);
+}
+
+[[gnu::noinline]] static void counted_free(void *ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void *operator new(std::size_t size)
+{
+  if (auto ptr = counted_alloc(size); ptr)
+  {
+    return ptr;
+  }
+
+  throw std::bad_alloc{};
+}
+
+void *operator new[](std::size_t size)
+{
+  return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_alloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_alloc(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+  counted_free(ptr);
+}
+
+namespace microloop::utils
+{
+
+/**
+ * \brief Wait until the counter reaches the expected value or a generous timeout expires.
+ */
+static bool wait_for(const std::atomic<std::uint64_t> &counter, std::uint64_t expected)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (counter.load() != expected && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::yield();
+  }
+
+  return counter.load() == expected;
+}
+
+/**
+ * \brief An executor whose callbacks are run explicitly by the test, in place of the event loop.
+ */
+class ManualExecutor : public Executor
+{
+public:
+  void post(UniqueFunction<void()> callback) override
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    callbacks_.push_back(std::move(callback));
+    posted_.store(callbacks_.size());
+  }
+
+  /**
+   * \brief Wait for a callback to be posted, then run all the posted callbacks on this thread.
+   */
+  std::size_t run_posted()
+  {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+    while (!posted_.load() && std::chrono::steady_clock::now() < deadline)
+    {
+      std::this_thread::yield();
+    }
+
+    std::vector<UniqueFunction<void()>> callbacks;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      callbacks.swap(callbacks_);
+      posted_.store(0);
+    }
+
+    for (auto &cb : callbacks)
+    {
+      cb();
+    }
+
+    return callbacks.size();
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<UniqueFunction<void()>> callbacks_;
+  std::atomic<std::size_t> posted_{0};
+};
+
+TEST(WorkStealingDeque, OwnerPopsInLifoOrderThievesInFifoOrder)
+{
+  WorkStealingDeque<int> deque{2};
+
+  for (int i = 0; i != 5; ++i)
+  {
+    deque.push(i);
+  }
+
+  EXPECT_EQ(deque.size(), 5);
+  EXPECT_EQ(deque.steal(), 0);
+  EXPECT_EQ(deque.pop(), 4);
+  EXPECT_EQ(deque.steal(), 1);
+  EXPECT_EQ(deque.pop(), 3);
+  EXPECT_EQ(deque.pop(), 2);
+  EXPECT_FALSE(deque.pop().has_value());
+  EXPECT_FALSE(deque.steal().has_value());
+}
+
+TEST(WorkStealingDeque, ConcurrentStealsTakeEveryElementOnce)
+{
+  static constexpr int count = 100000;
+
+  WorkStealingDeque<int> deque;
+  std::atomic<std::uint64_t> sum{0};
+  std::atomic<std::uint64_t> taken{0};
+  std::atomic_bool pushing{true};
+
+  std::vector<std::thread> thieves;
+  for (int i = 0; i != 3; ++i)
+  {
+    thieves.emplace_back([&] {
+      while (pushing || !deque.empty())
+      {
+        if (auto v = deque.steal(); v)
+        {
+          sum += *v;
+          ++taken;
+        }
+      }
+    });
+  }
+
+  for (int i = 1; i <= count; ++i)
+  {
+    deque.push(i);
+    if (i % 3 == 0)
+    {
+      if (auto v = deque.pop(); v)
+      {
+        sum += *v;
+        ++taken;
+      }
+    }
+  }
+
+  while (auto v = deque.pop())
+  {
+    sum += *v;
+    ++taken;
+  }
+
+  pushing = false;
+  for (auto &t : thieves)
+  {
+    t.join();
+  }
+
+  EXPECT_EQ(taken.load(), count);
+  EXPECT_EQ(sum.load(), static_cast<std::uint64_t>(count) * (count + 1) / 2);
+}
+
+TEST(ThreadPool, RunsAllSubmittedJobs)
+{
+  ThreadPool pool{4};
+  std::atomic<std::uint64_t> counter{0};
+
+  for (int i = 0; i != 10000; ++i)
+  {
+    pool.submit([&] { ++counter; });
+  }
+
+  EXPECT_TRUE(wait_for(counter, 10000));
+}
+
+TEST(ThreadPool, RunsJobsSubmittedFromJobs)
+{
+  ThreadPool pool{4};
+  std::atomic<std::uint64_t> counter{0};
+
+  for (int i = 0; i != 100; ++i)
+  {
+    pool.submit([&] {
+      for (int j = 0; j != 100; ++j)
+      {
+        pool.submit([&] { ++counter; });
+      }
+    });
+  }
+
+  EXPECT_TRUE(wait_for(counter, 10000));
+}
+
+TEST(ThreadPool, SubmittingSmallJobsDoesNotAllocate)
+{
+  ThreadPool pool{2};
+  std::atomic<std::uint64_t> counter{0};
+
+  /*
+   * Warm up the job free list, so that it already holds the nodes needed below.
+   */
+  for (int i = 0; i != 1000; ++i)
+  {
+    pool.submit([&] { ++counter; });
+  }
+
+  ASSERT_TRUE(wait_for(counter, 1000));
+
+  std::array<std::uint64_t, 4> captured{1, 2, 3, 4};
+
+  auto before = allocations_count;
+  for (int i = 0; i != 32; ++i)
+  {
+    pool.submit([&counter, captured] { counter += captured[0]; });
+  }
+  auto after = allocations_count;
+
+  EXPECT_EQ(after, before);
+  EXPECT_TRUE(wait_for(counter, 1032));
+}
+
+/**
+ * \brief A job keeping the single worker of a pool busy until it is opened.
+ */
+class Gate
+{
+public:
+  explicit Gate(ThreadPool &pool)
+  {
+    pool.submit([this] {
+      entered = 1;
+      while (!opened.load())
+      {
+        std::this_thread::yield();
+      }
+    });
+
+    wait_for(entered, 1);
+  }
+
+  void open()
+  {
+    opened = true;
+  }
+
+  ~Gate()
+  {
+    open();
+  }
+
+private:
+  std::atomic<std::uint64_t> entered{0};
+  std::atomic_bool opened{false};
+};
+
+TEST(ThreadPool, RunsJobsByPriority)
+{
+  ThreadPool pool{1};
+  std::mutex mutex;
+  std::vector<char> order;
+  std::atomic<std::uint64_t> counter{0};
+
+  auto record = [&](char name) {
+    std::lock_guard<std::mutex> lock{mutex};
+    order.push_back(name);
+    ++counter;
+  };
+
+  Gate gate{pool};
+  pool.submit(ThreadPool::Priority::LOW, record, 'l');
+  pool.submit(record, 'n');
+  pool.submit(ThreadPool::Priority::HIGH, record, 'h');
+
+  EXPECT_EQ(pool.queue_stats(ThreadPool::Priority::HIGH).depth, 1);
+  EXPECT_EQ(pool.queue_stats(ThreadPool::Priority::NORMAL).depth, 1);
+  EXPECT_EQ(pool.queue_stats(ThreadPool::Priority::LOW).depth, 1);
+
+  gate.open();
+  ASSERT_TRUE(wait_for(counter, 3));
+  EXPECT_EQ(order, (std::vector<char>{'h', 'n', 'l'}));
+  EXPECT_EQ(pool.queue_stats(ThreadPool::Priority::NORMAL).depth, 0);
+}
+
+TEST(ThreadPool, RejectsJobsWhenQueueIsFull)
+{
+  ThreadPool pool{1};
+  std::atomic<std::uint64_t> counter{0};
+
+  Gate gate{pool};
+  pool.set_queue_limit(ThreadPool::Priority::NORMAL, {2, ThreadPool::Overflow::REJECT});
+
+  pool.submit([&] { ++counter; });
+  pool.submit([&] { ++counter; });
+  EXPECT_THROW(pool.submit([&] { ++counter; }), QueueFullError);
+  EXPECT_FALSE(pool.try_submit(ThreadPool::Priority::NORMAL, [&] { ++counter; }));
+  EXPECT_TRUE(pool.try_submit(ThreadPool::Priority::HIGH, [&] { ++counter; }));
+
+  auto stats = pool.queue_stats(ThreadPool::Priority::NORMAL);
+  EXPECT_EQ(stats.depth, 2);
+  EXPECT_EQ(stats.rejected, 1);
+
+  gate.open();
+  EXPECT_TRUE(wait_for(counter, 3));
+}
+
+TEST(ThreadPool, BlocksSubmittersUntilQueueHasRoom)
+{
+  ThreadPool pool{1};
+  std::atomic<std::uint64_t> counter{0};
+  std::atomic_bool submitted{false};
+
+  Gate gate{pool};
+  pool.set_queue_limit(ThreadPool::Priority::NORMAL, {1, ThreadPool::Overflow::BLOCK});
+  pool.submit([&] { ++counter; });
+
+  std::thread submitter{[&] {
+    pool.submit([&] { ++counter; });
+    submitted = true;
+  }};
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  EXPECT_FALSE(submitted.load());
+
+  gate.open();
+  submitter.join();
+
+  EXPECT_TRUE(submitted.load());
+  EXPECT_TRUE(wait_for(counter, 2));
+  EXPECT_EQ(pool.queue_stats(ThreadPool::Priority::NORMAL).blocked, 1);
+}
+
+TEST(ThreadPool, WorkersRunJobsInPlaceInsteadOfBlocking)
+{
+  ThreadPool pool{1};
+  std::atomic<std::uint64_t> counter{0};
+
+  pool.set_queue_limit(ThreadPool::Priority::NORMAL, {1, ThreadPool::Overflow::BLOCK});
+  pool.submit([&] {
+    for (int i = 0; i != 10; ++i)
+    {
+      pool.submit([&] { ++counter; });
+    }
+  });
+
+  EXPECT_TRUE(wait_for(counter, 10));
+}
+
+TEST(ThreadPool, ElasticPoolGrowsWhileJobsWaitAndShrinksWhenIdle)
+{
+  ThreadPool::ElasticOptions options;
+  options.min_workers = 1;
+  options.max_workers = 4;
+  options.target_wait = std::chrono::milliseconds{1};
+  options.idle_timeout = std::chrono::milliseconds{50};
+
+  ThreadPool pool{options};
+  ASSERT_EQ(pool.size(), 1);
+  ASSERT_EQ(pool.max_size(), 4);
+
+  std::atomic_bool released{false};
+  std::atomic<std::uint64_t> finished{0};
+  std::uint64_t submitted = 0;
+
+  /*
+   * Jobs blocking the workers keep the queue from moving, until the pool reaches its maximum.
+   */
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (pool.size() < 4 && std::chrono::steady_clock::now() < deadline)
+  {
+    pool.submit([&] {
+      while (!released.load())
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      }
+      ++finished;
+    });
+    ++submitted;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{5});
+  }
+
+  EXPECT_EQ(pool.size(), 4);
+
+  released = true;
+  ASSERT_TRUE(wait_for(finished, submitted));
+
+  auto stats = pool.wait_time_stats();
+  EXPECT_GT(stats.samples, 0);
+  EXPECT_LE(stats.samples, submitted);
+  EXPECT_GE(stats.p99, std::chrono::milliseconds{1});
+  EXPECT_LE(stats.p50, stats.p90);
+  EXPECT_LE(stats.p90, stats.p99);
+
+  deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (pool.size() > 1 && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+
+  EXPECT_EQ(pool.size(), 1);
+
+  /*
+   * The remaining worker still runs jobs, and retired slots can be used again.
+   */
+  std::atomic<std::uint64_t> counter{0};
+  for (int i = 0; i != 1000; ++i)
+  {
+    pool.submit([&] { ++counter; });
+  }
+
+  EXPECT_TRUE(wait_for(counter, 1000));
+}
+
+TEST(LatencyHistogram, ComputesPercentiles)
+{
+  LatencyHistogram histogram;
+  for (int i = 0; i != 90; ++i)
+  {
+    histogram.record(std::chrono::nanoseconds{100});
+  }
+
+  for (int i = 0; i != 10; ++i)
+  {
+    histogram.record(std::chrono::microseconds{100});
+  }
+
+  auto snapshot = LatencyHistogram::Snapshot{}.add(histogram);
+  EXPECT_EQ(snapshot.samples(), 100);
+  EXPECT_EQ(snapshot.percentile(50), std::chrono::nanoseconds{128});
+  EXPECT_EQ(snapshot.percentile(99), std::chrono::nanoseconds{131072});
+}
+
+TEST(ThreadPool, SubmitAsyncResumesOnExecutor)
+{
+  ThreadPool pool{2};
+  ManualExecutor loop;
+
+  auto completion = pool.submit_async(loop, [](int a, int b) { return a + b; }, 20, 22);
+
+  int result = 0;
+  std::thread::id resumed_on;
+  completion.then([&](int value) {
+    result = value;
+    resumed_on = std::this_thread::get_id();
+  });
+
+  ASSERT_EQ(loop.run_posted(), 1);
+  EXPECT_TRUE(completion.ready());
+  EXPECT_EQ(result, 42);
+  EXPECT_EQ(resumed_on, std::this_thread::get_id());
+}
+
+TEST(ThreadPool, SubmitAsyncAttachesContinuationAfterCompletion)
+{
+  ThreadPool pool{2};
+  ManualExecutor loop;
+
+  auto completion = pool.submit_async(loop, [] {});
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+  while (!completion.ready() && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::yield();
+  }
+
+  ASSERT_TRUE(completion.ready());
+
+  bool called = false;
+  completion.then([&] { called = true; });
+
+  ASSERT_EQ(loop.run_posted(), 1);
+  EXPECT_TRUE(called);
+}
+
+TEST(ThreadPool, SubmitAsyncDeliversExceptions)
+{
+  ThreadPool pool{2};
+  ManualExecutor loop;
+
+  auto completion
+      = pool.submit_async(loop, []() -> std::string { throw std::runtime_error{"failed"}; });
+
+  std::string message;
+  completion.then([](std::string) { FAIL(); },
+      [&](std::exception_ptr error) {
+        try
+        {
+          std::rethrow_exception(error);
+        }
+        catch (const std::runtime_error &e)
+        {
+          message = e.what();
+        }
+      });
+
+  ASSERT_EQ(loop.run_posted(), 1);
+  EXPECT_EQ(message, "failed");
+}
+
+TEST(ThreadPool, DroppedJobsCompleteWithBrokenPromise)
+{
+  ThreadPool pool{1};
+  ManualExecutor loop;
+  std::atomic_bool started{false};
+  std::atomic_bool release{false};
+
+  /*
+   * The only worker is kept busy, so that the jobs submitted next are still queued when the pool
+   * is closed.
+   */
+  pool.submit([&] {
+    started = true;
+    while (!release)
+    {
+      std::this_thread::yield();
+    }
+  });
+
+  while (!started)
+  {
+    std::this_thread::yield();
+  }
+
+  std::atomic_bool ran{false};
+  auto single = pool.submit_async(loop, [&ran] { ran = true; });
+
+  std::vector<ThreadPool::Task> tasks;
+  for (int i = 0; i != 3; ++i)
+  {
+    tasks.emplace_back([&ran] { ran = true; });
+  }
+
+  auto batch = pool.submit_batch(loop, tasks.begin(), tasks.end());
+
+  std::vector<std::string> errors;
+  auto on_error = [&errors](std::exception_ptr error) {
+    try
+    {
+      std::rethrow_exception(error);
+    }
+    catch (const std::future_error &e)
+    {
+      errors.push_back(e.code() == std::future_errc::broken_promise ? "broken" : "other");
+    }
+  };
+
+  single.then([] { FAIL(); }, on_error);
+  batch.then([] { FAIL(); }, on_error);
+
+  std::thread closer{[&pool] { pool.close(); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  release = true;
+  closer.join();
+
+  for (int i = 0; i != 2 && errors.size() != 2; ++i)
+  {
+    loop.run_posted();
+  }
+
+  EXPECT_FALSE(ran);
+  EXPECT_EQ(errors, (std::vector<std::string>{"broken", "broken"}));
+}
+
+TEST(ThreadPool, SubmitBatchCompletesOnceAllJobsFinished)
+{
+  ThreadPool pool{4};
+  ManualExecutor loop;
+  std::atomic<std::uint64_t> counter{0};
+
+  std::vector<ThreadPool::Task> tasks;
+  for (int i = 0; i != 1000; ++i)
+  {
+    tasks.emplace_back([&counter] { ++counter; });
+  }
+
+  auto completion = pool.submit_batch(loop, tasks.begin(), tasks.end());
+
+  std::uint64_t seen = 0;
+  completion.then([&] { seen = counter.load(); });
+
+  ASSERT_EQ(loop.run_posted(), 1);
+  EXPECT_EQ(seen, 1000);
+  EXPECT_EQ(pool.queue_stats(ThreadPool::Priority::NORMAL).depth, 0);
+}
+
+TEST(ThreadPool, ParallelForCoversTheRangeOnce)
+{
+  ThreadPool pool{4};
+  ManualExecutor loop;
+
+  std::vector<std::atomic<int>> hits(10007);
+  std::atomic<std::uint64_t> chunks{0};
+
+  auto mark = [&](std::size_t from, std::size_t to) {
+    EXPECT_LE(to - from, 64);
+    for (auto i = from; i != to; ++i)
+    {
+      ++hits[i];
+    }
+    ++chunks;
+  };
+
+  auto completion = pool.parallel_for(loop, 0, hits.size(), 64, mark);
+
+  auto done = false;
+  completion.then([&] { done = true; });
+
+  ASSERT_EQ(loop.run_posted(), 1);
+  EXPECT_TRUE(done);
+  EXPECT_EQ(chunks.load(), (hits.size() + 63) / 64);
+  for (const auto &hit : hits)
+  {
+    ASSERT_EQ(hit.load(), 1);
+  }
+}
+
+TEST(ThreadPool, ParallelForCompletesEmptyRanges)
+{
+  ThreadPool pool{2};
+  ManualExecutor loop;
+
+  auto done = false;
+  pool.parallel_for(loop, 5, 5, 0, [](std::size_t, std::size_t) { FAIL(); }).then([&] {
+    done = true;
+  });
+
+  ASSERT_EQ(loop.run_posted(), 1);
+  EXPECT_TRUE(done);
+}
+
+TEST(ThreadPool, ParallelForDeliversExceptions)
+{
+  ThreadPool pool{2};
+  ManualExecutor loop;
+
+  auto completion = pool.parallel_for(loop, 0, 100, 10, [](std::size_t from, std::size_t) {
+    if (from == 50)
+    {
+      throw std::runtime_error{"chunk failed"};
+    }
+  });
+
+  std::string message;
+  completion.then([] { FAIL(); },
+      [&](std::exception_ptr error) {
+        try
+        {
+          std::rethrow_exception(error);
+        }
+        catch (const std::runtime_error &e)
+        {
+          message = e.what();
+        }
+      });
+
+  ASSERT_EQ(loop.run_posted(), 1);
+  EXPECT_EQ(message, "chunk failed");
+}
+
+TEST(ThreadPool, ParallelForRunsFromJobs)
+{
+  ThreadPool pool{2};
+  ManualExecutor loop;
+  std::atomic<std::uint64_t> sum{0};
+
+  pool.submit([&] {
+    auto sum_range = [&](std::size_t from, std::size_t to) {
+      for (auto i = from; i != to; ++i)
+      {
+        sum += i;
+      }
+    };
+
+    pool.parallel_for(loop, 1, 1001, 0, sum_range).then([] {});
+  });
+
+  ASSERT_EQ(loop.run_posted(), 1);
+  EXPECT_EQ(sum.load(), 500500);
+}
+
+TEST(UniqueFunction, StoresSmallCallablesInline)
+{
+  int calls = 0;
+
+  auto before = allocations_count;
+  UniqueFunction<int(int)> fn{[&calls](int x) {
+    ++calls;
+    return x * 2;
+  }};
+  auto moved = std::move(fn);
+  auto after = allocations_count;
+
+  EXPECT_EQ(after, before);
+  EXPECT_FALSE(static_cast<bool>(fn));
+  EXPECT_EQ(moved(21), 42);
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(UniqueFunction, StoresLargeAndMoveOnlyCallables)
+{
+  std::array<char, 256> large{};
+  large[0] = 'x';
+
+  UniqueFunction<char()> large_fn{[large] { return large[0]; }};
+  EXPECT_EQ(large_fn(), 'x');
+
+  auto ptr = std::make_unique<int>(7);
+  UniqueFunction<int()> move_only_fn{[p = std::move(ptr)] { return *p; }};
+
+  UniqueFunction<int()> other;
+  other = std::move(move_only_fn);
+  EXPECT_EQ(other(), 7);
+}
+
+}  // namespace microloop::utils
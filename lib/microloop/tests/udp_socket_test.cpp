@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "microloop/event_sources/net/udp_socket.h"
+
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <cstdint>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+namespace microloop::event_sources::net
+{
+
+/**
+ * \brief Get the loopback address of the same family the socket is bound to.
+ */
+static std::pair<sockaddr_storage, socklen_t> loopback_of(const UdpSocket &sock)
+{
+  auto [addr, addrlen] = sock.local_address();
+
+  if (addr.ss_family == AF_INET6)
+  {
+    reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_addr = in6addr_loopback;
+  }
+  else
+  {
+    reinterpret_cast<sockaddr_in *>(&addr)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+
+  return std::make_pair(addr, addrlen);
+}
+
+TEST(UdpSocket, ReceivesInBatches)
+{
+  UdpSocket::Options options;
+  options.batch_size = 4;
+  options.max_batches_per_tick = 1;
+
+  UdpSocket receiver{0, options};
+  UdpSocket sender{0};
+
+  auto [addr, addrlen] = loopback_of(receiver);
+
+  std::vector<std::string> payloads{"a", "bb", "ccc", "dddd", "eeeee", "ffffff"};
+  std::vector<OutgoingDatagram> outgoing;
+  for (const auto &p : payloads)
+  {
+    outgoing.push_back(OutgoingDatagram{reinterpret_cast<sockaddr *>(&addr), addrlen, p});
+  }
+
+  ASSERT_EQ(sender.send_batch(outgoing), payloads.size());
+
+  std::vector<std::size_t> batch_sizes;
+  std::vector<std::string> received;
+  receiver.set_on_recv([&](const std::vector<Datagram> &datagrams) {
+    batch_sizes.push_back(datagrams.size());
+    for (const auto &d : datagrams)
+    {
+      received.emplace_back(d.payload);
+    }
+  });
+
+  receiver.run_callback();
+  receiver.run_callback();
+
+  ASSERT_EQ(batch_sizes, (std::vector<std::size_t>{4, 2}));
+  EXPECT_EQ(received, payloads);
+}
+
+TEST(UdpSocket, DropsTruncatedDatagrams)
+{
+  UdpSocket::Options options;
+  options.max_datagram_size = 8;
+
+  UdpSocket receiver{0, options};
+  UdpSocket sender{0};
+
+  auto [addr, addrlen] = loopback_of(receiver);
+
+  std::vector<std::string> payloads{"short", "much too long", "fits"};
+  std::vector<OutgoingDatagram> outgoing;
+  for (const auto &p : payloads)
+  {
+    outgoing.push_back(OutgoingDatagram{reinterpret_cast<sockaddr *>(&addr), addrlen, p});
+  }
+
+  ASSERT_EQ(sender.send_batch(outgoing), payloads.size());
+
+  std::vector<std::string> received;
+  receiver.set_on_recv([&](const std::vector<Datagram> &datagrams) {
+    for (const auto &d : datagrams)
+    {
+      received.emplace_back(d.payload);
+    }
+  });
+
+  receiver.run_callback();
+
+  EXPECT_EQ(received, (std::vector<std::string>{"short", "fits"}));
+  EXPECT_EQ(receiver.truncated(), 1u);
+}
+
+TEST(UdpSocket, SharesBufferPool)
+{
+  BufferPool pool{2048, 8};
+
+  UdpSocket::Options options;
+  options.batch_size = 8;
+
+  {
+    UdpSocket sock{0, options, &pool};
+    EXPECT_EQ(pool.available(), 0);
+  }
+
+  EXPECT_EQ(pool.available(), 8);
+  EXPECT_EQ(pool.capacity(), 8);
+}
+
+}  // namespace microloop::event_sources::net
@@ -16,28 +16,12 @@ inline constexpr bool is_c_string = std::is_same_v<T, char *> || std::is_same_v<
 template <typename T, typename U>
 std::enable_if_t<!is_c_string<T> && !is_c_string<U>, bool> ends_with(T sv, U needle) noexcept
 {
-  if (needle.empty())
-  {
-    return true;
-  }
-
   if (sv.size() < needle.size())
   {
     return false;
   }
 
-  if (sv == needle)
-  {
-    return true;
-  }
-
-  typename T::size_type p = sv.rfind(needle);
-  if (p == T::npos)
-  {
-    return false;
-  }
-
-  return sv.size() - p == needle.size();
+  return sv.compare(sv.size() - needle.size(), needle.size(), needle) == 0;
 }
 
 template <typename T, typename U>
@@ -49,17 +33,12 @@ std::enable_if_t<is_c_string<T> || is_c_string<U>, bool> ends_with(T sv, U needl
 template <typename T, typename U>
 std::enable_if_t<!is_c_string<T> && !is_c_string<U>, bool> starts_with(T s, U needle) noexcept
 {
-  if (needle.empty() || s == needle)
-  {
-    return true;
-  }
-
-  if (s.empty() || needle.size() > s.size())
+  if (needle.size() > s.size())
   {
     return false;
   }
 
-  return s.find(needle) == 0;
+  return s.compare(0, needle.size(), needle) == 0;
 }
 
 template <typename T, typename U>
@@ -68,4 +47,34 @@ std::enable_if_t<is_c_string<T> || is_c_string<U>, bool> starts_with(T s, U need
   return starts_with(std::string_view(s), std::string_view(needle));
 }
 
+/**
+ * \brief Lowercase an ASCII character. Other characters are returned as they are.
+ */
+constexpr char to_lower_ascii(char c) noexcept
+{
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+/**
+ * \brief Compare two strings, ignoring the case of ASCII letters. This is how HTTP field names are
+ * compared, and unlike `strcasecmp()` it does not depend on the locale.
+ */
+constexpr bool iequals(std::string_view a, std::string_view b) noexcept
+{
+  if (a.size() != b.size())
+  {
+    return false;
+  }
+
+  for (std::size_t i = 0; i != a.size(); ++i)
+  {
+    if (to_lower_ascii(a[i]) != to_lower_ascii(b[i]))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 }  // namespace utils::string
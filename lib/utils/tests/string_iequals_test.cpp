@@ -0,0 +1,36 @@
+//
+// Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
+//
+
+#include "utils/string.h"
+
+#include "gtest/gtest.h"
+#include <string>
+#include <tuple>
+
+namespace utils::string
+{
+
+class IEqualsTest : public testing::TestWithParam<std::tuple<std::string, std::string, bool>>
+{};
+
+TEST_P(IEqualsTest, IgnoresAsciiCase)
+{
+  auto [a, b, expected] = GetParam();
+
+  EXPECT_EQ(iequals(a, b), expected);
+  EXPECT_EQ(iequals(b, a), expected);
+}
+
+TEST(IEqualsTest, IsConstexpr)
+{
+  static_assert(iequals("Content-Length", "content-length"));
+  static_assert(!iequals("Content-Length", "Content-Type"));
+}
+
+INSTANTIATE_TEST_CASE_P(Utils, IEqualsTest,
+    testing::Values(std::make_tuple("", "", true), std::make_tuple("Host", "host", true),
+        std::make_tuple("HOST", "host", true), std::make_tuple("host", "hosts", false),
+        std::make_tuple("a-b", "A_B", false), std::make_tuple("\xc3\x89", "\xc3\xa9", false)));
+
+}  // namespace utils::string
@@ -2,93 +2,19 @@
 // Copyright (c) 2019 by Victor Barbu. All Rights Reserved.
 //
 
-#include "microhttp/request_parser.h"
-#include "microloop/net/tcp_server.h"
-#include "microhttp/http_response.h"
+#include "microhttp/basic_http_server.h"
+#include "microhttp/static_files.h"
 
-#include <chrono>
-#include <errno.h>
-#include <fcntl.h>
-#include <functional>
 #include <iostream>
 #include <limits>
-#include <map>
-#include <sstream>
 #include <stdexcept>
-#include <stdlib.h>
 #include <string>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
-
-using namespace microloop;
-
-struct BasicHttpServer
-{
-  microloop::net::TcpServer server_;
-  std::map<std::int32_t, microhttp::http::RequestParser> clients_;
-
-  BasicHttpServer(int port) : server_{port}
-  {
-    server_.set_connection_callback(&BasicHttpServer::on_conn, this);
-    server_.set_data_callback(&BasicHttpServer::on_data, this);
-  }
-
-  void on_conn(net::TcpServer::PeerConnection &conn)
-  {
-    if (clients_.find(conn.fd()) == clients_.end())
-    {
-      clients_[conn.fd()] = microhttp::http::RequestParser();
-    }
-  }
-
-  void on_data(net::TcpServer::PeerConnection &conn, const microloop::Buffer &buf)
-  {
-    if (buf.empty())
-    {
-      clients_.erase(conn.fd());
-      server_.close_conn(conn);
-
-      return;
-    }
-
-    auto t1 = std::chrono::high_resolution_clock::now();
-
-    auto &parser = clients_[conn.fd()];
-    parser.add_chunk(buf);
-
-    microloop::Buffer content{
-        "<html><head><title>Micro Server</title></head><body><h1>Micro HTTP</h1><p>This is the "
-        "<code>microhttp</code> framework powered by <code>microloop</code>.</body></html>"};
-
-    microhttp::http::HttpResponse response{content};
-    response.set_header("Server", "microhttp");
-    response.set_header("Tag", 12);
-    conn.send(response.format<microloop::Buffer>());
-
-    const auto &request = parser.get_parsed_request();
-
-    auto t2 = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> dur_ms{t2 - t1};
-
-    std::cout << "[" << conn.str() << "] " << request.get_http_method() << " " << request.get_uri()
-              << " - " << dur_ms.count() << "ms\n";
-
-    clients_[conn.fd()].reset();
-  }
-
-  void run()
-  {
-    while (MICROLOOP_TICK())
-      ;
-  }
-};
 
 int main(int argc, char **argv)
 {
   if (argc < 2)
   {
-    std::cerr << "usage: " << argv[0] << " <port>\n";
+    std::cerr << "usage: " << argv[0] << " <port> [root]\n";
     return -1;
   }
 
@@ -98,6 +24,9 @@ int main(int argc, char **argv)
     throw std::range_error("invalid port");
   }
 
-  static BasicHttpServer server{port};
+  static microhttp::http::StaticFiles files{argc > 2 ? argv[2] : "."};
+
+  static microhttp::BasicHttpServer server{static_cast<std::uint16_t>(port)};
+  server.serve_files("/*path", files);
   server.run();
 }